@@ -20,6 +20,7 @@
 #include "Game.h"
 
 #include <Deserializer/Scene3DDeserializer.h>
+#include <Input/InputRecording.h>
 
 #include <ECS/ECS.h>
 #include <Components/TransformComponent.h>
@@ -29,16 +30,29 @@
 #include <Systems/Movement3DSystem.h>
 #include <Systems/ModelRender3DSystem.h>
 #include <Systems/EntityStartup3DSystem.h>
+#include <Systems/PointLight3DSystem.h>
 
 using namespace engine;
 
 namespace game
 {
-	Game::Game(Window& window, Kernel& kernel, std::shared_ptr<EventBus> eventBus)
+	/// <summary>
+	/// Time per frame the asset manager can spend finishing assets loaded in the background.
+	/// </summary>
+	const double ASSET_UPLOAD_BUDGET_MS = 2.0;
+	/// <summary>
+	/// Memory textures, sounds, fonts and meshes can take together before unused ones get evicted.
+	/// </summary>
+	const size_t ASSET_MEMORY_BUDGET = 256 * 1024 * 1024;
+
+	Game::Game(Window& window, Kernel& kernel, std::shared_ptr<EventBus> eventBus, std::shared_ptr<InputState> inputState)
 	{
 		registry = std::make_unique<Registry>();
 		assetManager = std::make_unique<AssetManager>();
+		assetManager->SetMemoryBudget(ASSET_MEMORY_BUDGET);
+		renderResources = std::make_unique<RenderResourceRegistry>();
 		this->eventBus = eventBus;
+		this->inputState = inputState;
 
 		this->kernel = &kernel;
 		this->window = &window;
@@ -53,81 +67,73 @@ namespace game
 	void Game::SetupScene()
 	{
 		/*
-		*	We tell the eventBus (event manager for all entities) that we are listening for all events of the type InputEvent.
-		*	eventBus will call the function we pass as parameter whenever the event is fired.
+		*	We start loading the .wav sounds we want to use in this demo. They are decoded by the job system
+		*	while the scene is built.
 		*/
-		eventBus->AddEventListener<InputEvent>(this, &Game::OnInputRegistered);
+		sound = assetManager->LoadSoundAsync("hit", "../../../assets/sounds/hit.wav");
+		death = assetManager->LoadSoundAsync("death", "../../../assets/sounds/death.wav");
+		Mix_Volume(-1, 60);
+
 		/*
 		*	Deserializes and spawns all static objects - In this demo, the four walls.
 		*/
-		Scene3DDeserializer deserializer("../../../assets/scenes/test.scene", registry.get(), window);
+		Scene3DDeserializer deserializer("../../../assets/scenes/test.scene", registry.get(), window, renderResources.get());
 		deserializer.Initialize();
 
 		/*
-		*	We load up the .wav sounds we want to use in this demo.
+		*	Meshes are GL objects: the asset manager builds and deletes them wherever the GL context is, the render thread's when it runs.
 		*/
-		sound = Mix_LoadWAV("../../../assets/sounds/hit.wav");
-		if (sound == NULL)
-		{
-			spdlog::error("Couldn't load .wav from the wanted path");
-		}
-		death = Mix_LoadWAV("../../../assets/sounds/death.wav");
-		Mix_Volume(-1, 60);
+		assetManager->SetGlContextRunner([this](std::function<void()> work)
+			{
+				registry->GetSystem<ModelRender3DSystem>().RunOnRenderThread(std::move(work));
+			});
 
 		/*
 		*	We start up and add all needed components to the dynamic (moving) entities.
 		*/
 
 		player = registry->CreateEntity();
-		std::shared_ptr< glt::Model  > cubeModel(new glt::Model);
-		cubeModel->add(std::shared_ptr<glt::Drawable>(new glt::Cube), glt::Material::default_material());
+		std::shared_ptr< glt::Model  > cubeModel = renderResources->CreateCubeModel();
 		player.AddComponent<RigidbodyComponent>(glm::vec3(0.f, 0, 0), glm::vec3(0.f, 0.f, 0.f));
 		player.AddComponent<TransformComponent>(glm::vec3(0, 0, -20.f), glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
 		player.AddComponent<Node3DComponent>("cube", cubeModel);
 
 		Entity rightArm = registry->CreateEntity();
-		std::shared_ptr< glt::Model  > cube2Model(new glt::Model);
-		cube2Model->add(std::shared_ptr<glt::Drawable>(new glt::Cube), glt::Material::default_material());
+		std::shared_ptr< glt::Model  > cube2Model = renderResources->CreateCubeModel();
 		rightArm.AddComponent<TransformComponent>(glm::vec3(1, 1, 0.f), glm::vec3(0, 0, 0), glm::vec3(0.2f, 1, 0.2f), &player);
 		rightArm.AddComponent<Node3DComponent>("rightArm", cube2Model);
 
 		Entity leftArm = registry->CreateEntity();
-		std::shared_ptr< glt::Model  > cube3Model(new glt::Model);
-		cube3Model->add(std::shared_ptr<glt::Drawable>(new glt::Cube), glt::Material::default_material());
+		std::shared_ptr< glt::Model  > cube3Model = renderResources->CreateCubeModel();
 		leftArm.AddComponent<TransformComponent>(glm::vec3(-1, 1, 0.f), glm::vec3(0, 0, 0), glm::vec3(0.2f, 1, 0.2f), &player);
 		leftArm.AddComponent<Node3DComponent>("leftArm", cube3Model);
 
 		Entity head = registry->CreateEntity();
-		std::shared_ptr< glt::Model  > cube4Model(new glt::Model);
-		cube4Model->add(std::shared_ptr<glt::Drawable>(new glt::Cube), glt::Material::default_material());
+		std::shared_ptr< glt::Model  > cube4Model = renderResources->CreateCubeModel();
 		head.AddComponent<TransformComponent>(glm::vec3(0, 0.5f, 1.f), glm::vec3(0, 0, 0), glm::vec3(0.7f, 0.7f, 0.7f), &player);
 		head.AddComponent<Node3DComponent>("head", cube4Model);
 
 		enemies[0] = registry->CreateEntity();
-		std::shared_ptr< glt::Model  > enemyTopRightModel(new glt::Model);
-		enemyTopRightModel->add(std::shared_ptr<glt::Drawable>(new glt::Cube), glt::Material::default_material());
+		std::shared_ptr< glt::Model  > enemyTopRightModel = renderResources->CreateCubeModel();
 		enemies[0].AddComponent<RigidbodyComponent>(glm::vec3(0, 0, 0), glm::vec3(0.f, 0.f, 0.f));
 		enemies[0].AddComponent<TransformComponent>(glm::vec3(36, 14, -20.f), glm::vec3(0, 0, 0), glm::vec3(.4f, .4f, .4f));
 		enemies[0].AddComponent<Node3DComponent>("enemyTopRight", enemyTopRightModel);
 
 		enemies[1] = registry->CreateEntity();
-		std::shared_ptr< glt::Model  > enemyTopLeftModel(new glt::Model);
-		enemyTopLeftModel->add(std::shared_ptr<glt::Drawable>(new glt::Cube), glt::Material::default_material());
+		std::shared_ptr< glt::Model  > enemyTopLeftModel = renderResources->CreateCubeModel();
 		enemies[1].AddComponent<RigidbodyComponent>(glm::vec3(0, 0, 0), glm::vec3(0.f, 0.f, 0.f));
 		enemies[1].AddComponent<TransformComponent>(glm::vec3(-36, 14, -20.f), glm::vec3(0, 0, 0), glm::vec3(.4f, .4f, .4f));
 		enemies[1].AddComponent<Node3DComponent>("enemyTopLeft", enemyTopLeftModel);
 
 		enemies[2] = registry->CreateEntity();
-		std::shared_ptr< glt::Model  > enemyBotRightModel(new glt::Model);
-		enemyBotRightModel->add(std::shared_ptr<glt::Drawable>(new glt::Cube), glt::Material::default_material());
+		std::shared_ptr< glt::Model  > enemyBotRightModel = renderResources->CreateCubeModel();
 		enemies[2].AddComponent<RigidbodyComponent>(glm::vec3(0, 0, 0), glm::vec3(0.f, 0.f, 0.f));
 		enemies[2].AddComponent<TransformComponent>(glm::vec3(36, -14, -20.f), glm::vec3(0, 0, 0), glm::vec3(.4f, .4f, .4f));
 		enemies[2].AddComponent<TransformComponent>(glm::vec3(36, -14, -20.f), glm::vec3(0, 0, 0), glm::vec3(.4f, .4f, .4f));
 		enemies[2].AddComponent<Node3DComponent>("enemyBotRight", enemyBotRightModel);
 
 		enemies[3] = registry->CreateEntity();
-		std::shared_ptr< glt::Model  > enemyBotLeftModel(new glt::Model);
-		enemyBotLeftModel->add(std::shared_ptr<glt::Drawable>(new glt::Cube), glt::Material::default_material());
+		std::shared_ptr< glt::Model  > enemyBotLeftModel = renderResources->CreateCubeModel();
 		enemies[3].AddComponent<RigidbodyComponent>(glm::vec3(0, 0, 0), glm::vec3(0.f, 0.f, 0.f));
 		enemies[3].AddComponent<TransformComponent>(glm::vec3(-36, -14, -20.f), glm::vec3(0, 0, 0), glm::vec3(.4f, .4f, .4f));
 		enemies[3].AddComponent<Node3DComponent>("enemyBotLeft", enemyBotLeftModel);
@@ -149,11 +155,32 @@ namespace game
 		*	Telling the kernel what tasks does it need to initialize and what tasks does it have to keep running in loop.
 		*/
 		//Update registry to process the entities that are waiting
+		assetManager->WaitAll();
 		kernel->InitializeTask(*registry);
 		kernel->InitializeTask(registry->GetSystem<ModelRender3DSystem>());
 		kernel->InitializeTask(registry->GetSystem<EntityStartup3DSystem>());
 		kernel->AddRunningTask(registry->GetSystem<Movement3DSystem>());
 		kernel->AddRunningTask(registry->GetSystem<ModelRender3DSystem>());
+
+		registry->GetSystem<ModelRender3DSystem>().SetFrameStats(kernel->GetFrameStats(), inputState);
+		registry->GetSystem<ModelRender3DSystem>().SetRenderResources(renderResources.get());
+		registry->GetSystem<ModelRender3DSystem>().EnableOcclusionCulling(true);
+		if (registry->HasSystem<PointLight3DSystem>())
+		{
+			registry->GetSystem<ModelRender3DSystem>().SetPointLights(&registry->GetSystem<PointLight3DSystem>());
+		}
+		renderResources->LogStats();
+	}
+
+	void Game::EnableLowLatencyMode(InputPollingTask& inputPoller)
+	{
+		this->inputPoller = &inputPoller;
+		registry->GetSystem<ModelRender3DSystem>().SetLateLatch(this);
+	}
+
+	void Game::EnableRenderThread(bool enable)
+	{
+		registry->GetSystem<ModelRender3DSystem>().EnableRenderThread(enable);
 	}
 
 	/*
@@ -161,6 +188,21 @@ namespace game
 	*/
 	void Game::Run(float deltaTime)
 	{
+		/*
+		*	Input is read from the snapshot the input task built this frame, instead of reacting to every InputEvent.
+		*/
+		const InputSnapshot input = inputState->Read();
+		assetManager->Update(ASSET_UPLOAD_BUDGET_MS);
+		if (input.WasPressed(InputEvent::Action::QUIT))
+		{
+			//The render thread must let go of the GL context before SDL shuts down.
+			EnableRenderThread(false);
+			kernel->Stop();
+			return;
+		}
+		ApplyInput(input);
+		lastDeltaTime = deltaTime;
+
 		/*
 		*	Restraining player movement...
 		*/
@@ -171,7 +213,7 @@ namespace game
 			auto& transform = player.GetComponent<TransformComponent>();
 			transform.position.y = 13.95f;
 			registry->GetSystem<Movement3DSystem>().MoveToPosition(player, transform.position);
-			Mix_PlayChannel(-1, sound, 0);
+			Mix_PlayChannel(-1, sound.Get(), 0);
 		}
 
 		if (playerTransform.position.y < -14)
@@ -179,7 +221,7 @@ namespace game
 			auto& transform = player.GetComponent<TransformComponent>();
 			transform.position.y = -13.95f;
 			registry->GetSystem<Movement3DSystem>().MoveToPosition(player, transform.position);
-			Mix_PlayChannel(-1, sound, 0);
+			Mix_PlayChannel(-1, sound.Get(), 0);
 		}
 
 		if (playerTransform.position.x > 35)
@@ -187,7 +229,7 @@ namespace game
 			auto& transform = player.GetComponent<TransformComponent>();
 			transform.position.x = 34.95f;
 			registry->GetSystem<Movement3DSystem>().MoveToPosition(player, transform.position);
-			Mix_PlayChannel(-1, sound, 0);
+			Mix_PlayChannel(-1, sound.Get(), 0);
 		}
 
 		if (playerTransform.position.x < -35)
@@ -195,7 +237,7 @@ namespace game
 			auto& transform = player.GetComponent<TransformComponent>();
 			transform.position.x = -34.95f;
 			registry->GetSystem<Movement3DSystem>().MoveToPosition(player, transform.position);
-			Mix_PlayChannel(-1, sound, 0);
+			Mix_PlayChannel(-1, sound.Get(), 0);
 		}
 
 		/*
@@ -214,7 +256,7 @@ namespace game
 			*/
 			if (movement3DSystem.Distance(playerTransform.position, transform.position) < 1.f)
 			{
-				Mix_PlayChannel(-1, death, 0);
+				Mix_PlayChannel(-1, death.Get(), 0);
 				movement3DSystem.ResetTransform(player);
 				for (auto e : enemies)
 				{
@@ -226,26 +268,51 @@ namespace game
 
 	}
 
-	void Game::OnInputRegistered(InputEvent& event)
+	void Game::ApplyInput(const InputSnapshot& input)
 	{
 		RigidbodyComponent& cubeRigidbody = player.GetComponent<RigidbodyComponent>();
-		switch (event.action)
+		float forward = input.GetValue(InputEvent::Action::FORWARD) - input.GetValue(InputEvent::Action::BACKWARDS);
+		float turn = input.GetValue(InputEvent::Action::LEFT) - input.GetValue(InputEvent::Action::RIGHT);
+
+		cubeRigidbody.velocity = glm::vec3(cubeRigidbody.velocity.x, 8 * forward, cubeRigidbody.velocity.z);
+		cubeRigidbody.angularVelocity = glm::vec3(0, 0, 2 * turn);
+	}
+
+	void Game::Latch()
+	{
+		inputPoller->Sample();
+
+		const InputSnapshot input = inputState->Read();
+		float forward = input.GetValue(InputEvent::Action::FORWARD) - input.GetValue(InputEvent::Action::BACKWARDS);
+		float turn = input.GetValue(InputEvent::Action::LEFT) - input.GetValue(InputEvent::Action::RIGHT);
+		float latchedForward = inputState->PeekValue(InputEvent::Action::FORWARD) - inputState->PeekValue(InputEvent::Action::BACKWARDS);
+		float latchedTurn = inputState->PeekValue(InputEvent::Action::LEFT) - inputState->PeekValue(InputEvent::Action::RIGHT);
+
+		/*
+		*	Same speeds as ApplyInput(). Children (arms, head) follow the player's node.
+		*/
+		glt::Node* playerNode = player.GetComponent<Node3DComponent>().node.get();
+		unlatchedPlayerTransformation = playerNode->get_transformation();
+		playerNode->translate(glm::vec3(0, 8 * (latchedForward - forward) * lastDeltaTime, 0));
+		playerNode->rotate_around_z(2 * (latchedTurn - turn) * lastDeltaTime);
+	}
+
+	void Game::Unlatch()
+	{
+		player.GetComponent<Node3DComponent>().node->set_transformation(unlatchedPlayerTransformation);
+	}
+
+	uint64_t Game::ComputeStateChecksum() const
+	{
+		StateChecksum checksum;
+		for (auto& entity : registry->GetSystem<Movement3DSystem>().GetSystemEntities())
 		{
-		case InputEvent::Action::QUIT:
-			kernel->Stop();
-			break;
-		case InputEvent::Action::FORWARD:
-			cubeRigidbody.velocity = glm::vec3(cubeRigidbody.velocity.x, 8 * event.value, cubeRigidbody.velocity.z);
-			break;
-		case InputEvent::Action::BACKWARDS:
-			cubeRigidbody.velocity = glm::vec3(cubeRigidbody.velocity.x, -8 * event.value, cubeRigidbody.velocity.z);
-			break;
-		case InputEvent::Action::LEFT:
-			cubeRigidbody.angularVelocity = glm::vec3(0, 0, 2 * event.value);
-			break;
-		case InputEvent::Action::RIGHT:
-			cubeRigidbody.angularVelocity = glm::vec3(0, 0, -2 * event.value);
-			break;
+			const TransformComponent& transform = entity.GetComponent<TransformComponent>();
+			checksum.Add(entity.GetId());
+			checksum.Add(transform.position);
+			checksum.Add(transform.rotation);
+			checksum.Add(entity.GetComponent<Node3DComponent>().node->get_transformation());
 		}
+		return checksum.Get();
 	}
 }
\ No newline at end of file
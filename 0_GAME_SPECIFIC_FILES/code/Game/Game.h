@@ -7,16 +7,20 @@
 #include <sdl2/SDL_mixer.h>
 #include <ECS/ECS.h>
 #include <AssetManager/AssetManager.h>
+#include <Render/RenderResourceRegistry.h>
 #include <Window/Window.h>
 #include <gltk/Render_Node.hpp>
 #include <Kernel/Kernel.h>
 #include <EventBus/EventBus.h>
 #include <Events/InputEvent.h>
+#include <Input/InputState.h>
+#include <Input/InputPollingTask.h>
+#include <Input/LateLatch.h>
 
 using namespace engine;
 namespace game
 {
-	class Game : public Task
+	class Game : public Task, public LateLatch
 	{
 	private:
 		Window* window;
@@ -25,21 +29,47 @@ namespace game
 
 		std::unique_ptr<Registry> registry;
 		std::unique_ptr<AssetManager> assetManager;
+		std::unique_ptr<RenderResourceRegistry> renderResources;
 		std::shared_ptr<EventBus> eventBus;
+		std::shared_ptr<InputState> inputState;
+		InputPollingTask* inputPoller = nullptr;
 
 	private:
 		Entity player;
 		Entity enemies[4];
 
-		Mix_Chunk* sound;
-		Mix_Chunk* death;
+		AssetHandle<Mix_Chunk> sound;
+		AssetHandle<Mix_Chunk> death;
+
+		float lastDeltaTime = 0;
+		glt::Node::Transformation unlatchedPlayerTransformation;
 
 	public:
-		Game(Window& window, Kernel& kernel, std::shared_ptr<EventBus> eventBus);
+		Game(Window& window, Kernel& kernel, std::shared_ptr<EventBus> eventBus, std::shared_ptr<InputState> inputState);
 		~Game() = default;
 
 		void SetupScene();
 		virtual void Run(float deltaTime);
-		void OnInputRegistered(InputEvent& event);
+		void ApplyInput(const InputSnapshot& input);
+
+		/// <summary>
+		/// Re-samples the input right before rendering and moves the player by the difference between what
+		/// the simulation used this frame and what the input says now. The simulation itself is not touched.
+		/// Call after SetupScene().
+		/// </summary>
+		void EnableLowLatencyMode(InputPollingTask& inputPoller);
+
+		/// <summary>
+		/// Draws on a render thread, one frame behind the simulation (see ModelRender3DSystem::EnableRenderThread()).
+		/// Not combined with the low latency mode, whose corrections come too late for the snapshot.
+		/// </summary>
+		void EnableRenderThread(bool enable);
+		virtual void Latch() override;
+		virtual void Unlatch() override;
+
+		/// <summary>
+		/// Hash of every moving entity's transform, used to check input replays against their recording.
+		/// </summary>
+		uint64_t ComputeStateChecksum() const;
 	};
 }
\ No newline at end of file
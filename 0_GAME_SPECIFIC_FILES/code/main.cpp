@@ -14,6 +14,7 @@
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
 
 #include <sdl2/SDL.h>
+#include <cstdlib>
 #include "Game/Game.h"
 #include "Window/Window.h"
 #include "Kernel/Kernel.h"
@@ -21,34 +22,145 @@
 #include <spdlog/sinks/rotating_file_sink.h>
 #include "Input/InputPollingTask.h"
 #include "EventBus/EventBus.h"
+#include "Input/InputState.h"
+#include "Input/ActionMap.h"
+#include "Input/InputRecording.h"
+#include "Benchmark/SpriteBatchBenchmark.h"
+#include "Benchmark/RenderQueueBenchmark.h"
+#include "Benchmark/RenderCpuBenchmark.h"
 
 using namespace engine;
 using namespace game;
 
 // SDL Requires a number of arguments and an array of the actual parameters in the main function.
+//	--record <file>		Saves the input of the session to <file>.
+//	--replay <file>		Plays <file> back headless and at full speed, then writes <file>.profile.csv.
+//						Returns 1 if the game state diverges from the recording.
+//	--low-latency <ms>	Waits <ms> before sampling the input every frame and late-latches the input
+//						right before rendering. Input-to-present latency is kept in the kernel's frame stats.
+//	--render-thread		Draws on a thread of its own, one frame behind the simulation. Ignores --low-latency.
+//	--bench-sprites <n>	Runs the headless 2D sprite benchmark with <n> sprites and exits.
+//	--bench-render-queue <n>	Compares Render_Node with the render queue on <n> nodes and exits.
+//	--bench-render-cpu <n>	Measures the CPU side of the 3D renderer on <n> cubes, with GL calls recorded instead
+//						of sent to a GPU (no window needed), and exits.
+//	--bench-materials <m>	Materials the cubes of --bench-render-cpu are spread over, 16 by default.
 int main(int args, char* argv[])
 {
+	std::string recordPath;
+	std::string replayPath;
+	double frameDelayMs = -1;
+	unsigned benchmarkSprites = 0;
+	unsigned benchmarkNodes = 0;
+	unsigned benchmarkCubes = 0;
+	unsigned benchmarkMaterials = 16;
+	bool renderThread = false;
+	for (int i = 1; i < args; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--render-thread")
+		{
+			renderThread = true;
+			continue;
+		}
+		if (i + 1 >= args) break;
+		if (arg == "--record") recordPath = argv[++i];
+		else if (arg == "--replay") replayPath = argv[++i];
+		else if (arg == "--low-latency") frameDelayMs = std::atof(argv[++i]);
+		else if (arg == "--bench-sprites") benchmarkSprites = unsigned(std::atoi(argv[++i]));
+		else if (arg == "--bench-render-queue") benchmarkNodes = unsigned(std::atoi(argv[++i]));
+		else if (arg == "--bench-render-cpu") benchmarkCubes = unsigned(std::atoi(argv[++i]));
+		else if (arg == "--bench-materials") benchmarkMaterials = unsigned(std::atoi(argv[++i]));
+	}
+
 	// Create a file rotating logger with 5mb size max and 3 rotated files
 	const int max_size = 1048576 * 5;
 	const int max_files = 1;
 	std::shared_ptr<spdlog::logger> gameLogger = spdlog::rotating_logger_mt("EngineLogger", "logs/EngineLogs.txt", max_size, max_files);
 	spdlog::set_default_logger(gameLogger);
 
+	if (benchmarkSprites > 0)
+	{
+		RunSpriteBatchBenchmark(benchmarkSprites);
+		return 0;
+	}
+	if (benchmarkNodes > 0)
+	{
+		RunRenderQueueBenchmark(benchmarkNodes);
+		return 0;
+	}
+	if (benchmarkCubes > 0)
+	{
+		RunRenderCpuBenchmark(benchmarkCubes, benchmarkMaterials);
+		return 0;
+	}
+
 	std::shared_ptr<engine::EventBus> eventBus = std::make_shared<engine::EventBus>();
+	std::shared_ptr<engine::InputState> inputState = std::make_shared<engine::InputState>();
+	std::shared_ptr<engine::ActionMap> actionMap = std::make_shared<engine::ActionMap>();
 	Window window("Unnamed game engine", 1920, 1080, false, -1);
-	InputPollingTask inputPoller(eventBus);
+	// Keeps the default layout if the bindings file is missing.
+	actionMap->Load("../../../assets/config/input.bindings");
+	InputPollingTask inputPoller(eventBus, inputState, actionMap);
 	Kernel kernel;
 
 	// We create the game in the stack. We don't need the 'new' keyword for stack-only variables.
-	Game game(window, kernel, eventBus);
+	Game game(window, kernel, eventBus, inputState);
 
 	//We initialize all scene specific tasks to add them to the kernel...
 	game.SetupScene();
+	StateChecksumFunction checksum = [&game]() { return game.ComputeStateChecksum(); };
+	std::unique_ptr<InputRecorder> recorder;
+	std::unique_ptr<InputPlayer> player;
+	if (!replayPath.empty())
+	{
+		player = std::make_unique<InputPlayer>(replayPath, checksum);
+		if (!player->IsLoaded())
+		{
+			return 1;
+		}
+		inputPoller.SetPlayer(player.get());
+		kernel.SetFrameClock(player.get());
+		window.SetVsync(false);
+		window.SetVisible(false);
+	}
+	else if (!recordPath.empty())
+	{
+		recorder = std::make_unique<InputRecorder>(recordPath, checksum);
+		inputPoller.SetRecorder(recorder.get());
+	}
+
+	// The render thread draws from a snapshot taken before any late latch could correct it.
+	if (renderThread)
+	{
+		if (frameDelayMs >= 0)
+		{
+			spdlog::warn("--low-latency is ignored with --render-thread");
+		}
+		game.EnableRenderThread(true);
+	}
+
+	// Late-latched corrections are render-only, so they can be recorded but mean nothing in a replay.
+	if (!renderThread && replayPath.empty() && frameDelayMs >= 0)
+	{
+		kernel.SetFrameDelay(frameDelayMs / 1000.0);
+		game.EnableLowLatencyMode(inputPoller);
+	}
+
 	//Then start the kernel loop.
 	kernel.AddPriorizedRunningTask(inputPoller);
 	kernel.AddPriorizedRunningTask(game);
 
 	kernel.Execute();
+	game.EnableRenderThread(false);
+
+	FrameStats& frameStats = kernel.GetFrameStats();
+	spdlog::info("Average input-to-present latency: {:.2f} ms", frameStats.averageInputToPresent * 1000.0);
+
+	if (player)
+	{
+		player->WriteProfile(replayPath + ".profile.csv");
+		return player->HasDiverged() ? 1 : 0;
+	}
 	return 0;
 
 }
\ No newline at end of file
@@ -0,0 +1,186 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sdl2/SDL.h>
+
+namespace engine
+{
+	class AssetManager;
+	struct PendingMesh;
+
+	enum class AssetType
+	{
+		TEXTURE,
+		SOUND,
+		FONT,
+		MESH,
+		TYPE_COUNT
+	};
+
+	enum class AssetStatus
+	{
+		/// <summary>
+		/// Not in memory: not loaded yet, or released to stay under the memory budget.
+		/// It's loaded the next time it's used.
+		/// </summary>
+		UNLOADED,
+		/// <summary>
+		/// Being read and decoded by a worker thread.
+		/// </summary>
+		LOADING,
+		/// <summary>
+		/// Decoded, waiting for its dependencies and the upload on the owning thread.
+		/// </summary>
+		DECODED,
+		READY,
+		FAILED
+	};
+
+	/// <summary>
+	/// Book-keeping of a single asset. Owned by the AssetManager, handles only point at it.
+	/// </summary>
+	struct AssetSlot
+	{
+		AssetManager* owner = nullptr;
+		std::string id;
+		std::string filePath;
+		AssetType type;
+		std::atomic<AssetStatus> status{ AssetStatus::UNLOADED };
+
+		SDL_Renderer* renderer = nullptr;
+		int fontSize = 0;
+		/// <summary>
+		/// Decoded image waiting to become a texture on the owning thread.
+		/// </summary>
+		SDL_Surface* surface = nullptr;
+		/// <summary>
+		/// Raw file contents, for the types that are parsed from memory (fonts keep reading from it).
+		/// </summary>
+		std::vector<char> fileData;
+		/// <summary>
+		/// SDL_Texture, Mix_Chunk, TTF_Font or glt::Model, depending on type. Its deleter frees it the SDL way.
+		/// Meshes are shared with the scene graph, which keeps them alive after an eviction.
+		/// </summary>
+		std::shared_ptr<void> resource;
+		/// <summary>
+		/// Mesh being built wherever the GL context is (see AssetManager::SetGlContextRunner()), until
+		/// Upload() takes it.
+		/// </summary>
+		std::shared_ptr<PendingMesh> pendingMesh;
+
+		/// <summary>
+		/// Approximate memory used by the asset, in bytes.
+		/// </summary>
+		size_t size = 0;
+		/// <summary>
+		/// Live handles. Assets with handles are never evicted.
+		/// </summary>
+		std::atomic<int> references{ 0 };
+		/// <summary>
+		/// Performance counter of the last time the asset was used, to evict the least recently used first.
+		/// </summary>
+		std::atomic<Uint64> lastUsed{ 0 };
+
+		std::vector<AssetSlot*> dependencies;
+
+		bool IsInUse() const { return references.load(std::memory_order_acquire) > 0 || resource.use_count() > 1; }
+		void Touch() { lastUsed.store(SDL_GetPerformanceCounter(), std::memory_order_relaxed); }
+	};
+
+	/// <summary>
+	/// Reference to an asset. While any handle to an asset exists, it won't be evicted.
+	/// </summary>
+	class AssetHandleBase
+	{
+		friend class AssetManager;
+	protected:
+		AssetSlot* slot = nullptr;
+
+		void Acquire()
+		{
+			if (slot)
+			{
+				slot->references.fetch_add(1, std::memory_order_relaxed);
+				slot->Touch();
+			}
+		}
+
+		void Release()
+		{
+			if (slot)
+			{
+				//Counts as the last use, so an asset that was held for a long time isn't the first to go.
+				slot->Touch();
+				slot->references.fetch_sub(1, std::memory_order_release);
+				slot = nullptr;
+			}
+		}
+	public:
+		AssetHandleBase() = default;
+		explicit AssetHandleBase(AssetSlot* slot) : slot(slot) { Acquire(); }
+		AssetHandleBase(const AssetHandleBase& other) : slot(other.slot) { Acquire(); }
+		AssetHandleBase(AssetHandleBase&& other) noexcept : slot(other.slot) { other.slot = nullptr; }
+		~AssetHandleBase() { Release(); }
+
+		AssetHandleBase& operator = (const AssetHandleBase& other)
+		{
+			if (slot != other.slot)
+			{
+				Release();
+				slot = other.slot;
+				Acquire();
+			}
+			return *this;
+		}
+
+		AssetHandleBase& operator = (AssetHandleBase&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Release();
+				slot = other.slot;
+				other.slot = nullptr;
+			}
+			return *this;
+		}
+
+		bool IsValid() const { return slot != nullptr; }
+		AssetStatus GetStatus() const { return slot ? slot->status.load(std::memory_order_acquire) : AssetStatus::FAILED; }
+		bool IsReady() const { return GetStatus() == AssetStatus::READY; }
+		bool HasFailed() const { return GetStatus() == AssetStatus::FAILED; }
+		const std::string& GetId() const { return slot->id; }
+	};
+
+	/// <summary>
+	/// Returned right away by the asynchronous loads. Get() stays nullptr until the asset is ready.
+	/// Handles must not outlive their AssetManager.
+	/// </summary>
+	template <typename T>
+	class AssetHandle : public AssetHandleBase
+	{
+	public:
+		AssetHandle() = default;
+		explicit AssetHandle(AssetSlot* slot) : AssetHandleBase(slot) {}
+
+		/// <summary>
+		/// Reloads the asset on the calling thread if it was evicted. Owning thread only.
+		/// Defined in AssetManager.h.
+		/// </summary>
+		T* Get() const;
+
+		/// <summary>
+		/// Shared ownership of the resource, for the scene graph (meshes).
+		/// </summary>
+		std::shared_ptr<T> Share() const
+		{
+			return Get() ? std::static_pointer_cast<T>(slot->resource) : nullptr;
+		}
+	};
+}
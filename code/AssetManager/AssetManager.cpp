@@ -4,9 +4,53 @@
 
 #include <AssetManager/AssetManager.h>
 #include <sdl2/SDL_image.h>
+#include <gltk/Model_Obj.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <limits>
+#include <mutex>
 
 namespace engine
 {
+	/// <summary>
+	/// Hands a mesh built with the GL context over to the owning thread.
+	/// </summary>
+	struct PendingMesh
+	{
+		std::mutex mutex;
+		bool built = false;
+		std::shared_ptr<glt::Model_Obj> model;
+	};
+
+	namespace
+	{
+		const char* typeNames[size_t(AssetType::TYPE_COUNT)] = { "texture", "sound", "font", "mesh" };
+
+		size_t FileSize(const std::string& filePath)
+		{
+			SDL_RWops* file = SDL_RWFromFile(filePath.c_str(), "rb");
+			if (!file)
+			{
+				return 0;
+			}
+			Sint64 size = SDL_RWsize(file);
+			SDL_RWclose(file);
+			return size > 0 ? size_t(size) : 0;
+		}
+
+		void RunWithGlContext(const std::shared_ptr<AssetManager::GlContextRunner>& runner, std::function<void()> work)
+		{
+			if (runner && *runner)
+			{
+				(*runner)(std::move(work));
+			}
+			else
+			{
+				work();
+			}
+		}
+	}
+
 	AssetManager::AssetManager()
 	{
 
@@ -15,31 +59,576 @@ namespace engine
 	AssetManager::~AssetManager()
 	{
 		ClearAssets();
+		for (auto& cache : caches)
+		{
+			cache.clear();
+		}
 	}
 
 	void AssetManager::ClearAssets()
 	{
-		for (auto texture : textures)
+		//Atlases hold handles to their pages.
+		atlases.clear();
+
+		//Workers may still be writing into the slots.
+		JobSystem::Instance().Wait(loadJobs);
+		decoded.clear();
+		waitingUpload.clear();
+
+		for (auto& cache : caches)
 		{
-			SDL_DestroyTexture(texture.second);
+			for (auto it = cache.begin(); it != cache.end();)
+			{
+				AssetSlot* slot = it->second.get();
+				Release(slot);
+				slot->status = AssetStatus::UNLOADED;
+
+				if (slot->references > 0)
+				{
+					//Its dependencies may be gone after this.
+					slot->dependencies.clear();
+					it++;
+				}
+				else
+				{
+					it = cache.erase(it);
+				}
+			}
 		}
-		textures.clear();
 	}
 
 	void AssetManager::AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath)
 	{
-		SDL_Surface* surface = IMG_Load(filePath.c_str());
-		SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-		SDL_FreeSurface(surface);
-
-		//Add the texture to the map
-		textures.emplace(assetId, texture);
+		AssetSlot* slot = CreateSlot(AssetType::TEXTURE, assetId, filePath, {});
+		if (!slot->renderer)
+		{
+			slot->renderer = renderer;
+		}
+		LoadNow(slot);
 	}
 
 	SDL_Texture* AssetManager::GetTexture(const std::string& assetId)
 	{
-		return textures[assetId];
+		return static_cast<SDL_Texture*>(Use(FindSlot(assetId, AssetType::TEXTURE)));
+	}
+
+	Mix_Chunk* AssetManager::GetSound(const std::string& assetId)
+	{
+		return static_cast<Mix_Chunk*>(Use(FindSlot(assetId, AssetType::SOUND)));
+	}
+
+	TTF_Font* AssetManager::GetFont(const std::string& assetId)
+	{
+		return static_cast<TTF_Font*>(Use(FindSlot(assetId, AssetType::FONT)));
+	}
+
+	std::shared_ptr<glt::Model> AssetManager::GetMesh(const std::string& assetId)
+	{
+		AssetSlot* slot = FindSlot(assetId, AssetType::MESH);
+		return Use(slot) ? std::static_pointer_cast<glt::Model>(slot->resource) : nullptr;
+	}
+
+	AssetHandle<SDL_Texture> AssetManager::LoadTextureAsync(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath,
+		std::initializer_list<AssetHandleBase> dependencies)
+	{
+		AssetSlot* slot = CreateSlot(AssetType::TEXTURE, assetId, filePath, dependencies);
+		if (!slot->renderer)
+		{
+			slot->renderer = renderer;
+		}
+		StartLoad(slot);
+		return AssetHandle<SDL_Texture>(slot);
+	}
+
+	AssetHandle<Mix_Chunk> AssetManager::LoadSoundAsync(const std::string& assetId, const std::string& filePath,
+		std::initializer_list<AssetHandleBase> dependencies)
+	{
+		AssetSlot* slot = CreateSlot(AssetType::SOUND, assetId, filePath, dependencies);
+		StartLoad(slot);
+		return AssetHandle<Mix_Chunk>(slot);
+	}
+
+	AssetHandle<TTF_Font> AssetManager::LoadFontAsync(const std::string& assetId, const std::string& filePath, int pointSize,
+		std::initializer_list<AssetHandleBase> dependencies)
+	{
+		AssetSlot* slot = CreateSlot(AssetType::FONT, assetId, filePath, dependencies);
+		if (slot->fontSize == 0)
+		{
+			slot->fontSize = pointSize;
+		}
+		StartLoad(slot);
+		return AssetHandle<TTF_Font>(slot);
+	}
+
+	AssetHandle<glt::Model> AssetManager::LoadMeshAsync(const std::string& assetId, const std::string& filePath,
+		std::initializer_list<AssetHandleBase> dependencies)
+	{
+		AssetSlot* slot = CreateSlot(AssetType::MESH, assetId, filePath, dependencies);
+		StartLoad(slot);
+		return AssetHandle<glt::Model>(slot);
+	}
+
+	void AssetManager::Update(double budgetMs)
+	{
+		{
+			std::lock_guard<std::mutex> lock(decodedMutex);
+			waitingUpload.insert(waitingUpload.end(), decoded.begin(), decoded.end());
+			decoded.clear();
+		}
+
+		const Uint64 start = SDL_GetPerformanceCounter();
+		const double countsPerMs = SDL_GetPerformanceFrequency() / 1000.0;
+		std::vector<AssetSlot*> stillWaiting;
+		bool outOfBudget = false;
+
+		for (AssetSlot* slot : waitingUpload)
+		{
+			if (outOfBudget)
+			{
+				stillWaiting.push_back(slot);
+				continue;
+			}
+
+			bool dependenciesReady = true;
+			bool dependencyFailed = false;
+			for (AssetSlot* dependency : slot->dependencies)
+			{
+				//A dependency may have been evicted while this asset was loading.
+				StartLoad(dependency);
+
+				AssetStatus status = dependency->status.load(std::memory_order_acquire);
+				dependenciesReady = dependenciesReady && status == AssetStatus::READY;
+				dependencyFailed = dependencyFailed || status == AssetStatus::FAILED;
+			}
+
+			if (dependencyFailed)
+			{
+				spdlog::error("Asset \"" + slot->id + "\" failed because one of its dependencies did");
+				Release(slot);
+				slot->status = AssetStatus::FAILED;
+				continue;
+			}
+			if (!dependenciesReady)
+			{
+				stillWaiting.push_back(slot);
+				continue;
+			}
+
+			if (!Upload(slot))
+			{
+				stillWaiting.push_back(slot);
+				continue;
+			}
+			outOfBudget = (SDL_GetPerformanceCounter() - start) / countsPerMs >= budgetMs;
+		}
+
+		waitingUpload.swap(stillWaiting);
+		EnforceBudget();
+	}
+
+	void AssetManager::WaitAll()
+	{
+		JobSystem::Instance().Wait(loadJobs);
+
+		//Everything is decoded already, no reason to spread the uploads over frames.
+		Update(std::numeric_limits<double>::max());
+		while (!waitingUpload.empty())
+		{
+			const size_t waitingBefore = waitingUpload.size();
+			//Dependencies evicted in the meantime are being decoded again.
+			JobSystem::Instance().Wait(loadJobs);
+			Update(std::numeric_limits<double>::max());
+			if (std::all_of(waitingUpload.begin(), waitingUpload.end(), [](const AssetSlot* slot) { return slot->pendingMesh != nullptr; }))
+			{
+				//Only meshes the render thread is building, they can't be waited for here.
+				break;
+			}
+			if (waitingUpload.size() == waitingBefore)
+			{
+				//Nothing got uploaded in a whole pass: what's left depends on assets that will never be ready.
+				spdlog::error(std::to_string(waitingUpload.size()) + " assets are waiting for dependencies that never finished loading");
+				break;
+			}
+		}
+	}
+
+	bool AssetManager::IsLoading()
+	{
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		return !loadJobs.IsDone() || !decoded.empty() || !waitingUpload.empty();
+	}
+
+	TextureAtlas* AssetManager::BuildAtlas(SDL_Renderer* renderer, const std::string& atlasId, const std::vector<AtlasImage>& images,
+		const AtlasSettings& settings)
+	{
+		std::unique_ptr<TextureAtlas> atlas = std::make_unique<TextureAtlas>(atlasId);
+		if (!atlas->Build(images, settings))
+		{
+			return nullptr;
+		}
+
+		for (size_t page = 0; page < atlas->pageSurfaces.size(); page++)
+		{
+			//Built pages have no file to reload from: the atlas' handles keep them from being evicted.
+			AssetSlot* slot = CreateSlot(AssetType::TEXTURE, TextureAtlas::GetPageId(atlasId, page), "", {});
+			Release(slot);
+			slot->renderer = renderer;
+			slot->surface = atlas->pageSurfaces[page];
+			slot->status = AssetStatus::LOADING;
+			Upload(slot);
+			atlas->pageTextures.emplace_back(slot);
+		}
+		//Upload() freed them.
+		atlas->pageSurfaces.clear();
+
+		TextureAtlas* result = atlas.get();
+		atlases[atlasId] = std::move(atlas);
+		return result;
+	}
+
+	TextureAtlas* AssetManager::LoadAtlas(SDL_Renderer* renderer, const std::string& atlasId, const std::string& layoutPath)
+	{
+		std::unique_ptr<TextureAtlas> atlas = std::make_unique<TextureAtlas>(atlasId);
+		if (!atlas->Load(layoutPath))
+		{
+			return nullptr;
+		}
+
+		for (size_t page = 0; page < atlas->pageFiles.size(); page++)
+		{
+			atlas->pageTextures.push_back(LoadTextureAsync(renderer, TextureAtlas::GetPageId(atlasId, page), atlas->pageFiles[page]));
+		}
+
+		TextureAtlas* result = atlas.get();
+		atlases[atlasId] = std::move(atlas);
+		return result;
+	}
+
+	TextureAtlas* AssetManager::GetAtlas(const std::string& atlasId)
+	{
+		auto it = atlases.find(atlasId);
+		return it != atlases.end() ? it->second.get() : nullptr;
+	}
+
+	AtlasSprite AssetManager::GetAtlasSprite(const std::string& imageId) const
+	{
+		AtlasSprite sprite;
+		for (const auto& atlas : atlases)
+		{
+			if (const AtlasRegion* region = atlas.second->Find(imageId))
+			{
+				sprite.texture = atlas.second->GetPageTexture(region->page);
+				sprite.rect = region->rect;
+				break;
+			}
+		}
+		return sprite;
+	}
+
+	bool AssetManager::RemapToAtlas(std::string& assetId, SDL_Rect& srcRect) const
+	{
+		for (const auto& atlas : atlases)
+		{
+			if (atlas.second->Remap(assetId, srcRect))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void AssetManager::SetMemoryBudget(size_t bytes)
+	{
+		memoryBudget = bytes;
+		budgetWarningLogged = false;
+	}
+
+	size_t AssetManager::GetMemoryUsage() const
+	{
+		size_t total = 0;
+		for (size_t usage : memoryUsage)
+		{
+			total += usage;
+		}
+		return total;
+	}
+
+	AssetSlot* AssetManager::CreateSlot(AssetType type, const std::string& assetId, const std::string& filePath, std::initializer_list<AssetHandleBase> dependencies)
+	{
+		auto& cache = caches[size_t(type)];
+		auto it = cache.find(assetId);
+		if (it != cache.end())
+		{
+			return it->second.get();
+		}
+
+		std::unique_ptr<AssetSlot> slot = std::make_unique<AssetSlot>();
+		slot->owner = this;
+		slot->id = assetId;
+		slot->filePath = filePath;
+		slot->type = type;
+		for (const AssetHandleBase& dependency : dependencies)
+		{
+			if (dependency.IsValid())
+			{
+				slot->dependencies.push_back(dependency.slot);
+			}
+		}
+
+		AssetSlot* result = slot.get();
+		cache.emplace(assetId, std::move(slot));
+		return result;
+	}
+
+	AssetSlot* AssetManager::FindSlot(const std::string& assetId, AssetType type) const
+	{
+		const auto& cache = caches[size_t(type)];
+		auto it = cache.find(assetId);
+		return it != cache.end() ? it->second.get() : nullptr;
+	}
+
+	void AssetManager::StartLoad(AssetSlot* slot)
+	{
+		if (slot->status != AssetStatus::UNLOADED)
+		{
+			return;
+		}
+
+		slot->status = AssetStatus::LOADING;
+		JobSystem::Instance().Schedule([this, slot]()
+			{
+				Decode(slot);
+				std::lock_guard<std::mutex> lock(decodedMutex);
+				decoded.push_back(slot);
+			}, &loadJobs);
+	}
+
+	void AssetManager::LoadNow(AssetSlot* slot)
+	{
+		if (slot->status != AssetStatus::UNLOADED)
+		{
+			return;
+		}
+
+		for (AssetSlot* dependency : slot->dependencies)
+		{
+			Use(dependency);
+		}
+
+		//No eviction here: the caller may be in the middle of a frame, holding raw pointers to assets
+		//without handles (see GetTexture()). Update() brings the usage back under budget.
+		slot->status = AssetStatus::LOADING;
+		Decode(slot);
+		if (!Upload(slot))
+		{
+			waitingUpload.push_back(slot);
+		}
+	}
+
+	void AssetManager::Decode(AssetSlot* slot)
+	{
+		//Only file reading and decoding here, nothing that touches the renderer or the GL context.
+		switch (slot->type)
+		{
+		case AssetType::TEXTURE:
+			slot->surface = IMG_Load(slot->filePath.c_str());
+			break;
+		case AssetType::SOUND:
+			if (Mix_Chunk* chunk = Mix_LoadWAV(slot->filePath.c_str()))
+			{
+				slot->resource = std::shared_ptr<void>(chunk, [](void* resource) { Mix_FreeChunk(static_cast<Mix_Chunk*>(resource)); });
+				slot->size = sizeof(Mix_Chunk) + chunk->alen;
+			}
+			break;
+		case AssetType::FONT:
+			if (SDL_RWops* file = SDL_RWFromFile(slot->filePath.c_str(), "rb"))
+			{
+				Sint64 size = SDL_RWsize(file);
+				slot->fileData.resize(size > 0 ? size_t(size) : 0);
+				if (SDL_RWread(file, slot->fileData.data(), 1, slot->fileData.size()) != slot->fileData.size())
+				{
+					slot->fileData.clear();
+				}
+				SDL_RWclose(file);
+			}
+			break;
+		case AssetType::MESH:
+			//Model_Obj parses the file itself while it builds the GL buffers. Its size on disk is as
+			//close to the memory it will take as we can tell from here.
+			slot->size = FileSize(slot->filePath);
+			break;
+		case AssetType::TYPE_COUNT:
+			break;
+		}
+
+		slot->status.store(AssetStatus::DECODED, std::memory_order_release);
 	}
 
+	bool AssetManager::Upload(AssetSlot* slot)
+	{
+		switch (slot->type)
+		{
+		case AssetType::TEXTURE:
+			if (slot->surface)
+			{
+				if (SDL_Texture* texture = SDL_CreateTextureFromSurface(slot->renderer, slot->surface))
+				{
+					slot->resource = std::shared_ptr<void>(texture, [](void* resource) { SDL_DestroyTexture(static_cast<SDL_Texture*>(resource)); });
+					slot->size = size_t(slot->surface->w) * slot->surface->h * 4;
+				}
+				SDL_FreeSurface(slot->surface);
+				slot->surface = nullptr;
+			}
+			break;
+		case AssetType::SOUND:
+			//Ready to use straight out of the decoder.
+			break;
+		case AssetType::FONT:
+			if (!slot->fileData.empty())
+			{
+				//The font keeps reading glyphs from fileData, which stays alive as long as the font.
+				SDL_RWops* memory = SDL_RWFromConstMem(slot->fileData.data(), int(slot->fileData.size()));
+				if (TTF_Font* font = TTF_OpenFontRW(memory, 1, slot->fontSize))
+				{
+					slot->resource = std::shared_ptr<void>(font, [](void* resource) { TTF_CloseFont(static_cast<TTF_Font*>(resource)); });
+					slot->size = slot->fileData.size();
+				}
+			}
+			break;
+		case AssetType::MESH:
+			if (slot->size > 0)
+			{
+				if (!slot->pendingMesh)
+				{
+					StartMeshBuild(slot);
+				}
+				std::shared_ptr<glt::Model_Obj> model;
+				{
+					std::lock_guard<std::mutex> lock(slot->pendingMesh->mutex);
+					if (!slot->pendingMesh->built)
+					{
+						return false;
+					}
+					model = std::move(slot->pendingMesh->model);
+				}
+				slot->pendingMesh.reset();
+
+				if (model->is_ok())
+				{
+					slot->resource = model;
+				}
+				else
+				{
+					spdlog::error(model->get_error());
+				}
+			}
+			break;
+		case AssetType::TYPE_COUNT:
+			break;
+		}
 
-}
\ No newline at end of file
+		if (!slot->resource)
+		{
+			spdlog::error("Couldn't load " + std::string(typeNames[size_t(slot->type)]) + " \"" + slot->id + "\" from " + slot->filePath + ": " + SDL_GetError());
+			Release(slot);
+			slot->status.store(AssetStatus::FAILED, std::memory_order_release);
+			return true;
+		}
+
+		memoryUsage[size_t(slot->type)] += slot->size;
+		slot->Touch();
+		slot->status.store(AssetStatus::READY, std::memory_order_release);
+		return true;
+	}
+
+	void AssetManager::Release(AssetSlot* slot)
+	{
+		if (slot->surface)
+		{
+			SDL_FreeSurface(slot->surface);
+			slot->surface = nullptr;
+		}
+		if (slot->status == AssetStatus::READY)
+		{
+			memoryUsage[size_t(slot->type)] -= slot->size;
+		}
+		slot->resource.reset();
+		//A mesh still being built is deleted once it is.
+		slot->pendingMesh.reset();
+		slot->fileData = std::vector<char>();
+		slot->size = 0;
+	}
+
+	void AssetManager::StartMeshBuild(AssetSlot* slot)
+	{
+		std::shared_ptr<PendingMesh> pending = std::make_shared<PendingMesh>();
+		slot->pendingMesh = pending;
+
+		//Deleted with the context too, wherever the last reference goes: evictions, the scene graph...
+		std::weak_ptr<GlContextRunner> runner = glContextRunner;
+		RunWithGlContext(glContextRunner, [pending, runner, filePath = slot->filePath]()
+			{
+				std::shared_ptr<glt::Model_Obj> model(new glt::Model_Obj(filePath), [runner](glt::Model_Obj* model)
+					{
+						RunWithGlContext(runner.lock(), [model]() { delete model; });
+					});
+				std::lock_guard<std::mutex> lock(pending->mutex);
+				pending->model = std::move(model);
+				pending->built = true;
+			});
+	}
+
+	void AssetManager::EnforceBudget()
+	{
+		size_t usage = GetMemoryUsage();
+		if (memoryBudget == 0 || usage <= memoryBudget)
+		{
+			budgetWarningLogged = false;
+			return;
+		}
+
+		std::vector<AssetSlot*> candidates;
+		for (auto& cache : caches)
+		{
+			for (auto& asset : cache)
+			{
+				AssetSlot* slot = asset.second.get();
+				if (slot->status == AssetStatus::READY && !slot->IsInUse())
+				{
+					candidates.push_back(slot);
+				}
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(),
+			[](const AssetSlot* a, const AssetSlot* b) { return a->lastUsed < b->lastUsed; });
+
+		for (AssetSlot* slot : candidates)
+		{
+			if (usage <= memoryBudget)
+			{
+				break;
+			}
+			usage -= slot->size;
+			Release(slot);
+			slot->status = AssetStatus::UNLOADED;
+		}
+
+		if (usage > memoryBudget && !budgetWarningLogged)
+		{
+			spdlog::warn("Assets in use take " + std::to_string(usage) + " bytes, over the " + std::to_string(memoryBudget) + " bytes budget");
+			budgetWarningLogged = true;
+		}
+	}
+
+	void* AssetManager::Use(AssetSlot* slot)
+	{
+		if (!slot)
+		{
+			return nullptr;
+		}
+
+		LoadNow(slot);
+		slot->Touch();
+		return slot->status.load(std::memory_order_acquire) == AssetStatus::READY ? slot->resource.get() : nullptr;
+	}
+}
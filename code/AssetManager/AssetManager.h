@@ -5,22 +5,217 @@
 \******************************************/
 
 #include <map>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
+#include <initializer_list>
 #include <sdl2/SDL.h>
+#include <sdl2/SDL_mixer.h>
+#include <sdl2/SDL_ttf.h>
+#include <Jobs/JobSystem.h>
+#include <AssetManager/AssetHandle.h>
+#include <AssetManager/TextureAtlas.h>
+
+namespace glt
+{
+	class Model;
+}
 
 namespace engine
 {
+	/// <summary>
+	/// Image packed in an atlas: the page texture and the rectangle the image takes in it.
+	/// </summary>
+	struct AtlasSprite
+	{
+		AssetHandle<SDL_Texture> texture;
+		SDL_Rect rect = { 0, 0, 0, 0 };
+	};
+
+	/// <summary>
+	/// Owns the textures, sounds, fonts and meshes of the game.
+	///
+	/// Asynchronous loads read and decode the files on the JobSystem workers. What needs the renderer
+	/// (textures, fonts) is done by Update() on the thread that owns the manager, a few assets per frame.
+	/// Meshes need the GL context instead: they're built and deleted through SetGlContextRunner().
+	///
+	/// Every type has its own cache, but they all share one memory budget. When it's exceeded, Update()
+	/// releases the least recently used assets without handles, and they reload the next time they're
+	/// asked for.
+	/// </summary>
 	class AssetManager {
+		template <typename T> friend class AssetHandle;
+	public:
+		/// <summary>
+		/// Runs work with the GL context current, now or later.
+		/// </summary>
+		typedef std::function<void(std::function<void()>)> GlContextRunner;
+
 	private:
-		std::map<std::string, SDL_Texture*> textures;
-		//TODO: Create a map for fonts.
-		//TODO: Create a map for audio.
+		std::map<std::string, std::unique_ptr<AssetSlot>> caches[size_t(AssetType::TYPE_COUNT)];
+		size_t memoryUsage[size_t(AssetType::TYPE_COUNT)] = {};
+		/// <summary>
+		/// 0 means no budget.
+		/// </summary>
+		size_t memoryBudget = 0;
+		bool budgetWarningLogged = false;
+
+		/// <summary>
+		/// Assets decoded by the workers since the last Update().
+		/// </summary>
+		std::vector<AssetSlot*> decoded;
+		std::mutex decodedMutex;
+
+		/// <summary>
+		/// Assets waiting for their dependencies or for upload budget. Owning thread only.
+		/// </summary>
+		std::vector<AssetSlot*> waitingUpload;
+
+		JobCounter loadJobs;
+
+		/// <summary>
+		/// Shared with the deleters of the meshes, which may outlive the manager.
+		/// </summary>
+		std::shared_ptr<GlContextRunner> glContextRunner = std::make_shared<GlContextRunner>();
+
+		std::map<std::string, std::unique_ptr<TextureAtlas>> atlases;
+
+		AssetSlot* CreateSlot(AssetType type, const std::string& assetId, const std::string& filePath, std::initializer_list<AssetHandleBase> dependencies);
+		AssetSlot* FindSlot(const std::string& assetId, AssetType type) const;
+
+		/// <summary>
+		/// Starts decoding the slot on a worker, if it isn't loaded or loading already.
+		/// </summary>
+		void StartLoad(AssetSlot* slot);
+		/// <summary>
+		/// Loads an unloaded slot on the calling thread. A mesh the GL context runner defers is finished by Update().
+		/// </summary>
+		void LoadNow(AssetSlot* slot);
+		/// <summary>
+		/// File reading and decoding, the part that can run on a worker.
+		/// </summary>
+		void Decode(AssetSlot* slot);
+		/// <returns>false if the asset isn't finished yet (a mesh still being built), Update() tries again</returns>
+		bool Upload(AssetSlot* slot);
+		void Release(AssetSlot* slot);
+		/// <summary>
+		/// Builds the slot's mesh through the GL context runner, into slot->pendingMesh.
+		/// </summary>
+		void StartMeshBuild(AssetSlot* slot);
+
+		/// <summary>
+		/// Evicts unused assets, least recently used first, until the memory usage is under budget.
+		/// </summary>
+		void EnforceBudget();
+
+		/// <summary>
+		/// The slot's resource if it's loaded, reloading it if it was evicted.
+		/// </summary>
+		void* Use(AssetSlot* slot);
 	public:
 		AssetManager();
+		/// <summary>
+		/// Every handle must be released before the manager is destroyed.
+		/// </summary>
 		~AssetManager();
 
+		/// <summary>
+		/// Releases every asset. Assets that still have handles are evicted instead, so they reload on use.
+		/// </summary>
 		void ClearAssets();
+
 		void AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath);
+		/// <summary>
+		/// The raw pointers returned by the getters stay valid until the next Update(), the only place
+		/// unused assets are evicted. Keep a handle to hold them longer.
+		/// </summary>
+		/// <returns>nullptr if the texture doesn't exist or isn't loaded yet</returns>
 		SDL_Texture* GetTexture(const std::string& assetId);
+		/// <returns>nullptr if the sound doesn't exist or isn't loaded yet</returns>
+		Mix_Chunk* GetSound(const std::string& assetId);
+		/// <returns>nullptr if the font doesn't exist or isn't loaded yet</returns>
+		TTF_Font* GetFont(const std::string& assetId);
+		/// <returns>nullptr if the mesh doesn't exist or isn't loaded yet</returns>
+		std::shared_ptr<glt::Model> GetMesh(const std::string& assetId);
+
+		/// <summary>
+		/// Starts loading a texture and returns its handle right away. Loading an id that already
+		/// exists returns the existing asset.
+		/// </summary>
+		/// <param name="dependencies">Assets that must be ready before this one is flagged as ready</param>
+		AssetHandle<SDL_Texture> LoadTextureAsync(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath,
+			std::initializer_list<AssetHandleBase> dependencies = {});
+		AssetHandle<Mix_Chunk> LoadSoundAsync(const std::string& assetId, const std::string& filePath,
+			std::initializer_list<AssetHandleBase> dependencies = {});
+		AssetHandle<TTF_Font> LoadFontAsync(const std::string& assetId, const std::string& filePath, int pointSize,
+			std::initializer_list<AssetHandleBase> dependencies = {});
+		/// <summary>
+		/// Wavefront .obj models. The file is parsed wherever the GL context is, as it builds GL buffers as it goes.
+		/// </summary>
+		AssetHandle<glt::Model> LoadMeshAsync(const std::string& assetId, const std::string& filePath,
+			std::initializer_list<AssetHandleBase> dependencies = {});
+
+		/// <summary>
+		/// Where meshes are built and deleted. Set it to ModelRender3DSystem::RunOnRenderThread() when the
+		/// render thread may hold the context: the meshes are then ready an Update() or two later. Without a
+		/// runner it's done on the calling thread. Set it before loading any mesh.
+		/// </summary>
+		void SetGlContextRunner(GlContextRunner runner) { *glContextRunner = std::move(runner); }
+
+		/// <summary>
+		/// Finishes decoded assets on the calling thread until budgetMs runs out. At least one asset
+		/// is finished per call, so a tiny budget still makes progress. Call once per frame, outside of
+		/// rendering: it also evicts assets over the memory budget.
+		/// </summary>
+		void Update(double budgetMs);
+
+		/// <summary>
+		/// Blocks until every load started so far is ready or failed. The calling thread helps decoding.
+		/// Meshes the GL context runner defers are left to later Update() calls.
+		/// </summary>
+		void WaitAll();
+
+		bool IsLoading();
+
+		/// <summary>
+		/// Packs the images into an atlas and creates its page textures. The images themselves are not
+		/// loaded as separate textures.
+		/// </summary>
+		TextureAtlas* BuildAtlas(SDL_Renderer* renderer, const std::string& atlasId, const std::vector<AtlasImage>& images,
+			const AtlasSettings& settings = AtlasSettings());
+		/// <summary>
+		/// Loads an atlas written by TextureAtlas::Save(). The pages load asynchronously.
+		/// </summary>
+		TextureAtlas* LoadAtlas(SDL_Renderer* renderer, const std::string& atlasId, const std::string& layoutPath);
+		/// <returns>nullptr if there's no atlas with that id</returns>
+		TextureAtlas* GetAtlas(const std::string& atlasId);
+
+		/// <summary>
+		/// Looks the image up in every atlas. The handle is invalid if no atlas has it.
+		/// </summary>
+		AtlasSprite GetAtlasSprite(const std::string& imageId) const;
+
+		/// <summary>
+		/// Moves a sprite from its own image to the atlas page holding it (see TextureAtlas::Remap()).
+		/// Sprites whose image isn't in any atlas are left untouched.
+		/// </summary>
+		bool RemapToAtlas(std::string& assetId, SDL_Rect& srcRect) const;
+
+		/// <summary>
+		/// Memory all the caches together may use, in bytes. 0 disables eviction. Enforced from the next Update().
+		/// </summary>
+		void SetMemoryBudget(size_t bytes);
+		size_t GetMemoryBudget() const { return memoryBudget; }
+		size_t GetMemoryUsage() const;
+		size_t GetMemoryUsage(AssetType type) const { return memoryUsage[size_t(type)]; }
 	};
-}
\ No newline at end of file
+
+	template <typename T>
+	T* AssetHandle<T>::Get() const
+	{
+		return slot ? static_cast<T*>(slot->owner->Use(slot)) : nullptr;
+	}
+}
@@ -0,0 +1,289 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <AssetManager/TextureAtlas.h>
+#include <Jobs/JobSystem.h>
+#include <sdl2/SDL_image.h>
+#include <rapidxml/rapidxml.hpp>
+#include <rapidxml/rapidxml_utils.hpp>
+#include <spdlog/spdlog.h>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imgui/imstb_rectpack.h>
+
+namespace engine
+{
+	namespace
+	{
+		std::string ChildValue(rapidxml::xml_node<>* node, const char* name)
+		{
+			rapidxml::xml_node<>* child = node->first_node(name);
+			return child ? std::string(child->value()) : std::string();
+		}
+
+		std::string GetDirectory(const std::string& filePath)
+		{
+			size_t separator = filePath.find_last_of("/\\");
+			return separator == std::string::npos ? std::string() : filePath.substr(0, separator + 1);
+		}
+
+		std::string GetFileName(const std::string& filePath)
+		{
+			size_t separator = filePath.find_last_of("/\\");
+			std::string name = separator == std::string::npos ? filePath : filePath.substr(separator + 1);
+			return name.substr(0, name.find_last_of('.'));
+		}
+
+		/// <summary>
+		/// Fills the gutter around rect with copies of the pixels on its border. Surface must be RGBA32.
+		/// </summary>
+		void ExtrudeEdges(SDL_Surface* page, const SDL_Rect& rect, int gutter)
+		{
+			Uint32* pixels = static_cast<Uint32*>(page->pixels);
+			const int pitch = page->pitch / 4;
+			auto pixel = [&](int x, int y) -> Uint32& { return pixels[y * pitch + x]; };
+
+			for (int y = rect.y; y < rect.y + rect.h; y++)
+			{
+				for (int g = 1; g <= gutter; g++)
+				{
+					pixel(rect.x - g, y) = pixel(rect.x, y);
+					pixel(rect.x + rect.w - 1 + g, y) = pixel(rect.x + rect.w - 1, y);
+				}
+			}
+			//Rows last, so the corners get the corner pixels.
+			const int left = rect.x - gutter;
+			const size_t rowBytes = size_t(rect.w + 2 * gutter) * 4;
+			for (int g = 1; g <= gutter; g++)
+			{
+				std::memcpy(&pixel(left, rect.y - g), &pixel(left, rect.y), rowBytes);
+				std::memcpy(&pixel(left, rect.y + rect.h - 1 + g), &pixel(left, rect.y + rect.h - 1), rowBytes);
+			}
+		}
+	}
+
+	TextureAtlas::~TextureAtlas()
+	{
+		FreePageSurfaces();
+	}
+
+	void TextureAtlas::FreePageSurfaces()
+	{
+		for (SDL_Surface* surface : pageSurfaces)
+		{
+			SDL_FreeSurface(surface);
+		}
+		pageSurfaces.clear();
+	}
+
+	bool TextureAtlas::Build(const std::vector<AtlasImage>& images, const AtlasSettings& settings)
+	{
+		FreePageSurfaces();
+		regions.clear();
+
+		/*
+		*	Decoding is most of the work, every image goes to a different worker.
+		*/
+		std::vector<SDL_Surface*> surfaces(images.size(), nullptr);
+		JobSystem::Instance().ParallelFor(images.size(), 1, [&images, &surfaces](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					if (SDL_Surface* loaded = IMG_Load(images[i].filePath.c_str()))
+					{
+						surfaces[i] = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+						SDL_FreeSurface(loaded);
+					}
+				}
+			});
+
+		/*
+		*	Every image takes its size plus the gutter on both sides plus the padding, so two neighbours
+		*	are separated by gutter + padding + gutter.
+		*/
+		const int border = settings.gutter * 2 + settings.padding;
+		std::vector<stbrp_rect> pending;
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			if (!surfaces[i])
+			{
+				spdlog::error("Couldn't read " + images[i].filePath + " for atlas \"" + id + "\"");
+				continue;
+			}
+			if (surfaces[i]->w + border > settings.pageSize || surfaces[i]->h + border > settings.pageSize)
+			{
+				spdlog::error(images[i].filePath + " doesn't fit in a page of atlas \"" + id + "\"");
+				continue;
+			}
+
+			stbrp_rect rect = {};
+			rect.id = int(i);
+			rect.w = surfaces[i]->w + border;
+			rect.h = surfaces[i]->h + border;
+			pending.push_back(rect);
+		}
+
+		std::vector<stbrp_node> nodes(settings.pageSize);
+		while (!pending.empty())
+		{
+			stbrp_context context;
+			stbrp_init_target(&context, settings.pageSize, settings.pageSize, nodes.data(), int(nodes.size()));
+			stbrp_pack_rects(&context, pending.data(), int(pending.size()));
+
+			SDL_Surface* page = SDL_CreateRGBSurfaceWithFormat(0, settings.pageSize, settings.pageSize, 32, SDL_PIXELFORMAT_RGBA32);
+			SDL_FillRect(page, nullptr, 0);
+			const int pageIndex = int(pageSurfaces.size());
+			pageSurfaces.push_back(page);
+
+			std::vector<stbrp_rect> leftOver;
+			for (const stbrp_rect& rect : pending)
+			{
+				if (!rect.was_packed)
+				{
+					leftOver.push_back(rect);
+					continue;
+				}
+
+				SDL_Surface* image = surfaces[rect.id];
+				SDL_Rect destination = { rect.x + settings.gutter, rect.y + settings.gutter, image->w, image->h };
+				SDL_SetSurfaceBlendMode(image, SDL_BLENDMODE_NONE);
+				SDL_BlitSurface(image, nullptr, page, &destination);
+				ExtrudeEdges(page, destination, settings.gutter);
+
+				regions[images[rect.id].id] = { pageIndex, destination };
+			}
+			pending.swap(leftOver);
+		}
+
+		for (SDL_Surface* surface : surfaces)
+		{
+			SDL_FreeSurface(surface);
+		}
+
+		spdlog::info("Packed " + std::to_string(regions.size()) + " images into " + std::to_string(pageSurfaces.size()) + " pages for atlas \"" + id + "\"");
+		return !regions.empty();
+	}
+
+	bool TextureAtlas::Save(const std::string& layoutPath) const
+	{
+		if (pageSurfaces.empty())
+		{
+			spdlog::error("Atlas \"" + id + "\" has no pages to save");
+			return false;
+		}
+
+		std::ofstream stream(layoutPath);
+		if (!stream)
+		{
+			spdlog::error("Couldn't write atlas layout " + layoutPath);
+			return false;
+		}
+
+		stream << "<atlas>\n";
+		for (size_t page = 0; page < pageSurfaces.size(); page++)
+		{
+			std::string pageFile = GetFileName(layoutPath) + "_" + std::to_string(page) + ".png";
+			if (IMG_SavePNG(pageSurfaces[page], (GetDirectory(layoutPath) + pageFile).c_str()) != 0)
+			{
+				spdlog::error("Couldn't write atlas page " + pageFile + ": " + IMG_GetError());
+				return false;
+			}
+			stream << "\t<page>" << pageFile << "</page>\n";
+		}
+		for (const auto& region : regions)
+		{
+			stream << "\t<image>\n";
+			stream << "\t\t<id>" << region.first << "</id>\n";
+			stream << "\t\t<page>" << region.second.page << "</page>\n";
+			stream << "\t\t<x>" << region.second.rect.x << "</x>\n";
+			stream << "\t\t<y>" << region.second.rect.y << "</y>\n";
+			stream << "\t\t<w>" << region.second.rect.w << "</w>\n";
+			stream << "\t\t<h>" << region.second.rect.h << "</h>\n";
+			stream << "\t</image>\n";
+		}
+		stream << "</atlas>\n";
+		return true;
+	}
+
+	bool TextureAtlas::Load(const std::string& layoutPath)
+	{
+		std::ifstream stream(layoutPath);
+		if (!stream)
+		{
+			spdlog::error("Couldn't open atlas layout " + layoutPath);
+			return false;
+		}
+
+		rapidxml::file<> xmlFile(stream);
+		rapidxml::xml_document<> doc;
+		std::vector<std::string> newPageFiles;
+		std::map<std::string, AtlasRegion> newRegions;
+		try
+		{
+			doc.parse<0>(xmlFile.data());
+
+			rapidxml::xml_node<>* atlasNode = doc.first_node("atlas");
+			if (!atlasNode)
+			{
+				spdlog::error("Atlas layout " + layoutPath + " has no <atlas> node");
+				return false;
+			}
+
+			for (rapidxml::xml_node<>* node = atlasNode->first_node("page"); node != 0; node = node->next_sibling("page"))
+			{
+				newPageFiles.push_back(GetDirectory(layoutPath) + node->value());
+			}
+			for (rapidxml::xml_node<>* node = atlasNode->first_node("image"); node != 0; node = node->next_sibling("image"))
+			{
+				AtlasRegion region;
+				region.page = std::stoi(ChildValue(node, "page"));
+				region.rect.x = std::stoi(ChildValue(node, "x"));
+				region.rect.y = std::stoi(ChildValue(node, "y"));
+				region.rect.w = std::stoi(ChildValue(node, "w"));
+				region.rect.h = std::stoi(ChildValue(node, "h"));
+				newRegions[ChildValue(node, "id")] = region;
+			}
+		}
+		catch (const rapidxml::parse_error& error)
+		{
+			spdlog::error("Atlas layout " + layoutPath + " is not valid XML: " + error.what());
+			return false;
+		}
+		catch (const std::logic_error&)
+		{
+			//std::stoi: a coordinate missing or not a number.
+			spdlog::error("Atlas layout " + layoutPath + " has an image with a missing or invalid page or rectangle");
+			return false;
+		}
+
+		FreePageSurfaces();
+		pageFiles.swap(newPageFiles);
+		regions.swap(newRegions);
+		return true;
+	}
+
+	const AtlasRegion* TextureAtlas::Find(const std::string& imageId) const
+	{
+		auto it = regions.find(imageId);
+		return it != regions.end() ? &it->second : nullptr;
+	}
+
+	bool TextureAtlas::Remap(std::string& assetId, SDL_Rect& srcRect) const
+	{
+		const AtlasRegion* region = Find(assetId);
+		if (!region)
+		{
+			return false;
+		}
+
+		assetId = GetPageId(id, region->page);
+		srcRect.x += region->rect.x;
+		srcRect.y += region->rect.y;
+		return true;
+	}
+}
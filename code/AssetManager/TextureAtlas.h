@@ -0,0 +1,131 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <map>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <sdl2/SDL.h>
+#include <AssetManager/AssetHandle.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Image to pack into an atlas. The id is what sprites use to refer to it (usually their assetId).
+	/// </summary>
+	struct AtlasImage
+	{
+		std::string id;
+		std::string filePath;
+	};
+
+	struct AtlasSettings
+	{
+		/// <summary>
+		/// Width and height of every page, in pixels.
+		/// </summary>
+		int pageSize = 2048;
+		/// <summary>
+		/// Empty pixels between two gutters.
+		/// </summary>
+		int padding = 2;
+		/// <summary>
+		/// Pixels around every image filled with copies of its border, so filtering and mipmaps sample
+		/// the image's own edge instead of its neighbour.
+		/// </summary>
+		int gutter = 1;
+	};
+
+	/// <summary>
+	/// Where an image ended up: page index and rectangle inside it, gutter excluded.
+	/// </summary>
+	struct AtlasRegion
+	{
+		int page;
+		SDL_Rect rect;
+	};
+
+	/// <summary>
+	/// Packs many small images into a few big textures (pages), so sprites sharing a page can be drawn
+	/// without switching textures.
+	///
+	/// Atlases are built at load time with Build(), or offline with Build() + Save() and then loaded with
+	/// AssetManager::LoadAtlas(). The AssetManager owns the page textures.
+	/// </summary>
+	class TextureAtlas
+	{
+		friend class AssetManager;
+	private:
+		std::string id;
+		std::map<std::string, AtlasRegion> regions;
+
+		/// <summary>
+		/// Built pages, until the AssetManager turns them into textures.
+		/// </summary>
+		std::vector<SDL_Surface*> pageSurfaces;
+		/// <summary>
+		/// Page files of atlases loaded from disk.
+		/// </summary>
+		std::vector<std::string> pageFiles;
+		/// <summary>
+		/// Keeps the pages loaded as long as the atlas exists.
+		/// </summary>
+		std::vector<AssetHandle<SDL_Texture>> pageTextures;
+
+		void FreePageSurfaces();
+
+	public:
+		TextureAtlas(const std::string& id) : id(id) {}
+		~TextureAtlas();
+
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator = (const TextureAtlas&) = delete;
+
+		const std::string& GetId() const { return id; }
+		size_t GetPageCount() const { return std::max(pageSurfaces.size(), std::max(pageFiles.size(), pageTextures.size())); }
+
+		/// <summary>
+		/// Asset id of a page texture.
+		/// </summary>
+		static std::string GetPageId(const std::string& atlasId, size_t page)
+		{
+			return atlasId + "#" + std::to_string(page);
+		}
+
+		/// <summary>
+		/// Decodes the images in parallel and packs them into as few pages as possible.
+		/// Images that can't be read or don't fit in a page are skipped with an error.
+		/// </summary>
+		bool Build(const std::vector<AtlasImage>& images, const AtlasSettings& settings = AtlasSettings());
+
+		/// <summary>
+		/// Writes the pages as "<layout file name>_<page>.png" next to the layout file. Only for atlases
+		/// built in this session, before they are given to the AssetManager.
+		/// </summary>
+		bool Save(const std::string& layoutPath) const;
+
+		/// <summary>
+		/// Reads a layout written by Save(). The pages are loaded by the AssetManager.
+		/// </summary>
+		/// <returns>false, logged and leaving the atlas untouched, if the file can't be read or is malformed</returns>
+		bool Load(const std::string& layoutPath);
+
+		/// <returns>nullptr if the image isn't in this atlas</returns>
+		const AtlasRegion* Find(const std::string& imageId) const;
+
+		/// <summary>
+		/// Texture of a page, once the AssetManager has created it.
+		/// </summary>
+		const AssetHandle<SDL_Texture>& GetPageTexture(size_t page) const { return pageTextures[page]; }
+
+		/// <summary>
+		/// Turns a sprite that points at a region of one of the packed images into the same region of the
+		/// atlas page: assetId becomes the page's asset id and srcRect is moved into page space.
+		/// </summary>
+		/// <returns>false, leaving both untouched, if the image isn't in this atlas</returns>
+		bool Remap(std::string& assetId, SDL_Rect& srcRect) const;
+	};
+}
@@ -0,0 +1,295 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Benchmark/RenderCpuBenchmark.h>
+#include <Render/RenderQueue.h>
+#include <Render/AabbTree.h>
+#include <Jobs/JobSystem.h>
+#include <gltk/Render_Backend.hpp>
+#include <gltk/Cube.hpp>
+#include <gltk/Light.hpp>
+#include <gltk/Render_Node.hpp>
+#include <gltk/Vertex_Shader.hpp>
+#include <gltk/Fragment_Shader.hpp>
+#include <spdlog/spdlog.h>
+#include <sdl2/SDL.h>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+	namespace
+	{
+		const int MESH_COUNT = 8;
+		/// <summary>
+		/// The toolkit's cube spans -1..1 on every axis.
+		/// </summary>
+		const Aabb CUBE_BOUNDS(glm::vec3(-1.f), glm::vec3(1.f));
+
+		//Never compiled for real, but the uniforms are the ones the toolkit and the queue look up.
+		const char* VERTEX_SHADER_CODE =
+			"#version 330\n"
+			"uniform mat4 model_view_matrix;\n"
+			"uniform mat4 projection_matrix;\n"
+			"uniform mat4 normal_matrix;\n"
+			"layout (location = 0) in vec3 vertex_coordinates;\n"
+			"void main() { gl_Position = projection_matrix * model_view_matrix * vec4(vertex_coordinates, 1.0); }\n";
+		const char* FRAGMENT_SHADER_CODE =
+			"#version 330\n"
+			"uniform vec3 material_color;\n"
+			"out vec4 fragment_color;\n"
+			"void main() { fragment_color = vec4(material_color, 1.0); }\n";
+
+		struct StageTime
+		{
+			const char* name;
+			Uint64 counts = 0;
+			/// <summary>
+			/// Draws the stage handled over all the frames.
+			/// </summary>
+			size_t draws = 0;
+		};
+
+		void Report(const StageTime& stage, unsigned frames)
+		{
+			const double frameNs = double(stage.counts) * 1e9 / SDL_GetPerformanceFrequency() / frames;
+			const double drawNs = stage.draws > 0 ? double(stage.counts) * 1e9 / SDL_GetPerformanceFrequency() / stage.draws : 0.0;
+			char line[256];
+			std::snprintf(line, sizeof(line), "%-28s %9.3f ms/frame  %8.1f ns/draw", stage.name, frameNs / 1e6, drawNs);
+			spdlog::info(line);
+			std::printf("%s\n", line);
+		}
+
+		/// <summary>
+		/// Calls recorded since the backend's last reset, per frame, with the most called functions.
+		/// </summary>
+		void ReportCalls(const std::string& name, const glt::Recording_Backend& backend, unsigned frames)
+		{
+			std::vector<glt::Recording_Backend::Function> functions;
+			for (unsigned i = 0; i < glt::Recording_Backend::FUNCTION_COUNT; i++)
+			{
+				if (backend.get_count(glt::Recording_Backend::Function(i)) > 0)
+				{
+					functions.push_back(glt::Recording_Backend::Function(i));
+				}
+			}
+			std::sort(functions.begin(), functions.end(), [&backend](glt::Recording_Backend::Function a, glt::Recording_Backend::Function b)
+				{
+					return backend.get_count(a) > backend.get_count(b);
+				});
+
+			std::string line = name + " GL calls per frame: " + std::to_string(backend.get_total_count() / frames) + " ("
+				+ std::to_string(backend.get_draw_call_count() / frames) + " draws)";
+			for (size_t i = 0; i < functions.size() && i < 4; i++)
+			{
+				line += std::string(i == 0 ? ", " : " ") + glt::Recording_Backend::get_function_name(functions[i]) + " "
+					+ std::to_string(backend.get_count(functions[i]) / frames);
+			}
+			spdlog::info(line);
+			std::printf("%s\n", line.c_str());
+		}
+	}
+
+	void RunRenderCpuBenchmark(unsigned cubeCount, unsigned materialCount, unsigned frames)
+	{
+		//Declared first: the scene below calls GL until it's destroyed.
+		glt::Recording_Backend backend;
+		if (!backend.install())
+		{
+			spdlog::error("Couldn't install the recording render backend");
+			return;
+		}
+		materialCount = std::max(materialCount, 1u);
+		frames = std::max(frames, 1u);
+
+		glt::Render_Node renderNode;
+
+		//Inside the field, so part of it is behind or around the camera.
+		std::shared_ptr<glt::Camera> camera(new glt::Camera(20.f, 1.f, 500.f, 16.f / 9.f));
+		camera->translate(glt::Vector3(0.f, 0.f, 20.f));
+		renderNode.add("camera", camera);
+
+		std::shared_ptr<glt::Light> light(new glt::Light);
+		light->translate(glt::Vector3(10.f, 10.f, 10.f));
+		renderNode.add("light", light);
+
+		std::shared_ptr<glt::Shader_Program> program(new glt::Shader_Program);
+		glt::Vertex_Shader vertexShader(glt::Shader::Source_Code::from_string(VERTEX_SHADER_CODE));
+		glt::Fragment_Shader fragmentShader(glt::Shader::Source_Code::from_string(FRAGMENT_SHADER_CODE));
+		program->attach(vertexShader);
+		program->attach(fragmentShader);
+		program->link();
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> channel(0.2f, 1.f);
+		std::vector<std::shared_ptr<glt::Material>> materials;
+		for (unsigned i = 0; i < materialCount; i++)
+		{
+			materials.emplace_back(new glt::Material("material" + std::to_string(i), program));
+			materials.back()->set("material_color", glt::Vector3(channel(random), channel(random), channel(random)));
+		}
+
+		std::vector<std::shared_ptr<glt::Drawable>> meshes;
+		for (int i = 0; i < MESH_COUNT; i++)
+		{
+			meshes.push_back(std::shared_ptr<glt::Drawable>(new glt::Cube));
+		}
+
+		std::uniform_real_distribution<float> position(-60.f, 60.f);
+		std::vector<std::shared_ptr<glt::Model>> models(cubeCount);
+		AabbTree tree;
+		for (unsigned i = 0; i < cubeCount; i++)
+		{
+			models[i].reset(new glt::Model);
+			models[i]->add(meshes[random() % MESH_COUNT], materials[i % materialCount]);
+			models[i]->translate(glt::Vector3(position(random), position(random), position(random)));
+			renderNode.add("node" + std::to_string(i), models[i]);
+			tree.CreateProxy(CUBE_BOUNDS.Transform(models[i]->get_total_transformation()), int(i));
+		}
+
+		std::string header = "Render CPU benchmark (no GPU, " + std::string(backend.get_name()) + " backend): " + std::to_string(cubeCount)
+			+ " cubes, " + std::to_string(materialCount) + " materials, " + std::to_string(frames) + " frames";
+		spdlog::info(header);
+		std::printf("%s\n", header.c_str());
+
+		/*
+		*	Render_Node: traversal and draws in one go, every node every frame.
+		*/
+		StageTime traversal = { "Render_Node::render" };
+		renderNode.render();
+		backend.reset();
+		for (unsigned frame = 0; frame < frames; frame++)
+		{
+			GlState::Instance().BeginFrame();
+			const Uint64 start = SDL_GetPerformanceCounter();
+			renderNode.render();
+			traversal.counts += SDL_GetPerformanceCounter() - start;
+			traversal.draws += cubeCount;
+		}
+		Report(traversal, frames);
+		ReportCalls("Render_Node", backend, frames);
+
+		/*
+		*	Render queue, stage by stage.
+		*/
+		std::vector<glt::Node*> shaderListeners = { light.get() };
+		RenderQueue queue;
+		std::vector<RenderCommandBuffer> commandBuffers(JobSystem::Instance().GetWorkerCount() + 1);
+		std::vector<int> visible;
+		CullingStats cullingStats;
+		const glt::Matrix44 viewProjection = camera->get_projection_matrix() * camera->get_inverse_total_transformation();
+
+		StageTime culling = { "Culling (AabbTree)" };
+		StageTime recording = { "Recording" };
+		StageTime parallelRecording = { "Recording (JobSystem)" };
+		StageTime sorting = { "Sorting" };
+		StageTime submission = { "Command generation" };
+
+		auto runFrame = [&](bool measure)
+		{
+			GlState::Instance().BeginFrame();
+			Uint64 time = SDL_GetPerformanceCounter();
+			auto lap = [&time](StageTime& stage, size_t draws)
+			{
+				const Uint64 now = SDL_GetPerformanceCounter();
+				stage.counts += now - time;
+				stage.draws += draws;
+				time = now;
+			};
+
+			visible.clear();
+			cullingStats = CullingStats();
+			tree.Query(Frustum::FromMatrix(viewProjection), visible, cullingStats);
+			lap(culling, cubeCount);
+
+			queue.Begin(*camera);
+			for (int index : visible)
+			{
+				queue.Add(*models[index]);
+			}
+			lap(recording, queue.GetPacketCount());
+
+			const size_t batchSize = std::max<size_t>(1, (visible.size() + commandBuffers.size() - 1) / commandBuffers.size());
+			queue.Begin(*camera);
+			for (RenderCommandBuffer& buffer : commandBuffers)
+			{
+				buffer.Begin(*camera);
+			}
+			JobSystem::Instance().ParallelFor(visible.size(), batchSize, [&](size_t begin, size_t end)
+				{
+					RenderCommandBuffer& buffer = commandBuffers[begin / batchSize];
+					for (size_t i = begin; i < end; i++)
+					{
+						buffer.Add(*models[visible[i]]);
+					}
+				});
+			for (const RenderCommandBuffer& buffer : commandBuffers)
+			{
+				queue.Merge(buffer);
+			}
+			lap(parallelRecording, queue.GetPacketCount());
+
+			queue.Sort();
+			lap(sorting, queue.GetPacketCount());
+
+			queue.Submit(shaderListeners);
+			lap(submission, queue.GetPacketCount());
+
+			if (!measure)
+			{
+				culling = { culling.name };
+				recording = { recording.name };
+				parallelRecording = { parallelRecording.name };
+				sorting = { sorting.name };
+				submission = { submission.name };
+			}
+		};
+
+		runFrame(false);
+		backend.reset();
+		for (unsigned frame = 0; frame < frames; frame++)
+		{
+			runFrame(true);
+		}
+		for (const StageTime* stage : { &culling, &recording, &parallelRecording, &sorting, &submission })
+		{
+			Report(*stage, frames);
+		}
+		ReportCalls("RenderQueue", backend, frames);
+
+		std::string culled = "Frustum culling: " + std::to_string(cullingStats.drawn) + " of " + std::to_string(cubeCount) + " cubes drawn, "
+			+ std::to_string(queue.GetShaderChangeCount()) + " programs and " + std::to_string(queue.GetMaterialChangeCount()) + " materials bound";
+		spdlog::info(culled);
+		std::printf("%s\n", culled.c_str());
+
+		/*
+		*	Command generation again with every material instanced.
+		*/
+		UniformBlocks uniformBlocks;
+		InstancedRenderer instancedRenderer;
+		if (!uniformBlocks.Initialize(materialCount) || !instancedRenderer.Initialize())
+		{
+			return;
+		}
+		queue.SetUniformBlocks(&uniformBlocks);
+		queue.SetInstancing(&instancedRenderer);
+		for (const auto& material : materials)
+		{
+			queue.EnableInstancing(material.get());
+		}
+
+		submission = { "Command generation instanced" };
+		runFrame(false);
+		backend.reset();
+		for (unsigned frame = 0; frame < frames; frame++)
+		{
+			runFrame(true);
+		}
+		Report(submission, frames);
+		ReportCalls("RenderQueue instanced", backend, frames);
+	}
+}
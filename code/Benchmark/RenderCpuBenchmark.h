@@ -0,0 +1,19 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+namespace engine
+{
+	/// <summary>
+	/// Measures the CPU side of the 3D renderer without GPU, window or GL context: the GL calls go to a
+	/// glt::Recording_Backend, which only counts them. The scene is cubeCount cubes sharing a few meshes
+	/// and materialCount materials, seen from inside the field.
+	///
+	/// Reports glt::Render_Node::render() traversal and, for the render queue, culling, recording (serial
+	/// and on the JobSystem), sorting and command generation (Submit(), plain and instanced), in ns per
+	/// draw, plus the GL calls each renderer issues per frame. Results go to the log and to stdout.
+	/// </summary>
+	void RunRenderCpuBenchmark(unsigned cubeCount, unsigned materialCount, unsigned frames = 100);
+}
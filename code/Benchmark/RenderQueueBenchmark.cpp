@@ -0,0 +1,318 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Benchmark/RenderQueueBenchmark.h>
+#include <Render/RenderQueue.h>
+#include <Render/AabbTree.h>
+#include <Render/ClusteredLighting.h>
+#include <Jobs/JobSystem.h>
+#include <Window/Window.h>
+#include <gltk/Cube.hpp>
+#include <gltk/Light.hpp>
+#include <gltk/Render_Node.hpp>
+#include <spdlog/spdlog.h>
+#include <sdl2/SDL.h>
+#include <cstdio>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace engine
+{
+	namespace
+	{
+		const int MESH_COUNT = 8;
+		/// <summary>
+		/// The toolkit's cube spans -1..1 on every axis.
+		/// </summary>
+		const Aabb CUBE_BOUNDS(glm::vec3(-1.f), glm::vec3(1.f));
+
+		/// <summary>
+		/// Average milliseconds per frame of the given work. glFinish() closes every frame so the driver
+		/// queue can't grow across frames and hide the cost of the next ones.
+		/// </summary>
+		double Measure(unsigned frames, const std::function<void()>& frame)
+		{
+			frame();
+			glFinish();
+
+			const Uint64 start = SDL_GetPerformanceCounter();
+			for (unsigned i = 0; i < frames; i++)
+			{
+				frame();
+				glFinish();
+			}
+			return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+		}
+
+		void Report(const std::string& name, unsigned nodeCount, double frameMs)
+		{
+			char line[256];
+			std::snprintf(line, sizeof(line), "%-28s %8.3f ms/frame  %10.1f nodes/ms", name.c_str(), frameMs, nodeCount / frameMs);
+			spdlog::info(line);
+			std::printf("%s\n", line);
+		}
+	}
+
+	void RunRenderQueueBenchmark(unsigned nodeCount, unsigned frames)
+	{
+		Window window("Render queue benchmark", 640, 360, false, -1);
+		window.SetVisible(false);
+		window.SetVsync(false);
+
+		glt::Render_Node renderNode;
+
+		std::shared_ptr<glt::Camera> camera(new glt::Camera(20.f, 1.f, 500.f, 640.f / 360.f));
+		camera->translate(glt::Vector3(0.f, 0.f, 200.f));
+		renderNode.add("camera", camera);
+
+		std::shared_ptr<glt::Light> light(new glt::Light);
+		light->translate(glt::Vector3(10.f, 10.f, 10.f));
+		renderNode.add("light", light);
+
+		/*
+		*	A few meshes shared by all the nodes, as a scene full of copies of the same enemies would have.
+		*/
+		std::vector<std::shared_ptr<glt::Drawable>> meshes;
+		for (int i = 0; i < MESH_COUNT; i++)
+		{
+			meshes.push_back(std::shared_ptr<glt::Drawable>(new glt::Cube));
+		}
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-60.f, 60.f);
+		std::vector<std::shared_ptr<glt::Model>> models(nodeCount);
+		for (unsigned i = 0; i < nodeCount; i++)
+		{
+			models[i].reset(new glt::Model);
+			models[i]->add(meshes[random() % MESH_COUNT], glt::Material::default_material());
+			models[i]->translate(glt::Vector3(position(random), position(random), position(random)));
+			renderNode.add("node" + std::to_string(i), models[i]);
+		}
+
+		std::vector<glt::Node*> shaderListeners = { light.get() };
+		RenderQueue queue;
+		auto fillQueue = [&]()
+		{
+			queue.Begin(*camera);
+			for (const auto& model : models)
+			{
+				queue.Add(*model);
+			}
+			queue.Sort();
+		};
+
+		std::string header = "Render queue benchmark: " + std::to_string(nodeCount) + " nodes, " + std::to_string(frames) + " frames";
+		spdlog::info(header);
+		std::printf("%s\n", header.c_str());
+
+		Report("Render_Node::render", nodeCount, Measure(frames, [&]()
+			{
+				window.Clear();
+				renderNode.render();
+			}));
+
+		Report("RenderQueue", nodeCount, Measure(frames, [&]()
+			{
+				window.Clear();
+				GlState::Instance().BeginFrame();
+				fillQueue();
+				queue.Submit(shaderListeners);
+			}));
+		GlState::Instance().BeginFrame();
+
+		Report("RenderQueue build+sort only", nodeCount, Measure(frames, fillQueue));
+
+		//The same, recorded on every thread of the JobSystem and merged.
+		std::vector<RenderCommandBuffer> commandBuffers(JobSystem::Instance().GetWorkerCount() + 1);
+		const size_t batchSize = std::max<size_t>(1, (models.size() + commandBuffers.size() - 1) / commandBuffers.size());
+		Report("RenderQueue parallel record", nodeCount, Measure(frames, [&]()
+			{
+				queue.Begin(*camera);
+				for (RenderCommandBuffer& buffer : commandBuffers)
+				{
+					buffer.Begin(*camera);
+				}
+				JobSystem::Instance().ParallelFor(models.size(), batchSize, [&](size_t begin, size_t end)
+					{
+						RenderCommandBuffer& buffer = commandBuffers[begin / batchSize];
+						for (size_t i = begin; i < end; i++)
+						{
+							buffer.Add(*models[i]);
+						}
+					});
+				for (const RenderCommandBuffer& buffer : commandBuffers)
+				{
+					queue.Merge(buffer);
+				}
+				queue.Sort();
+			}));
+
+		std::string changes = "RenderQueue state changes per frame: " + std::to_string(queue.GetShaderChangeCount()) + " programs, "
+			+ std::to_string(queue.GetMaterialChangeCount()) + " materials, " + std::to_string(queue.GetDrawCallCount()) + " draws";
+		spdlog::info(changes);
+		std::printf("%s\n", changes.c_str());
+
+		const GlState::Counters& glCalls = GlState::Instance().GetLastFrameCounters();
+		std::string redundant = "GL state calls per frame: " + std::to_string(glCalls.GetIssued()) + " issued, "
+			+ std::to_string(glCalls.GetSkipped()) + " skipped as redundant ("
+			+ std::to_string(glCalls.skipped[GlState::UNIFORM]) + " uniforms, "
+			+ std::to_string(glCalls.skipped[GlState::VERTEX_ARRAY]) + " vertex arrays)";
+		spdlog::info(redundant);
+		std::printf("%s\n", redundant.c_str());
+
+		/*
+		*	Same scene with the meshes in a pool: one vertex array for all of them.
+		*/
+		MeshPool meshPool;
+		if (meshPool.Initialize())
+		{
+			for (const auto& mesh : meshes)
+			{
+				meshPool.Add(mesh);
+			}
+			queue.SetMeshPool(&meshPool);
+			Report("RenderQueue pooled meshes", nodeCount, Measure(frames, [&]()
+				{
+					window.Clear();
+					GlState::Instance().BeginFrame();
+					fillQueue();
+					queue.Submit(shaderListeners);
+				}));
+			GlState::Instance().BeginFrame();
+
+			const MeshPoolStats poolStats = meshPool.GetStats();
+			std::string pooled = "Mesh pool: " + std::to_string(poolStats.meshes) + " meshes, "
+				+ std::to_string(GlState::Instance().GetLastFrameCounters().issued[GlState::VERTEX_ARRAY])
+				+ " vertex array binds per frame";
+			spdlog::info(pooled);
+			std::printf("%s\n", pooled.c_str());
+		}
+
+		/*
+		*	Same scene with the runs of shared meshes instanced. Also a smoke test of the instanced path:
+		*	it runs on any GL 3.3 driver, llvmpipe included (LIBGL_ALWAYS_SOFTWARE=1).
+		*/
+		UniformBlocks uniformBlocks;
+		InstancedRenderer instancedRenderer;
+		if (!uniformBlocks.Initialize() || !instancedRenderer.Initialize())
+		{
+			return;
+		}
+		queue.SetUniformBlocks(&uniformBlocks);
+		queue.SetInstancing(&instancedRenderer);
+		queue.EnableInstancing(glt::Material::default_material().get());
+		while (glGetError() != GL_NO_ERROR) {}
+
+		Report("RenderQueue instanced", nodeCount, Measure(frames, [&]()
+			{
+				window.Clear();
+				GlState::Instance().BeginFrame();
+				fillQueue();
+				queue.Submit(shaderListeners);
+			}));
+		GlState::Instance().BeginFrame();
+
+		const GLenum error = glGetError();
+		std::string instanced = "RenderQueue instanced draws per frame: " + std::to_string(queue.GetDrawCallCount())
+			+ (error == GL_NO_ERROR ? ", no GL errors" : ", GL error " + std::to_string(error));
+		spdlog::info(instanced);
+		std::printf("%s\n", instanced.c_str());
+
+		/*
+		*	Same again with every instanced mesh of a material in one multi-draw, if the meshes are pooled.
+		*/
+		if (meshPool.IsReady())
+		{
+			queue.EnableMultiDraw(true);
+			Report("RenderQueue multi-draw", nodeCount, Measure(frames, [&]()
+				{
+					window.Clear();
+					GlState::Instance().BeginFrame();
+					fillQueue();
+					queue.Submit(shaderListeners);
+				}));
+			GlState::Instance().BeginFrame();
+
+			std::string multiDrawn = "RenderQueue multi-draw: " + std::to_string(queue.GetDrawCallCount()) + " draws per frame for "
+				+ std::to_string(queue.GetMultiDrawCommandCount()) + " meshes"
+				+ (instancedRenderer.HasMultiDrawIndirect() ? ", glMultiDrawElementsIndirect" : ", one draw per mesh (no GL 4.3)");
+			spdlog::info(multiDrawn);
+			std::printf("%s\n", multiDrawn.c_str());
+			queue.EnableMultiDraw(false);
+		}
+
+		/*
+		*	Instanced again, shaded by a few hundred point lights binned into clusters every frame.
+		*/
+		ClusteredLighting clusteredLighting;
+		if (clusteredLighting.Initialize())
+		{
+			std::vector<PointLight> pointLights(256);
+			std::uniform_real_distribution<float> channel(0.2f, 1.f);
+			for (PointLight& pointLight : pointLights)
+			{
+				pointLight.position = glm::vec3(position(random), position(random), position(random));
+				pointLight.radius = 15.f;
+				pointLight.color = glm::vec3(channel(random), channel(random), channel(random));
+			}
+
+			Report("RenderQueue clustered lights", nodeCount, Measure(frames, [&]()
+				{
+					window.Clear();
+					GlState::Instance().BeginFrame();
+					clusteredLighting.Update(camera->get_inverse_total_transformation(), camera->get_projection_matrix(), pointLights);
+					clusteredLighting.Bind();
+					uniformBlocks.SetClusters(&clusteredLighting.GetClusters(), 640.f, 360.f);
+					fillQueue();
+					queue.Submit(shaderListeners);
+				}));
+			GlState::Instance().BeginFrame();
+			uniformBlocks.SetClusters(nullptr, 0.f, 0.f);
+
+			const LightClusters& clusters = clusteredLighting.GetClusters();
+			std::string lights = "Clustered lights: " + std::to_string(pointLights.size()) + " lights, "
+				+ std::to_string(clusters.GetClusterCount()) + " clusters, " + std::to_string(clusters.GetLightIndices().size())
+				+ " light references, at most " + std::to_string(clusters.GetMaxLightsPerCluster()) + " per cluster";
+			spdlog::info(lights);
+			std::printf("%s\n", lights.c_str());
+		}
+
+		/*
+		*	And with frustum culling, the camera moved into the field so part of it is behind or around it.
+		*/
+		camera->translate(glt::Vector3(0.f, 0.f, -180.f));
+		AabbTree tree;
+		for (unsigned i = 0; i < nodeCount; i++)
+		{
+			tree.CreateProxy(CUBE_BOUNDS.Transform(models[i]->get_total_transformation()), int(i));
+		}
+
+		std::vector<int> visible;
+		CullingStats cullingStats;
+		Report("RenderQueue culled", nodeCount, Measure(frames, [&]()
+			{
+				window.Clear();
+				GlState::Instance().BeginFrame();
+				visible.clear();
+				cullingStats = CullingStats();
+				tree.Query(Frustum::FromMatrix(camera->get_projection_matrix() * camera->get_inverse_total_transformation()), visible, cullingStats);
+				queue.Begin(*camera);
+				for (int index : visible)
+				{
+					queue.Add(*models[index]);
+				}
+				queue.Sort();
+				queue.Submit(shaderListeners);
+			}));
+		GlState::Instance().BeginFrame();
+
+		std::string culling = "Frustum culling: " + std::to_string(cullingStats.tested) + " tested, " + std::to_string(cullingStats.culled)
+			+ " culled, " + std::to_string(cullingStats.drawn) + " drawn, tree height " + std::to_string(tree.GetHeight());
+		spdlog::info(culling);
+		std::printf("%s\n", culling.c_str());
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+namespace engine
+{
+	/// <summary>
+	/// Compares glt::Render_Node::render() with RenderQueue on nodeCount cubes sharing a few meshes, in a
+	/// hidden window. Reports the CPU time per frame of both, plus the queue build and sort alone and the
+	/// queue with instancing and with frustum culling.
+	/// Results go to the log and to stdout.
+	/// </summary>
+	void RunRenderQueueBenchmark(unsigned nodeCount, unsigned frames = 60);
+}
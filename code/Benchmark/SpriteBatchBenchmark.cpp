@@ -0,0 +1,140 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Benchmark/SpriteBatchBenchmark.h>
+#include <Render/SpriteBatch.h>
+#include <spdlog/spdlog.h>
+#include <sdl2/SDL.h>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace engine
+{
+	namespace
+	{
+		const int SCREEN_WIDTH = 1920;
+		const int SCREEN_HEIGHT = 1080;
+		const int TEXTURE_COUNT = 4;
+		const int LAYER_COUNT = 4;
+
+		struct BenchmarkSprite
+		{
+			SDL_Texture* texture;
+			SDL_Rect srcRect;
+			SDL_FRect dstRect;
+			float angle;
+			int layer;
+		};
+
+		/// <summary>
+		/// Average milliseconds per frame of the given work.
+		/// </summary>
+		double Measure(unsigned frames, const std::function<void()>& frame)
+		{
+			//One untimed frame to warm caches and let the vectors grow.
+			frame();
+
+			const Uint64 start = SDL_GetPerformanceCounter();
+			for (unsigned i = 0; i < frames; i++)
+			{
+				frame();
+			}
+			return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+		}
+
+		void Report(const std::string& name, unsigned spriteCount, double frameMs)
+		{
+			char line[256];
+			std::snprintf(line, sizeof(line), "%-22s %8.3f ms/frame  %10.1f sprites/ms", name.c_str(), frameMs, spriteCount / frameMs);
+			spdlog::info(line);
+			std::printf("%s\n", line);
+		}
+	}
+
+	void RunSpriteBatchBenchmark(unsigned spriteCount, unsigned frames)
+	{
+		SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_RGBA32);
+		SDL_Renderer* renderer = target ? SDL_CreateSoftwareRenderer(target) : nullptr;
+		if (!renderer)
+		{
+			spdlog::error(std::string("Couldn't create the benchmark renderer: ") + SDL_GetError());
+			SDL_FreeSurface(target);
+			return;
+		}
+
+		/*
+		*	A few 32x32 textures, as if every unit type had its own image.
+		*/
+		SDL_Texture* textures[TEXTURE_COUNT];
+		for (int i = 0; i < TEXTURE_COUNT; i++)
+		{
+			SDL_Surface* image = SDL_CreateRGBSurfaceWithFormat(0, 32, 32, 32, SDL_PIXELFORMAT_RGBA32);
+			SDL_FillRect(image, nullptr, SDL_MapRGBA(image->format, Uint8(60 * i), 200, Uint8(255 - 60 * i), 255));
+			textures[i] = SDL_CreateTextureFromSurface(renderer, image);
+			SDL_FreeSurface(image);
+		}
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> x(0.f, SCREEN_WIDTH - 32.f);
+		std::uniform_real_distribution<float> y(0.f, SCREEN_HEIGHT - 32.f);
+		std::vector<BenchmarkSprite> sprites(spriteCount);
+		for (unsigned i = 0; i < spriteCount; i++)
+		{
+			//A quarter of them rotated, like units turning around.
+			sprites[i] = { textures[random() % TEXTURE_COUNT], { 0, 0, 32, 32 }, { x(random), y(random), 32.f, 32.f },
+				i % 4 == 0 ? float(random() % 360) : 0.f, int(random() % LAYER_COUNT) };
+		}
+
+		SpriteBatch batch;
+		auto fillBatch = [&batch, &sprites]()
+		{
+			batch.Begin();
+			for (const BenchmarkSprite& sprite : sprites)
+			{
+				batch.Draw(sprite.texture, sprite.srcRect, sprite.dstRect, sprite.angle, sprite.layer);
+			}
+		};
+
+		std::string header = "Sprite benchmark: " + std::to_string(spriteCount) + " sprites, " + std::to_string(frames) + " frames";
+		spdlog::info(header);
+		std::printf("%s\n", header.c_str());
+
+		Report("RenderCopyEx", spriteCount, Measure(frames, [&]()
+			{
+				for (const BenchmarkSprite& sprite : sprites)
+				{
+					SDL_Rect dstRect = { int(sprite.dstRect.x), int(sprite.dstRect.y), int(sprite.dstRect.w), int(sprite.dstRect.h) };
+					SDL_RenderCopyEx(renderer, sprite.texture, &sprite.srcRect, &dstRect, sprite.angle, NULL, SDL_FLIP_NONE);
+				}
+				SDL_RenderPresent(renderer);
+			}));
+
+		Report("SpriteBatch", spriteCount, Measure(frames, [&]()
+			{
+				fillBatch();
+				batch.End(renderer);
+				SDL_RenderPresent(renderer);
+			}));
+
+		Report("SpriteBatch build only", spriteCount, Measure(frames, [&]()
+			{
+				fillBatch();
+				batch.End(nullptr);
+			}));
+
+		std::string drawCalls = "SpriteBatch draw calls per frame: " + std::to_string(batch.GetDrawCallCount());
+		spdlog::info(drawCalls);
+		std::printf("%s\n", drawCalls.c_str());
+
+		for (SDL_Texture* texture : textures)
+		{
+			SDL_DestroyTexture(texture);
+		}
+		SDL_DestroyRenderer(renderer);
+		SDL_FreeSurface(target);
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+namespace engine
+{
+	/// <summary>
+	/// Headless benchmark of the 2D sprite path. Draws spriteCount sprites per frame on a software renderer,
+	/// once with a SDL_RenderCopyEx per sprite and once through SpriteBatch, and reports sprites/ms of both
+	/// (plus the batch build alone, which is what the CPU pays whatever the renderer).
+	/// Results go to the log and to stdout.
+	/// </summary>
+	void RunSpriteBatchBenchmark(unsigned spriteCount, unsigned frames = 60);
+}
@@ -19,10 +19,27 @@ namespace engine
 	struct Node3DComponent {
 		std::string modelId;
 		std::shared_ptr< glt::Node  > node;
+		/// <summary>
+		/// Object color when the node is drawn instanced.
+		/// </summary>
+		glm::vec4 color;
+		/// <summary>
+		/// The node hides what's behind it (walls, floors). Its bounds are used as its shape, so only
+		/// solid box-like meshes should be flagged.
+		/// </summary>
+		bool occluder;
+		/// <summary>
+		/// The node never moves: its meshes are merged with the other static ones (see StaticBatcher).
+		/// </summary>
+		bool isStatic;
 
-		Node3DComponent(std::string assetId = "", std::shared_ptr<glt::Node> node = nullptr) {
+		Node3DComponent(std::string assetId = "", std::shared_ptr<glt::Node> node = nullptr, glm::vec4 color = glm::vec4(1, 1, 1, 1), bool occluder = false,
+			bool isStatic = false) {
 			this->modelId = assetId;
 			this->node = node;
+			this->color = color;
+			this->occluder = occluder;
+			this->isStatic = isStatic;
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <glm/glm.hpp>
+
+namespace engine
+{
+	/// <summary>
+	/// Light with a limited range, at the entity's position. Drawn through the clustered lights, so
+	/// there can be hundreds of them.
+	/// </summary>
+	struct PointLightComponent
+	{
+		glm::vec3 color;
+		float intensity;
+		/// <summary>
+		/// Distance at which the light fades out completely.
+		/// </summary>
+		float radius;
+
+		PointLightComponent(glm::vec3 color = glm::vec3(1.0, 1.0, 1.0), float intensity = 1.f, float radius = 10.f) {
+			this->color = color;
+			this->intensity = intensity;
+			this->radius = radius;
+		}
+	};
+
+}
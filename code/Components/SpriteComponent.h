@@ -4,6 +4,7 @@
  *  Copyright (c) Lorenzo Herran - 2021   *
 \******************************************/
 
+#include <string>
 #include <glm/glm.hpp>
 #include <sdl2/SDL.h>
 
@@ -19,12 +20,17 @@ namespace engine
 		int width;
 		int height;
 		SDL_Rect srcRect;
+		/// <summary>
+		/// Sprites in lower layers are drawn first (behind).
+		/// </summary>
+		int layer;
 
-		SpriteComponent(std::string assetId = "", int width = 0, int height = 0, int srcRectX = 0, int srcRectY = 0) {
+		SpriteComponent(std::string assetId = "", int width = 0, int height = 0, int srcRectX = 0, int srcRectY = 0, int layer = 0) {
 			this->assetId = assetId;
 			this->width = width;
 			this->height = height;
 			this->srcRect = { srcRectX, srcRectY, width, height };
+			this->layer = layer;
 		}
 	};
 }
\ No newline at end of file
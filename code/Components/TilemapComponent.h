@@ -0,0 +1,134 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sdl2/SDL.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Tiles of a chunk baked into one static vertex batch, in map space (pixels from the map's corner).
+	/// </summary>
+	struct TilemapChunk
+	{
+		/// <summary>
+		/// Four per non-empty tile.
+		/// </summary>
+		std::vector<SDL_Vertex> vertices;
+		/// <summary>
+		/// Tiles changed since the last bake.
+		/// </summary>
+		bool dirty = true;
+	};
+
+	/// <summary>
+	/// Grid of tiles drawn from a tileset image, meant to replace one SpriteComponent entity per tile.
+	/// The entity's TransformComponent places the map's top-left corner and scales it.
+	///
+	/// The map is split in chunks of chunkSize x chunkSize tiles. TilemapRenderSystem bakes every chunk
+	/// once and draws each visible chunk with a single call; SetTile() only flags the chunk it touches.
+	/// </summary>
+	struct TilemapComponent {
+		static constexpr uint16_t EMPTY_TILE = 0xFFFF;
+
+		/// <summary>
+		/// Tileset texture. Tile n is the n-th tileSize square, left to right and then top to bottom.
+		/// </summary>
+		std::string assetId;
+		int tileSize;
+		int width;
+		int height;
+		int chunkSize;
+		/// <summary>
+		/// Tile ids by row, EMPTY_TILE where there's nothing to draw.
+		/// </summary>
+		std::vector<uint16_t> tiles;
+		/// <summary>
+		/// 1 where the tile blocks movement.
+		/// </summary>
+		std::vector<uint8_t> collision;
+		std::vector<TilemapChunk> chunks;
+		int chunkColumns;
+		int chunkRows;
+		/// <summary>
+		/// Tilemaps in lower layers are drawn first.
+		/// </summary>
+		int layer;
+
+		TilemapComponent(std::string assetId = "", int tileSize = 32, int chunkSize = 16, int layer = -1) {
+			this->assetId = assetId;
+			this->tileSize = tileSize;
+			this->chunkSize = chunkSize;
+			this->layer = layer;
+			this->width = 0;
+			this->height = 0;
+			this->chunkColumns = 0;
+			this->chunkRows = 0;
+		}
+
+		/// <summary>
+		/// Takes a whole new grid. Every chunk is rebuilt and the collision grid is cleared.
+		/// </summary>
+		void SetTiles(int newWidth, int newHeight, std::vector<uint16_t> newTiles)
+		{
+			width = newWidth;
+			height = newHeight;
+			tiles = std::move(newTiles);
+			tiles.resize(size_t(width) * height, EMPTY_TILE);
+			collision.assign(tiles.size(), 0);
+
+			chunkColumns = (width + chunkSize - 1) / chunkSize;
+			chunkRows = (height + chunkSize - 1) / chunkSize;
+			chunks.clear();
+			chunks.resize(size_t(chunkColumns) * chunkRows);
+		}
+
+		bool IsInside(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+
+		uint16_t GetTile(int x, int y) const { return IsInside(x, y) ? tiles[size_t(y) * width + x] : EMPTY_TILE; }
+
+		void SetTile(int x, int y, uint16_t tile)
+		{
+			if (!IsInside(x, y) || tiles[size_t(y) * width + x] == tile)
+			{
+				return;
+			}
+			tiles[size_t(y) * width + x] = tile;
+			chunks[size_t(y / chunkSize) * chunkColumns + x / chunkSize].dirty = true;
+		}
+
+		/// <summary>
+		/// Flags every cell holding one of these tiles as solid, and every other cell as free.
+		/// </summary>
+		void SetSolidTiles(const std::vector<uint16_t>& solidTiles)
+		{
+			std::vector<uint8_t> isSolid(size_t(EMPTY_TILE) + 1, 0);
+			for (uint16_t tile : solidTiles)
+			{
+				isSolid[tile] = 1;
+			}
+			for (size_t i = 0; i < tiles.size(); i++)
+			{
+				collision[i] = isSolid[tiles[i]];
+			}
+		}
+
+		void SetSolid(int x, int y, bool solid)
+		{
+			if (IsInside(x, y))
+			{
+				collision[size_t(y) * width + x] = solid ? 1 : 0;
+			}
+		}
+
+		/// <summary>
+		/// Outside the map counts as solid, so nothing walks off it.
+		/// </summary>
+		bool IsSolid(int x, int y) const { return !IsInside(x, y) || collision[size_t(y) * width + x] != 0; }
+	};
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <cstddef>
+#include <cstdint>
+
+namespace engine
+{
+	/// <summary>
+	/// 64-bit FNV-1a hash, fed piece by piece. Fast and stable across runs, not meant to resist collisions on purpose.
+	/// </summary>
+	class Fnv1aHash
+	{
+	private:
+		uint64_t hash = 14695981039346656037ull;
+
+	public:
+		void Add(const void* data, size_t size)
+		{
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for (size_t i = 0; i < size; i++)
+			{
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+		}
+
+		template <typename T>
+		void Add(const T& value)
+		{
+			Add(&value, sizeof(T));
+		}
+
+		uint64_t Get() const { return hash; }
+	};
+}
@@ -25,6 +25,10 @@ namespace engine
 				{
 					registry->AddSystem<EntityStartup3DSystem>();
 				}
+				if (std::string(childNode->value()) == "PointLight3DSystem")
+				{
+					registry->AddSystem<PointLight3DSystem>();
+				}
 				childNode = childNode->next_sibling();
 			}
 			registryNode = registryNode->next_sibling("registry");
@@ -69,7 +73,7 @@ namespace engine
 						{
 							for (auto entity : registry->GetSystem<EntityStartup3DSystem>().GetSystemEntities())
 							{
-								if (entity.GetComponent<Node3DComponent>().modelId == std::string(parentNode->value()))
+								if (entity.HasComponent<Node3DComponent>() && entity.GetComponent<Node3DComponent>().modelId == std::string(parentNode->value()))
 								{
 									entity.AddComponent<TransformComponent>(glm::vec3(xPos, yPos, zPos), glm::vec3(xRot, yRot, zRot), glm::vec3(xSca, ySca, zSca), &entity);
 								}
@@ -105,10 +109,28 @@ namespace engine
 						rapidxml::xml_node<>* nameNode = componentNode->first_node("name");
 						std::string name = nameNode->value();
 
-						std::shared_ptr< glt::Model  > clone(new glt::Model);
-						clone->add(std::shared_ptr<glt::Drawable>(new glt::Cube), glt::Material::default_material());
+						rapidxml::xml_node<>* occluderNode = componentNode->first_node("occluder");
+						bool occluder = occluderNode && std::string(occluderNode->value()) == "true";
+
+						rapidxml::xml_node<>* staticNode = componentNode->first_node("static");
+						bool isStatic = staticNode && std::string(staticNode->value()) == "true";
+
+						//Every node gets its own transform, but they all share the cube's buffers.
+						entity.AddComponent<Node3DComponent>(name, renderResources->CreateCubeModel(), glm::vec4(1, 1, 1, 1), occluder, isStatic);
+					}
+
+					if (std::string(componentNode->name()) == "PointLightComponent")
+					{
+						rapidxml::xml_node<>* colorNode = componentNode->first_node("color");
+
+						float r = std::stof(std::string(colorNode->first_node("x")->value()));
+						float g = std::stof(std::string(colorNode->first_node("y")->value()));
+						float b = std::stof(std::string(colorNode->first_node("z")->value()));
+
+						float intensity = std::stof(std::string(componentNode->first_node("intensity")->value()));
+						float radius = std::stof(std::string(componentNode->first_node("radius")->value()));
 
-						entity.AddComponent<Node3DComponent>(name, clone);
+						entity.AddComponent<PointLightComponent>(glm::vec3(r, g, b), intensity, radius);
 					}
 
 					componentNode = componentNode->next_sibling();
@@ -8,11 +8,15 @@
 #include <Systems/EntityStartup3DSystem.h>
 #include <Systems/ModelRender3DSystem.h>
 #include <Systems/Movement3DSystem.h>
+#include <Systems/PointLight3DSystem.h>
 
 #include <Components/Node3DComponent.h>
+#include <Components/PointLightComponent.h>
 #include <Components/RigidbodyComponent.h>
 #include <Components/TransformComponent.h>
 
+#include <Render/RenderResourceRegistry.h>
+
 namespace engine
 {
 	class Scene3DDeserializer : public Task
@@ -21,10 +25,12 @@ namespace engine
 		Registry* registry;
 		Window* window;
 		const char* path;
+		RenderResourceRegistry* renderResources;
 
 	public:
 
-		Scene3DDeserializer(const char* path, Registry* registry, Window* window) : path(path), registry(registry), window(window) {}
+		Scene3DDeserializer(const char* path, Registry* registry, Window* window, RenderResourceRegistry* renderResources)
+			: path(path), registry(registry), window(window), renderResources(renderResources) {}
 
 		bool Initialize();
 		void Run(float deltaTime);
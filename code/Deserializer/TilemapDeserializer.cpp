@@ -0,0 +1,121 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Deserializer/TilemapDeserializer.h>
+#include <spdlog/spdlog.h>
+#include <sdl2/SDL.h>
+
+namespace engine
+{
+	bool TilemapDeserializer::Parse(const char* text, size_t length, TilemapComponent& tilemap)
+	{
+		const char* it = text;
+		const char* end = text + length;
+
+		std::vector<uint16_t> tiles;
+		//Big maps are mostly made of two-digit ids and a comma: a fair guess that avoids most reallocations.
+		tiles.reserve(length / 3);
+		int width = 0;
+		int height = 0;
+		int column = 0;
+
+		auto EndRow = [&]()
+		{
+			if (height == 0)
+			{
+				width = column;
+			}
+			else if (column != width)
+			{
+				spdlog::error("Tilemap row " + std::to_string(height + 1) + " has " + std::to_string(column) + " tiles, expected " + std::to_string(width));
+				return false;
+			}
+			height++;
+			column = 0;
+			return true;
+		};
+
+		//Hand-written instead of streams, it's called on every map load and .map files can get big.
+		while (it != end)
+		{
+			const char c = *it;
+			if (c == ' ' || c == '\t' || c == '\r')
+			{
+				it++;
+				continue;
+			}
+			if (c == '\n' || c == ',')
+			{
+				it++;
+				if (c == '\n' && column > 0 && !EndRow())
+				{
+					return false;
+				}
+				continue;
+			}
+
+			bool negative = false;
+			if (c == '-')
+			{
+				negative = true;
+				it++;
+			}
+			if (it == end || *it < '0' || *it > '9')
+			{
+				spdlog::error("Unexpected character in tilemap at offset " + std::to_string(it - text));
+				return false;
+			}
+
+			unsigned value = 0;
+			while (it != end && *it >= '0' && *it <= '9')
+			{
+				value = value * 10 + unsigned(*it - '0');
+				if (value >= TilemapComponent::EMPTY_TILE)
+				{
+					spdlog::error("Tile id out of range in tilemap at offset " + std::to_string(it - text));
+					return false;
+				}
+				it++;
+			}
+
+			tiles.push_back(negative ? TilemapComponent::EMPTY_TILE : uint16_t(value));
+			column++;
+		}
+
+		//Last row without a line break.
+		if (column > 0 && !EndRow())
+		{
+			return false;
+		}
+
+		if (width == 0 || height == 0)
+		{
+			spdlog::error("Tilemap is empty");
+			return false;
+		}
+
+		tilemap.SetTiles(width, height, std::move(tiles));
+		return true;
+	}
+
+	bool TilemapDeserializer::Load(const std::string& filePath, TilemapComponent& tilemap)
+	{
+		size_t length = 0;
+		char* text = static_cast<char*>(SDL_LoadFile(filePath.c_str(), &length));
+		if (!text)
+		{
+			spdlog::error("Could not read tilemap " + filePath + ": " + SDL_GetError());
+			return false;
+		}
+
+		const bool loaded = Parse(text, length, tilemap);
+		SDL_free(text);
+
+		if (loaded)
+		{
+			spdlog::info("Tilemap " + filePath + " loaded: " + std::to_string(tilemap.width) + "x" + std::to_string(tilemap.height) + " tiles");
+		}
+		return loaded;
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <string>
+#include <Components/TilemapComponent.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Reads .map files: one row of tiles per line, tile ids separated by commas. Leading zeros are
+	/// allowed ("08") and negative ids (-1) are empty cells. Every row must have the same length.
+	/// </summary>
+	class TilemapDeserializer
+	{
+	public:
+		/// <summary>
+		/// Parses text that's already in memory into the tilemap's grid.
+		/// </summary>
+		/// <returns>false, leaving the tilemap untouched, if the text isn't a valid map</returns>
+		static bool Parse(const char* text, size_t length, TilemapComponent& tilemap);
+
+		/// <returns>false, leaving the tilemap untouched, if the file can't be read or isn't a valid map</returns>
+		static bool Load(const std::string& filePath, TilemapComponent& tilemap);
+	};
+}
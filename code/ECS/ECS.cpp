@@ -12,6 +12,7 @@ namespace engine
 
 	void System::AddEntityToSystem(Entity entity) {
 		entities.push_back(entity);
+		OnEntityAdded(entity);
 	}
 
 	/// <summary>
@@ -50,6 +51,7 @@ namespace engine
 				[&entity](Entity other) {
 					return entity == other;
 				}), entities.end());
+		OnEntityRemoved(entity);
 	}
 
 	const Signature& System::GetComponentSignature() const {
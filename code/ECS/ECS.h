@@ -145,7 +145,15 @@ namespace engine
 
 		void AddEntityToSystem(Entity entity);
 		void RemoveEntityFromSystem(Entity entity);
-		std::vector<Entity> GetSystemEntities() const { return entities; };
+
+		/// <summary>
+		/// Called right after an entity starts or stops being processed by the system, for systems that
+		/// keep their own structures over their entities (ex: spatial partitions).
+		/// </summary>
+		virtual void OnEntityAdded(Entity) {}
+		virtual void OnEntityRemoved(Entity) {}
+
+		const std::vector<Entity>& GetSystemEntities() const { return entities; };
 		const Signature& GetComponentSignature() const;
 
 		/// <summary>
@@ -24,7 +24,9 @@ namespace engine
 			UPWARD_ROTATION,
 			DOWNWARD_ROTATION,
 			FIRE1,
-			FIRE2
+			FIRE2,
+			/// Not an action: number of actions above, used to size per-action tables.
+			ACTION_COUNT
 		};
 
 		enum Action action;
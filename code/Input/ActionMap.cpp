@@ -0,0 +1,313 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Input/ActionMap.h>
+#include <Input/InputState.h>
+#include <rapidxml/rapidxml.hpp>
+#include <rapidxml/rapidxml_utils.hpp>
+#include <spdlog/spdlog.h>
+#include <fstream>
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+
+namespace engine
+{
+	namespace
+	{
+		//Same order as InputEvent::Action.
+		const char* actionNames[INPUT_ACTION_COUNT] =
+		{
+			"QUIT",
+			"MINIMIZE",
+			"FORWARD",
+			"BACKWARDS",
+			"LEFT",
+			"RIGHT",
+			"JUMP",
+			"LEFT_ROTATION",
+			"RIGHT_ROTATION",
+			"UPWARD_ROTATION",
+			"DOWNWARD_ROTATION",
+			"FIRE1",
+			"FIRE2"
+		};
+
+		const char* mouseButtonNames[ActionMap::MOUSE_BUTTON_COUNT] = { "left", "middle", "right", "x1", "x2" };
+
+		std::string ChildValue(rapidxml::xml_node<>* node, const char* name, const char* fallback = "")
+		{
+			rapidxml::xml_node<>* child = node->first_node(name);
+			return child ? std::string(child->value()) : std::string(fallback);
+		}
+
+		/// <summary>
+		/// Reads a number child, fallback if there's none.
+		/// </summary>
+		/// <returns>false if the child isn't a number</returns>
+		bool ChildFloat(rapidxml::xml_node<>* node, const char* name, float fallback, float& value)
+		{
+			value = fallback;
+			rapidxml::xml_node<>* child = node->first_node(name);
+			if (!child)
+			{
+				return true;
+			}
+			const char* text = child->value();
+			char* end = nullptr;
+			value = std::strtof(text, &end);
+			while (end != text && std::isspace((unsigned char)*end))
+			{
+				end++;
+			}
+			return end != text && *end == '\0';
+		}
+	}
+
+	ActionMap::ActionMap()
+	{
+		table.resize(SOURCE_COUNT);
+		LoadDefaults();
+	}
+
+	void ActionMap::Clear()
+	{
+		for (auto& slot : table)
+		{
+			slot.fill(ActionBinding());
+		}
+		version++;
+	}
+
+	void ActionMap::LoadDefaults()
+	{
+		Clear();
+		Bind(KeySource(SDL_SCANCODE_ESCAPE), { InputEvent::Action::QUIT });
+		Bind(KeySource(SDL_SCANCODE_W), { InputEvent::Action::FORWARD });
+		Bind(KeySource(SDL_SCANCODE_A), { InputEvent::Action::LEFT });
+		Bind(KeySource(SDL_SCANCODE_S), { InputEvent::Action::BACKWARDS });
+		Bind(KeySource(SDL_SCANCODE_D), { InputEvent::Action::RIGHT });
+		Bind(KeySource(SDL_SCANCODE_LEFT), { InputEvent::Action::LEFT_ROTATION });
+		Bind(KeySource(SDL_SCANCODE_RIGHT), { InputEvent::Action::RIGHT_ROTATION });
+	}
+
+	bool ActionMap::Bind(unsigned source, const ActionBinding& binding)
+	{
+		if (source >= SOURCE_COUNT || !binding.IsBound())
+		{
+			return false;
+		}
+
+		for (auto& slot : table[source])
+		{
+			if (!slot.IsBound())
+			{
+				slot = binding;
+				version++;
+				return true;
+			}
+		}
+
+		spdlog::warn("Input source \"" + GetSourceName(source) + "\" can't hold more bindings");
+		return false;
+	}
+
+	void ActionMap::Rebind(unsigned source, const ActionBinding& binding)
+	{
+		Unbind(source);
+		Bind(source, binding);
+	}
+
+	void ActionMap::Unbind(unsigned source)
+	{
+		if (source < SOURCE_COUNT)
+		{
+			table[source].fill(ActionBinding());
+			version++;
+		}
+	}
+
+	float ActionMap::ApplyAxis(const ActionBinding& binding, float rawValue)
+	{
+		float magnitude = std::fabs(rawValue);
+		if (magnitude <= binding.deadzone)
+		{
+			return 0.f;
+		}
+
+		//Stretch what's left out of the deadzone so the action still goes all the way from 0 to 1.
+		magnitude = std::fmin((magnitude - binding.deadzone) / (1.f - binding.deadzone), 1.f);
+		float value = std::copysign(magnitude, rawValue) * binding.scale;
+
+		if (binding.halfAxis && value < 0.f)
+		{
+			return 0.f;
+		}
+		return value;
+	}
+
+	const char* ActionMap::GetActionName(InputEvent::Action action)
+	{
+		return action < INPUT_ACTION_COUNT ? actionNames[action] : "NONE";
+	}
+
+	bool ActionMap::ParseAction(const std::string& name, InputEvent::Action& action)
+	{
+		for (unsigned i = 0; i < INPUT_ACTION_COUNT; i++)
+		{
+			if (name == actionNames[i])
+			{
+				action = InputEvent::Action(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::string ActionMap::GetSourceName(unsigned source)
+	{
+		if (source < BUTTON_SOURCES_BEGIN)
+		{
+			return std::string("key ") + SDL_GetScancodeName(SDL_Scancode(source - KEY_SOURCES_BEGIN));
+		}
+		if (source < AXIS_SOURCES_BEGIN)
+		{
+			return std::string("button ") + SDL_GameControllerGetStringForButton(SDL_GameControllerButton(source - BUTTON_SOURCES_BEGIN));
+		}
+		if (source < MOUSE_SOURCES_BEGIN)
+		{
+			return std::string("axis ") + SDL_GameControllerGetStringForAxis(SDL_GameControllerAxis(source - AXIS_SOURCES_BEGIN));
+		}
+		if (source < SOURCE_COUNT)
+		{
+			return std::string("mouse ") + mouseButtonNames[source - MOUSE_SOURCES_BEGIN];
+		}
+		return "unknown";
+	}
+
+	bool ActionMap::ParseSource(const std::string& type, const std::string& name, unsigned& source)
+	{
+		if (type == "key")
+		{
+			SDL_Scancode scancode = SDL_GetScancodeFromName(name.c_str());
+			source = KeySource(scancode);
+			return scancode != SDL_SCANCODE_UNKNOWN;
+		}
+		if (type == "button")
+		{
+			SDL_GameControllerButton button = SDL_GameControllerGetButtonFromString(name.c_str());
+			source = ButtonSource(button);
+			return button != SDL_CONTROLLER_BUTTON_INVALID;
+		}
+		if (type == "axis")
+		{
+			SDL_GameControllerAxis axis = SDL_GameControllerGetAxisFromString(name.c_str());
+			source = AxisSource(axis);
+			return axis != SDL_CONTROLLER_AXIS_INVALID;
+		}
+		if (type == "mouse")
+		{
+			for (unsigned i = 0; i < MOUSE_BUTTON_COUNT; i++)
+			{
+				if (name == mouseButtonNames[i])
+				{
+					source = MOUSE_SOURCES_BEGIN + i;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool ActionMap::Load(const std::string& filePath)
+	{
+		std::ifstream stream(filePath);
+		if (!stream)
+		{
+			spdlog::error("Couldn't open input bindings file " + filePath);
+			return false;
+		}
+
+		rapidxml::file<> xmlFile(stream);
+		rapidxml::xml_document<> doc;
+		try
+		{
+			doc.parse<0>(xmlFile.data());
+		}
+		catch (const rapidxml::parse_error& error)
+		{
+			//Nothing was cleared yet: the game keeps the bindings it had, the defaults at startup.
+			spdlog::error("Input bindings file " + filePath + " is not valid XML: " + error.what());
+			return false;
+		}
+
+		rapidxml::xml_node<>* bindingsNode = doc.first_node("bindings");
+		if (!bindingsNode)
+		{
+			spdlog::error("Input bindings file " + filePath + " has no <bindings> node");
+			return false;
+		}
+
+		Clear();
+		for (rapidxml::xml_node<>* node = bindingsNode->first_node("binding"); node != 0; node = node->next_sibling("binding"))
+		{
+			unsigned source;
+			ActionBinding binding;
+			std::string type = ChildValue(node, "source");
+			std::string name = ChildValue(node, "name");
+			std::string action = ChildValue(node, "action");
+
+			if (!ParseSource(type, name, source) || !ParseAction(action, binding.action))
+			{
+				spdlog::warn("Skipping input binding \"" + type + " " + name + "\" -> \"" + action + "\"");
+				continue;
+			}
+
+			if (!ChildFloat(node, "scale", 1.f, binding.scale) || !ChildFloat(node, "deadzone", 0.f, binding.deadzone))
+			{
+				spdlog::warn("Skipping input binding \"" + type + " " + name + "\" -> \"" + action + "\", its scale or deadzone isn't a number");
+				continue;
+			}
+			binding.halfAxis = ChildValue(node, "half", "false") == "true";
+			Bind(source, binding);
+		}
+
+		spdlog::info("Loaded input bindings from " + filePath);
+		return true;
+	}
+
+	bool ActionMap::Save(const std::string& filePath) const
+	{
+		std::ofstream stream(filePath);
+		if (!stream)
+		{
+			spdlog::error("Couldn't write input bindings file " + filePath);
+			return false;
+		}
+
+		stream << "<bindings>\n";
+		for (unsigned source = 0; source < SOURCE_COUNT; source++)
+		{
+			for (const auto& binding : table[source])
+			{
+				if (!binding.IsBound()) continue;
+
+				//GetSourceName() returns "<type> <name>".
+				std::string sourceName = GetSourceName(source);
+				size_t separator = sourceName.find(' ');
+
+				stream << "\t<binding>\n";
+				stream << "\t\t<source>" << sourceName.substr(0, separator) << "</source>\n";
+				stream << "\t\t<name>" << sourceName.substr(separator + 1) << "</name>\n";
+				stream << "\t\t<action>" << GetActionName(binding.action) << "</action>\n";
+				if (binding.scale != 1.f) stream << "\t\t<scale>" << binding.scale << "</scale>\n";
+				if (binding.deadzone != 0.f) stream << "\t\t<deadzone>" << binding.deadzone << "</deadzone>\n";
+				if (binding.halfAxis) stream << "\t\t<half>true</half>\n";
+				stream << "\t</binding>\n";
+			}
+		}
+		stream << "</bindings>\n";
+		return true;
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <array>
+#include <string>
+#include <vector>
+#include <sdl2/SDL.h>
+#include <Events/InputEvent.h>
+
+namespace engine
+{
+	/// <summary>
+	/// What a single input source (key, gamepad button or axis, mouse button) does when it changes.
+	/// </summary>
+	struct ActionBinding
+	{
+		/// <summary>
+		/// ACTION_COUNT means the binding is empty.
+		/// </summary>
+		InputEvent::Action action = InputEvent::Action::ACTION_COUNT;
+		/// <summary>
+		/// Multiplies the source value. A negative scale inverts an axis.
+		/// </summary>
+		float scale = 1.f;
+		/// <summary>
+		/// Axis values under this magnitude are read as 0. The rest of the range is stretched back to 0..1.
+		/// </summary>
+		float deadzone = 0.f;
+		/// <summary>
+		/// Only the half of the axis that ends up positive after scaling drives the action.
+		/// Useful to split one stick axis into two actions, like FORWARD and BACKWARDS.
+		/// </summary>
+		bool halfAxis = false;
+
+		bool IsBound() const { return action != InputEvent::Action::ACTION_COUNT; }
+	};
+
+	/// <summary>
+	/// Data-driven table relating input sources to actions, loaded from a bindings file.
+	///
+	/// Every source has a fixed index inside a single flat array (keys first, then gamepad buttons,
+	/// gamepad axes and mouse buttons), so resolving an SDL event to its actions is one array access.
+	/// Bindings can be changed at any time; GetVersion() lets the input task notice it.
+	/// </summary>
+	class ActionMap
+	{
+	public:
+		/// <summary>
+		/// A source can drive more than one action, ex: both halves of a stick axis.
+		/// </summary>
+		static const unsigned MAX_BINDINGS_PER_SOURCE = 2;
+		typedef std::array<ActionBinding, MAX_BINDINGS_PER_SOURCE> BindingSlot;
+
+		static const unsigned MOUSE_BUTTON_COUNT = 5;
+
+		static const unsigned KEY_SOURCES_BEGIN = 0;
+		static const unsigned BUTTON_SOURCES_BEGIN = KEY_SOURCES_BEGIN + SDL_NUM_SCANCODES;
+		static const unsigned AXIS_SOURCES_BEGIN = BUTTON_SOURCES_BEGIN + SDL_CONTROLLER_BUTTON_MAX;
+		static const unsigned MOUSE_SOURCES_BEGIN = AXIS_SOURCES_BEGIN + SDL_CONTROLLER_AXIS_MAX;
+		static const unsigned SOURCE_COUNT = MOUSE_SOURCES_BEGIN + MOUSE_BUTTON_COUNT;
+
+		static unsigned KeySource(SDL_Scancode scancode) { return KEY_SOURCES_BEGIN + unsigned(scancode); }
+		static unsigned ButtonSource(SDL_GameControllerButton button) { return BUTTON_SOURCES_BEGIN + unsigned(button); }
+		static unsigned AxisSource(SDL_GameControllerAxis axis) { return AXIS_SOURCES_BEGIN + unsigned(axis); }
+		/// <summary>
+		/// SDL numbers mouse buttons from 1 (SDL_BUTTON_LEFT).
+		/// </summary>
+		static unsigned MouseButtonSource(Uint8 button) { return MOUSE_SOURCES_BEGIN + unsigned(button - 1); }
+
+		static bool IsAxisSource(unsigned source) { return source >= AXIS_SOURCES_BEGIN && source < MOUSE_SOURCES_BEGIN; }
+
+	private:
+		std::vector<BindingSlot> table;
+		unsigned version = 0;
+
+	public:
+		/// <summary>
+		/// Starts with the default keyboard layout.
+		/// </summary>
+		ActionMap();
+
+		/// <summary>
+		/// Replaces every binding with the ones in the file. Keeps the current ones if the file can't be read.
+		/// </summary>
+		bool Load(const std::string& filePath);
+		bool Save(const std::string& filePath) const;
+
+		/// <summary>
+		/// WASD to move, arrows to rotate and escape to quit.
+		/// </summary>
+		void LoadDefaults();
+		void Clear();
+
+		/// <summary>
+		/// Adds a binding to the source. Fails if the source already holds MAX_BINDINGS_PER_SOURCE bindings.
+		/// </summary>
+		bool Bind(unsigned source, const ActionBinding& binding);
+		/// <summary>
+		/// Replaces whatever the source was bound to. A source held meanwhile is released through its old
+		/// bindings by the input task, and its new ones wait for the next press.
+		/// </summary>
+		void Rebind(unsigned source, const ActionBinding& binding);
+		void Unbind(unsigned source);
+
+		const BindingSlot& Lookup(unsigned source) const { return table[source]; }
+
+		/// <summary>
+		/// Increased every time a binding changes.
+		/// </summary>
+		unsigned GetVersion() const { return version; }
+
+		/// <summary>
+		/// Turns a normalized (-1..1) axis reading into the value of the bound action.
+		/// </summary>
+		static float ApplyAxis(const ActionBinding& binding, float rawValue);
+
+		static const char* GetActionName(InputEvent::Action action);
+		static bool ParseAction(const std::string& name, InputEvent::Action& action);
+		static std::string GetSourceName(unsigned source);
+		static bool ParseSource(const std::string& type, const std::string& name, unsigned& source);
+	};
+}
@@ -3,7 +3,11 @@
 #include <sdl2/SDL.h>
 #include <EventBus/EventBus.h>
 #include <Events/InputEvent.h>
+#include <Input/InputState.h>
+#include <Input/ActionMap.h>
+#include <Input/InputRecording.h>
 #include <spdlog/spdlog.h>
+#include <vector>
 
 namespace engine
 {
@@ -11,82 +15,271 @@ namespace engine
     {
     private:
         std::shared_ptr<EventBus> eventBus;
+        std::shared_ptr<InputState> inputState;
+
+        std::shared_ptr<ActionMap> actionMap;
+        unsigned actionMapVersion;
+        std::vector<SDL_GameController*> controllers;
+
+        InputRecorder* recorder = nullptr;
+        InputPlayer* player = nullptr;
+
+        /// <summary>
+        /// Bindings every held key or button was pressed with, empty while it's up. A release without
+        /// a press (a key held since before launch or since ReleaseAll()) is ignored, so no action goes
+        /// below 0. Axes keep the bindings they last moved.
+        /// </summary>
+        std::vector<ActionMap::BindingSlot> heldSources = std::vector<ActionMap::BindingSlot>(ActionMap::SOURCE_COUNT);
+
+        static bool IsHeld(const ActionMap::BindingSlot& slot)
+        {
+            return slot[0].IsBound() || slot[1].IsBound();
+        }
+
+        /// <summary>
+        /// A key or button changed state. Sends it to every action bound to it.
+        /// </summary>
+        void ApplyDigital(unsigned source, bool down)
+        {
+            ActionMap::BindingSlot& held = heldSources[source];
+            if (down == IsHeld(held))
+            {
+                return;
+            }
+            if (down)
+            {
+                held = actionMap->Lookup(source);
+            }
+            for (const auto& binding : held)
+            {
+                if (binding.IsBound())
+                {
+                    inputState->SetButton(binding.action, down, binding.scale);
+                }
+            }
+            if (!down)
+            {
+                held.fill(ActionBinding());
+            }
+        }
+
+        /// <summary>
+        /// Releases every held source through the bindings it was pressed with, so none of their actions
+        /// stays on when the bindings change. Their releases are ignored afterwards.
+        /// </summary>
+        void ReleaseHeldSources()
+        {
+            for (unsigned source = 0; source < ActionMap::SOURCE_COUNT; source++)
+            {
+                for (const auto& binding : heldSources[source])
+                {
+                    if (!binding.IsBound())
+                    {
+                        continue;
+                    }
+                    if (ActionMap::IsAxisSource(source))
+                    {
+                        inputState->SetAxis(binding.action, 0.f);
+                    }
+                    else
+                    {
+                        inputState->SetButton(binding.action, false, binding.scale);
+                    }
+                }
+                heldSources[source].fill(ActionBinding());
+            }
+        }
+
+        /// <summary>
+        /// Forgets every held source, see InputState::ReleaseAll().
+        /// </summary>
+        void ReleaseAll()
+        {
+            inputState->ReleaseAll();
+            for (auto& held : heldSources)
+            {
+                held.fill(ActionBinding());
+            }
+        }
+
+        /// <summary>
+        /// An axis moved. rawValue is normalized to -1..1.
+        /// </summary>
+        void ApplyAxis(unsigned source, float rawValue)
+        {
+            heldSources[source] = actionMap->Lookup(source);
+            for (const auto& binding : heldSources[source])
+            {
+                if (binding.IsBound())
+                {
+                    inputState->SetAxis(binding.action, ActionMap::ApplyAxis(binding, rawValue));
+                }
+            }
+        }
+
     public:
 
-        InputPollingTask(std::shared_ptr<EventBus> eventBus)
+        InputPollingTask(std::shared_ptr<EventBus> eventBus, std::shared_ptr<InputState> inputState, std::shared_ptr<ActionMap> actionMap)
         {
             this->eventBus = eventBus;
+            this->inputState = inputState;
+            this->actionMap = actionMap;
+            this->actionMapVersion = actionMap->GetVersion();
+        }
+
+        ~InputPollingTask()
+        {
+            for (auto controller : controllers)
+            {
+                SDL_GameControllerClose(controller);
+            }
+        }
+
+        /// <summary>
+        /// Every published snapshot will also be written to the recorder.
+        /// </summary>
+        void SetRecorder(InputRecorder* inputRecorder)
+        {
+            recorder = inputRecorder;
+        }
+
+        /// <summary>
+        /// Snapshots will come from the recording instead of the live input.
+        /// </summary>
+        void SetPlayer(InputPlayer* inputPlayer)
+        {
+            player = inputPlayer;
+        }
+
+        /// <summary>
+        /// Reads the input received since the last poll without publishing a new snapshot, so what the
+        /// renderer is about to show can be corrected with it (see InputState::PeekValue()). It will
+        /// still reach the game through the next frame's snapshot, edges included.
+        /// Does nothing while replaying: the recording is the only input then.
+        /// </summary>
+        void Sample()
+        {
+            if (!player)
+            {
+                PumpEvents();
+            }
         }
 
         void Run(float deltaTime)
+        {
+            //Sources held under the old bindings are released before the new ones get any input.
+            if (actionMap->GetVersion() != actionMapVersion)
+            {
+                ReleaseHeldSources();
+                actionMapVersion = actionMap->GetVersion();
+            }
+
+            if (player)
+            {
+                //The OS queue still has to be drained, but only the recorded input reaches the game.
+                SDL_Event sdlEvent;
+                while (SDL_PollEvent(&sdlEvent)) {}
+                player->VerifyFrame();
+                inputState->Publish(player->GetSnapshot());
+                FireInputEvents();
+                return;
+            }
+
+            PumpEvents();
+            inputState->Publish();
+            if (recorder)
+            {
+                recorder->WriteFrame(deltaTime, inputState->Read());
+            }
+            FireInputEvents();
+        }
+
+    private:
+        void PumpEvents()
         {
             SDL_Event sdlEvent;
             while (SDL_PollEvent(&sdlEvent))
             {
-                if (sdlEvent.type == SDL_KEYDOWN)
+                switch (sdlEvent.type)
                 {
-                    switch (sdlEvent.key.keysym.sym)
+                case SDL_KEYDOWN:
+                case SDL_KEYUP:
+                    //If != 0, the key is repeated. The snapshot already knows the key is being held.
+                    if (sdlEvent.key.repeat == 0)
                     {
-                    case SDLK_ESCAPE:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::QUIT, 1);
-                        break;
-                    case SDLK_w:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::FORWARD, 1);
-                        break;
-                    case SDLK_a:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::LEFT, 1);
-                        break;
-                    case SDLK_s:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::BACKWARDS, 1);
-                        break;
-                    case SDLK_d:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::RIGHT, 1);
-                        break;
-                    case SDLK_LEFT:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::LEFT_ROTATION, 1);
-                        break;
-                    case SDLK_RIGHT:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::RIGHT_ROTATION, 1);
-                        break;
+                        ApplyDigital(ActionMap::KeySource(sdlEvent.key.keysym.scancode), sdlEvent.type == SDL_KEYDOWN);
                     }
-                }
-                //If != 0, the key is repeated
-                else if (sdlEvent.type == SDL_KEYUP && sdlEvent.key.repeat == 0)
-                {
-                    switch (sdlEvent.key.keysym.sym)
+                    break;
+                case SDL_CONTROLLERBUTTONDOWN:
+                case SDL_CONTROLLERBUTTONUP:
+                    ApplyDigital(ActionMap::ButtonSource(SDL_GameControllerButton(sdlEvent.cbutton.button)), sdlEvent.type == SDL_CONTROLLERBUTTONDOWN);
+                    break;
+                case SDL_CONTROLLERAXISMOTION:
+                    ApplyAxis(ActionMap::AxisSource(SDL_GameControllerAxis(sdlEvent.caxis.axis)), sdlEvent.caxis.value / 32767.f);
+                    break;
+                case SDL_MOUSEBUTTONDOWN:
+                case SDL_MOUSEBUTTONUP:
+                    if (sdlEvent.button.button >= 1 && sdlEvent.button.button <= ActionMap::MOUSE_BUTTON_COUNT)
                     {
-                    case SDLK_ESCAPE:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::QUIT, 0);
-                        break;
-                    case SDLK_w:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::FORWARD, 0);
-                        break;
-                    case SDLK_a:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::LEFT, 0);
-                        break;
-                    case SDLK_s:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::BACKWARDS, 0);
-                        break;
-                    case SDLK_d:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::RIGHT, 0);
-                        break;
-                    case SDLK_LEFT:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::LEFT_ROTATION, 0);
-                        break;
-                    case SDLK_RIGHT:
-                        eventBus->FireEvent<InputEvent>(InputEvent::Action::RIGHT_ROTATION, 0);
-                        break;
+                        ApplyDigital(ActionMap::MouseButtonSource(sdlEvent.button.button), sdlEvent.type == SDL_MOUSEBUTTONDOWN);
                     }
-                }
-
-                switch (sdlEvent.type)
-                {
+                    break;
+                case SDL_CONTROLLERDEVICEADDED:
+                    if (SDL_GameController* controller = SDL_GameControllerOpen(sdlEvent.cdevice.which))
+                    {
+                        controllers.push_back(controller);
+                        const char* name = SDL_GameControllerName(controller);
+                        spdlog::info(std::string("Gamepad connected: ") + (name ? name : "unknown"));
+                    }
+                    break;
+                case SDL_CONTROLLERDEVICEREMOVED:
+                    for (auto it = controllers.begin(); it != controllers.end(); it++)
+                    {
+                        if (SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(*it)) == sdlEvent.cdevice.which)
+                        {
+                            SDL_GameControllerClose(*it);
+                            controllers.erase(it);
+                            break;
+                        }
+                    }
+                    ReleaseAll();
+                    break;
+                case SDL_MOUSEMOTION:
+                    inputState->AddMouseMotion(
+                        float(sdlEvent.motion.xrel), float(sdlEvent.motion.yrel),
+                        float(sdlEvent.motion.x), float(sdlEvent.motion.y));
+                    break;
+                case SDL_WINDOWEVENT:
+                    //Key-up events are not delivered to an unfocused window, so nothing can stay held.
+                    if (sdlEvent.window.event == SDL_WINDOWEVENT_FOCUS_LOST)
+                    {
+                        ReleaseAll();
+                    }
+                    break;
                     //Event that the system triggers when the user closes the window
                 case SDL_QUIT:
-                    eventBus->FireEvent<InputEvent>(InputEvent::Action::QUIT, 1);
+                    inputState->Pulse(InputEvent::Action::QUIT);
                     break;
                 }
             }
+            inputState->MarkSampled(SDL_GetPerformanceCounter());
+        }
+
+        void FireInputEvents()
+        {
+            //Listeners that still want events (UI) get one per state change instead of one per SDL event.
+            const InputSnapshot snapshot = inputState->Read();
+            for (unsigned i = 0; i < INPUT_ACTION_COUNT; i++)
+            {
+                if (snapshot.pressed[i])
+                {
+                    eventBus->FireEvent<InputEvent>(InputEvent::Action(i), snapshot.values[i] != 0.f ? snapshot.values[i] : 1.f);
+                }
+                if (snapshot.released[i])
+                {
+                    eventBus->FireEvent<InputEvent>(InputEvent::Action(i), 0.f);
+                }
+            }
         }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,288 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Input/InputRecording.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+
+namespace engine
+{
+	namespace
+	{
+		const char RECORDING_MAGIC[4] = { 'G', 'E', 'I', 'R' };
+		const uint32_t RECORDING_VERSION = 1;
+
+		enum FrameFlags : uint8_t
+		{
+			CHANGED_VALUES = 1 << 0,
+			EDGES = 1 << 1,
+			MOUSE = 1 << 2,
+			CHECKSUM = 1 << 3
+		};
+
+		static_assert(INPUT_ACTION_COUNT <= 32, "Action masks in input recordings are 32 bits wide");
+
+		template <typename T>
+		void Write(std::ofstream& stream, const T& value)
+		{
+			stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		/// <summary>
+		/// Reads sequentially from a recording loaded in memory.
+		/// </summary>
+		class Reader
+		{
+		private:
+			const std::vector<char>& data;
+			size_t offset = 0;
+		public:
+			Reader(const std::vector<char>& data) : data(data) {}
+
+			bool AtEnd() const { return offset >= data.size(); }
+
+			template <typename T>
+			bool Read(T& value)
+			{
+				if (offset + sizeof(T) > data.size()) return false;
+				std::memcpy(&value, data.data() + offset, sizeof(T));
+				offset += sizeof(T);
+				return true;
+			}
+		};
+	}
+
+	InputRecorder::InputRecorder(const std::string& filePath, StateChecksumFunction checksumFunction, unsigned checksumInterval)
+		: stream(filePath, std::ios::binary), checksumFunction(checksumFunction), checksumInterval(checksumFunction ? checksumInterval : 0)
+	{
+		if (!stream)
+		{
+			spdlog::error("Couldn't create input recording " + filePath);
+			return;
+		}
+
+		stream.write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+		Write(stream, RECORDING_VERSION);
+		Write(stream, uint32_t(INPUT_ACTION_COUNT));
+		Write(stream, uint32_t(this->checksumInterval));
+		spdlog::info("Recording input to " + filePath);
+	}
+
+	InputRecorder::~InputRecorder()
+	{
+		if (stream.is_open())
+		{
+			spdlog::info("Input recording closed after " + std::to_string(frameCount) + " frames");
+		}
+	}
+
+	void InputRecorder::WriteFrame(double deltaTime, const InputSnapshot& snapshot)
+	{
+		if (!stream) return;
+
+		uint32_t changedMask = 0, pressedMask = 0, releasedMask = 0;
+		for (unsigned i = 0; i < INPUT_ACTION_COUNT; i++)
+		{
+			if (snapshot.values[i] != previous.values[i]) changedMask |= 1u << i;
+			if (snapshot.pressed[i]) pressedMask |= 1u << i;
+			if (snapshot.released[i]) releasedMask |= 1u << i;
+		}
+
+		const bool hasMouse = snapshot.mouseDelta != glm::vec2(0, 0) || snapshot.mousePosition != previous.mousePosition;
+		const bool hasChecksum = checksumInterval != 0 && frameCount % checksumInterval == 0;
+
+		uint8_t flags = 0;
+		if (changedMask) flags |= CHANGED_VALUES;
+		if (pressedMask || releasedMask) flags |= EDGES;
+		if (hasMouse) flags |= MOUSE;
+		if (hasChecksum) flags |= CHECKSUM;
+
+		Write(stream, flags);
+		Write(stream, float(deltaTime));
+
+		if (flags & CHANGED_VALUES)
+		{
+			Write(stream, changedMask);
+			for (unsigned i = 0; i < INPUT_ACTION_COUNT; i++)
+			{
+				if (changedMask & (1u << i)) Write(stream, snapshot.values[i]);
+			}
+		}
+		if (flags & EDGES)
+		{
+			Write(stream, pressedMask);
+			Write(stream, releasedMask);
+		}
+		if (flags & MOUSE)
+		{
+			Write(stream, snapshot.mouseDelta);
+			Write(stream, snapshot.mousePosition);
+		}
+		if (flags & CHECKSUM)
+		{
+			Write(stream, uint64_t(checksumFunction()));
+		}
+
+		previous = snapshot;
+		frameCount++;
+	}
+
+	InputPlayer::InputPlayer(const std::string& filePath, StateChecksumFunction checksumFunction)
+		: checksumFunction(checksumFunction)
+	{
+		std::ifstream stream(filePath, std::ios::binary);
+		if (!stream)
+		{
+			spdlog::error("Couldn't open input recording " + filePath);
+			return;
+		}
+		std::vector<char> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+		Reader reader(data);
+
+		char magic[4];
+		uint32_t version = 0, actionCount = 0, checksumInterval = 0;
+		bool validHeader = reader.Read(magic) && reader.Read(version) && reader.Read(actionCount) && reader.Read(checksumInterval);
+		if (!validHeader || std::memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0 || version != RECORDING_VERSION)
+		{
+			spdlog::error(filePath + " is not a valid input recording");
+			return;
+		}
+		if (actionCount != INPUT_ACTION_COUNT)
+		{
+			spdlog::error(filePath + " was recorded with a different set of input actions");
+			return;
+		}
+
+		InputSnapshot current;
+		while (!reader.AtEnd())
+		{
+			Frame frame;
+			uint8_t flags;
+			if (!reader.Read(flags) || !reader.Read(frame.deltaTime))
+			{
+				spdlog::warn(filePath + " ends with a truncated frame");
+				break;
+			}
+
+			current.pressed.fill(false);
+			current.released.fill(false);
+			current.mouseDelta = glm::vec2(0, 0);
+
+			bool ok = true;
+			if (flags & CHANGED_VALUES)
+			{
+				uint32_t changedMask = 0;
+				ok = ok && reader.Read(changedMask);
+				for (unsigned i = 0; ok && i < INPUT_ACTION_COUNT; i++)
+				{
+					if (changedMask & (1u << i)) ok = reader.Read(current.values[i]);
+				}
+			}
+			if (flags & EDGES)
+			{
+				uint32_t pressedMask = 0, releasedMask = 0;
+				ok = ok && reader.Read(pressedMask) && reader.Read(releasedMask);
+				for (unsigned i = 0; i < INPUT_ACTION_COUNT; i++)
+				{
+					current.pressed[i] = (pressedMask & (1u << i)) != 0;
+					current.released[i] = (releasedMask & (1u << i)) != 0;
+				}
+			}
+			if (flags & MOUSE)
+			{
+				ok = ok && reader.Read(current.mouseDelta) && reader.Read(current.mousePosition);
+			}
+			frame.hasChecksum = (flags & CHECKSUM) != 0;
+			frame.checksum = 0;
+			if (frame.hasChecksum)
+			{
+				ok = ok && reader.Read(frame.checksum);
+			}
+
+			if (!ok)
+			{
+				spdlog::warn(filePath + " ends with a truncated frame");
+				break;
+			}
+
+			frame.snapshot = current;
+			frames.push_back(frame);
+		}
+
+		measuredFrameTimes.reserve(frames.size());
+		spdlog::info("Loaded input recording " + filePath + " (" + std::to_string(frames.size()) + " frames)");
+	}
+
+	bool InputPlayer::NextFrame(double measuredFrameTime, double& deltaTime)
+	{
+		if (started)
+		{
+			measuredFrameTimes.push_back(float(measuredFrameTime));
+			currentFrame++;
+		}
+		started = true;
+
+		if (currentFrame >= frames.size())
+		{
+			spdlog::info("Input replay finished: " + std::to_string(checksumsVerified) + " checksums verified, " +
+				std::to_string(checksumMismatches) + " mismatches");
+			return false;
+		}
+
+		deltaTime = frames[currentFrame].deltaTime;
+		return true;
+	}
+
+	void InputPlayer::VerifyFrame()
+	{
+		const Frame& frame = frames[currentFrame];
+		if (!frame.hasChecksum || !checksumFunction)
+		{
+			return;
+		}
+
+		checksumsVerified++;
+		uint64_t checksum = checksumFunction();
+		if (checksum != frame.checksum)
+		{
+			if (checksumMismatches == 0)
+			{
+				spdlog::error("Input replay diverged from the recording at frame " + std::to_string(currentFrame));
+			}
+			checksumMismatches++;
+		}
+	}
+
+	bool InputPlayer::WriteProfile(const std::string& filePath) const
+	{
+		if (measuredFrameTimes.empty())
+		{
+			return false;
+		}
+
+		std::ofstream stream(filePath);
+		if (!stream)
+		{
+			spdlog::error("Couldn't write frame-time profile " + filePath);
+			return false;
+		}
+
+		stream << "frame,recorded_delta_ms,measured_frame_ms\n";
+		double total = 0;
+		for (size_t i = 0; i < measuredFrameTimes.size(); i++)
+		{
+			stream << i << ',' << frames[i].deltaTime * 1000.0 << ',' << measuredFrameTimes[i] * 1000.0 << '\n';
+			total += measuredFrameTimes[i];
+		}
+
+		std::vector<float> sorted = measuredFrameTimes;
+		std::sort(sorted.begin(), sorted.end());
+		auto percentile = [&sorted](double p) { return sorted[size_t(p * (sorted.size() - 1))] * 1000.0; };
+
+		spdlog::info("Replay frame times (ms): avg {:.3f} | p50 {:.3f} | p95 {:.3f} | p99 {:.3f} | max {:.3f}",
+			total * 1000.0 / sorted.size(), percentile(0.5), percentile(0.95), percentile(0.99), sorted.back() * 1000.0);
+		return true;
+	}
+}
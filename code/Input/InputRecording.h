@@ -0,0 +1,118 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <functional>
+#include <Core/Hash.h>
+#include <Input/InputState.h>
+#include <Kernel/Kernel.h>
+
+namespace engine
+{
+	/*
+	*	Input recording file layout (little endian):
+	*
+	*	Header:		char[4] "GEIR" | uint32 version | uint32 action count | uint32 checksum interval
+	*	Frames:		uint8 flags | float deltaTime | [optional blocks, in flag order]
+	*
+	*	Optional blocks only appear when their flag is set, so an idle frame costs 5 bytes:
+	*		CHANGED_VALUES	uint32 mask of actions whose value changed | float per set bit
+	*		EDGES			uint32 pressed mask | uint32 released mask
+	*		MOUSE			float mouseDelta x, y | float mousePosition x, y
+	*		CHECKSUM		uint64 checksum of the game state at the start of the frame
+	*/
+
+	/// <summary>
+	/// Function returning a hash of the game state, used to detect replays diverging from the recording.
+	/// </summary>
+	typedef std::function<uint64_t()> StateChecksumFunction;
+
+	/// <summary>
+	/// Hash to build game state checksums with.
+	/// </summary>
+	typedef Fnv1aHash StateChecksum;
+
+	/// <summary>
+	/// Writes the input snapshot and delta time of every frame to a compact binary file.
+	/// </summary>
+	class InputRecorder
+	{
+	private:
+		std::ofstream stream;
+		InputSnapshot previous;
+		StateChecksumFunction checksumFunction;
+		unsigned checksumInterval;
+		unsigned long long frameCount = 0;
+
+	public:
+		/// <param name="checksumInterval">Frames between state checksums, 0 disables them</param>
+		InputRecorder(const std::string& filePath, StateChecksumFunction checksumFunction = nullptr, unsigned checksumInterval = 60);
+		~InputRecorder();
+
+		bool IsOpen() const { return stream.is_open(); }
+
+		/// <summary>
+		/// Appends a frame. Called by the input task right after it publishes the snapshot.
+		/// </summary>
+		void WriteFrame(double deltaTime, const InputSnapshot& snapshot);
+	};
+
+	/// <summary>
+	/// Plays an input recording back. As the kernel's frame clock it hands out the recorded delta times,
+	/// so the replay runs as fast as the machine allows while the simulation sees the same time steps.
+	/// It also keeps the measured duration of every frame to build a frame-time profile.
+	/// </summary>
+	class InputPlayer : public FrameClock
+	{
+	private:
+		struct Frame
+		{
+			float deltaTime;
+			InputSnapshot snapshot;
+			bool hasChecksum;
+			uint64_t checksum;
+		};
+
+		std::vector<Frame> frames;
+		size_t currentFrame = 0;
+		bool started = false;
+
+		StateChecksumFunction checksumFunction;
+		unsigned checksumMismatches = 0;
+		unsigned checksumsVerified = 0;
+
+		std::vector<float> measuredFrameTimes;
+
+	public:
+		InputPlayer(const std::string& filePath, StateChecksumFunction checksumFunction = nullptr);
+
+		bool IsLoaded() const { return !frames.empty(); }
+		size_t GetFrameCount() const { return frames.size(); }
+		bool HasDiverged() const { return checksumMismatches > 0; }
+
+		virtual bool NextFrame(double measuredFrameTime, double& deltaTime) override;
+
+		/// <summary>
+		/// Snapshot recorded for the current frame.
+		/// </summary>
+		const InputSnapshot& GetSnapshot() const { return frames[currentFrame].snapshot; }
+
+		/// <summary>
+		/// Compares the game state against the recorded checksum, if the current frame has one.
+		/// Called by the input task at the same point of the frame the recorder computed it.
+		/// </summary>
+		void VerifyFrame();
+
+		/// <summary>
+		/// Writes one line per frame (frame, recorded delta time, measured frame time) to a CSV file and
+		/// logs a summary, so frame-time profiles of different builds can be compared.
+		/// </summary>
+		bool WriteProfile(const std::string& filePath) const;
+	};
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <Events/InputEvent.h>
+
+namespace engine
+{
+	const unsigned int INPUT_ACTION_COUNT = InputEvent::Action::ACTION_COUNT;
+
+	/// <summary>
+	/// Picture of the input for a single frame. Every repeat and motion event received during the
+	/// frame is already folded into it, so gameplay reads one value per action instead of handling events.
+	/// </summary>
+	struct InputSnapshot
+	{
+		/// <summary>
+		/// Normalized value of every action, -1..1. Buttons will usually only be 1/0.
+		/// </summary>
+		std::array<float, INPUT_ACTION_COUNT> values{};
+		/// <summary>
+		/// True only in the frame the action went from idle to active.
+		/// </summary>
+		std::array<bool, INPUT_ACTION_COUNT> pressed{};
+		/// <summary>
+		/// True only in the frame the action went from active to idle.
+		/// </summary>
+		std::array<bool, INPUT_ACTION_COUNT> released{};
+
+		/// <summary>
+		/// Sum of every mouse motion event received during the frame.
+		/// </summary>
+		glm::vec2 mouseDelta = glm::vec2(0, 0);
+		glm::vec2 mousePosition = glm::vec2(0, 0);
+
+		/// <summary>
+		/// Number of snapshots published before this one.
+		/// </summary>
+		unsigned long long frame = 0;
+
+		float GetValue(InputEvent::Action action) const { return values[action]; }
+		bool IsDown(InputEvent::Action action) const { return values[action] != 0.f; }
+		bool WasPressed(InputEvent::Action action) const { return pressed[action]; }
+		bool WasReleased(InputEvent::Action action) const { return released[action]; }
+	};
+
+	/// <summary>
+	/// Double-buffered input snapshot, built once per frame by the input polling task.
+	///
+	/// The polling thread is the only writer: it feeds raw input through the writer functions during the
+	/// frame and calls Publish() once at the end of its polling pass. Readers call Read() from any thread
+	/// and get a copy of the front snapshot, theirs to keep however long they want. The writer builds the
+	/// back buffer without locking; only the copy and the swap of the buffers share a lock.
+	/// </summary>
+	class InputState
+	{
+	private:
+		InputSnapshot snapshots[2];
+		/// <summary>
+		/// Only changed by the writer, under the lock. The writer reads it without.
+		/// </summary>
+		int frontIndex = 0;
+		mutable std::mutex frontMutex;
+
+		//Writer side accumulators, only touched by the polling thread.
+		std::array<float, INPUT_ACTION_COUNT> digital{};
+		std::array<float, INPUT_ACTION_COUNT> analog{};
+		std::array<bool, INPUT_ACTION_COUNT> wentDown{};
+		std::array<bool, INPUT_ACTION_COUNT> pulses{};
+		glm::vec2 mouseDelta = glm::vec2(0, 0);
+		glm::vec2 mousePosition = glm::vec2(0, 0);
+
+		std::atomic<uint64_t> lastSampleTime{ 0 };
+
+	public:
+		InputState() = default;
+		InputState(const InputState&) = delete;
+		InputState& operator = (const InputState&) = delete;
+
+		/*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*
+		* Reader side
+		*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*/
+
+		/// <summary>
+		/// Copy of the latest published snapshot. Safe to call from any thread.
+		/// </summary>
+		InputSnapshot Read() const
+		{
+			std::lock_guard<std::mutex> lock(frontMutex);
+			return snapshots[frontIndex];
+		}
+
+		/// <summary>
+		/// When input was last read from the OS, in the writer's clock units (SDL performance counter).
+		/// </summary>
+		uint64_t GetLastSampleTime() const
+		{
+			return lastSampleTime.load(std::memory_order_acquire);
+		}
+
+		/// <summary>
+		/// Value the action would have if the snapshot was published now. Writer thread only, used to
+		/// late-latch input sampled after the frame's snapshot was published.
+		/// </summary>
+		float PeekValue(InputEvent::Action action) const
+		{
+			return std::clamp(digital[action] + analog[action], -1.f, 1.f);
+		}
+
+		/*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*
+		* Writer side (polling thread only)
+		*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*.*/
+
+		/// <summary>
+		/// A digital source (key, button) bound to the action changed its state.
+		/// Several sources can hold the same action at once; their scales are added up. Every release must
+		/// match a press of the same source with the same scale, the caller keeps track of which are held.
+		/// </summary>
+		void SetButton(InputEvent::Action action, bool down, float scale = 1.f)
+		{
+			digital[action] += down ? scale : -scale;
+			if (down) wentDown[action] = true;
+		}
+
+		/// <summary>
+		/// An analog source bound to the action moved. Only the latest value of the frame is kept.
+		/// </summary>
+		void SetAxis(InputEvent::Action action, float value)
+		{
+			analog[action] = value;
+			if (value != 0.f) wentDown[action] = true;
+		}
+
+		/// <summary>
+		/// Activates the action for the current frame only (ex: the window close button).
+		/// </summary>
+		void Pulse(InputEvent::Action action)
+		{
+			pulses[action] = true;
+		}
+
+		void AddMouseMotion(float deltaX, float deltaY, float x, float y)
+		{
+			mouseDelta += glm::vec2(deltaX, deltaY);
+			mousePosition = glm::vec2(x, y);
+		}
+
+		/// <summary>
+		/// Input was just read from the OS, see GetLastSampleTime().
+		/// </summary>
+		void MarkSampled(uint64_t sampleTime)
+		{
+			lastSampleTime.store(sampleTime, std::memory_order_release);
+		}
+
+		/// <summary>
+		/// Forgets every held source, used when the window loses focus and key-up events would be lost.
+		/// </summary>
+		void ReleaseAll()
+		{
+			digital.fill(0.f);
+			analog.fill(0.f);
+		}
+
+		/// <summary>
+		/// Builds the back snapshot from everything received since the last call and makes it the front one.
+		/// </summary>
+		void Publish()
+		{
+			const int front = frontIndex;
+			const InputSnapshot& previous = snapshots[front];
+			InputSnapshot& next = snapshots[1 - front];
+
+			for (unsigned action = 0; action < INPUT_ACTION_COUNT; action++)
+			{
+				float value = std::clamp(digital[action] + analog[action], -1.f, 1.f);
+				if (pulses[action] && value == 0.f) value = 1.f;
+
+				const bool wasActive = previous.values[action] != 0.f;
+				const bool isActive = value != 0.f;
+
+				next.values[action] = value;
+				//A tap shorter than a frame still counts as a press followed by a release.
+				next.pressed[action] = !wasActive && (isActive || wentDown[action] || pulses[action]);
+				next.released[action] = (wasActive && !isActive) || (next.pressed[action] && !isActive);
+			}
+
+			next.mouseDelta = mouseDelta;
+			next.mousePosition = mousePosition;
+			next.frame = previous.frame + 1;
+
+			wentDown.fill(false);
+			pulses.fill(false);
+			mouseDelta = glm::vec2(0, 0);
+
+			std::lock_guard<std::mutex> lock(frontMutex);
+			frontIndex = 1 - front;
+		}
+
+		/// <summary>
+		/// Publishes a snapshot built somewhere else (ex: read from an input recording) instead of the live input.
+		/// Live input received in the meantime is ignored.
+		/// </summary>
+		void Publish(const InputSnapshot& snapshot)
+		{
+			const int front = frontIndex;
+			InputSnapshot& next = snapshots[1 - front];
+
+			next = snapshot;
+			next.frame = snapshots[front].frame + 1;
+
+			wentDown.fill(false);
+			pulses.fill(false);
+			mouseDelta = glm::vec2(0, 0);
+
+			std::lock_guard<std::mutex> lock(frontMutex);
+			frontIndex = 1 - front;
+		}
+	};
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+namespace engine
+{
+	/// <summary>
+	/// Hook the renderer calls right before and right after submitting a frame. Implementations re-sample
+	/// the input and move what the player looks at (camera, player character) to match it, so the picture
+	/// reflects input newer than the one the simulation ran with.
+	///
+	/// Corrections must be render-only: Unlatch() puts back everything Latch() touched, so the simulation
+	/// (and input replays) never see them.
+	/// </summary>
+	class LateLatch
+	{
+	public:
+		virtual ~LateLatch() = default;
+
+		virtual void Latch() = 0;
+		virtual void Unlatch() = 0;
+	};
+}
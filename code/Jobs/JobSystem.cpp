@@ -0,0 +1,132 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Jobs/JobSystem.h>
+#include <algorithm>
+
+namespace engine
+{
+	JobSystem::JobSystem(unsigned workerCount)
+	{
+		if (workerCount == 0)
+		{
+			//hardware_concurrency() is 0 when it can't tell.
+			const unsigned hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		for (unsigned i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back(&JobSystem::WorkerLoop, this);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	JobSystem& JobSystem::Instance()
+	{
+		static JobSystem instance;
+		return instance;
+	}
+
+	void JobSystem::Schedule(std::function<void()> job, JobCounter* counter)
+	{
+		if (counter)
+		{
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.push_back({ std::move(job), counter });
+		}
+		jobAvailable.notify_one();
+	}
+
+	void JobSystem::Wait(JobCounter& counter)
+	{
+		while (!counter.IsDone())
+		{
+			if (!RunNextJob())
+			{
+				//What's left is already running on the workers.
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void JobSystem::ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& function)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		batchSize = std::max<size_t>(batchSize, 1);
+
+		JobCounter counter;
+		for (size_t begin = 0; begin < count; begin += batchSize)
+		{
+			const size_t end = std::min(begin + batchSize, count);
+			Schedule([&function, begin, end]() { function(begin, end); }, &counter);
+		}
+		Wait(counter);
+	}
+
+	void JobSystem::WorkerLoop()
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				jobAvailable.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty())
+				{
+					return;
+				}
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			job.function();
+			if (job.counter)
+			{
+				job.counter->pending.fetch_sub(1, std::memory_order_release);
+			}
+		}
+	}
+
+	bool JobSystem::RunNextJob()
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (queue.empty())
+			{
+				return false;
+			}
+			job = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		job.function();
+		if (job.counter)
+		{
+			job.counter->pending.fetch_sub(1, std::memory_order_release);
+		}
+		return true;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace engine
+{
+	/// <summary>
+	/// Counts the unfinished jobs of a group, so whoever scheduled them can wait for all of them at once.
+	/// </summary>
+	class JobCounter
+	{
+		friend class JobSystem;
+	private:
+		std::atomic<int> pending{ 0 };
+	public:
+		bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+	};
+
+	/// <summary>
+	/// Fixed pool of worker threads running short jobs from a shared queue.
+	/// Threads waiting for a group of jobs run queued jobs in the meantime instead of blocking.
+	/// </summary>
+	class JobSystem
+	{
+	private:
+		struct Job
+		{
+			std::function<void()> function;
+			JobCounter* counter;
+		};
+
+		std::vector<std::thread> workers;
+		std::deque<Job> queue;
+		std::mutex queueMutex;
+		std::condition_variable jobAvailable;
+		bool stopping = false;
+
+		void WorkerLoop();
+
+		/// <summary>
+		/// Runs the next queued job on the calling thread. Returns false if the queue was empty.
+		/// </summary>
+		bool RunNextJob();
+
+	public:
+		/// <param name="workerCount">0 uses one worker per hardware thread, minus the main one</param>
+		explicit JobSystem(unsigned workerCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator = (const JobSystem&) = delete;
+
+		/// <summary>
+		/// Pool shared by the whole engine, created on first use.
+		/// </summary>
+		static JobSystem& Instance();
+
+		unsigned GetWorkerCount() const { return unsigned(workers.size()); }
+
+		/// <summary>
+		/// Queues a job. If counter is given, it counts the job until it finishes.
+		/// </summary>
+		void Schedule(std::function<void()> job, JobCounter* counter = nullptr);
+
+		/// <summary>
+		/// Returns once every job counted by counter has finished.
+		/// </summary>
+		void Wait(JobCounter& counter);
+
+		/// <summary>
+		/// Splits [0, count) in ranges of up to batchSize elements, runs them in parallel and waits for all of them.
+		/// </summary>
+		void ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& function);
+	};
+}
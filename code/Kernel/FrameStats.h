@@ -0,0 +1,39 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+namespace engine
+{
+	/// <summary>
+	/// Timings of the latest frame, filled in by the kernel and the tasks that know about each measure.
+	/// All times are in seconds.
+	/// </summary>
+	struct FrameStats
+	{
+		unsigned long long frame = 0;
+		/// <summary>
+		/// Whole frame, including the frame delay wait and the buffer swap.
+		/// </summary>
+		double frameTime = 0;
+		/// <summary>
+		/// Time slept before sampling input in low-latency mode.
+		/// </summary>
+		double frameDelay = 0;
+		/// <summary>
+		/// From the latest input sample that made it into the frame to the buffer swap returning.
+		/// </summary>
+		double inputToPresent = 0;
+		/// <summary>
+		/// Exponential moving average of inputToPresent, steadier to display or log.
+		/// </summary>
+		double averageInputToPresent = 0;
+
+		void AddInputToPresent(double latency)
+		{
+			inputToPresent = latency;
+			averageInputToPresent = averageInputToPresent == 0 ? latency : averageInputToPresent * 0.95 + latency * 0.05;
+		}
+	};
+}
@@ -6,12 +6,36 @@
 
 namespace engine
 {
+    void Kernel::Wait(double seconds)
+    {
+        const Uint64 frequency = SDL_GetPerformanceFrequency();
+        const Uint64 end = SDL_GetPerformanceCounter() + Uint64(seconds * frequency);
+
+        for (Uint64 now = SDL_GetPerformanceCounter(); now < end; now = SDL_GetPerformanceCounter())
+        {
+            //SDL_Delay() may oversleep by a scheduler tick, so the last couple of milliseconds are spun.
+            const double remainingMs = (end - now) * 1000.0 / frequency;
+            if (remainingMs > 2.0)
+            {
+                SDL_Delay(Uint32(remainingMs - 2.0));
+            }
+        }
+    }
+
     void Kernel::Execute()
     {
         exit = false;
+        const double secondsPerCount = 1.0 / double(SDL_GetPerformanceFrequency());
+        double measuredFrameTime = deltaTime;
         do
         {
-            millisecondsPreviousFrame = SDL_GetTicks64();
+            frameStartCounter = SDL_GetPerformanceCounter();
+
+            if (frameClock && !frameClock->NextFrame(measuredFrameTime, deltaTime))
+            {
+                exit = true;
+                break;
+            }
 
             if (!tasksToInitialize.empty())
             {
@@ -23,6 +47,13 @@ namespace engine
                 tasksToInitialize.clear();
             }
 
+            if (frameDelay > 0)
+            {
+                const Uint64 waitStart = SDL_GetPerformanceCounter();
+                Wait(frameDelay);
+                frameStats.frameDelay = (SDL_GetPerformanceCounter() - waitStart) * secondsPerCount;
+            }
+
             for (auto task : priorizedRunningTasks)
             {
                 task->Run(deltaTime);
@@ -32,7 +63,11 @@ namespace engine
             {
                 task->Run(deltaTime);
             }
-            deltaTime = (SDL_GetTicks64() - millisecondsPreviousFrame) * 0.001f;
+            measuredFrameTime = (SDL_GetPerformanceCounter() - frameStartCounter) * secondsPerCount;
+            deltaTime = measuredFrameTime;
+
+            frameStats.frame++;
+            frameStats.frameTime = measuredFrameTime;
         } while (!exit);
     }
 }
\ No newline at end of file
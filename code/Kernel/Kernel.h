@@ -2,9 +2,27 @@
 #include <list>
 #include <sdl2/SDL.h>
 #include <Task/Task.h>
+#include <Kernel/FrameStats.h>
 
 namespace engine
 {
+    /// <summary>
+    /// Lets something other than the wall clock decide the delta time of every frame (ex: input replays).
+    /// </summary>
+    class FrameClock
+    {
+    public:
+        virtual ~FrameClock() = default;
+
+        /// <summary>
+        /// Called at the start of every frame, before any task runs.
+        /// </summary>
+        /// <param name="measuredFrameTime">Wall-clock duration of the previous frame, in seconds</param>
+        /// <param name="deltaTime">Delta time the tasks of this frame will receive</param>
+        /// <returns>false to stop the kernel</returns>
+        virtual bool NextFrame(double measuredFrameTime, double& deltaTime) = 0;
+    };
+
     class Kernel
     {
     private:
@@ -22,14 +40,24 @@ namespace engine
         /// This tasks will run in a loop.
         /// </summary>
         std::list < Task*> runningTasks;
-        Uint64 millisecondsPreviousFrame;
+        Uint64 frameStartCounter;
         double deltaTime = 1.f / 60.f;
         bool exit;
+
+        FrameClock* frameClock = nullptr;
+
+        double frameDelay = 0;
+        FrameStats frameStats;
+
+        /// <summary>
+        /// Sleeps with sub-millisecond precision: SDL_Delay() for most of the time, then spins.
+        /// </summary>
+        static void Wait(double seconds);
     public:
 
         Kernel()
         {
-            millisecondsPreviousFrame = SDL_GetTicks64();
+            frameStartCounter = SDL_GetPerformanceCounter();
         }
 
         void InitializeTask(Task& task)
@@ -49,6 +77,30 @@ namespace engine
             priorizedRunningTasks.push_back(&task);
         }
 
+        /// <summary>
+        /// Replaces the wall clock as the source of delta times. nullptr goes back to the wall clock.
+        /// </summary>
+        void SetFrameClock(FrameClock* clock)
+        {
+            frameClock = clock;
+        }
+
+        /// <summary>
+        /// Low-latency mode: sleeps this long at the start of every frame, right before the input is sampled.
+        /// With vsync the frame starts when the previous one is presented, so delaying the sampling by
+        /// what the frame won't need of the refresh interval shows newer input on screen. Too long and
+        /// frames start missing the vsync. 0 disables it.
+        /// </summary>
+        void SetFrameDelay(double seconds)
+        {
+            frameDelay = seconds;
+        }
+
+        FrameStats& GetFrameStats()
+        {
+            return frameStats;
+        }
+
         void Execute();
         void Stop()
         {
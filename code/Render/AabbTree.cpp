@@ -0,0 +1,393 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/AabbTree.h>
+#include <cassert>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define AABB_TREE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace engine
+{
+	namespace
+	{
+		const size_t LEAF_BATCH = 8;
+
+		/// <summary>
+		/// Returns a bit per box, set if it's outside the frustum. Boxes are given as structure of arrays,
+		/// LEAF_BATCH of each, and the eight of them are tested against a plane at once (two SSE registers).
+		/// </summary>
+		unsigned TestBatch(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+			const float* extentX, const float* extentY, const float* extentZ)
+		{
+#ifdef AABB_TREE_SSE
+			const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+			__m128 outside[2] = { _mm_setzero_ps(), _mm_setzero_ps() };
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const __m128 normalX = _mm_set1_ps(plane.x);
+				const __m128 normalY = _mm_set1_ps(plane.y);
+				const __m128 normalZ = _mm_set1_ps(plane.z);
+				const __m128 distance = _mm_set1_ps(plane.w);
+				const __m128 absX = _mm_and_ps(normalX, signMask);
+				const __m128 absY = _mm_and_ps(normalY, signMask);
+				const __m128 absZ = _mm_and_ps(normalZ, signMask);
+
+				for (int half = 0; half < 2; half++)
+				{
+					const int offset = half * 4;
+					const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, _mm_loadu_ps(centerX + offset)),
+						_mm_mul_ps(normalY, _mm_loadu_ps(centerY + offset))),
+						_mm_add_ps(_mm_mul_ps(normalZ, _mm_loadu_ps(centerZ + offset)), distance));
+					const __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX, _mm_loadu_ps(extentX + offset)),
+						_mm_mul_ps(absY, _mm_loadu_ps(extentY + offset))),
+						_mm_mul_ps(absZ, _mm_loadu_ps(extentZ + offset)));
+					outside[half] = _mm_or_ps(outside[half], _mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+				}
+			}
+			return unsigned(_mm_movemask_ps(outside[0])) | unsigned(_mm_movemask_ps(outside[1])) << 4;
+#else
+			unsigned outside = 0;
+			for (size_t i = 0; i < LEAF_BATCH; i++)
+			{
+				for (const glm::vec4& plane : frustum.planes)
+				{
+					const float d = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+					const float r = std::abs(plane.x) * extentX[i] + std::abs(plane.y) * extentY[i] + std::abs(plane.z) * extentZ[i];
+					if (d + r < 0.f)
+					{
+						outside |= 1u << i;
+						break;
+					}
+				}
+			}
+			return outside;
+#endif
+		}
+	}
+
+	int AabbTree::AllocateNode()
+	{
+		if (freeList == NULL_NODE)
+		{
+			nodes.emplace_back();
+			nodes.back().height = 0;
+			return int(nodes.size() - 1);
+		}
+		const int node = freeList;
+		freeList = nodes[node].parent;
+		nodes[node] = Node();
+		nodes[node].height = 0;
+		return node;
+	}
+
+	void AabbTree::FreeNode(int node)
+	{
+		nodes[node].parent = freeList;
+		nodes[node].height = -1;
+		freeList = node;
+	}
+
+	void AabbTree::Refit(int node)
+	{
+		Node& n = nodes[node];
+		const Node& child0 = nodes[n.children[0]];
+		const Node& child1 = nodes[n.children[1]];
+		n.bounds = child0.bounds;
+		n.bounds.Add(child1.bounds);
+		n.height = 1 + std::max(child0.height, child1.height);
+		n.leafCount = child0.leafCount + child1.leafCount;
+	}
+
+	void AabbTree::InsertLeaf(int leaf)
+	{
+		if (root == NULL_NODE)
+		{
+			root = leaf;
+			nodes[root].parent = NULL_NODE;
+			return;
+		}
+
+		//Walks down to the sibling that grows the tree's surface the least.
+		const Aabb leafBounds = nodes[leaf].bounds;
+		int index = root;
+		while (!nodes[index].IsLeaf())
+		{
+			const Node& node = nodes[index];
+			const float area = node.bounds.GetHalfArea();
+
+			Aabb combined = node.bounds;
+			combined.Add(leafBounds);
+			const float combinedArea = combined.GetHalfArea();
+
+			//Cost of making a new parent for this node and the leaf, and the minimum cost pushed down to the children.
+			const float cost = 2.f * combinedArea;
+			const float inheritanceCost = 2.f * (combinedArea - area);
+
+			float childCosts[2];
+			for (int i = 0; i < 2; i++)
+			{
+				const Node& child = nodes[node.children[i]];
+				Aabb childCombined = child.bounds;
+				childCombined.Add(leafBounds);
+				childCosts[i] = child.IsLeaf() ? childCombined.GetHalfArea() + inheritanceCost
+					: childCombined.GetHalfArea() - child.bounds.GetHalfArea() + inheritanceCost;
+			}
+
+			if (cost < childCosts[0] && cost < childCosts[1])
+			{
+				break;
+			}
+			index = childCosts[0] < childCosts[1] ? node.children[0] : node.children[1];
+		}
+
+		const int sibling = index;
+		const int oldParent = nodes[sibling].parent;
+		const int newParent = AllocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].children[0] = sibling;
+		nodes[newParent].children[1] = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+		Refit(newParent);
+
+		if (oldParent == NULL_NODE)
+		{
+			root = newParent;
+		}
+		else
+		{
+			Node& parent = nodes[oldParent];
+			parent.children[parent.children[0] == sibling ? 0 : 1] = newParent;
+		}
+
+		//Refits the ancestors, balancing them on the way up.
+		for (int node = nodes[leaf].parent; node != NULL_NODE; node = nodes[node].parent)
+		{
+			node = Balance(node);
+			Refit(node);
+		}
+	}
+
+	void AabbTree::RemoveLeaf(int leaf)
+	{
+		if (leaf == root)
+		{
+			root = NULL_NODE;
+			return;
+		}
+
+		const int parent = nodes[leaf].parent;
+		const int grandParent = nodes[parent].parent;
+		const int sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+
+		if (grandParent == NULL_NODE)
+		{
+			root = sibling;
+			nodes[sibling].parent = NULL_NODE;
+			FreeNode(parent);
+			return;
+		}
+
+		Node& grand = nodes[grandParent];
+		grand.children[grand.children[0] == parent ? 0 : 1] = sibling;
+		nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		for (int node = grandParent; node != NULL_NODE; node = nodes[node].parent)
+		{
+			node = Balance(node);
+			Refit(node);
+		}
+	}
+
+	int AabbTree::Balance(int a)
+	{
+		//Rotates a child up when one side is more than one level deeper than the other (as an AVL tree).
+		Node& nodeA = nodes[a];
+		if (nodeA.IsLeaf() || nodeA.height < 2)
+		{
+			return a;
+		}
+
+		const int b = nodeA.children[0];
+		const int c = nodeA.children[1];
+		const int balance = nodes[c].height - nodes[b].height;
+		if (balance >= -1 && balance <= 1)
+		{
+			return a;
+		}
+
+		//The deeper child takes a's place; a keeps the shallower child and the shallower grandchild.
+		const int up = balance > 1 ? c : b;
+		const int stay = balance > 1 ? b : c;
+		const int upSlot = balance > 1 ? 1 : 0;
+
+		const int f = nodes[up].children[0];
+		const int g = nodes[up].children[1];
+
+		nodes[up].children[0] = a;
+		nodes[up].parent = nodeA.parent;
+		nodeA.parent = up;
+
+		if (nodes[up].parent != NULL_NODE)
+		{
+			Node& parent = nodes[nodes[up].parent];
+			parent.children[parent.children[0] == a ? 0 : 1] = up;
+		}
+		else
+		{
+			root = up;
+		}
+
+		const int deeper = nodes[f].height > nodes[g].height ? f : g;
+		const int shallower = deeper == f ? g : f;
+		nodes[up].children[1] = deeper;
+		nodeA.children[upSlot] = shallower;
+		nodeA.children[1 - upSlot] = stay;
+		nodes[shallower].parent = a;
+
+		Refit(a);
+		Refit(up);
+		return up;
+	}
+
+	int AabbTree::CreateProxy(const Aabb& bounds, int userData)
+	{
+		const int proxy = AllocateNode();
+		nodes[proxy].bounds = Aabb(bounds.min - glm::vec3(margin), bounds.max + glm::vec3(margin));
+		nodes[proxy].userData = userData;
+		InsertLeaf(proxy);
+		proxyCount++;
+		return proxy;
+	}
+
+	void AabbTree::DestroyProxy(int proxy)
+	{
+		assert(nodes[proxy].IsLeaf());
+		RemoveLeaf(proxy);
+		FreeNode(proxy);
+		proxyCount--;
+	}
+
+	bool AabbTree::MoveProxy(int proxy, const Aabb& bounds)
+	{
+		if (nodes[proxy].bounds.Contains(bounds))
+		{
+			return false;
+		}
+
+		RemoveLeaf(proxy);
+		nodes[proxy].bounds = Aabb(bounds.min - glm::vec3(margin), bounds.max + glm::vec3(margin));
+		InsertLeaf(proxy);
+		return true;
+	}
+
+	void AabbTree::Clear()
+	{
+		nodes.clear();
+		root = NULL_NODE;
+		freeList = NULL_NODE;
+		proxyCount = 0;
+	}
+
+	void AabbTree::AddSubtree(int node, std::vector<int>& visible, CullingStats& stats)
+	{
+		const size_t base = stack.size();
+		stack.push_back(node);
+		while (stack.size() > base)
+		{
+			const Node& n = nodes[stack.back()];
+			stack.pop_back();
+			if (n.IsLeaf())
+			{
+				visible.push_back(n.userData);
+				stats.drawn++;
+			}
+			else
+			{
+				stack.push_back(n.children[0]);
+				stack.push_back(n.children[1]);
+			}
+		}
+	}
+
+	void AabbTree::TestPendingLeaves(const Frustum& frustum, std::vector<int>& visible, CullingStats& stats)
+	{
+		alignas(16) float centerX[LEAF_BATCH], centerY[LEAF_BATCH], centerZ[LEAF_BATCH];
+		alignas(16) float extentX[LEAF_BATCH], extentY[LEAF_BATCH], extentZ[LEAF_BATCH];
+
+		for (size_t first = 0; first < pendingLeaves.size(); first += LEAF_BATCH)
+		{
+			const size_t count = std::min(LEAF_BATCH, pendingLeaves.size() - first);
+			for (size_t i = 0; i < LEAF_BATCH; i++)
+			{
+				//The last batch is padded with copies of its first box.
+				const Aabb& bounds = nodes[pendingLeaves[first + (i < count ? i : 0)]].bounds;
+				const glm::vec3 center = bounds.GetCenter();
+				const glm::vec3 extents = bounds.GetExtents();
+				centerX[i] = center.x; centerY[i] = center.y; centerZ[i] = center.z;
+				extentX[i] = extents.x; extentY[i] = extents.y; extentZ[i] = extents.z;
+			}
+
+			const unsigned outside = TestBatch(frustum, centerX, centerY, centerZ, extentX, extentY, extentZ);
+			for (size_t i = 0; i < count; i++)
+			{
+				if (outside & (1u << i))
+				{
+					stats.culled++;
+				}
+				else
+				{
+					visible.push_back(nodes[pendingLeaves[first + i]].userData);
+					stats.drawn++;
+				}
+			}
+			stats.tested += unsigned(count);
+		}
+		pendingLeaves.clear();
+	}
+
+	void AabbTree::Query(const Frustum& frustum, std::vector<int>& visible, CullingStats& stats)
+	{
+		if (root == NULL_NODE)
+		{
+			return;
+		}
+
+		stack.clear();
+		pendingLeaves.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const int index = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[index];
+
+			if (node.IsLeaf())
+			{
+				pendingLeaves.push_back(index);
+				continue;
+			}
+
+			stats.tested++;
+			switch (frustum.Classify(node.bounds))
+			{
+			case Frustum::OUTSIDE:
+				stats.culled += node.leafCount;
+				break;
+			case Frustum::INSIDE:
+				AddSubtree(index, visible, stats);
+				break;
+			case Frustum::INTERSECTING:
+				stack.push_back(node.children[0]);
+				stack.push_back(node.children[1]);
+				break;
+			}
+		}
+		TestPendingLeaves(frustum, visible, stats);
+	}
+}
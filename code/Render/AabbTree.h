@@ -0,0 +1,112 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <Render/Bounds.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Counters of the last culling pass.
+	/// </summary>
+	struct CullingStats
+	{
+		/// <summary>
+		/// Bounds tested against the frustum, tree nodes included.
+		/// </summary>
+		unsigned tested = 0;
+		unsigned culled = 0;
+		unsigned drawn = 0;
+		/// <summary>
+		/// Inside the frustum but hidden behind occluders, not counted in drawn.
+		/// </summary>
+		unsigned occluded = 0;
+	};
+
+	/// <summary>
+	/// Dynamic bounding volume hierarchy. Leaves are objects (proxies), every inner node holds the box of
+	/// its two children.
+	///
+	/// Leaves store their bounds fattened by a margin, so an object moving a little only costs a
+	/// containment test. Only leaving its fat box reinserts it, refitting the ancestors on the way up and
+	/// rotating them to keep the tree balanced.
+	/// </summary>
+	class AabbTree
+	{
+	private:
+		static const int NULL_NODE = -1;
+
+		struct Node
+		{
+			Aabb bounds;
+			/// <summary>
+			/// Next free node while the node is in the free list.
+			/// </summary>
+			int parent = NULL_NODE;
+			int children[2] = { NULL_NODE, NULL_NODE };
+			int userData = -1;
+			/// <summary>
+			/// 0 for leaves, -1 for free nodes.
+			/// </summary>
+			int height = -1;
+			/// <summary>
+			/// Proxies below, to count a culled subtree without walking it.
+			/// </summary>
+			unsigned leafCount = 1;
+
+			bool IsLeaf() const { return children[0] == NULL_NODE; }
+		};
+
+		std::vector<Node> nodes;
+		int root = NULL_NODE;
+		int freeList = NULL_NODE;
+		size_t proxyCount = 0;
+		float margin;
+
+		/// <summary>
+		/// Leaves waiting for the SIMD test, eight at a time.
+		/// </summary>
+		std::vector<int> pendingLeaves;
+		std::vector<int> stack;
+
+		int AllocateNode();
+		void FreeNode(int node);
+		void InsertLeaf(int leaf);
+		void RemoveLeaf(int leaf);
+		int Balance(int node);
+		void Refit(int node);
+
+		void AddSubtree(int node, std::vector<int>& visible, CullingStats& stats);
+		void TestPendingLeaves(const Frustum& frustum, std::vector<int>& visible, CullingStats& stats);
+
+	public:
+		/// <param name="margin">Added to every side of the leaves, in world units</param>
+		explicit AabbTree(float margin = 0.5f) : margin(margin) {}
+
+		/// <returns>Proxy id, stable until the proxy is destroyed</returns>
+		int CreateProxy(const Aabb& bounds, int userData);
+		void DestroyProxy(int proxy);
+
+		/// <summary>
+		/// Updates the bounds of a proxy. Cheap when they're still inside its fat bounds.
+		/// </summary>
+		/// <returns>true if the proxy was reinserted</returns>
+		bool MoveProxy(int proxy, const Aabb& bounds);
+
+		int GetUserData(int proxy) const { return nodes[proxy].userData; }
+		const Aabb& GetFatBounds(int proxy) const { return nodes[proxy].bounds; }
+		size_t GetProxyCount() const { return proxyCount; }
+		int GetHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+		void Clear();
+
+		/// <summary>
+		/// Appends the user data of every proxy touching the frustum. Subtrees fully inside are taken
+		/// without testing their leaves, and the remaining leaves are tested eight at a time with SIMD.
+		/// </summary>
+		void Query(const Frustum& frustum, std::vector<int>& visible, CullingStats& stats);
+	};
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <cfloat>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace engine
+{
+	/// <summary>
+	/// Axis-aligned bounding box. The default one is empty (min > max).
+	/// </summary>
+	struct Aabb
+	{
+		glm::vec3 min = glm::vec3(FLT_MAX);
+		glm::vec3 max = glm::vec3(-FLT_MAX);
+
+		Aabb() = default;
+		Aabb(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+		/// <summary>
+		/// Box that's never culled, for objects whose size isn't known.
+		/// </summary>
+		static Aabb Infinite() { return Aabb(glm::vec3(-FLT_MAX), glm::vec3(FLT_MAX)); }
+
+		bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+		bool IsInfinite() const { return min.x == -FLT_MAX || max.x == FLT_MAX; }
+
+		glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+		glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+		void Add(const glm::vec3& point)
+		{
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+
+		void Add(const Aabb& other)
+		{
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+
+		bool Contains(const Aabb& other) const
+		{
+			return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+				&& max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+		}
+
+		/// <summary>
+		/// Half the surface area, all the tree's cost heuristic needs.
+		/// </summary>
+		float GetHalfArea() const
+		{
+			const glm::vec3 size = max - min;
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		}
+
+		/// <summary>
+		/// Box around this one once transformed: the center is transformed and the extents are projected
+		/// on the new axes (Arvo).
+		/// </summary>
+		Aabb Transform(const glm::mat4& matrix) const
+		{
+			if (IsEmpty() || IsInfinite())
+			{
+				return *this;
+			}
+			const glm::vec3 center = glm::vec3(matrix * glm::vec4(GetCenter(), 1.f));
+			const glm::vec3 extents = GetExtents();
+			const glm::vec3 newExtents(
+				std::abs(matrix[0][0]) * extents.x + std::abs(matrix[1][0]) * extents.y + std::abs(matrix[2][0]) * extents.z,
+				std::abs(matrix[0][1]) * extents.x + std::abs(matrix[1][1]) * extents.y + std::abs(matrix[2][1]) * extents.z,
+				std::abs(matrix[0][2]) * extents.x + std::abs(matrix[1][2]) * extents.y + std::abs(matrix[2][2]) * extents.z);
+			return Aabb(center - newExtents, center + newExtents);
+		}
+	};
+
+	/// <summary>
+	/// Six planes pointing inwards, (normal, distance) with dot(normal, point) + distance >= 0 inside.
+	/// </summary>
+	struct Frustum
+	{
+		enum Side
+		{
+			OUTSIDE,
+			INTERSECTING,
+			INSIDE
+		};
+
+		glm::vec4 planes[6];
+
+		/// <summary>
+		/// Planes of a projection * view matrix, in world space (Gribb-Hartmann).
+		/// </summary>
+		static Frustum FromMatrix(const glm::mat4& viewProjection)
+		{
+			const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+			const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+			const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+			const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+			Frustum frustum;
+			frustum.planes[0] = row3 + row0;
+			frustum.planes[1] = row3 - row0;
+			frustum.planes[2] = row3 + row1;
+			frustum.planes[3] = row3 - row1;
+			frustum.planes[4] = row3 + row2;
+			frustum.planes[5] = row3 - row2;
+			for (glm::vec4& plane : frustum.planes)
+			{
+				plane /= glm::length(glm::vec3(plane));
+			}
+			return frustum;
+		}
+
+		Side Classify(const Aabb& bounds) const
+		{
+			if (bounds.IsInfinite())
+			{
+				return INTERSECTING;
+			}
+			const glm::vec3 center = bounds.GetCenter();
+			const glm::vec3 extents = bounds.GetExtents();
+			Side side = INSIDE;
+			for (const glm::vec4& plane : planes)
+			{
+				const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+				const float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+				if (distance + radius < 0.f)
+				{
+					return OUTSIDE;
+				}
+				if (distance - radius < 0.f)
+				{
+					side = INTERSECTING;
+				}
+			}
+			return side;
+		}
+	};
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <glm/glm.hpp>
+#include <sdl2/SDL.h>
+
+namespace engine
+{
+	/// <summary>
+	/// View of the 2D world: the world point at the center of the viewport, a zoom factor (screen pixels
+	/// per world unit) and the screen rectangle it's drawn into.
+	/// </summary>
+	class Camera2D
+	{
+	private:
+		glm::vec2 position;
+		float zoom;
+		SDL_Rect viewport;
+
+	public:
+		Camera2D(const SDL_Rect& viewport, glm::vec2 position = glm::vec2(0, 0), float zoom = 1.f)
+			: position(position), zoom(zoom), viewport(viewport) {}
+
+		void SetPosition(const glm::vec2& newPosition) { position = newPosition; }
+		void Move(const glm::vec2& displacement) { position += displacement; }
+		const glm::vec2& GetPosition() const { return position; }
+
+		void SetZoom(float newZoom) { zoom = newZoom > 0.f ? newZoom : zoom; }
+		float GetZoom() const { return zoom; }
+
+		void SetViewport(const SDL_Rect& newViewport) { viewport = newViewport; }
+		const SDL_Rect& GetViewport() const { return viewport; }
+
+		/// <summary>
+		/// Part of the world the camera sees, in world units.
+		/// </summary>
+		SDL_FRect GetViewRect() const
+		{
+			const float width = viewport.w / zoom;
+			const float height = viewport.h / zoom;
+			return { position.x - width * 0.5f, position.y - height * 0.5f, width, height };
+		}
+
+		SDL_FRect WorldToScreen(const SDL_FRect& world) const
+		{
+			const SDL_FRect view = GetViewRect();
+			return { (world.x - view.x) * zoom + viewport.x, (world.y - view.y) * zoom + viewport.y, world.w * zoom, world.h * zoom };
+		}
+
+		glm::vec2 ScreenToWorld(const glm::vec2& screen) const
+		{
+			const SDL_FRect view = GetViewRect();
+			return glm::vec2((screen.x - viewport.x) / zoom + view.x, (screen.y - viewport.y) / zoom + view.y);
+		}
+	};
+}
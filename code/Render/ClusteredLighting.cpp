@@ -0,0 +1,129 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/ClusteredLighting.h>
+#include <Render/GlState.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <iterator>
+
+namespace engine
+{
+	const char* ClusteredLighting::SHADER_SOURCE =
+		"uniform samplerBuffer  cluster_lights;\n"
+		"uniform usamplerBuffer cluster_ranges;\n"
+		"uniform usamplerBuffer cluster_indices;\n"
+		"vec3 shade_point_lights(vec3 position, vec3 normal, vec3 eye, vec3 albedo, vec4 specular)\n"
+		"{\n"
+		"    if (cluster_grid.z == 0.0) return vec3(0.0);\n"
+		"    int slice = clamp(int(log(max(-position.z, 1e-4)) * cluster_depth.x + cluster_depth.y), 0, int(cluster_grid.z) - 1);\n"
+		"    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / cluster_depth.zw * cluster_grid.xy), ivec2(0), ivec2(cluster_grid.xy) - 1);\n"
+		"    uvec2 range = texelFetch(cluster_ranges, (slice * int(cluster_grid.y) + tile.y) * int(cluster_grid.x) + tile.x).xy;\n"
+		"    vec3 result = vec3(0.0);\n"
+		"    for (uint i = 0u; i < range.y; i++)\n"
+		"    {\n"
+		"        int light = int(texelFetch(cluster_indices, int(range.x + i)).x);\n"
+		"        vec4 sphere = texelFetch(cluster_lights, light * 2);\n"
+		"        vec3 to_light = sphere.xyz - position;\n"
+		"        float distance = length(to_light);\n"
+		"        float attenuation = clamp(1.0 - distance / sphere.w, 0.0, 1.0);\n"
+		"        vec3 l = to_light / max(distance, 1e-4);\n"
+		"        float diffuse = max(dot(normal, l), 0.0);\n"
+		"        float shine = diffuse > 0.0 ? pow(max(dot(normal, normalize(l + eye)), 0.0), specular.w) : 0.0;\n"
+		"        result += texelFetch(cluster_lights, light * 2 + 1).rgb * (attenuation * attenuation) * (albedo * diffuse + specular.rgb * shine);\n"
+		"    }\n"
+		"    return result;\n"
+		"}\n";
+
+	ClusteredLighting::~ClusteredLighting()
+	{
+		for (unsigned i = 0; i < BUFFER_COUNT; i++)
+		{
+			if (buffers[i])
+			{
+				GlState::Instance().ForgetBuffer(buffers[i]);
+				glDeleteBuffers(1, &buffers[i]);
+				glDeleteTextures(1, &textures[i]);
+			}
+		}
+	}
+
+	bool ClusteredLighting::Initialize()
+	{
+		const GLenum formats[BUFFER_COUNT] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+		glGenBuffers(BUFFER_COUNT, buffers);
+		glGenTextures(BUFFER_COUNT, textures);
+		for (unsigned i = 0; i < BUFFER_COUNT; i++)
+		{
+			//Never empty: a texture buffer without storage can't be sampled.
+			Upload(BufferIndex(i), nullptr, 0);
+			GlState::Instance().BindTexture(FIRST_TEXTURE_UNIT + i, GL_TEXTURE_BUFFER, textures[i]);
+			glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+		}
+
+		if (glGetError() != GL_NO_ERROR)
+		{
+			spdlog::error("Couldn't create the clustered lighting buffers");
+			for (unsigned i = 0; i < BUFFER_COUNT; i++)
+			{
+				GlState::Instance().ForgetBuffer(buffers[i]);
+			}
+			glDeleteBuffers(BUFFER_COUNT, buffers);
+			glDeleteTextures(BUFFER_COUNT, textures);
+			std::fill(std::begin(buffers), std::end(buffers), 0u);
+			std::fill(std::begin(textures), std::end(textures), 0u);
+			return false;
+		}
+		return true;
+	}
+
+	void ClusteredLighting::BindProgram(const glt::Shader_Program& program)
+	{
+		const char* samplers[BUFFER_COUNT] = { "cluster_lights", "cluster_ranges", "cluster_indices" };
+		program.use();
+		for (unsigned i = 0; i < BUFFER_COUNT; i++)
+		{
+			const GLint location = glGetUniformLocation(program, samplers[i]);
+			if (location >= 0)
+			{
+				program.set_uniform_value(location, GLint(FIRST_TEXTURE_UNIT + i));
+			}
+		}
+	}
+
+	void ClusteredLighting::Upload(BufferIndex buffer, const void* data, size_t bytes)
+	{
+		//Orphaned every frame: the previous frame's lights may still be read by the GPU.
+		const uint32_t empty[4] = {};
+		GlState::Instance().BindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+		glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(std::max(bytes, sizeof(empty))), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, GLsizeiptr(bytes ? bytes : sizeof(empty)), bytes ? data : empty);
+	}
+
+	void ClusteredLighting::Update(const glm::mat4& view, const glm::mat4& projection, const std::vector<PointLight>& lights)
+	{
+		clusters.SetProjection(projection);
+		clusters.Build(view, lights);
+
+		const std::vector<PointLight>& viewLights = clusters.GetViewLights();
+		lightTexels.resize(viewLights.size() * 2);
+		for (size_t i = 0; i < viewLights.size(); i++)
+		{
+			lightTexels[i * 2] = glm::vec4(viewLights[i].position, viewLights[i].radius);
+			lightTexels[i * 2 + 1] = glm::vec4(viewLights[i].color * viewLights[i].intensity, 0.f);
+		}
+
+		Upload(LIGHTS, lightTexels.data(), lightTexels.size() * sizeof(glm::vec4));
+		Upload(RANGES, clusters.GetClusters().data(), clusters.GetClusters().size() * sizeof(ClusterRange));
+		Upload(INDICES, clusters.GetLightIndices().data(), clusters.GetLightIndices().size() * sizeof(uint32_t));
+	}
+
+	void ClusteredLighting::Bind()
+	{
+		for (unsigned i = 0; i < BUFFER_COUNT; i++)
+		{
+			GlState::Instance().BindTexture(FIRST_TEXTURE_UNIT + i, GL_TEXTURE_BUFFER, textures[i]);
+		}
+	}
+}
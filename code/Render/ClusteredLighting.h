@@ -0,0 +1,82 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <gltk/OpenGL.hpp>
+#include <gltk/Shader_Program.hpp>
+#include <Render/LightClusters.h>
+
+namespace engine
+{
+	/// <summary>
+	/// GPU side of the clustered lights: uploads what LightClusters computed into three texture
+	/// buffers (the lights, the range of every cluster and the compact light index lists) that
+	/// shaders read with texelFetch.
+	///
+	/// Shaders paste SHADER_SOURCE after the frame block (see UniformBlocks) and call
+	/// shade_point_lights(); the grid parameters come from the frame block.
+	/// </summary>
+	class ClusteredLighting
+	{
+	private:
+		enum BufferIndex
+		{
+			LIGHTS,
+			RANGES,
+			INDICES,
+			BUFFER_COUNT
+		};
+
+		LightClusters clusters;
+
+		GLuint buffers[BUFFER_COUNT] = {};
+		GLuint textures[BUFFER_COUNT] = {};
+
+		/// <summary>
+		/// Two texels per light: position and radius, color times intensity.
+		/// </summary>
+		std::vector<glm::vec4> lightTexels;
+
+		void Upload(BufferIndex buffer, const void* data, size_t bytes);
+
+	public:
+		/// <summary>
+		/// Texture units the buffers are bound to, above the ones materials use.
+		/// </summary>
+		static const GLuint FIRST_TEXTURE_UNIT = 4;
+
+		static const char* SHADER_SOURCE;
+
+		ClusteredLighting(unsigned tilesX = 16, unsigned tilesY = 9, unsigned slices = 24) : clusters(tilesX, tilesY, slices) {}
+		~ClusteredLighting();
+
+		ClusteredLighting(const ClusteredLighting&) = delete;
+		ClusteredLighting& operator = (const ClusteredLighting&) = delete;
+
+		/// <summary>
+		/// Creates the buffers. Needs the GL context.
+		/// </summary>
+		bool Initialize();
+		bool IsReady() const { return buffers[LIGHTS] != 0; }
+
+		/// <summary>
+		/// Points the program's light samplers at the texture units. Once per program.
+		/// </summary>
+		static void BindProgram(const glt::Shader_Program& program);
+
+		/// <summary>
+		/// Bins the lights for the camera and uploads the result.
+		/// </summary>
+		void Update(const glm::mat4& view, const glm::mat4& projection, const std::vector<PointLight>& lights);
+
+		/// <summary>
+		/// Binds the buffers to their texture units.
+		/// </summary>
+		void Bind();
+
+		const LightClusters& GetClusters() const { return clusters; }
+	};
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <sdl2/SDL.h>
+#include <gltk/Math.hpp>
+#include <Render/LightClusters.h>
+#include <Render/UniformBlocks.h>
+
+namespace engine
+{
+	/// <summary>
+	/// What the renderer reads of a model, copied at the end of the simulation frame.
+	/// </summary>
+	struct ModelSnapshot
+	{
+		/// <summary>
+		/// Model to world.
+		/// </summary>
+		glt::Matrix44 transform;
+		glm::vec4 color;
+		bool visible;
+		/// <summary>
+		/// See ModelRender3DSystem::MarkStatic().
+		/// </summary>
+		bool isStatic;
+		/// <summary>
+		/// Its bounds are updated every frame.
+		/// </summary>
+		bool dynamic;
+		/// <summary>
+		/// ModelRender3DSystem::MarkMoved() was called on it since the previous snapshot.
+		/// </summary>
+		bool moved;
+	};
+
+	/// <summary>
+	/// Everything a frame is drawn from, so the renderer never reads the scene while the simulation
+	/// changes it. The vectors keep their memory from frame to frame.
+	/// </summary>
+	struct FrameSnapshot
+	{
+		unsigned long long frame = 0;
+
+		/// <summary>
+		/// Nothing is drawn without a camera.
+		/// </summary>
+		bool hasCamera = false;
+		/// <summary>
+		/// World to camera.
+		/// </summary>
+		glt::Matrix44 view = glt::Matrix44(1);
+		glt::Matrix44 projection = glt::Matrix44(1);
+		float farPlane = 1.f;
+
+		/// <summary>
+		/// One per model of the renderer, in the same order.
+		/// </summary>
+		std::vector<ModelSnapshot> models;
+		/// <summary>
+		/// The toolkit's lights, in the order of the renderer's shader listeners.
+		/// </summary>
+		std::vector<FrameLight> lights;
+		bool hasPointLights = false;
+		std::vector<PointLight> pointLights;
+
+		/// <summary>
+		/// Performance counter of the latest input sample the frame saw, 0 if none (replays).
+		/// </summary>
+		Uint64 inputSampleTime = 0;
+		/// <summary>
+		/// Performance counter when the simulation handed the snapshot over.
+		/// </summary>
+		Uint64 publishTime = 0;
+	};
+}
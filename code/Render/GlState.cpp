@@ -0,0 +1,234 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/GlState.h>
+#include <cstring>
+
+namespace engine
+{
+	unsigned GlState::Counters::GetIssued() const
+	{
+		unsigned total = 0;
+		for (unsigned count : issued)
+		{
+			total += count;
+		}
+		return total;
+	}
+
+	unsigned GlState::Counters::GetSkipped() const
+	{
+		unsigned total = 0;
+		for (unsigned count : skipped)
+		{
+			total += count;
+		}
+		return total;
+	}
+
+	GlState& GlState::Instance()
+	{
+		static GlState state;
+		return state;
+	}
+
+	bool GlState::Changed(CallType type, bool isDifferent)
+	{
+		if (isDifferent)
+		{
+			counters.issued[type]++;
+		}
+		else
+		{
+			counters.skipped[type]++;
+		}
+		return isDifferent;
+	}
+
+	void GlState::Invalidate(bool uniformValues)
+	{
+		vertexArray = UNKNOWN;
+		activeTexture = GL_NONE;
+		blendSource = GL_NONE;
+		blendDestination = GL_NONE;
+		depthFunction = GL_NONE;
+		depthWrite = -1;
+
+		buffers.clear();
+		indexedBuffers.clear();
+		textures.clear();
+		capabilities.clear();
+		if (uniformValues)
+		{
+			uniforms.clear();
+		}
+	}
+
+	void GlState::BeginFrame()
+	{
+		lastFrameCounters = counters;
+		counters = Counters();
+		Invalidate(true);
+	}
+
+	void GlState::BindVertexArray(GLuint vertexArray)
+	{
+		if (Changed(VERTEX_ARRAY, vertexArray != this->vertexArray))
+		{
+			glBindVertexArray(vertexArray);
+			this->vertexArray = vertexArray;
+			//The index buffer binding belongs to the vertex array.
+			buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+		}
+	}
+
+	void GlState::BindBuffer(GLenum target, GLuint buffer)
+	{
+		auto binding = buffers.find(target);
+		if (Changed(BUFFER, binding == buffers.end() || binding->second != buffer))
+		{
+			glBindBuffer(target, buffer);
+			buffers[target] = buffer;
+		}
+	}
+
+	void GlState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		const uint64_t key = uint64_t(target) << 32 | index;
+		auto binding = indexedBuffers.find(key);
+		if (Changed(BUFFER, binding == indexedBuffers.end() || binding->second.buffer != buffer
+			|| binding->second.offset != offset || binding->second.size != size))
+		{
+			if (size == 0)
+			{
+				glBindBufferBase(target, index, buffer);
+			}
+			else
+			{
+				glBindBufferRange(target, index, buffer, offset, size);
+			}
+			indexedBuffers[key] = { buffer, offset, size };
+			buffers[target] = buffer;
+		}
+	}
+
+	void GlState::BindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		GLuint& binding = textures.emplace(uint64_t(unit) << 32 | target, UNKNOWN).first->second;
+		if (Changed(TEXTURE, binding != texture))
+		{
+			if (activeTexture != GL_TEXTURE0 + unit)
+			{
+				activeTexture = GL_TEXTURE0 + unit;
+				glActiveTexture(activeTexture);
+			}
+			glBindTexture(target, texture);
+			binding = texture;
+		}
+	}
+
+	void GlState::ForgetBuffer(GLuint buffer)
+	{
+		for (auto& binding : buffers)
+		{
+			if (binding.second == buffer)
+			{
+				binding.second = UNKNOWN;
+			}
+		}
+		for (auto& binding : indexedBuffers)
+		{
+			if (binding.second.buffer == buffer)
+			{
+				binding.second.buffer = UNKNOWN;
+			}
+		}
+	}
+
+	void GlState::ForgetVertexArray(GLuint vertexArray)
+	{
+		if (this->vertexArray == vertexArray)
+		{
+			this->vertexArray = UNKNOWN;
+		}
+	}
+
+	void GlState::ForgetProgram(GLuint program)
+	{
+		for (auto uniform = uniforms.begin(); uniform != uniforms.end();)
+		{
+			if (GLuint(uniform->first >> 32) == program)
+			{
+				uniform = uniforms.erase(uniform);
+			}
+			else
+			{
+				++uniform;
+			}
+		}
+	}
+
+	void GlState::SetCapability(GLenum capability, bool enabled)
+	{
+		auto state = capabilities.find(capability);
+		if (Changed(RENDER_STATE, state == capabilities.end() || state->second != enabled))
+		{
+			if (enabled)
+			{
+				glEnable(capability);
+			}
+			else
+			{
+				glDisable(capability);
+			}
+			capabilities[capability] = enabled;
+		}
+	}
+
+	void GlState::SetBlendFunction(GLenum source, GLenum destination)
+	{
+		if (Changed(RENDER_STATE, source != blendSource || destination != blendDestination))
+		{
+			blendSource = source;
+			blendDestination = destination;
+			glBlendFunc(source, destination);
+		}
+	}
+
+	void GlState::SetDepthFunction(GLenum function)
+	{
+		if (Changed(RENDER_STATE, function != depthFunction))
+		{
+			depthFunction = function;
+			glDepthFunc(function);
+		}
+	}
+
+	void GlState::SetDepthWrite(bool enabled)
+	{
+		if (Changed(RENDER_STATE, depthWrite != int(enabled)))
+		{
+			depthWrite = int(enabled);
+			glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+		}
+	}
+
+	bool GlState::UniformChanged(GLuint program, GLint location, const void* value, size_t size)
+	{
+		//GL ignores them, nothing to remember.
+		if (location < 0)
+		{
+			return Changed(UNIFORM, false);
+		}
+
+		UniformShadow& shadow = uniforms[uint64_t(program) << 32 | GLuint(location)];
+		if (!Changed(UNIFORM, shadow.size != size || std::memcmp(shadow.value, value, size) != 0))
+		{
+			return false;
+		}
+		shadow.size = size;
+		std::memcpy(shadow.value, value, size);
+		return true;
+	}
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <gltk/OpenGL.hpp>
+#include <gltk/Shader_Program.hpp>
+
+namespace engine
+{
+	/// <summary>
+	/// Shadow copy of the GL state the engine changes while drawing: bound vertex array, buffers and
+	/// textures, blend/depth state and the uniform values it uploads. Calls that would set what is
+	/// already set are skipped.
+	///
+	/// The shadow is only right as long as every change goes through it. The toolkit binds and draws on its
+	/// own (glt::Mesh::draw(), glt::Material::use(), glt::Shader_Program::use()...), so every call into it
+	/// must be followed by Invalidate(). Programs are always bound with glt::Shader_Program::use(), which
+	/// remembers the active one itself. BeginFrame() also forgets everything, assets loaded between
+	/// frames bind whatever they want.
+	/// </summary>
+	class GlState
+	{
+	public:
+		enum CallType
+		{
+			VERTEX_ARRAY,
+			BUFFER,
+			TEXTURE,
+			UNIFORM,
+			RENDER_STATE,
+			CALL_TYPE_COUNT
+		};
+
+		struct Counters
+		{
+			unsigned issued[CALL_TYPE_COUNT] = {};
+			unsigned skipped[CALL_TYPE_COUNT] = {};
+
+			unsigned GetIssued() const;
+			unsigned GetSkipped() const;
+		};
+
+	private:
+		static constexpr GLuint UNKNOWN = ~GLuint(0);
+
+		struct BufferRange
+		{
+			GLuint buffer;
+			GLintptr offset;
+			//0 for the whole buffer.
+			GLsizeiptr size;
+		};
+
+		struct UniformShadow
+		{
+			size_t size = 0;
+			uint8_t value[64];
+		};
+
+		GLuint vertexArray = UNKNOWN;
+		GLenum activeTexture = GL_NONE;
+
+		GLenum blendSource = GL_NONE;
+		GLenum blendDestination = GL_NONE;
+		GLenum depthFunction = GL_NONE;
+		int depthWrite = -1;
+
+		/// <summary>
+		/// By target.
+		/// </summary>
+		std::unordered_map<GLenum, GLuint> buffers;
+		/// <summary>
+		/// By target << 32 | binding point.
+		/// </summary>
+		std::unordered_map<uint64_t, BufferRange> indexedBuffers;
+		/// <summary>
+		/// By unit << 32 | target.
+		/// </summary>
+		std::unordered_map<uint64_t, GLuint> textures;
+		std::unordered_map<GLenum, bool> capabilities;
+		/// <summary>
+		/// By program << 32 | location.
+		/// </summary>
+		std::unordered_map<uint64_t, UniformShadow> uniforms;
+
+		Counters counters;
+		Counters lastFrameCounters;
+
+		GlState() = default;
+
+		bool Changed(CallType type, bool isDifferent);
+
+		/// <summary>
+		/// Compares the value with the one last given to the uniform of the program and remembers it.
+		/// </summary>
+		/// <returns>false if the glUniform* call can be skipped</returns>
+		bool UniformChanged(GLuint program, GLint location, const void* value, size_t size);
+
+	public:
+		GlState(const GlState&) = delete;
+		GlState& operator=(const GlState&) = delete;
+
+		static GlState& Instance();
+
+		/// <summary>
+		/// Forgets the bindings and render states, they'll be set again on their next use. Uniform values
+		/// are kept unless asked: during a frame, the uniforms set through SetUniform() are only written there.
+		/// </summary>
+		void Invalidate(bool uniformValues = false);
+
+		/// <summary>
+		/// Starts counting a new frame and forgets everything, uniform values included.
+		/// </summary>
+		void BeginFrame();
+
+		const Counters& GetCounters() const { return counters; }
+		const Counters& GetLastFrameCounters() const { return lastFrameCounters; }
+
+		void BindVertexArray(GLuint vertexArray);
+		void BindBuffer(GLenum target, GLuint buffer);
+		/// <summary>
+		/// Binds a range of the buffer to an indexed binding point (uniform blocks). Like glBindBufferRange,
+		/// it binds the buffer to the generic target too. A size of 0 binds the whole buffer.
+		/// </summary>
+		void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset = 0, GLsizeiptr size = 0);
+		void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+		/// <summary>
+		/// A deleted object's id can be given to a new one, which isn't bound even if the old one was.
+		/// </summary>
+		void ForgetBuffer(GLuint buffer);
+		void ForgetVertexArray(GLuint vertexArray);
+		void ForgetProgram(GLuint program);
+
+		void SetCapability(GLenum capability, bool enabled);
+		void SetBlendFunction(GLenum source, GLenum destination);
+		void SetDepthFunction(GLenum function);
+		void SetDepthWrite(bool enabled);
+
+		/// <summary>
+		/// Uploads the value unless the uniform already has it. The program must be the one in use, as with glUniform*.
+		/// </summary>
+		template <typename T>
+		void SetUniform(const glt::Shader_Program& program, GLint location, const T& value)
+		{
+			static_assert(sizeof(T) <= sizeof(UniformShadow::value), "Uniform too big to shadow");
+			if (UniformChanged(program, location, &value, sizeof(T)))
+			{
+				program.set_uniform_value(location, value);
+			}
+		}
+	};
+}
@@ -0,0 +1,266 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/InstancedRenderer.h>
+#include <Render/ClusteredLighting.h>
+#include <Render/GlState.h>
+#include <Render/MeshAccess.h>
+#include <spdlog/spdlog.h>
+#include <sdl2/SDL.h>
+#include <cstring>
+#include <cstddef>
+
+namespace engine
+{
+	namespace
+	{
+		/// <summary>
+		/// GL 4.0 enum, missing from the 3.3 headers.
+		/// </summary>
+		const GLenum DRAW_INDIRECT_BUFFER = 0x8F3F;
+
+		//The frame and material blocks (see UniformBlocks) are inserted after the #version line, and the
+		//clustered lights (see ClusteredLighting) before the fragment shader.
+		const char* VERTEX_SHADER_CODE =
+			"layout (location = 0) in vec3 vertex_coordinates;\n"
+			"layout (location = 1) in vec3 vertex_normal;\n"
+			"layout (location = 4) in mat4 instance_transform;\n"
+			"layout (location = 8) in vec4 instance_color;\n"
+			"out vec3 position;\n"
+			"out vec3 normal;\n"
+			"out vec4 color;\n"
+			"void main()\n"
+			"{\n"
+			"    mat4 model_view = view_matrix * instance_transform;\n"
+			"    vec4 view_position = model_view * vec4(vertex_coordinates, 1.0);\n"
+			"    position = view_position.xyz;\n"
+			"    normal = mat3(model_view) * vertex_normal;\n"
+			"    color = instance_color * material_color;\n"
+			"    gl_Position = projection_matrix * view_position;\n"
+			"}\n";
+
+		const char* FRAGMENT_SHADER_CODE =
+			"in vec3 position;\n"
+			"in vec3 normal;\n"
+			"in vec4 color;\n"
+			"out vec4 fragment_color;\n"
+			"void main()\n"
+			"{\n"
+			"    vec3 n = normalize(normal);\n"
+			"    vec3 eye = normalize(-position);\n"
+			"    vec3 light = ambient_color.rgb * color.rgb;\n"
+			"    for (int i = 0; i < light_count.x; i++)\n"
+			"    {\n"
+			"        vec3 l = normalize(lights[i].position.xyz - position);\n"
+			"        float diffuse = max(dot(n, l), 0.0);\n"
+			"        float specular = diffuse > 0.0 ? pow(max(dot(n, normalize(l + eye)), 0.0), material_specular.w) : 0.0;\n"
+			"        light += lights[i].color.rgb * (color.rgb * diffuse + material_specular.rgb * specular);\n"
+			"    }\n"
+			"    light += shade_point_lights(position, n, eye, color.rgb, material_specular);\n"
+			"    fragment_color = vec4(light, color.a);\n"
+			"}\n";
+	}
+
+	InstancedRenderer::~InstancedRenderer()
+	{
+		if (program)
+		{
+			GlState::Instance().ForgetProgram(*program);
+		}
+		for (GLuint buffer : { instanceBuffer, indirectBuffer })
+		{
+			if (buffer)
+			{
+				GlState::Instance().ForgetBuffer(buffer);
+				glDeleteBuffers(1, &buffer);
+			}
+		}
+	}
+
+	bool InstancedRenderer::Initialize(ShaderCache* shaderCache, size_t bufferBytes)
+	{
+		//The shader is #version 330 and the instance attributes need glVertexAttribDivisor, both GL 3.3.
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major < 3 || (major == 3 && minor < 3))
+		{
+			spdlog::warn("Instanced rendering needs GL 3.3, the context is " + std::to_string(major) + "." + std::to_string(minor));
+			return false;
+		}
+
+		//Without a cache it's only compiled.
+		ShaderCache compiler;
+		const std::string header = std::string("#version 330\n") + UniformBlocks::FRAME_BLOCK_SOURCE + UniformBlocks::MATERIAL_BLOCK_SOURCE;
+		std::unique_ptr<glt::Shader_Program> newProgram = (shaderCache ? *shaderCache : compiler).Build(ProgramSource{ "instancing",
+			header + VERTEX_SHADER_CODE, header + ClusteredLighting::SHADER_SOURCE + FRAGMENT_SHADER_CODE });
+		if (!newProgram)
+		{
+			return false;
+		}
+
+		UniformBlocks::BindProgram(*newProgram);
+		ClusteredLighting::BindProgram(*newProgram);
+		program = std::move(newProgram);
+
+		bufferSize = bufferBytes;
+		writeOffset = 0;
+		glGenBuffers(1, &instanceBuffer);
+		GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(bufferSize), nullptr, GL_STREAM_DRAW);
+		GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
+
+		//The per-draw instance offsets come from the commands' base instance, also 4.2+.
+		if (major > 4 || (major == 4 && minor >= 3))
+		{
+			multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)SDL_GL_GetProcAddress("glMultiDrawElementsIndirect");
+		}
+		if (multiDrawElementsIndirect)
+		{
+			glGenBuffers(1, &indirectBuffer);
+		}
+		spdlog::info(multiDrawElementsIndirect ? "Multi-draw indirect available" : "Multi-draw indirect unavailable, using a draw per command");
+
+		spdlog::info("Instanced rendering ready");
+		return true;
+	}
+
+	void InstancedRenderer::Begin()
+	{
+		program->use();
+	}
+
+	size_t InstancedRenderer::Stream(const InstanceData* instances, size_t count)
+	{
+		const size_t bytes = count * sizeof(InstanceData);
+		if (bytes > bufferSize)
+		{
+			//Grows for good: a batch this big will probably come again next frame.
+			bufferSize = bytes * 2;
+			writeOffset = 0;
+			glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(bufferSize), nullptr, GL_STREAM_DRAW);
+		}
+		else if (writeOffset + bytes > bufferSize)
+		{
+			//Orphaning: the driver hands out fresh storage and frees the old one once the GPU is done with it.
+			writeOffset = 0;
+			glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(bufferSize), nullptr, GL_STREAM_DRAW);
+		}
+
+		//Nothing the GPU may still be reading is ever overwritten, so there's nothing to wait for.
+		void* destination = glMapBufferRange(GL_ARRAY_BUFFER, GLintptr(writeOffset), GLsizeiptr(bytes),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (destination)
+		{
+			std::memcpy(destination, instances, bytes);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		else
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, GLintptr(writeOffset), GLsizeiptr(bytes), instances);
+		}
+
+		const size_t offset = writeOffset;
+		writeOffset += bytes;
+		return offset;
+	}
+
+	void InstancedRenderer::BindInstances(const InstanceData* instances, size_t count)
+	{
+		GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		PointInstances(Stream(instances, count));
+	}
+
+	void InstancedRenderer::PointInstances(size_t offset)
+	{
+		//The offset changes every batch, so the pointers are set on every draw (six calls, no allocation).
+		const GLsizei stride = GLsizei(sizeof(InstanceData));
+		for (GLuint column = 0; column < 4; column++)
+		{
+			const GLuint location = INSTANCE_ATTRIBUTE + column;
+			glEnableVertexAttribArray(location);
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (const void*)(offset + offsetof(InstanceData, transform) + column * sizeof(glt::Vector4)));
+			glVertexAttribDivisor(location, 1);
+		}
+		const GLuint colorLocation = INSTANCE_ATTRIBUTE + 4;
+		glEnableVertexAttribArray(colorLocation);
+		glVertexAttribPointer(colorLocation, 4, GL_FLOAT, GL_FALSE, stride, (const void*)(offset + offsetof(InstanceData, color)));
+		glVertexAttribDivisor(colorLocation, 1);
+	}
+
+	void InstancedRenderer::Draw(const glt::Mesh& mesh, const InstanceData* instances, size_t count)
+	{
+		const glt::Vertex_Array_Object* vao = MeshAccess::GetVao(mesh);
+		if (!vao || count == 0)
+		{
+			return;
+		}
+
+		//Bound by the toolkit, the tracker can't tell.
+		vao->bind();
+		GlState::Instance().Invalidate();
+		BindInstances(instances, count);
+
+		if (MeshAccess::GetIndicesType(mesh) == GL_NONE)
+		{
+			glDrawArraysInstanced(MeshAccess::GetPrimitiveType(mesh), 0, MeshAccess::GetVerticesCount(mesh), GLsizei(count));
+		}
+		else
+		{
+			glDrawElementsInstanced(MeshAccess::GetPrimitiveType(mesh), MeshAccess::GetVerticesCount(mesh), MeshAccess::GetIndicesType(mesh), nullptr, GLsizei(count));
+		}
+		drawCalls++;
+		//The VAO stays bound, the render queue unbinds it at the end of the frame.
+	}
+
+	void InstancedRenderer::Draw(const MeshPool& pool, const MeshRange& range, const InstanceData* instances, size_t count)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		//Every mesh of the pool shares its vertex array, consecutive batches don't bind it again.
+		pool.Bind();
+		BindInstances(instances, count);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, GLsizei(range.indexCount), GL_UNSIGNED_INT,
+			(const void*)(size_t(range.firstIndex) * sizeof(uint32_t)), GLsizei(count), GLint(range.baseVertex));
+		drawCalls++;
+	}
+
+	unsigned InstancedRenderer::DrawMulti(const MeshPool& pool, const MultiDrawCommand* commands, size_t commandCount,
+		const InstanceData* instances, size_t count)
+	{
+		if (commandCount == 0 || count == 0)
+		{
+			return 0;
+		}
+
+		pool.Bind();
+		GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		const size_t offset = Stream(instances, count);
+
+		if (multiDrawElementsIndirect)
+		{
+			PointInstances(offset);
+			//Commands are rebuilt every frame: orphaned like the instances.
+			GlState::Instance().BindBuffer(DRAW_INDIRECT_BUFFER, indirectBuffer);
+			glBufferData(DRAW_INDIRECT_BUFFER, GLsizeiptr(commandCount * sizeof(MultiDrawCommand)), commands, GL_STREAM_DRAW);
+			multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, GLsizei(commandCount), 0);
+			drawCalls++;
+			return 1;
+		}
+
+		//Without base instances the attributes are moved to every command's first instance instead.
+		for (size_t i = 0; i < commandCount; i++)
+		{
+			const MultiDrawCommand& command = commands[i];
+			PointInstances(offset + command.baseInstance * sizeof(InstanceData));
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, GLsizei(command.count), GL_UNSIGNED_INT,
+				(const void*)(size_t(command.firstIndex) * sizeof(uint32_t)), GLsizei(command.instanceCount), command.baseVertex);
+		}
+		drawCalls += unsigned(commandCount);
+		return unsigned(commandCount);
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <memory>
+#include <gltk/Math.hpp>
+#include <gltk/Mesh.hpp>
+#include <gltk/Shader_Program.hpp>
+#include <Render/UniformBlocks.h>
+#include <Render/MeshPool.h>
+#include <Render/ShaderCache.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Per-instance data read by the instanced shader.
+	/// </summary>
+	struct InstanceData
+	{
+		glt::Matrix44 transform;
+		glt::Vector4 color;
+	};
+
+	/// <summary>
+	/// One draw of a multi-draw, laid out as GL's DrawElementsIndirectCommand. Its instances are
+	/// baseInstance onwards in the instance data.
+	/// </summary>
+	struct MultiDrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	/// <summary>
+	/// Draws many copies of a mesh with one glDrawElementsInstanced call.
+	///
+	/// The instance data of every batch is written into a streaming buffer, a ring that's orphaned when it
+	/// wraps around so the GPU can keep reading the previous frames while the next ones are written.
+	/// Instance attributes are attached to the mesh's own vertex array, after the toolkit's attributes.
+	///
+	/// Camera, lights and material come from the UniformBlocks: the frame block and a material block
+	/// must be bound before drawing.
+	/// </summary>
+	class InstancedRenderer
+	{
+	private:
+		std::unique_ptr<glt::Shader_Program> program;
+
+		GLuint instanceBuffer = 0;
+		size_t bufferSize = 0;
+		size_t writeOffset = 0;
+
+		typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+		/// <summary>
+		/// glMultiDrawElementsIndirect, loaded when the context is 4.3 or later. The engine's GL loader
+		/// stops at 3.3.
+		/// </summary>
+		MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+		GLuint indirectBuffer = 0;
+
+		unsigned drawCalls = 0;
+
+		/// <summary>
+		/// Copies the instances into the ring and returns where they start, in bytes.
+		/// </summary>
+		size_t Stream(const InstanceData* instances, size_t count);
+
+		/// <summary>
+		/// Streams the instances and points the instance attributes of the bound vertex array at them.
+		/// </summary>
+		void BindInstances(const InstanceData* instances, size_t count);
+		/// <summary>
+		/// Points the instance attributes of the bound vertex array at offset in the instance buffer.
+		/// </summary>
+		void PointInstances(size_t offset);
+
+	public:
+		/// <summary>
+		/// First attribute location used for the instance data: the transform takes four, the color one.
+		/// The toolkit's meshes use the first ones for coordinates, normals and texture coordinates.
+		/// </summary>
+		static const GLuint INSTANCE_ATTRIBUTE = 4;
+
+		InstancedRenderer() = default;
+		~InstancedRenderer();
+
+		InstancedRenderer(const InstancedRenderer&) = delete;
+		InstancedRenderer& operator = (const InstancedRenderer&) = delete;
+
+		/// <summary>
+		/// Builds the shader and creates the instance buffer. Needs a current GL 3.3 context, false on older ones.
+		/// </summary>
+		/// <param name="shaderCache">Where the shader binary is kept between launches, none to always compile it.</param>
+		/// <param name="bufferBytes">Size of the streaming ring. A batch bigger than this gets its own buffer.</param>
+		bool Initialize(ShaderCache* shaderCache = nullptr, size_t bufferBytes = 4 * 1024 * 1024);
+		bool IsReady() const { return program != nullptr; }
+
+		/// <summary>
+		/// Binds the instanced shader. The next program has to be bound again after the batches.
+		/// </summary>
+		void Begin();
+
+		/// <summary>
+		/// Draws count copies of the mesh, one per instance.
+		/// </summary>
+		void Draw(const glt::Mesh& mesh, const InstanceData* instances, size_t count);
+
+		/// <summary>
+		/// Draws count copies of a mesh of the pool. The instance attributes go to the pool's vertex array.
+		/// </summary>
+		void Draw(const MeshPool& pool, const MeshRange& range, const InstanceData* instances, size_t count);
+
+		/// <summary>
+		/// Draws meshes of the pool, each with its own instances, with a single glMultiDrawElementsIndirect
+		/// when the driver has it. Otherwise (GL 3.3) every command is its own instanced draw, the instances
+		/// still uploaded at once.
+		/// </summary>
+		/// <returns>Draw calls issued</returns>
+		unsigned DrawMulti(const MeshPool& pool, const MultiDrawCommand* commands, size_t commandCount, const InstanceData* instances, size_t count);
+
+		/// <summary>
+		/// Whether DrawMulti() gets to use glMultiDrawElementsIndirect.
+		/// </summary>
+		bool HasMultiDrawIndirect() const { return multiDrawElementsIndirect != nullptr; }
+
+		/// <summary>
+		/// Instanced draws since the last ResetStats().
+		/// </summary>
+		unsigned GetDrawCallCount() const { return drawCalls; }
+		void ResetStats() { drawCalls = 0; }
+	};
+}
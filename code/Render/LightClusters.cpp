@@ -0,0 +1,248 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/LightClusters.h>
+#include <Jobs/JobSystem.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define LIGHT_CLUSTERS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace engine
+{
+	namespace
+	{
+		/// <summary>
+		/// Radii are grown this much so clusters merely touching a light, and points right on a slice
+		/// boundary, never lose it to rounding.
+		/// </summary>
+		const float RADIUS_MARGIN = 1.001f;
+	}
+
+	LightClusters::LightClusters(unsigned tilesX, unsigned tilesY, unsigned slices)
+		: tilesX(std::max(tilesX, 1u)), tilesY(std::max(tilesY, 1u)), slices(std::max(slices, 1u))
+	{
+		rowStride = (this->tilesX + 3) & ~3u;
+		clusters.assign(size_t(this->tilesX) * this->tilesY * this->slices, ClusterRange{ 0, 0 });
+		slicePairs.resize(this->slices);
+	}
+
+	float LightClusters::GetSliceScale() const
+	{
+		return slices / std::log(farPlane / nearPlane);
+	}
+
+	float LightClusters::GetSliceBias() const
+	{
+		return -float(slices) * std::log(nearPlane) / std::log(farPlane / nearPlane);
+	}
+
+	int LightClusters::GetSlice(float depth) const
+	{
+		const int slice = int(std::floor(std::log(std::max(depth, nearPlane)) * GetSliceScale() + GetSliceBias()));
+		return std::clamp(slice, 0, int(slices) - 1);
+	}
+
+	int LightClusters::GetCluster(const glm::vec3& viewPosition) const
+	{
+		const float depth = -viewPosition.z;
+		if (depth < nearPlane || depth > farPlane)
+		{
+			return -1;
+		}
+		const float ndcX = viewPosition.x / (depth * tanHalfX);
+		const float ndcY = viewPosition.y / (depth * tanHalfY);
+		if (std::abs(ndcX) > 1.f || std::abs(ndcY) > 1.f)
+		{
+			return -1;
+		}
+		const int tileX = std::min(int((ndcX * 0.5f + 0.5f) * tilesX), int(tilesX) - 1);
+		const int tileY = std::min(int((ndcY * 0.5f + 0.5f) * tilesY), int(tilesY) - 1);
+		return (GetSlice(depth) * int(tilesY) + tileY) * int(tilesX) + tileX;
+	}
+
+	void LightClusters::SetProjection(const glm::mat4& newProjection)
+	{
+		if (newProjection == projection)
+		{
+			return;
+		}
+		projection = newProjection;
+
+		//Perspective matrix as glm::perspective() builds it.
+		tanHalfX = 1.f / projection[0][0];
+		tanHalfY = 1.f / projection[1][1];
+		nearPlane = projection[3][2] / (projection[2][2] - 1.f);
+		farPlane = projection[3][2] / (projection[2][2] + 1.f);
+
+		BuildClusterBounds();
+	}
+
+	void LightClusters::BuildClusterBounds()
+	{
+		const size_t size = size_t(slices) * tilesY * rowStride;
+		//Padding clusters are empty boxes, so they never touch a light.
+		minX.assign(size, FLT_MAX); minY.assign(size, FLT_MAX); minZ.assign(size, FLT_MAX);
+		maxX.assign(size, -FLT_MAX); maxY.assign(size, -FLT_MAX); maxZ.assign(size, -FLT_MAX);
+
+		for (unsigned slice = 0; slice < slices; slice++)
+		{
+			const float nearDepth = nearPlane * std::pow(farPlane / nearPlane, float(slice) / slices);
+			const float farDepth = nearPlane * std::pow(farPlane / nearPlane, float(slice + 1) / slices);
+			for (unsigned y = 0; y < tilesY; y++)
+			{
+				const float bottom = (-1.f + 2.f * y / tilesY) * tanHalfY;
+				const float top = (-1.f + 2.f * (y + 1) / tilesY) * tanHalfY;
+				for (unsigned x = 0; x < tilesX; x++)
+				{
+					const float left = (-1.f + 2.f * x / tilesX) * tanHalfX;
+					const float right = (-1.f + 2.f * (x + 1) / tilesX) * tanHalfX;
+					const size_t index = (size_t(slice) * tilesY + y) * rowStride + x;
+					minX[index] = std::min(left * nearDepth, left * farDepth);
+					maxX[index] = std::max(right * nearDepth, right * farDepth);
+					minY[index] = std::min(bottom * nearDepth, bottom * farDepth);
+					maxY[index] = std::max(top * nearDepth, top * farDepth);
+					minZ[index] = -farDepth;
+					maxZ[index] = -nearDepth;
+				}
+			}
+		}
+	}
+
+	void LightClusters::Build(const glm::mat4& view, const std::vector<PointLight>& lights)
+	{
+		viewLights.resize(lights.size());
+		for (size_t i = 0; i < lights.size(); i++)
+		{
+			viewLights[i] = lights[i];
+			viewLights[i].position = glm::vec3(view * glm::vec4(lights[i].position, 1.f));
+		}
+
+		JobSystem::Instance().ParallelFor(slices, 1, [this](size_t begin, size_t end)
+			{
+				for (size_t slice = begin; slice < end; slice++)
+				{
+					BinSlice(unsigned(slice));
+				}
+			});
+
+		//Pairs are sorted by cluster within a slice, and slices hold consecutive clusters.
+		std::fill(clusters.begin(), clusters.end(), ClusterRange{ 0, 0 });
+		lightIndices.clear();
+		for (const auto& pairs : slicePairs)
+		{
+			for (uint64_t pair : pairs)
+			{
+				ClusterRange& cluster = clusters[size_t(pair >> 32)];
+				if (cluster.count == 0)
+				{
+					cluster.offset = uint32_t(lightIndices.size());
+				}
+				cluster.count++;
+				lightIndices.push_back(uint32_t(pair));
+			}
+		}
+	}
+
+	void LightClusters::BinSlice(unsigned slice)
+	{
+		std::vector<uint64_t>& pairs = slicePairs[slice];
+		pairs.clear();
+
+		const float sliceNear = nearPlane * std::pow(farPlane / nearPlane, float(slice) / slices);
+		const float sliceFar = nearPlane * std::pow(farPlane / nearPlane, float(slice + 1) / slices);
+
+		for (uint32_t light = 0; light < uint32_t(viewLights.size()); light++)
+		{
+			const glm::vec3& center = viewLights[light].position;
+			const float radius = viewLights[light].radius * RADIUS_MARGIN;
+
+			//Part of the light's depth range inside this slice.
+			const float nearest = std::max(-center.z - radius, sliceNear);
+			const float farthest = std::min(-center.z + radius, sliceFar);
+			if (nearest > farthest)
+			{
+				continue;
+			}
+
+			//Tiles under the light's box, from the extremes of its sides over that depth range.
+			const float left = std::min((center.x - radius) / nearest, (center.x - radius) / farthest) / tanHalfX;
+			const float right = std::max((center.x + radius) / nearest, (center.x + radius) / farthest) / tanHalfX;
+			const float bottom = std::min((center.y - radius) / nearest, (center.y - radius) / farthest) / tanHalfY;
+			const float top = std::max((center.y + radius) / nearest, (center.y + radius) / farthest) / tanHalfY;
+			if (right < -1.f || left > 1.f || top < -1.f || bottom > 1.f)
+			{
+				continue;
+			}
+			const int firstX = std::clamp(int((left * 0.5f + 0.5f) * tilesX), 0, int(tilesX) - 1);
+			const int lastX = std::clamp(int((right * 0.5f + 0.5f) * tilesX), 0, int(tilesX) - 1);
+			const int firstY = std::clamp(int((bottom * 0.5f + 0.5f) * tilesY), 0, int(tilesY) - 1);
+			const int lastY = std::clamp(int((top * 0.5f + 0.5f) * tilesY), 0, int(tilesY) - 1);
+
+			const float radiusSquared = radius * radius;
+			for (int y = firstY; y <= lastY; y++)
+			{
+				const size_t row = (size_t(slice) * tilesY + y) * rowStride;
+				const uint64_t firstCluster = (uint64_t(slice) * tilesY + y) * tilesX;
+#ifdef LIGHT_CLUSTERS_SSE
+				const __m128 centerX = _mm_set1_ps(center.x);
+				const __m128 centerY = _mm_set1_ps(center.y);
+				const __m128 centerZ = _mm_set1_ps(center.z);
+				const __m128 zero = _mm_setzero_ps();
+				//Distance from the sphere center to each box, squared, four boxes at a time.
+				for (int x = firstX & ~3; x <= lastX; x += 4)
+				{
+					const size_t index = row + x;
+					const __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[index]), centerX), zero),
+						_mm_max_ps(_mm_sub_ps(centerX, _mm_loadu_ps(&maxX[index])), zero));
+					const __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[index]), centerY), zero),
+						_mm_max_ps(_mm_sub_ps(centerY, _mm_loadu_ps(&maxY[index])), zero));
+					const __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[index]), centerZ), zero),
+						_mm_max_ps(_mm_sub_ps(centerZ, _mm_loadu_ps(&maxZ[index])), zero));
+					const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					int mask = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(radiusSquared)));
+					while (mask)
+					{
+						const int lane = mask & 1 ? 0 : mask & 2 ? 1 : mask & 4 ? 2 : 3;
+						mask &= mask - 1;
+						//Padding lanes never pass, the tile range may still start before the light's.
+						if (x + lane >= firstX && x + lane <= lastX)
+						{
+							pairs.push_back((firstCluster + x + lane) << 32 | light);
+						}
+					}
+				}
+#else
+				for (int x = firstX; x <= lastX; x++)
+				{
+					const size_t index = row + x;
+					const float dx = std::max(minX[index] - center.x, 0.f) + std::max(center.x - maxX[index], 0.f);
+					const float dy = std::max(minY[index] - center.y, 0.f) + std::max(center.y - maxY[index], 0.f);
+					const float dz = std::max(minZ[index] - center.z, 0.f) + std::max(center.z - maxZ[index], 0.f);
+					if (dx * dx + dy * dy + dz * dz <= radiusSquared)
+					{
+						pairs.push_back((firstCluster + x) << 32 | light);
+					}
+				}
+#endif
+			}
+		}
+
+		std::sort(pairs.begin(), pairs.end());
+	}
+
+	unsigned LightClusters::GetMaxLightsPerCluster() const
+	{
+		unsigned maximum = 0;
+		for (const ClusterRange& cluster : clusters)
+		{
+			maximum = std::max(maximum, cluster.count);
+		}
+		return maximum;
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace engine
+{
+	/// <summary>
+	/// Light with a limited range. Its contribution fades to 0 at radius.
+	/// </summary>
+	struct PointLight
+	{
+		glm::vec3 position = glm::vec3(0, 0, 0);
+		float radius = 10.f;
+		glm::vec3 color = glm::vec3(1, 1, 1);
+		float intensity = 1.f;
+	};
+
+	/// <summary>
+	/// Lights of one cluster: count indices starting at offset in the index list.
+	/// </summary>
+	struct ClusterRange
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	/// <summary>
+	/// Clustered light assignment. The view frustum is split into a grid of tiles on screen and
+	/// exponential slices in depth, and every point light is listed in the clusters its sphere touches,
+	/// so a pixel only shades the lights of its cluster.
+	///
+	/// Binning runs on the CPU, one depth slice per job, testing four clusters at a time against each
+	/// light with SIMD. It doesn't touch GL: ClusteredLighting uploads the result.
+	/// </summary>
+	class LightClusters
+	{
+	private:
+		unsigned tilesX;
+		unsigned tilesY;
+		unsigned slices;
+
+		glm::mat4 projection = glm::mat4(0);
+		float nearPlane = 1.f;
+		float farPlane = 100.f;
+		/// <summary>
+		/// View space x/y of the frustum side at depth 1.
+		/// </summary>
+		float tanHalfX = 1.f;
+		float tanHalfY = 1.f;
+
+		/// <summary>
+		/// View space bounds of every cluster, one array per component so four clusters of a row load
+		/// in one register. Rows are padded to a multiple of four.
+		/// </summary>
+		unsigned rowStride;
+		std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+		/// <summary>
+		/// Lights of the frame, in view space.
+		/// </summary>
+		std::vector<PointLight> viewLights;
+		std::vector<ClusterRange> clusters;
+		std::vector<uint32_t> lightIndices;
+
+		/// <summary>
+		/// (cluster, light) pairs found by each slice's job, merged into lightIndices afterwards.
+		/// </summary>
+		std::vector<std::vector<uint64_t>> slicePairs;
+
+		void BuildClusterBounds();
+		void BinSlice(unsigned slice);
+
+	public:
+		LightClusters(unsigned tilesX = 16, unsigned tilesY = 9, unsigned slices = 24);
+
+		/// <summary>
+		/// Takes the camera's perspective projection. The cluster bounds are only rebuilt when it changes.
+		/// </summary>
+		void SetProjection(const glm::mat4& projection);
+
+		/// <summary>
+		/// Moves the lights to view space and lists them in the clusters they touch.
+		/// </summary>
+		void Build(const glm::mat4& view, const std::vector<PointLight>& lights);
+
+		unsigned GetTilesX() const { return tilesX; }
+		unsigned GetTilesY() const { return tilesY; }
+		unsigned GetSlices() const { return slices; }
+		size_t GetClusterCount() const { return clusters.size(); }
+
+		/// <summary>
+		/// Slice of a view depth (distance along -z) is floor(log(depth) * scale + bias).
+		/// </summary>
+		float GetSliceScale() const;
+		float GetSliceBias() const;
+		int GetSlice(float depth) const;
+
+		/// <summary>
+		/// Cluster of a point in view space, -1 if it's out of the frustum.
+		/// </summary>
+		int GetCluster(const glm::vec3& viewPosition) const;
+
+		const std::vector<PointLight>& GetViewLights() const { return viewLights; }
+		/// <summary>
+		/// Indexed by (slice * tilesY + tileY) * tilesX + tileX, tile (0, 0) being the bottom left one.
+		/// </summary>
+		const std::vector<ClusterRange>& GetClusters() const { return clusters; }
+		const std::vector<uint32_t>& GetLightIndices() const { return lightIndices; }
+		unsigned GetMaxLightsPerCluster() const;
+	};
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <gltk/Mesh.hpp>
+#include <gltk/Vertex_Array_Object.hpp>
+
+namespace engine
+{
+	/// <summary>
+	/// The toolkit keeps the draw parameters of a mesh protected. A pointer to member formed through a
+	/// derived class can still read them from any mesh.
+	/// </summary>
+	struct MeshAccess : glt::Mesh
+	{
+		static const glt::Vertex_Array_Object* GetVao(const glt::Mesh& mesh) { return (mesh.*(&MeshAccess::vao)).get(); }
+		static GLenum GetPrimitiveType(const glt::Mesh& mesh) { return mesh.*(&MeshAccess::primitive_type); }
+		static GLenum GetIndicesType(const glt::Mesh& mesh) { return mesh.*(&MeshAccess::indices_type); }
+		static GLsizei GetVerticesCount(const glt::Mesh& mesh) { return mesh.*(&MeshAccess::vertices_count); }
+	};
+}
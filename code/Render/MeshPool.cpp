@@ -0,0 +1,270 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/MeshPool.h>
+#include <Render/GlState.h>
+#include <gltk/Mesh.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstddef>
+
+namespace engine
+{
+	MeshPool::~MeshPool()
+	{
+		if (vertexArray)
+		{
+			GlState::Instance().ForgetVertexArray(vertexArray);
+			glDeleteVertexArrays(1, &vertexArray);
+		}
+		for (GLuint buffer : { vertexBuffer, indexBuffer })
+		{
+			if (buffer)
+			{
+				GlState::Instance().ForgetBuffer(buffer);
+				glDeleteBuffers(1, &buffer);
+			}
+		}
+	}
+
+	bool MeshPool::Initialize(uint32_t vertexCapacity, uint32_t indexCapacity)
+	{
+		Repack(std::max(vertexCapacity, 1u), std::max(indexCapacity, 1u));
+		if (glGetError() != GL_NO_ERROR)
+		{
+			spdlog::error("Couldn't create the mesh pool buffers");
+			return false;
+		}
+		return true;
+	}
+
+	void MeshPool::CreateBuffers(uint32_t vertexCapacity, uint32_t indexCapacity)
+	{
+		GlState& state = GlState::Instance();
+		glGenVertexArrays(1, &vertexArray);
+		glGenBuffers(1, &vertexBuffer);
+		glGenBuffers(1, &indexBuffer);
+		state.BindVertexArray(vertexArray);
+
+		const GLsizei stride = GLsizei(sizeof(Vertex));
+		state.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(size_t(vertexCapacity) * sizeof(Vertex)), nullptr, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(glt::Mesh::COORDINATES);
+		glVertexAttribPointer(glt::Mesh::COORDINATES, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, position));
+		glEnableVertexAttribArray(glt::Mesh::NORMALS);
+		glVertexAttribPointer(glt::Mesh::NORMALS, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(StaticBatcher::TEXTURE_COORDINATES);
+		glVertexAttribPointer(StaticBatcher::TEXTURE_COORDINATES, 2, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, textureCoordinates));
+
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(size_t(indexCapacity) * sizeof(uint32_t)), nullptr, GL_STATIC_DRAW);
+		state.BindVertexArray(0);
+	}
+
+	void MeshPool::Repack(uint32_t vertexCapacity, uint32_t indexCapacity)
+	{
+		GlState& state = GlState::Instance();
+		const GLuint oldVertexArray = vertexArray;
+		const GLuint oldVertexBuffer = vertexBuffer;
+		const GLuint oldIndexBuffer = indexBuffer;
+
+		CreateBuffers(vertexCapacity, indexCapacity);
+		vertices.Reset(vertexCapacity);
+		indices.Reset(indexCapacity);
+
+		//Packed in their current order, meshes added together stay together.
+		std::vector<Entry*> live;
+		for (auto& mesh : meshes)
+		{
+			live.push_back(&mesh.second);
+		}
+		std::sort(live.begin(), live.end(), [](const Entry* a, const Entry* b) { return a->range.baseVertex < b->range.baseVertex; });
+
+		if (oldVertexBuffer)
+		{
+			//Copies stay on the GPU, the new buffers are separate so ranges never overlap.
+			for (Entry* entry : live)
+			{
+				MeshRange& range = entry->range;
+				const uint32_t baseVertex = vertices.Allocate(range.vertexCount);
+				const uint32_t firstIndex = indices.Allocate(range.indexCount);
+
+				state.BindBuffer(GL_COPY_READ_BUFFER, oldVertexBuffer);
+				state.BindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GLintptr(size_t(range.baseVertex) * sizeof(Vertex)),
+					GLintptr(size_t(baseVertex) * sizeof(Vertex)), GLsizeiptr(size_t(range.vertexCount) * sizeof(Vertex)));
+				state.BindBuffer(GL_COPY_READ_BUFFER, oldIndexBuffer);
+				state.BindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GLintptr(size_t(range.firstIndex) * sizeof(uint32_t)),
+					GLintptr(size_t(firstIndex) * sizeof(uint32_t)), GLsizeiptr(size_t(range.indexCount) * sizeof(uint32_t)));
+
+				range.baseVertex = baseVertex;
+				range.firstIndex = firstIndex;
+			}
+
+			state.ForgetVertexArray(oldVertexArray);
+			glDeleteVertexArrays(1, &oldVertexArray);
+			for (GLuint buffer : { oldVertexBuffer, oldIndexBuffer })
+			{
+				state.ForgetBuffer(buffer);
+				glDeleteBuffers(1, &buffer);
+			}
+			repacks++;
+		}
+	}
+
+	bool MeshPool::Reserve(uint32_t vertexCount, uint32_t indexCount, MeshRange& range)
+	{
+		range.vertexCount = vertexCount;
+		range.indexCount = indexCount;
+		range.baseVertex = vertices.Allocate(vertexCount);
+		range.firstIndex = indices.Allocate(indexCount);
+		if (range.baseVertex != RangeAllocator::INVALID_OFFSET && range.firstIndex != RangeAllocator::INVALID_OFFSET)
+		{
+			return true;
+		}
+		if (range.baseVertex != RangeAllocator::INVALID_OFFSET)
+		{
+			vertices.Free(range.baseVertex, vertexCount);
+		}
+		if (range.firstIndex != RangeAllocator::INVALID_OFFSET)
+		{
+			indices.Free(range.firstIndex, indexCount);
+		}
+
+		//Enough room in total means it's fragmented: packing closes the holes. Otherwise it grows too.
+		Collect();
+		const uint32_t usedVertices = vertices.GetCapacity() - vertices.GetFreeSpace();
+		const uint32_t usedIndices = indices.GetCapacity() - indices.GetFreeSpace();
+		const uint32_t vertexCapacity = vertices.GetFreeSpace() >= vertexCount ? vertices.GetCapacity()
+			: std::max(vertices.GetCapacity() * 2, usedVertices + vertexCount);
+		const uint32_t indexCapacity = indices.GetFreeSpace() >= indexCount ? indices.GetCapacity()
+			: std::max(indices.GetCapacity() * 2, usedIndices + indexCount);
+		Repack(vertexCapacity, indexCapacity);
+
+		range.baseVertex = vertices.Allocate(vertexCount);
+		range.firstIndex = indices.Allocate(indexCount);
+		return range.baseVertex != RangeAllocator::INVALID_OFFSET && range.firstIndex != RangeAllocator::INVALID_OFFSET;
+	}
+
+	bool MeshPool::Add(const std::shared_ptr<glt::Drawable>& drawable)
+	{
+		auto it = meshes.find(drawable.get());
+		if (it != meshes.end())
+		{
+			if (!it->second.drawable.expired())
+			{
+				return true;
+			}
+			//A new mesh got the address of a dead one.
+			Remove(drawable.get());
+		}
+
+		const glt::Mesh* mesh = dynamic_cast<const glt::Mesh*>(drawable.get());
+		MeshGeometry geometry;
+		if (!IsReady() || !mesh || !StaticBatcher::ReadGeometry(*mesh, geometry))
+		{
+			return false;
+		}
+
+		std::vector<Vertex> meshVertices(geometry.positions.size());
+		for (size_t i = 0; i < meshVertices.size(); i++)
+		{
+			meshVertices[i].position = geometry.positions[i];
+			meshVertices[i].normal = geometry.normals[i];
+			meshVertices[i].textureCoordinates = geometry.textureCoordinates.empty() ? glm::vec2(0, 0) : geometry.textureCoordinates[i];
+		}
+
+		MeshRange range;
+		if (!Reserve(uint32_t(meshVertices.size()), uint32_t(geometry.indices.size()), range))
+		{
+			return false;
+		}
+
+		//Written through the copy target: binding the element array would change the bound vertex array.
+		GlState& state = GlState::Instance();
+		state.BindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(size_t(range.baseVertex) * sizeof(Vertex)),
+			GLsizeiptr(meshVertices.size() * sizeof(Vertex)), meshVertices.data());
+		state.BindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(size_t(range.firstIndex) * sizeof(uint32_t)),
+			GLsizeiptr(geometry.indices.size() * sizeof(uint32_t)), geometry.indices.data());
+
+		meshes[drawable.get()] = { drawable, range };
+		return true;
+	}
+
+	bool MeshPool::Find(const glt::Drawable* drawable, MeshRange& range) const
+	{
+		auto it = meshes.find(drawable);
+		//A dead mesh's range until Collect(), whatever now lives at its address.
+		if (it == meshes.end() || it->second.drawable.expired())
+		{
+			return false;
+		}
+		range = it->second.range;
+		return true;
+	}
+
+	void MeshPool::Remove(const glt::Drawable* drawable)
+	{
+		auto it = meshes.find(drawable);
+		if (it == meshes.end())
+		{
+			return;
+		}
+		vertices.Free(it->second.range.baseVertex, it->second.range.vertexCount);
+		indices.Free(it->second.range.firstIndex, it->second.range.indexCount);
+		meshes.erase(it);
+	}
+
+	void MeshPool::Collect()
+	{
+		for (auto it = meshes.begin(); it != meshes.end();)
+		{
+			if (it->second.drawable.expired())
+			{
+				vertices.Free(it->second.range.baseVertex, it->second.range.vertexCount);
+				indices.Free(it->second.range.firstIndex, it->second.range.indexCount);
+				it = meshes.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	void MeshPool::Defragment()
+	{
+		Collect();
+		if (!vertices.IsPacked() || !indices.IsPacked())
+		{
+			Repack(vertices.GetCapacity(), indices.GetCapacity());
+		}
+	}
+
+	void MeshPool::Bind() const
+	{
+		GlState::Instance().BindVertexArray(vertexArray);
+	}
+
+	void MeshPool::Draw(const MeshRange& range) const
+	{
+		glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(range.indexCount), GL_UNSIGNED_INT,
+			(const void*)(size_t(range.firstIndex) * sizeof(uint32_t)), GLint(range.baseVertex));
+	}
+
+	MeshPoolStats MeshPool::GetStats() const
+	{
+		MeshPoolStats stats;
+		stats.meshes = meshes.size();
+		stats.vertexCapacity = vertices.GetCapacity();
+		stats.freeVertices = vertices.GetFreeSpace();
+		stats.indexCapacity = indices.GetCapacity();
+		stats.freeIndices = indices.GetFreeSpace();
+		stats.repacks = repacks;
+		return stats;
+	}
+}
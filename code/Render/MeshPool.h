@@ -0,0 +1,144 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <gltk/OpenGL.hpp>
+#include <gltk/Drawable.hpp>
+#include <Render/RangeAllocator.h>
+#include <Render/StaticBatcher.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Where a mesh lives in the pool. Indices count from baseVertex.
+	/// </summary>
+	struct MeshRange
+	{
+		uint32_t baseVertex;
+		uint32_t vertexCount;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	struct MeshPoolStats
+	{
+		size_t meshes = 0;
+		uint32_t vertexCapacity = 0;
+		uint32_t freeVertices = 0;
+		uint32_t indexCapacity = 0;
+		uint32_t freeIndices = 0;
+		/// <summary>
+		/// Times the live meshes were packed into new buffers, to grow or defragment them.
+		/// </summary>
+		unsigned repacks = 0;
+	};
+
+	/// <summary>
+	/// Shared vertex and index buffers for every mesh of the same vertex format (position, normal and
+	/// texture coordinates, as floats). Meshes get ranges of them from a free list, and are drawn with
+	/// glDrawElementsBaseVertex through the pool's single vertex array: drawing a different mesh no
+	/// longer switches vertex arrays.
+	///
+	/// The toolkit's meshes are copied in by reading their buffers back (see StaticBatcher::ReadGeometry()).
+	/// The pool only keeps weak references: Collect() frees the ranges of the meshes nobody draws anymore,
+	/// and the holes left are packed away when an allocation doesn't fit in any of them.
+	/// </summary>
+	class MeshPool
+	{
+	private:
+		struct Vertex
+		{
+			glm::vec3 position;
+			glm::vec3 normal;
+			glm::vec2 textureCoordinates;
+		};
+
+		struct Entry
+		{
+			std::weak_ptr<glt::Drawable> drawable;
+			MeshRange range;
+		};
+
+		std::unordered_map<const glt::Drawable*, Entry> meshes;
+
+		RangeAllocator vertices;
+		RangeAllocator indices;
+
+		GLuint vertexArray = 0;
+		GLuint vertexBuffer = 0;
+		GLuint indexBuffer = 0;
+
+		unsigned repacks = 0;
+
+		/// <summary>
+		/// Room for a mesh of this size, repacking the live meshes into new buffers (as big as needed)
+		/// when no hole fits it.
+		/// </summary>
+		bool Reserve(uint32_t vertexCount, uint32_t indexCount, MeshRange& range);
+
+		/// <summary>
+		/// Copies the live meshes one after the other into new buffers of the given capacities.
+		/// </summary>
+		void Repack(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+		/// <summary>
+		/// Creates the buffers and points the vertex array at them.
+		/// </summary>
+		void CreateBuffers(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+	public:
+		MeshPool() = default;
+		~MeshPool();
+
+		MeshPool(const MeshPool&) = delete;
+		MeshPool& operator = (const MeshPool&) = delete;
+
+		/// <summary>
+		/// Creates the buffers, in vertices and indices. They grow when they're full. Needs the GL context.
+		/// </summary>
+		bool Initialize(uint32_t vertexCapacity = 64 * 1024, uint32_t indexCapacity = 256 * 1024);
+		bool IsReady() const { return vertexArray != 0; }
+
+		/// <summary>
+		/// Copies the mesh into the pool, if it isn't already.
+		/// </summary>
+		/// <returns>false if its geometry can't be read, it's drawn as usual then</returns>
+		bool Add(const std::shared_ptr<glt::Drawable>& drawable);
+
+		/// <summary>
+		/// Range of a mesh of the pool.
+		/// </summary>
+		/// <returns>false if the mesh isn't in the pool, or died since it was added</returns>
+		bool Find(const glt::Drawable* drawable, MeshRange& range) const;
+
+		void Remove(const glt::Drawable* drawable);
+
+		/// <summary>
+		/// Frees the ranges of the meshes that were destroyed.
+		/// </summary>
+		void Collect();
+
+		/// <summary>
+		/// Packs the live meshes together, closing every hole.
+		/// </summary>
+		void Defragment();
+
+		/// <summary>
+		/// Binds the pool's vertex array. It's left bound, the render queue unbinds it at the end of the frame.
+		/// </summary>
+		void Bind() const;
+
+		/// <summary>
+		/// Draws the range, Bind() must have been called.
+		/// </summary>
+		void Draw(const MeshRange& range) const;
+
+		MeshPoolStats GetStats() const;
+	};
+}
@@ -0,0 +1,428 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/OcclusionCuller.h>
+#include <Jobs/JobSystem.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCCLUSION_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace engine
+{
+	namespace
+	{
+		/// <summary>
+		/// Vertices closer than this (clip w) are behind or too close to the camera to be projected.
+		/// </summary>
+		const float NEAR_W = 1e-3f;
+
+		/// <summary>
+		/// The deepest level the test walks down to has at most this many texels under the box.
+		/// </summary>
+		const int MAX_TEST_TEXELS = 64;
+
+		const uint32_t BOX_INDICES[36] = {
+			0, 1, 3, 0, 3, 2,	//-x
+			4, 6, 7, 4, 7, 5,	//+x
+			0, 4, 5, 0, 5, 1,	//-y
+			2, 3, 7, 2, 7, 6,	//+y
+			0, 2, 6, 0, 6, 4,	//-z
+			1, 5, 7, 1, 7, 3	//+z
+		};
+	}
+
+	OcclusionCuller::OcclusionCuller(int width, int height, int tileWidth, int tileHeight)
+		: width(width), height(height), tileWidth(tileWidth), tileHeight(tileHeight)
+	{
+		tileColumns = (width + tileWidth - 1) / tileWidth;
+		tileRows = (height + tileHeight - 1) / tileHeight;
+		tileBins.resize(size_t(tileColumns) * tileRows);
+		depth.assign(size_t(width) * height, 1.f);
+
+		for (int level = 1; ; level++)
+		{
+			const glm::ivec2 size = GetLevelSize(level);
+			maxLevels.emplace_back(size_t(size.x) * size.y, 1.f);
+			minLevels.emplace_back(size_t(size.x) * size.y, 1.f);
+			if (size.x == 1 && size.y == 1)
+			{
+				break;
+			}
+		}
+	}
+
+	void OcclusionCuller::Begin(const glm::mat4& viewProjection)
+	{
+		this->viewProjection = viewProjection;
+		triangles.clear();
+		occluderCount = 0;
+		for (auto& bin : tileBins)
+		{
+			bin.clear();
+		}
+		tested = 0;
+		occluded = 0;
+	}
+
+	void OcclusionCuller::AddOccluder(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, const glm::mat4& transform)
+	{
+		const glm::mat4 matrix = viewProjection * transform;
+
+		std::vector<glm::vec4> projected(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			projected[i] = matrix * glm::vec4(vertices[i], 1.f);
+		}
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			Triangle triangle;
+			triangle.occluder = occluderCount;
+			bool clipped = false;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const glm::vec4& clip = projected[indices[i + corner]];
+				//Not clipping against the near plane: losing an occluder is safe, a wrong one isn't.
+				if (clip.w < NEAR_W)
+				{
+					clipped = true;
+					break;
+				}
+				const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+				triangle.vertices[corner] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (0.5f - ndc.y * 0.5f) * height,
+					std::clamp(ndc.z * 0.5f + 0.5f, 0.f, 1.f));
+			}
+			if (clipped)
+			{
+				continue;
+			}
+
+			//Both windings are kept: a box seen from inside still hides what's out of it.
+			const glm::vec3& a = triangle.vertices[0];
+			const glm::vec3& b = triangle.vertices[1];
+			const glm::vec3& c = triangle.vertices[2];
+			const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			if (std::abs(area) < 1.f)
+			{
+				continue;
+			}
+			if (area < 0.f)
+			{
+				std::swap(triangle.vertices[1], triangle.vertices[2]);
+			}
+
+			const float minX = std::min({ a.x, b.x, c.x });
+			const float maxX = std::max({ a.x, b.x, c.x });
+			const float minY = std::min({ a.y, b.y, c.y });
+			const float maxY = std::max({ a.y, b.y, c.y });
+			if (maxX < 0.f || maxY < 0.f || minX >= width || minY >= height)
+			{
+				continue;
+			}
+
+			const uint32_t index = uint32_t(triangles.size());
+			triangles.push_back(triangle);
+
+			const int firstColumn = std::max(0, int(minX) / tileWidth);
+			const int lastColumn = std::min(tileColumns - 1, int(maxX) / tileWidth);
+			const int firstRow = std::max(0, int(minY) / tileHeight);
+			const int lastRow = std::min(tileRows - 1, int(maxY) / tileHeight);
+			for (int row = firstRow; row <= lastRow; row++)
+			{
+				for (int column = firstColumn; column <= lastColumn; column++)
+				{
+					tileBins[size_t(row) * tileColumns + column].push_back(index);
+				}
+			}
+		}
+		occluderCount++;
+	}
+
+	void OcclusionCuller::AddOccluder(const Aabb& localBounds, const glm::mat4& transform)
+	{
+		if (localBounds.IsEmpty() || localBounds.IsInfinite())
+		{
+			return;
+		}
+		std::vector<glm::vec3> corners(8);
+		for (int i = 0; i < 8; i++)
+		{
+			corners[i] = glm::vec3(i & 4 ? localBounds.max.x : localBounds.min.x,
+				i & 2 ? localBounds.max.y : localBounds.min.y,
+				i & 1 ? localBounds.max.z : localBounds.min.z);
+		}
+		AddOccluder(corners, std::vector<uint32_t>(BOX_INDICES, BOX_INDICES + 36), transform);
+	}
+
+	void OcclusionCuller::RasterizeTile(size_t tile)
+	{
+		const int tileX = int(tile % tileColumns) * tileWidth;
+		const int tileY = int(tile / tileColumns) * tileHeight;
+		const int tileRight = std::min(tileX + tileWidth, width);
+		const int tileBottom = std::min(tileY + tileHeight, height);
+
+		for (int y = tileY; y < tileBottom; y++)
+		{
+			std::fill(depth.begin() + size_t(y) * width + tileX, depth.begin() + size_t(y) * width + tileRight, 1.f);
+		}
+
+		//Nearest depth of the current occluder at each pixel corner of the tile, NO_DEPTH where it doesn't reach.
+		const float NO_DEPTH = 2.f;
+		const int cornerColumns = tileRight - tileX + 1;
+		thread_local std::vector<float> corners;
+		corners.resize(size_t(cornerColumns) * (tileBottom - tileY + 1));
+
+		const std::vector<uint32_t>& bin = tileBins[tile];
+		for (size_t first = 0, last = 0; first < bin.size(); first = last)
+		{
+			//Corners the occluder may reach in the tile.
+			const uint32_t occluder = triangles[bin[first]].occluder;
+			int minX = tileRight, maxX = tileX, minY = tileBottom, maxY = tileY;
+			for (last = first; last < bin.size() && triangles[bin[last]].occluder == occluder; last++)
+			{
+				const Triangle& triangle = triangles[bin[last]];
+				const glm::vec3& v0 = triangle.vertices[0];
+				const glm::vec3& v1 = triangle.vertices[1];
+				const glm::vec3& v2 = triangle.vertices[2];
+				minX = std::min(minX, std::max(tileX, int(std::ceil(std::min({ v0.x, v1.x, v2.x })))));
+				maxX = std::max(maxX, std::min(tileRight, int(std::floor(std::max({ v0.x, v1.x, v2.x })))));
+				minY = std::min(minY, std::max(tileY, int(std::ceil(std::min({ v0.y, v1.y, v2.y })))));
+				maxY = std::max(maxY, std::min(tileBottom, int(std::floor(std::max({ v0.y, v1.y, v2.y })))));
+			}
+			//Not a single pixel with its four corners in.
+			if (maxX - minX < 1 || maxY - minY < 1)
+			{
+				continue;
+			}
+			for (int y = minY; y <= maxY; y++)
+			{
+				float* cornerRow = corners.data() + size_t(y - tileY) * cornerColumns - tileX;
+				std::fill(cornerRow + minX, cornerRow + maxX + 1, NO_DEPTH);
+			}
+
+			for (size_t i = first; i < last; i++)
+			{
+				const Triangle& triangle = triangles[bin[i]];
+				const glm::vec3& v0 = triangle.vertices[0];
+				const glm::vec3& v1 = triangle.vertices[1];
+				const glm::vec3& v2 = triangle.vertices[2];
+
+				//Edge functions, positive inside: e(x, y) = a * x + b * y + c. Corners on an edge are in:
+				//the edge between two triangles is the same one negated, so no corner falls between them.
+				float a[3], b[3], c[3];
+				const glm::vec3* edges[3][2] = { { &v1, &v2 }, { &v2, &v0 }, { &v0, &v1 } };
+				for (int e = 0; e < 3; e++)
+				{
+					const glm::vec3& from = *edges[e][0];
+					const glm::vec3& to = *edges[e][1];
+					a[e] = from.y - to.y;
+					b[e] = to.x - from.x;
+					c[e] = from.x * to.y - from.y * to.x;
+				}
+
+				//Depth is affine in screen space: z = zx * x + zy * y + z0.
+				const float area = a[0] * v0.x + b[0] * v0.y + c[0];
+				const float zx = (a[0] * v0.z + a[1] * v1.z + a[2] * v2.z) / area;
+				const float zy = (b[0] * v0.z + b[1] * v1.z + b[2] * v2.z) / area;
+				const float z0 = v0.z - zx * v0.x - zy * v0.y;
+
+				const int firstX = std::max(minX, int(std::ceil(std::min({ v0.x, v1.x, v2.x }))));
+				const int lastX = std::min(maxX, int(std::floor(std::max({ v0.x, v1.x, v2.x }))));
+				const int firstY = std::max(minY, int(std::ceil(std::min({ v0.y, v1.y, v2.y }))));
+				const int lastY = std::min(maxY, int(std::floor(std::max({ v0.y, v1.y, v2.y }))));
+
+				for (int y = firstY; y <= lastY; y++)
+				{
+					const float cornerY = float(y);
+					float* cornerRow = corners.data() + size_t(y - tileY) * cornerColumns - tileX;
+					int x = firstX;
+#ifdef OCCLUSION_CULLER_SSE
+					const __m128 offsets = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+					const __m128 zero = _mm_setzero_ps();
+					for (; x + 3 <= lastX; x += 4)
+					{
+						const __m128 cornerX = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+						__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+						for (int e = 0; e < 3; e++)
+						{
+							const __m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[e]), cornerX), _mm_set1_ps(b[e] * cornerY + c[e]));
+							inside = _mm_and_ps(inside, _mm_cmpge_ps(value, zero));
+						}
+						if (_mm_movemask_ps(inside) == 0)
+						{
+							continue;
+						}
+						const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zx), cornerX), _mm_set1_ps(zy * cornerY + z0));
+						const __m128 current = _mm_loadu_ps(cornerRow + x);
+						const __m128 nearer = _mm_min_ps(current, z);
+						_mm_storeu_ps(cornerRow + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+					}
+#endif
+					for (; x <= lastX; x++)
+					{
+						const float cornerX = float(x);
+						if (a[0] * cornerX + b[0] * cornerY + c[0] >= 0.f
+							&& a[1] * cornerX + b[1] * cornerY + c[1] >= 0.f
+							&& a[2] * cornerX + b[2] * cornerY + c[2] >= 0.f)
+						{
+							cornerRow[x] = std::min(cornerRow[x], zx * cornerX + zy * cornerY + z0);
+						}
+					}
+				}
+			}
+
+			//Depth is affine over each triangle, so the farthest the occluder gets in a pixel it covers whole is
+			//at a corner.
+			for (int y = minY; y < maxY; y++)
+			{
+				const float* top = corners.data() + size_t(y - tileY) * cornerColumns - tileX;
+				const float* bottom = top + cornerColumns;
+				float* row = depth.data() + size_t(y) * width;
+				for (int x = minX; x < maxX; x++)
+				{
+					const float farthest = std::max(std::max(top[x], top[x + 1]), std::max(bottom[x], bottom[x + 1]));
+					if (farthest < NO_DEPTH)
+					{
+						row[x] = std::min(row[x], farthest);
+					}
+				}
+			}
+		}
+	}
+
+	void OcclusionCuller::BuildPyramid()
+	{
+		const float* previousMax = depth.data();
+		const float* previousMin = depth.data();
+		glm::ivec2 previousSize(width, height);
+
+		for (size_t level = 0; level < maxLevels.size(); level++)
+		{
+			const glm::ivec2 size = GetLevelSize(int(level) + 1);
+			float* levelMax = maxLevels[level].data();
+			float* levelMin = minLevels[level].data();
+			for (int y = 0; y < size.y; y++)
+			{
+				const int y0 = std::min(y * 2, previousSize.y - 1);
+				const int y1 = std::min(y * 2 + 1, previousSize.y - 1);
+				for (int x = 0; x < size.x; x++)
+				{
+					const int x0 = std::min(x * 2, previousSize.x - 1);
+					const int x1 = std::min(x * 2 + 1, previousSize.x - 1);
+					levelMax[y * size.x + x] = std::max(
+						std::max(previousMax[y0 * previousSize.x + x0], previousMax[y0 * previousSize.x + x1]),
+						std::max(previousMax[y1 * previousSize.x + x0], previousMax[y1 * previousSize.x + x1]));
+					levelMin[y * size.x + x] = std::min(
+						std::min(previousMin[y0 * previousSize.x + x0], previousMin[y0 * previousSize.x + x1]),
+						std::min(previousMin[y1 * previousSize.x + x0], previousMin[y1 * previousSize.x + x1]));
+				}
+			}
+			previousMax = levelMax;
+			previousMin = levelMin;
+			previousSize = size;
+		}
+	}
+
+	void OcclusionCuller::Rasterize()
+	{
+		JobSystem::Instance().ParallelFor(tileBins.size(), 1, [this](size_t begin, size_t end)
+			{
+				for (size_t tile = begin; tile < end; tile++)
+				{
+					RasterizeTile(tile);
+				}
+			});
+		BuildPyramid();
+	}
+
+	bool OcclusionCuller::IsVisible(const Aabb& worldBounds)
+	{
+		tested++;
+		if (worldBounds.IsEmpty() || worldBounds.IsInfinite())
+		{
+			return true;
+		}
+
+		//Screen rectangle and nearest depth of the box.
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = FLT_MAX;
+		for (int i = 0; i < 8; i++)
+		{
+			const glm::vec4 clip = viewProjection * glm::vec4(i & 4 ? worldBounds.max.x : worldBounds.min.x,
+				i & 2 ? worldBounds.max.y : worldBounds.min.y, i & 1 ? worldBounds.max.z : worldBounds.min.z, 1.f);
+			if (clip.w < NEAR_W)
+			{
+				return true;
+			}
+			const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			const float x = (ndc.x * 0.5f + 0.5f) * width;
+			const float y = (0.5f - ndc.y * 0.5f) * height;
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+			nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+		}
+
+		const int left = std::max(0, int(std::floor(minX)));
+		const int right = std::min(width - 1, int(std::floor(maxX)));
+		const int top = std::max(0, int(std::floor(minY)));
+		const int bottom = std::min(height - 1, int(std::floor(maxY)));
+		if (left > right || top > bottom)
+		{
+			//Off screen: the frustum test is the one that decides.
+			return true;
+		}
+
+		//Starts where the box covers about 2x2 texels and walks down while it can't decide.
+		const int size = std::max(right - left, bottom - top) + 1;
+		int level = 0;
+		while ((size >> level) > 2 && level < int(maxLevels.size()))
+		{
+			level++;
+		}
+
+		for (; level >= 0; level--)
+		{
+			const float* levelMax = level == 0 ? depth.data() : maxLevels[level - 1].data();
+			const float* levelMin = level == 0 ? depth.data() : minLevels[level - 1].data();
+			const glm::ivec2 levelSize = GetLevelSize(level);
+			const int x0 = std::min(left >> level, levelSize.x - 1);
+			const int x1 = std::min(right >> level, levelSize.x - 1);
+			const int y0 = std::min(top >> level, levelSize.y - 1);
+			const int y1 = std::min(bottom >> level, levelSize.y - 1);
+
+			float farthest = 0.f;
+			float closest = 1.f;
+			for (int y = y0; y <= y1; y++)
+			{
+				for (int x = x0; x <= x1; x++)
+				{
+					farthest = std::max(farthest, levelMax[y * levelSize.x + x]);
+					closest = std::min(closest, levelMin[y * levelSize.x + x]);
+				}
+			}
+
+			if (nearest > farthest)
+			{
+				occluded++;
+				return false;
+			}
+			//In front of every occluder under it: finer levels won't say otherwise.
+			if (nearest <= closest)
+			{
+				return true;
+			}
+			if (level > 0 && (x1 - x0 + 1) * (y1 - y0 + 1) * 4 > MAX_TEST_TEXELS)
+			{
+				return true;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <Render/Bounds.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Software occlusion culling. Occluders (big solid meshes: walls, floors) are rasterized into a
+	/// small CPU depth buffer, and a min/max depth pyramid built from it tells whether an object's
+	/// bounds are behind them.
+	///
+	/// The buffer is split in tiles rasterized in parallel on the JobSystem, four pixels at a time with
+	/// SIMD. An occluder writes only the pixels it covers whole, all four corners inside its triangles, at
+	/// the farthest depth it reaches at those corners: a gap thinner than a pixel, between two occluders or
+	/// along their outline, is left open, and what an occluder hides is never pushed further away than it is.
+	/// Each occluder is sampled on its own, so the edges between its triangles don't open cracks.
+	/// </summary>
+	class OcclusionCuller
+	{
+	private:
+		struct Triangle
+		{
+			//Screen space x, y and depth (0 near, 1 far) of the three corners.
+			glm::vec3 vertices[3];
+			//Triangles of an occluder are consecutive, in the list and in every bin.
+			uint32_t occluder;
+		};
+
+		int width;
+		int height;
+		int tileWidth;
+		int tileHeight;
+		int tileColumns;
+		int tileRows;
+
+		glm::mat4 viewProjection = glm::mat4(1);
+
+		std::vector<Triangle> triangles;
+		uint32_t occluderCount = 0;
+		/// <summary>
+		/// Triangles overlapping each tile.
+		/// </summary>
+		std::vector<std::vector<uint32_t>> tileBins;
+
+		std::vector<float> depth;
+		/// <summary>
+		/// Level n is (width >> n) x (height >> n). Level 0 is the depth buffer itself.
+		/// </summary>
+		std::vector<std::vector<float>> maxLevels;
+		std::vector<std::vector<float>> minLevels;
+
+		unsigned tested = 0;
+		unsigned occluded = 0;
+
+		void RasterizeTile(size_t tile);
+		void BuildPyramid();
+		glm::ivec2 GetLevelSize(int level) const { return glm::ivec2(std::max(width >> level, 1), std::max(height >> level, 1)); }
+
+	public:
+		/// <param name="width">Depth buffer width in pixels. A few hundred is plenty: occluders are big.</param>
+		OcclusionCuller(int width = 256, int height = 128, int tileWidth = 64, int tileHeight = 32);
+
+		/// <summary>
+		/// Clears the depth buffer and forgets the occluders of the previous frame.
+		/// </summary>
+		void Begin(const glm::mat4& viewProjection);
+
+		/// <summary>
+		/// Queues a solid mesh, given as triangles in its own space.
+		/// </summary>
+		void AddOccluder(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, const glm::mat4& transform);
+
+		/// <summary>
+		/// Queues a solid box. Only for meshes that fill their bounds (cubes, walls).
+		/// </summary>
+		void AddOccluder(const Aabb& localBounds, const glm::mat4& transform);
+
+		/// <summary>
+		/// Rasterizes the occluders and builds the depth pyramid. Must be called before IsVisible().
+		/// </summary>
+		void Rasterize();
+
+		/// <summary>
+		/// False if the box is behind the occluders for sure.
+		/// </summary>
+		bool IsVisible(const Aabb& worldBounds);
+
+		size_t GetOccluderTriangleCount() const { return triangles.size(); }
+		/// <summary>
+		/// Boxes tested and rejected since the last Begin().
+		/// </summary>
+		unsigned GetTestedCount() const { return tested; }
+		unsigned GetOccludedCount() const { return occluded; }
+
+		/// <summary>
+		/// Depth buffer of the last Rasterize(), for debugging.
+		/// </summary>
+		const std::vector<float>& GetDepthBuffer() const { return depth; }
+		int GetWidth() const { return width; }
+		int GetHeight() const { return height; }
+	};
+}
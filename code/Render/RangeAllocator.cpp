@@ -0,0 +1,104 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/RangeAllocator.h>
+#include <iterator>
+
+namespace engine
+{
+	void RangeAllocator::AddBlock(uint32_t offset, uint32_t size)
+	{
+		blocksByOffset.emplace(offset, size);
+		blocksBySize.emplace(size, offset);
+	}
+
+	void RangeAllocator::RemoveBlock(std::map<uint32_t, uint32_t>::iterator block)
+	{
+		auto sizes = blocksBySize.equal_range(block->second);
+		for (auto it = sizes.first; it != sizes.second; ++it)
+		{
+			if (it->second == block->first)
+			{
+				blocksBySize.erase(it);
+				break;
+			}
+		}
+		blocksByOffset.erase(block);
+	}
+
+	void RangeAllocator::Reset(uint32_t newCapacity)
+	{
+		capacity = newCapacity;
+		freeSpace = newCapacity;
+		blocksByOffset.clear();
+		blocksBySize.clear();
+		if (newCapacity > 0)
+		{
+			AddBlock(0, newCapacity);
+		}
+	}
+
+	uint32_t RangeAllocator::Allocate(uint32_t size)
+	{
+		if (size == 0)
+		{
+			return INVALID_OFFSET;
+		}
+		auto fit = blocksBySize.lower_bound(size);
+		if (fit == blocksBySize.end())
+		{
+			return INVALID_OFFSET;
+		}
+
+		const uint32_t offset = fit->second;
+		const uint32_t blockSize = fit->first;
+		RemoveBlock(blocksByOffset.find(offset));
+		if (blockSize > size)
+		{
+			AddBlock(offset + size, blockSize - size);
+		}
+		freeSpace -= size;
+		return offset;
+	}
+
+	void RangeAllocator::Free(uint32_t offset, uint32_t size)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+		freeSpace += size;
+
+		//Merged with the free block right after and the one right before, if they touch it.
+		auto next = blocksByOffset.lower_bound(offset);
+		if (next != blocksByOffset.end() && next->first == offset + size)
+		{
+			size += next->second;
+			RemoveBlock(next);
+			next = blocksByOffset.lower_bound(offset);
+		}
+		if (next != blocksByOffset.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == offset)
+			{
+				offset = previous->first;
+				size += previous->second;
+				RemoveBlock(previous);
+			}
+		}
+		AddBlock(offset, size);
+	}
+
+	void RangeAllocator::Grow(uint32_t newCapacity)
+	{
+		if (newCapacity <= capacity)
+		{
+			return;
+		}
+		const uint32_t oldCapacity = capacity;
+		capacity = newCapacity;
+		Free(oldCapacity, newCapacity - oldCapacity);
+	}
+}
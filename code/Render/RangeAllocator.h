@@ -0,0 +1,66 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+namespace engine
+{
+	/// <summary>
+	/// Hands out ranges of a linear space (elements of a buffer) from a free list. The smallest free
+	/// block that fits is taken, and freed ranges are merged with their free neighbours, so the list only
+	/// holds the real holes.
+	///
+	/// It only does the bookkeeping: the owner of the memory moves the data when it defragments.
+	/// </summary>
+	class RangeAllocator
+	{
+	private:
+		uint32_t capacity = 0;
+		uint32_t freeSpace = 0;
+		/// <summary>
+		/// Free blocks by offset, to find the neighbours, and by size, to find the best fit.
+		/// </summary>
+		std::map<uint32_t, uint32_t> blocksByOffset;
+		std::multimap<uint32_t, uint32_t> blocksBySize;
+
+		void AddBlock(uint32_t offset, uint32_t size);
+		void RemoveBlock(std::map<uint32_t, uint32_t>::iterator block);
+
+	public:
+		static const uint32_t INVALID_OFFSET = ~0u;
+
+		RangeAllocator(uint32_t capacity = 0) { Reset(capacity); }
+
+		/// <summary>
+		/// Frees everything.
+		/// </summary>
+		void Reset(uint32_t capacity);
+
+		/// <returns>Offset of the range, INVALID_OFFSET if no free block is big enough</returns>
+		uint32_t Allocate(uint32_t size);
+		void Free(uint32_t offset, uint32_t size);
+
+		/// <summary>
+		/// Adds free space at the end.
+		/// </summary>
+		void Grow(uint32_t newCapacity);
+
+		uint32_t GetCapacity() const { return capacity; }
+		uint32_t GetFreeSpace() const { return freeSpace; }
+		uint32_t GetLargestFreeBlock() const { return blocksBySize.empty() ? 0 : blocksBySize.rbegin()->first; }
+		size_t GetFreeBlockCount() const { return blocksByOffset.size(); }
+
+		/// <summary>
+		/// No hole between the ranges in use: all the free space is at the end.
+		/// </summary>
+		bool IsPacked() const
+		{
+			return blocksByOffset.empty() || (blocksByOffset.size() == 1 && blocksByOffset.begin()->first + blocksByOffset.begin()->second == capacity);
+		}
+	};
+}
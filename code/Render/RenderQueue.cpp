@@ -0,0 +1,519 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/RenderQueue.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+
+namespace engine
+{
+	namespace
+	{
+		const unsigned SHADER_BITS = 12;
+		const unsigned MATERIAL_BITS = 16;
+		const unsigned MESH_BITS = 16;
+		const unsigned DEPTH_BITS = 16;
+
+		inline uint64_t Field(unsigned value, unsigned bits)
+		{
+			return uint64_t(value & ((1u << bits) - 1));
+		}
+
+		/// <summary>
+		/// Mesh field of a key, where MakeKey() puts it for the key's pass.
+		/// </summary>
+		inline uint64_t MeshField(uint64_t key, unsigned meshId)
+		{
+			return (key >> 60) == uint64_t(RenderPass::TRANSPARENT_PASS) ? Field(meshId, MESH_BITS) : Field(meshId, MESH_BITS) << 16;
+		}
+
+		/// <summary>
+		/// Distance along the view direction, scaled to the far plane. The translation is all the key needs.
+		/// </summary>
+		inline float ViewDepth(const glt::Matrix44& view, const glt::Matrix44& transform, float farPlane)
+		{
+			return -(view * transform[3]).z / farPlane;
+		}
+	}
+
+	uint64_t RenderQueue::MakeKey(RenderPass pass, unsigned shaderId, unsigned materialId, unsigned meshId, float depth)
+	{
+		const unsigned quantizedDepth = unsigned(std::clamp(depth, 0.f, 1.f) * ((1u << DEPTH_BITS) - 1));
+		const uint64_t passField = uint64_t(pass) << 60;
+
+		if (pass == RenderPass::TRANSPARENT_PASS)
+		{
+			//Farthest first.
+			const uint64_t reversedDepth = Field(~quantizedDepth, DEPTH_BITS);
+			return passField | reversedDepth << 44 | Field(shaderId, SHADER_BITS) << 32
+				| Field(materialId, MATERIAL_BITS) << 16 | Field(meshId, MESH_BITS);
+		}
+
+		return passField | Field(shaderId, SHADER_BITS) << 48 | Field(materialId, MATERIAL_BITS) << 32
+			| Field(meshId, MESH_BITS) << 16 | Field(quantizedDepth, DEPTH_BITS);
+	}
+
+	uint32_t RenderQueue::GetMeshId(const glt::Drawable* drawable)
+	{
+		auto it = meshIds.find(drawable);
+		if (it != meshIds.end())
+		{
+			return it->second;
+		}
+		//Ids only group the draws, a wrapped one costs state changes but never draws wrong.
+		const uint32_t id = uint32_t(meshIds.size());
+		meshIds.emplace(drawable, id);
+		return id;
+	}
+
+	const RenderQueue::ShaderUniforms& RenderQueue::GetUniforms(const glt::Shader_Program* shader)
+	{
+		auto it = shaderUniforms.find(shader);
+		if (it == shaderUniforms.end())
+		{
+			ShaderUniforms uniforms;
+			uniforms.modelView = shader->get_uniform_id("model_view_matrix");
+			uniforms.normal = shader->get_uniform_id("normal_matrix");
+			uniforms.projection = shader->get_uniform_id("projection_matrix");
+			it = shaderUniforms.emplace(shader, uniforms).first;
+		}
+		return it->second;
+	}
+
+	void RenderQueue::Begin(const glt::Camera& camera)
+	{
+		Begin(camera.get_inverse_total_transformation(), camera.get_projection_matrix(), camera.get_far());
+	}
+
+	void RenderQueue::Begin(const glt::Matrix44& view, const glt::Matrix44& projection, float farPlane)
+	{
+		packets.clear();
+		items.clear();
+		staticCells.clear();
+		meshIds.clear();
+		this->view = view;
+		this->projection = projection;
+		this->farPlane = farPlane > 0.f ? farPlane : 1.f;
+	}
+
+	void RenderQueue::Add(glt::Drawable* drawable, glt::Material* material, const glt::Matrix44& transform, RenderPass pass,
+		const glt::Vector4& color)
+	{
+		const float depth = ViewDepth(view, transform, farPlane);
+		const uint64_t key = MakeKey(pass, material->get_shader_program()->id(), material->id(), GetMeshId(drawable), depth);
+
+		items.push_back({ key, uint32_t(packets.size()) });
+		packets.push_back({ drawable, material, transform, color });
+	}
+
+	void RenderQueue::Add(const glt::Model& model, RenderPass pass, const glt::Vector4& color)
+	{
+		if (model.is_not_visible())
+		{
+			return;
+		}
+		const glt::Matrix44 transform = model.get_total_transformation();
+		for (const auto& piece : model.get_pieces())
+		{
+			Add(piece.drawable.get(), piece.material.get(), transform, pass, color);
+		}
+	}
+
+	void RenderQueue::Merge(const RenderCommandBuffer& buffer)
+	{
+		const uint32_t first = uint32_t(packets.size());
+		packets.insert(packets.end(), buffer.packets.begin(), buffer.packets.end());
+		items.reserve(items.size() + buffer.keys.size());
+		for (size_t i = 0; i < buffer.keys.size(); i++)
+		{
+			const uint64_t key = buffer.keys[i];
+			items.push_back({ key | MeshField(key, GetMeshId(buffer.packets[i].drawable)), first + uint32_t(i) });
+		}
+	}
+
+	void RenderCommandBuffer::Begin(const glt::Camera& camera)
+	{
+		Begin(camera.get_inverse_total_transformation(), camera.get_far());
+	}
+
+	void RenderCommandBuffer::Begin(const glt::Matrix44& view, float farPlane)
+	{
+		packets.clear();
+		keys.clear();
+		this->view = view;
+		this->farPlane = farPlane > 0.f ? farPlane : 1.f;
+	}
+
+	void RenderCommandBuffer::Add(glt::Drawable* drawable, glt::Material* material, const glt::Matrix44& transform, RenderPass pass,
+		const glt::Vector4& color)
+	{
+		const float depth = ViewDepth(view, transform, farPlane);
+		keys.push_back(RenderQueue::MakeKey(pass, material->get_shader_program()->id(), material->id(), 0, depth));
+		packets.push_back({ drawable, material, transform, color });
+	}
+
+	void RenderCommandBuffer::Add(const glt::Model& model, RenderPass pass, const glt::Vector4& color)
+	{
+		if (model.is_not_visible())
+		{
+			return;
+		}
+		Add(model, model.get_total_transformation(), pass, color);
+	}
+
+	void RenderCommandBuffer::Add(const glt::Model& model, const glt::Matrix44& transform, RenderPass pass, const glt::Vector4& color)
+	{
+		for (const auto& piece : model.get_pieces())
+		{
+			Add(piece.drawable.get(), piece.material.get(), transform, pass, color);
+		}
+	}
+
+	void RenderQueue::RadixSort()
+	{
+		const size_t count = items.size();
+		sortScratch.resize(count);
+
+		//One pass over the keys counts all eight bytes.
+		size_t histograms[8][256] = {};
+		for (const SortItem& item : items)
+		{
+			for (unsigned byte = 0; byte < 8; byte++)
+			{
+				histograms[byte][(item.key >> (byte * 8)) & 0xFF]++;
+			}
+		}
+
+		SortItem* source = items.data();
+		SortItem* destination = sortScratch.data();
+		for (unsigned byte = 0; byte < 8; byte++)
+		{
+			size_t* histogram = histograms[byte];
+
+			//Every key has the same value in this byte (unused id ranges, single pass): nothing to move.
+			if (histogram[(source[0].key >> (byte * 8)) & 0xFF] == count)
+			{
+				continue;
+			}
+
+			size_t offset = 0;
+			for (unsigned bucket = 0; bucket < 256; bucket++)
+			{
+				const size_t bucketSize = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketSize;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				destination[histogram[(source[i].key >> (byte * 8)) & 0xFF]++] = source[i];
+			}
+			std::swap(source, destination);
+		}
+
+		if (source != items.data())
+		{
+			items.swap(sortScratch);
+		}
+	}
+
+	void RenderQueue::Sort()
+	{
+		if (items.size() < 2)
+		{
+			return;
+		}
+		//Below a few dozen draws the histograms cost more than they save.
+		if (items.size() < 64)
+		{
+			std::stable_sort(items.begin(), items.end(), [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+			return;
+		}
+		RadixSort();
+	}
+
+	size_t RenderQueue::GetInstanceRun(size_t first) const
+	{
+		const DrawPacket& packet = packets[items[first].packet];
+		if (!instancedRenderer || !uniformBlocks || (items[first].key >> 60) != uint64_t(RenderPass::OPAQUE_PASS)
+			|| instancedMaterials.find(packet.material) == instancedMaterials.end()
+			|| !dynamic_cast<const glt::Mesh*>(packet.drawable))
+		{
+			return 1;
+		}
+
+		//Same mesh and material means consecutive keys, only the depth bits differ.
+		size_t last = first + 1;
+		while (last < items.size())
+		{
+			const DrawPacket& next = packets[items[last].packet];
+			if (next.drawable != packet.drawable || next.material != packet.material || (items[last].key >> 60) != (items[first].key >> 60))
+			{
+				break;
+			}
+			last++;
+		}
+
+		return last - first < minimumInstances ? 1 : last - first;
+	}
+
+	void RenderQueue::EnableInstancing(const glt::Material* material, const MaterialBlock& block)
+	{
+		if (!uniformBlocks)
+		{
+			spdlog::error("Instancing needs the uniform blocks, material \"" + material->get_name() + "\" won't be instanced");
+			return;
+		}
+		auto it = instancedMaterials.find(material);
+		if (it != instancedMaterials.end())
+		{
+			uniformBlocks->SetMaterial(it->second, block);
+		}
+		else
+		{
+			instancedMaterials.emplace(material, uniformBlocks->AddMaterial(block));
+		}
+	}
+
+	void RenderQueue::SubmitInstanced(size_t first, size_t count)
+	{
+		instanceScratch.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			const DrawPacket& packet = packets[items[first + i].packet];
+			instanceScratch[i] = { packet.transform, packet.color };
+		}
+
+		const DrawPacket& packet = packets[items[first].packet];
+		//Camera and lights are in the frame block already, only the material range changes.
+		uniformBlocks->BindMaterial(instancedMaterials.find(packet.material)->second);
+		instancedRenderer->Begin();
+		MeshRange range;
+		if (meshPool && meshPool->Find(packet.drawable, range))
+		{
+			instancedRenderer->Draw(*meshPool, range, instanceScratch.data(), count);
+		}
+		else
+		{
+			instancedRenderer->Draw(*static_cast<const glt::Mesh*>(packet.drawable), instanceScratch.data(), count);
+		}
+		shaderChanges++;
+		drawCalls++;
+	}
+
+	size_t RenderQueue::GetMultiDrawRun(size_t first) const
+	{
+		MeshRange range;
+		const DrawPacket& packet = packets[items[first].packet];
+		if (!multiDraw || !meshPool || !instancedRenderer || !uniformBlocks || (items[first].key >> 60) != uint64_t(RenderPass::OPAQUE_PASS)
+			|| instancedMaterials.find(packet.material) == instancedMaterials.end() || !meshPool->Find(packet.drawable, range))
+		{
+			return 1;
+		}
+
+		//Same material means consecutive keys, sorted by mesh within it.
+		size_t last = first + 1;
+		while (last < items.size())
+		{
+			const DrawPacket& next = packets[items[last].packet];
+			if (next.material != packet.material || (items[last].key >> 60) != (items[first].key >> 60)
+				|| (next.drawable != packets[items[last - 1].packet].drawable && !meshPool->Find(next.drawable, range)))
+			{
+				break;
+			}
+			last++;
+		}
+
+		return last - first < minimumInstances ? 1 : last - first;
+	}
+
+	void RenderQueue::SubmitMultiDraw(size_t first, size_t count)
+	{
+		instanceScratch.resize(count);
+		multiDrawScratch.clear();
+		const glt::Drawable* drawable = nullptr;
+		for (size_t i = 0; i < count; i++)
+		{
+			const DrawPacket& packet = packets[items[first + i].packet];
+			instanceScratch[i] = { packet.transform, packet.color };
+
+			//A command per mesh, its instances are the run of packets drawing it.
+			if (packet.drawable != drawable)
+			{
+				drawable = packet.drawable;
+				MeshRange range;
+				meshPool->Find(drawable, range);
+				multiDrawScratch.push_back({ range.indexCount, 0, range.firstIndex, GLint(range.baseVertex), GLuint(i) });
+			}
+			multiDrawScratch.back().instanceCount++;
+		}
+
+		const DrawPacket& packet = packets[items[first].packet];
+		uniformBlocks->BindMaterial(instancedMaterials.find(packet.material)->second);
+		instancedRenderer->Begin();
+		drawCalls += instancedRenderer->DrawMulti(*meshPool, multiDrawScratch.data(), multiDrawScratch.size(), instanceScratch.data(), count);
+		multiDrawCommands += unsigned(multiDrawScratch.size());
+		shaderChanges++;
+	}
+
+	void RenderQueue::AddStaticCells(const StaticBatcher& batcher, const std::vector<unsigned>& cells)
+	{
+		staticBatcher = &batcher;
+		staticCells.insert(staticCells.end(), cells.begin(), cells.end());
+	}
+
+	void RenderQueue::SubmitStatic()
+	{
+		if (staticCells.empty() || !instancedRenderer || !uniformBlocks)
+		{
+			return;
+		}
+
+		ApplyPassState(RenderPass::OPAQUE_PASS);
+		instancedRenderer->Begin();
+		staticBatcher->Bind();
+		shaderChanges++;
+
+		//Cells are sorted by material, the material range only changes between runs.
+		const glt::Material* material = nullptr;
+		for (unsigned cell : staticCells)
+		{
+			const StaticBatchCell& batch = staticBatcher->GetCells()[cell];
+			auto slot = instancedMaterials.find(batch.material);
+			if (slot == instancedMaterials.end())
+			{
+				continue;
+			}
+			if (batch.material != material)
+			{
+				material = batch.material;
+				uniformBlocks->BindMaterial(slot->second);
+			}
+			staticBatcher->DrawCell(cell);
+			drawCalls++;
+		}
+	}
+
+	void RenderQueue::ApplyPassState(RenderPass pass)
+	{
+		GlState& state = GlState::Instance();
+		state.SetCapability(GL_DEPTH_TEST, pass != RenderPass::OVERLAY_PASS);
+		state.SetDepthWrite(pass == RenderPass::OPAQUE_PASS);
+		state.SetCapability(GL_BLEND, pass != RenderPass::OPAQUE_PASS);
+		if (pass != RenderPass::OPAQUE_PASS)
+		{
+			state.SetBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+	}
+
+	void RenderQueue::Submit(const std::vector<glt::Node*>& shaderListeners)
+	{
+		UniformBlocks::CollectLights(view, shaderListeners, lightScratch);
+		Submit(shaderListeners, lightScratch);
+	}
+
+	void RenderQueue::Submit(const std::vector<glt::Node*>& shaderListeners, const std::vector<FrameLight>& lights)
+	{
+		GlState& state = GlState::Instance();
+		shaderChanges = 0;
+		materialChanges = 0;
+		drawCalls = 0;
+		multiDrawCommands = 0;
+
+		const glt::Shader_Program* shader = nullptr;
+		const ShaderUniforms* uniforms = nullptr;
+		const glt::Material** material = nullptr;
+		//Material values may have changed since the last frame.
+		programMaterials.clear();
+		unsigned pass = ~0u;
+
+		if (uniformBlocks)
+		{
+			uniformBlocks->UpdateFrame(view, projection, lights);
+		}
+
+		//Static geometry is big and opaque, drawing it first lets it hide what's behind it early.
+		if (!staticCells.empty())
+		{
+			SubmitStatic();
+			pass = unsigned(RenderPass::OPAQUE_PASS);
+		}
+
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			const unsigned itemPass = unsigned(items[i].key >> 60);
+			if (itemPass != pass)
+			{
+				pass = itemPass;
+				ApplyPassState(RenderPass(pass));
+			}
+
+			const size_t multiDrawn = GetMultiDrawRun(i);
+			if (multiDrawn > 1)
+			{
+				SubmitMultiDraw(i, multiDrawn);
+				i += multiDrawn - 1;
+				shader = nullptr;
+				continue;
+			}
+
+			const size_t instances = GetInstanceRun(i);
+			if (instances > 1)
+			{
+				SubmitInstanced(i, instances);
+				i += instances - 1;
+				//The instanced shader is bound now.
+				shader = nullptr;
+				continue;
+			}
+
+			const DrawPacket& packet = packets[items[i].packet];
+
+			const glt::Shader_Program* packetShader = packet.material->get_shader_program();
+			if (packetShader != shader)
+			{
+				shader = packetShader;
+				shader->use();
+				uniforms = &GetUniforms(shader);
+				state.SetUniform(*shader, uniforms->projection, projection);
+				for (glt::Node* listener : shaderListeners)
+				{
+					listener->shader_changed(*shader);
+				}
+				//The toolkit binds on its own, the tracker can't tell what's bound after it.
+				state.Invalidate();
+				material = &programMaterials[shader];
+				shaderChanges++;
+			}
+			if (packet.material != *material)
+			{
+				*material = packet.material;
+				packet.material->use();
+				state.Invalidate();
+				materialChanges++;
+			}
+
+			const glt::Matrix44 modelView = view * packet.transform;
+			state.SetUniform(*shader, uniforms->modelView, modelView);
+			state.SetUniform(*shader, uniforms->normal, glt::transpose(glt::inverse(modelView)));
+			MeshRange range;
+			if (meshPool && meshPool->Find(packet.drawable, range))
+			{
+				meshPool->Bind();
+				meshPool->Draw(range);
+			}
+			else
+			{
+				packet.drawable->draw();
+				//Unbinds its vertex array behind the tracker's back.
+				state.Invalidate();
+			}
+			drawCalls++;
+		}
+
+		//Pooled and instanced draws leave their vertex array bound, a buffer created later would be recorded into it.
+		state.BindVertexArray(0);
+		//glClear() doesn't clear the depth buffer with writes disabled.
+		state.SetDepthWrite(true);
+	}
+}
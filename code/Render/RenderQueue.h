@@ -0,0 +1,300 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <gltk/Math.hpp>
+#include <gltk/Drawable.hpp>
+#include <gltk/Material.hpp>
+#include <gltk/Camera.hpp>
+#include <gltk/Model.hpp>
+#include <Render/GlState.h>
+#include <Render/InstancedRenderer.h>
+#include <Render/UniformBlocks.h>
+#include <Render/StaticBatcher.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Passes are drawn in this order. Opaque draws are sorted by state and then front to back,
+	/// transparent ones back to front.
+	/// </summary>
+	enum class RenderPass : uint8_t
+	{
+		OPAQUE_PASS = 0,
+		TRANSPARENT_PASS = 1,
+		OVERLAY_PASS = 2
+	};
+
+	/// <summary>
+	/// Everything needed to issue one draw.
+	/// </summary>
+	struct DrawPacket
+	{
+		glt::Drawable* drawable;
+		glt::Material* material;
+		glt::Matrix44 transform;
+		/// <summary>
+		/// Only read by the instanced path, the toolkit's materials have their own color.
+		/// </summary>
+		glt::Vector4 color;
+	};
+
+	/// <summary>
+	/// Draws recorded away from the GL thread, to be merged into a RenderQueue. Recording only reads the
+	/// models, materials and camera, and appends to the buffer's own arrays (kept between frames), so
+	/// several buffers can be filled at once by different threads.
+	///
+	/// The keys are complete but for the mesh field: mesh ids are the queue's, it adds them on Merge().
+	/// </summary>
+	class RenderCommandBuffer
+	{
+		friend class RenderQueue;
+	private:
+		std::vector<DrawPacket> packets;
+		/// <summary>
+		/// Sort key of every packet, mesh field left at 0.
+		/// </summary>
+		std::vector<uint64_t> keys;
+
+		glt::Matrix44 view = glt::Matrix44(1);
+		float farPlane = 1.f;
+
+	public:
+		/// <summary>
+		/// Forgets the previous frame's draws and takes the camera the next ones are seen from. Must be the
+		/// camera given to the queue.
+		/// </summary>
+		void Begin(const glt::Camera& camera);
+		void Begin(const glt::Matrix44& view, float farPlane);
+
+		/// <param name="transform">Model to world matrix</param>
+		void Add(glt::Drawable* drawable, glt::Material* material, const glt::Matrix44& transform, RenderPass pass = RenderPass::OPAQUE_PASS,
+			const glt::Vector4& color = glt::Vector4(1, 1, 1, 1));
+
+		/// <summary>
+		/// Records every piece of the model, unless it's hidden.
+		/// </summary>
+		void Add(const glt::Model& model, RenderPass pass = RenderPass::OPAQUE_PASS, const glt::Vector4& color = glt::Vector4(1, 1, 1, 1));
+
+		/// <summary>
+		/// Records every piece of the model with the given transform instead of its own (a copy taken
+		/// earlier), hidden or not.
+		/// </summary>
+		void Add(const glt::Model& model, const glt::Matrix44& transform, RenderPass pass = RenderPass::OPAQUE_PASS,
+			const glt::Vector4& color = glt::Vector4(1, 1, 1, 1));
+
+		size_t GetPacketCount() const { return packets.size(); }
+	};
+
+	/// <summary>
+	/// Flat replacement for glt::Render_Node's shader/material/node maps. The draws of the frame are
+	/// appended to a linear array with a 64-bit sort key each, radix sorted, and submitted in one walk
+	/// that only changes GL state when the shader or material of the key changes.
+	///
+	/// Opaque key, from the highest bit: pass (4) | shader (12) | material (16) | mesh (16) | depth (16).
+	/// Transparent keys move the depth (reversed) right after the pass, blending needs the order more
+	/// than the state.
+	///
+	/// With an InstancedRenderer, opaque runs of the same mesh and material are drawn with a single
+	/// instanced call, as long as the material was flagged with EnableInstancing().
+	///
+	/// Draws can also be recorded on other threads into RenderCommandBuffers and merged before Sort(): only
+	/// sorting and submission then happen on the GL thread.
+	/// </summary>
+	class RenderQueue
+	{
+	private:
+		struct SortItem
+		{
+			uint64_t key;
+			uint32_t packet;
+		};
+
+		/// <summary>
+		/// Uniforms the toolkit's shaders expect, looked up once per program.
+		/// </summary>
+		struct ShaderUniforms
+		{
+			GLint modelView;
+			GLint normal;
+			GLint projection;
+		};
+
+		std::vector<DrawPacket> packets;
+		std::vector<SortItem> items;
+		std::vector<SortItem> sortScratch;
+
+		/// <summary>
+		/// Drawables don't have an id of their own, so they get one the first time they're queued in a frame.
+		/// Ids only group the frame's draws: they're forgotten on Begin(), before any drawable can die and
+		/// leave its address to a new one.
+		/// </summary>
+		std::unordered_map<const glt::Drawable*, uint32_t> meshIds;
+		std::unordered_map<const glt::Shader_Program*, ShaderUniforms> shaderUniforms;
+		/// <summary>
+		/// Material whose values each program holds. Uniforms belong to the program, so switching
+		/// programs back and forth doesn't undo a material.
+		/// </summary>
+		std::unordered_map<const glt::Shader_Program*, const glt::Material*> programMaterials;
+
+		glt::Matrix44 view = glt::Matrix44(1);
+		glt::Matrix44 projection = glt::Matrix44(1);
+		float farPlane = 1.f;
+
+		UniformBlocks* uniformBlocks = nullptr;
+		InstancedRenderer* instancedRenderer = nullptr;
+		size_t minimumInstances = 4;
+		/// <summary>
+		/// Material block slot of every material that can be instanced.
+		/// </summary>
+		std::unordered_map<const glt::Material*, unsigned> instancedMaterials;
+		std::vector<InstanceData> instanceScratch;
+		std::vector<FrameLight> lightScratch;
+
+		const MeshPool* meshPool = nullptr;
+		bool multiDraw = false;
+		std::vector<MultiDrawCommand> multiDrawScratch;
+		unsigned multiDrawCommands = 0;
+
+		const StaticBatcher* staticBatcher = nullptr;
+		std::vector<unsigned> staticCells;
+
+		unsigned shaderChanges = 0;
+		unsigned materialChanges = 0;
+		unsigned drawCalls = 0;
+
+		uint32_t GetMeshId(const glt::Drawable* drawable);
+		const ShaderUniforms& GetUniforms(const glt::Shader_Program* shader);
+		void RadixSort();
+		/// <summary>
+		/// Depth and blend state of the pass. Only what differs from the current state reaches GL.
+		/// </summary>
+		static void ApplyPassState(RenderPass pass);
+
+		/// <summary>
+		/// Number of items from first on that can go in one instanced draw, 1 if they can't be instanced.
+		/// </summary>
+		size_t GetInstanceRun(size_t first) const;
+		void SubmitInstanced(size_t first, size_t count);
+		/// <summary>
+		/// Number of items from first on that can go in one multi-draw: same material, any pooled mesh.
+		/// 1 if they can't.
+		/// </summary>
+		size_t GetMultiDrawRun(size_t first) const;
+		void SubmitMultiDraw(size_t first, size_t count);
+		/// <summary>
+		/// Draws the static cells with the instanced shader.
+		/// </summary>
+		void SubmitStatic();
+
+	public:
+		static uint64_t MakeKey(RenderPass pass, unsigned shaderId, unsigned materialId, unsigned meshId, float depth);
+
+		/// <summary>
+		/// Forgets the previous frame's draws and takes the camera the next ones are seen from.
+		/// </summary>
+		void Begin(const glt::Camera& camera);
+		/// <param name="view">World to camera matrix</param>
+		void Begin(const glt::Matrix44& view, const glt::Matrix44& projection, float farPlane);
+
+		/// <param name="transform">Model to world matrix</param>
+		void Add(glt::Drawable* drawable, glt::Material* material, const glt::Matrix44& transform, RenderPass pass = RenderPass::OPAQUE_PASS,
+			const glt::Vector4& color = glt::Vector4(1, 1, 1, 1));
+
+		/// <summary>
+		/// Queues every piece of the model, unless it's hidden.
+		/// </summary>
+		void Add(const glt::Model& model, RenderPass pass = RenderPass::OPAQUE_PASS, const glt::Vector4& color = glt::Vector4(1, 1, 1, 1));
+
+		/// <summary>
+		/// Appends the draws recorded in buffer, after the ones already queued. Buffers merged in the order
+		/// they were filled give the same queue as adding their draws here. Call it on the GL thread, once
+		/// the recording threads are done.
+		/// </summary>
+		void Merge(const RenderCommandBuffer& buffer);
+
+		/// <summary>
+		/// Camera and lights are uploaded to the frame block once per Submit(). Needed by instancing.
+		/// </summary>
+		void SetUniformBlocks(UniformBlocks* blocks) { uniformBlocks = blocks; }
+
+		/// <summary>
+		/// Runs of at least minimumInstances draws sharing mesh and material will be instanced.
+		/// nullptr disables instancing.
+		/// </summary>
+		void SetInstancing(InstancedRenderer* renderer, size_t minimumInstances = 4)
+		{
+			instancedRenderer = renderer;
+			this->minimumInstances = minimumInstances < 2 ? 2 : minimumInstances;
+		}
+
+		/// <summary>
+		/// Draws with this material may be instanced. The instanced shader replaces the material's, with
+		/// block as its material and the packet color as the object color: only flag materials it can stand
+		/// in for. The uniform blocks must be set first.
+		/// </summary>
+		void EnableInstancing(const glt::Material* material, const MaterialBlock& block = MaterialBlock());
+
+		/// <summary>
+		/// Meshes found in the pool are drawn from its shared buffers instead of their own vertex arrays.
+		/// nullptr draws every mesh itself.
+		/// </summary>
+		void SetMeshPool(const MeshPool* pool) { meshPool = pool; }
+
+		/// <summary>
+		/// Opaque draws of an instanced material whose meshes are in the pool are gathered, whatever the
+		/// mesh, into one multi-draw per material: a command per mesh with its instances. Needs the pool
+		/// and instancing.
+		/// </summary>
+		void EnableMultiDraw(bool enable) { multiDraw = enable; }
+		/// <summary>
+		/// Whether draws with this material may be instanced (see EnableInstancing()).
+		/// </summary>
+		bool IsInstanced(const glt::Material* material) const { return instancedMaterials.find(material) != instancedMaterials.end(); }
+
+		/// <summary>
+		/// Cells of the static batches to draw this frame. They're drawn first, in the opaque pass and with
+		/// the instanced shader, so their materials must be instanced. Needs the instancing set up.
+		/// </summary>
+		void AddStaticCells(const StaticBatcher& batcher, const std::vector<unsigned>& cells);
+
+		/// <summary>
+		/// Orders the draws by key.
+		/// </summary>
+		void Sort();
+
+		/// <summary>
+		/// Draws everything in key order. shaderListeners (lights) are told every time a shader is bound,
+		/// as glt::Render_Node does, and lights go in the frame block. The engine's own GL state goes through
+		/// GlState, so binds and uniforms already set are skipped; the vertex array is unbound and depth
+		/// writes enabled again at the end.
+		/// </summary>
+		void Submit(const std::vector<glt::Node*>& shaderListeners, const std::vector<FrameLight>& lights);
+		/// <summary>
+		/// Same, with the frame block lights read from the listeners. Only where nothing else changes them.
+		/// </summary>
+		void Submit(const std::vector<glt::Node*>& shaderListeners);
+
+		size_t GetPacketCount() const { return packets.size(); }
+		/// <summary>
+		/// Program and material binds done by the last Submit(). Materials already held by their
+		/// program are not counted.
+		/// </summary>
+		unsigned GetShaderChangeCount() const { return shaderChanges; }
+		unsigned GetMaterialChangeCount() const { return materialChanges; }
+		/// <summary>
+		/// Draw calls issued by the last Submit(), instanced ones included.
+		/// </summary>
+		unsigned GetDrawCallCount() const { return drawCalls; }
+		/// <summary>
+		/// Mesh draws the last Submit() sent through multi-draws, each may have been a separate call
+		/// without glMultiDrawElementsIndirect.
+		/// </summary>
+		unsigned GetMultiDrawCommandCount() const { return multiDrawCommands; }
+	};
+}
@@ -0,0 +1,251 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/RenderResourceRegistry.h>
+#include <gltk/Cube.hpp>
+#include <gltk/Model_Obj.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+
+namespace engine
+{
+	namespace
+	{
+		/// <summary>
+		/// Coordinates, normals, texture coordinates and indices.
+		/// </summary>
+		const size_t CUBE_VERTEX_BUFFERS = 4;
+		/// <summary>
+		/// The toolkit's cube spans -1..1 on every axis.
+		/// </summary>
+		const Aabb CUBE_BOUNDS(glm::vec3(-1.f), glm::vec3(1.f));
+	}
+
+	void MaterialDescription::Set(const std::string& name, unsigned components, const glt::Vector4& value)
+	{
+		auto it = std::lower_bound(parameters.begin(), parameters.end(), name,
+			[](const Parameter& parameter, const std::string& name) { return parameter.name < name; });
+		if (it != parameters.end() && it->name == name)
+		{
+			*it = { name, components, value };
+		}
+		else
+		{
+			parameters.insert(it, { name, components, value });
+		}
+	}
+
+	std::string MaterialDescription::GetKey() const
+	{
+		std::string key = std::to_string(shader ? shader->id() : 0);
+		for (const Parameter& parameter : parameters)
+		{
+			key += "|" + parameter.name + "=";
+			for (unsigned i = 0; i < parameter.components; i++)
+			{
+				//Exact bits: materials only match if they'd upload the same values.
+				uint32_t bits;
+				std::memcpy(&bits, &parameter.value[i], sizeof(bits));
+				key += std::to_string(bits) + ",";
+			}
+		}
+		return key;
+	}
+
+	std::shared_ptr<glt::Drawable> RenderResourceRegistry::GetMesh(const std::string& key,
+		const std::function<std::shared_ptr<glt::Drawable>()>& create, size_t vertexBuffers, const Aabb& bounds)
+	{
+		MeshEntry& entry = meshes[key];
+		if (std::shared_ptr<glt::Drawable> drawable = entry.drawable.lock())
+		{
+			reused++;
+			return drawable;
+		}
+
+		std::shared_ptr<glt::Drawable> drawable = create();
+		entry.drawable = drawable;
+		entry.vertexArrays = 1;
+		entry.vertexBuffers = vertexBuffers;
+		meshBounds[drawable.get()] = { drawable, bounds };
+		return drawable;
+	}
+
+	Aabb RenderResourceRegistry::GetBounds(const glt::Drawable* drawable) const
+	{
+		auto it = meshBounds.find(drawable);
+		if (it == meshBounds.end() || it->second.drawable.expired())
+		{
+			return Aabb::Infinite();
+		}
+		return it->second.bounds;
+	}
+
+	Aabb RenderResourceRegistry::GetBounds(const glt::Model& model) const
+	{
+		Aabb bounds;
+		for (const auto& piece : model.get_pieces())
+		{
+			const Aabb pieceBounds = GetBounds(piece.drawable.get());
+			if (pieceBounds.IsInfinite())
+			{
+				return pieceBounds;
+			}
+			bounds.Add(pieceBounds);
+		}
+		return bounds;
+	}
+
+	Aabb RenderResourceRegistry::ReadObjBounds(const std::string& objFilePath)
+	{
+		std::ifstream file(objFilePath);
+		Aabb bounds;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.size() > 2 && line[0] == 'v' && line[1] == ' ')
+			{
+				char* end = &line[2];
+				const float x = std::strtof(end, &end);
+				const float y = std::strtof(end, &end);
+				const float z = std::strtof(end, &end);
+				bounds.Add(glm::vec3(x, y, z));
+			}
+		}
+		return bounds.IsEmpty() ? Aabb::Infinite() : bounds;
+	}
+
+	std::shared_ptr<glt::Drawable> RenderResourceRegistry::GetCube()
+	{
+		return GetMesh("generator:cube", []() { return std::shared_ptr<glt::Drawable>(new glt::Cube); }, CUBE_VERTEX_BUFFERS, CUBE_BOUNDS);
+	}
+
+	std::shared_ptr<glt::Material> RenderResourceRegistry::GetMaterial(const std::string& name, const MaterialDescription& description)
+	{
+		std::weak_ptr<glt::Material>& cached = materials[description.GetKey()];
+		if (std::shared_ptr<glt::Material> material = cached.lock())
+		{
+			reused++;
+			return material;
+		}
+
+		std::shared_ptr<glt::Shader_Program> shader = description.shader;
+		std::shared_ptr<glt::Material> material(new glt::Material(name, shader));
+		for (const auto& parameter : description.parameters)
+		{
+			switch (parameter.components)
+			{
+			case 1: material->set(parameter.name.c_str(), parameter.value.x); break;
+			case 3: material->set(parameter.name.c_str(), glt::Vector3(parameter.value)); break;
+			default: material->set(parameter.name.c_str(), parameter.value); break;
+			}
+		}
+		cached = material;
+		return material;
+	}
+
+	std::shared_ptr<glt::Model> RenderResourceRegistry::CreateCubeModel()
+	{
+		std::shared_ptr<glt::Model> model(new glt::Model);
+		model->add(GetCube(), glt::Material::default_material());
+		return model;
+	}
+
+	std::shared_ptr<glt::Model> RenderResourceRegistry::CreateModel(const std::string& objFilePath)
+	{
+		std::weak_ptr<glt::Model>& cached = modelTemplates["obj:" + objFilePath];
+		std::shared_ptr<glt::Model> modelTemplate = cached.lock();
+		if (modelTemplate)
+		{
+			reused++;
+		}
+		else
+		{
+			std::shared_ptr<glt::Model_Obj> loaded(new glt::Model_Obj(objFilePath));
+			if (!loaded->is_ok())
+			{
+				spdlog::error("Could not load model " + objFilePath + ": " + loaded->get_error());
+				return nullptr;
+			}
+			modelTemplate = loaded;
+			cached = modelTemplate;
+
+			//The pieces of a file share its bounds: a bit loose, but the file is only read once.
+			const Aabb bounds = ReadObjBounds(objFilePath);
+			for (const auto& piece : modelTemplate->get_pieces())
+			{
+				meshBounds[piece.drawable.get()] = { piece.drawable, bounds };
+			}
+		}
+
+		//The deleter holds the template, which holds the pieces, until the last model made from it is gone.
+		std::shared_ptr<glt::Model> model(new glt::Model, [modelTemplate](glt::Model* model) { delete model; });
+		for (const auto& piece : modelTemplate->get_pieces())
+		{
+			model->add(piece.drawable, piece.material);
+		}
+		return model;
+	}
+
+	RenderResourceStats RenderResourceRegistry::GetStats()
+	{
+		RenderResourceStats stats;
+		stats.reused = reused;
+
+		for (auto it = meshes.begin(); it != meshes.end();)
+		{
+			if (it->second.drawable.expired())
+			{
+				it = meshes.erase(it);
+				continue;
+			}
+			stats.meshes++;
+			stats.vertexArrays += it->second.vertexArrays;
+			stats.vertexBuffers += it->second.vertexBuffers;
+			++it;
+		}
+
+		for (auto it = meshBounds.begin(); it != meshBounds.end();)
+		{
+			it = it->second.drawable.expired() ? meshBounds.erase(it) : std::next(it);
+		}
+
+		for (auto it = modelTemplates.begin(); it != modelTemplates.end();)
+		{
+			std::shared_ptr<glt::Model> modelTemplate = it->second.lock();
+			if (!modelTemplate)
+			{
+				it = modelTemplates.erase(it);
+				continue;
+			}
+			const size_t pieces = modelTemplate->get_pieces().size();
+			stats.meshes += pieces;
+			stats.vertexArrays += pieces;
+			++it;
+		}
+
+		for (auto it = materials.begin(); it != materials.end();)
+		{
+			if (it->second.expired())
+			{
+				it = materials.erase(it);
+				continue;
+			}
+			stats.materials++;
+			++it;
+		}
+
+		return stats;
+	}
+
+	void RenderResourceRegistry::LogStats()
+	{
+		const RenderResourceStats stats = GetStats();
+		spdlog::info("Render resources: {} meshes, {} VAOs, {} VBOs, {} materials, {} requests reused an existing resource",
+			stats.meshes, stats.vertexArrays, stats.vertexBuffers, stats.materials, stats.reused);
+	}
+}
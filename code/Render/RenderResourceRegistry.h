@@ -0,0 +1,158 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <gltk/Math.hpp>
+#include <gltk/Drawable.hpp>
+#include <gltk/Material.hpp>
+#include <gltk/Model.hpp>
+#include <Render/Bounds.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Shader plus uniform values, everything that makes two materials the same.
+	/// </summary>
+	class MaterialDescription
+	{
+		friend class RenderResourceRegistry;
+	private:
+		struct Parameter
+		{
+			std::string name;
+			unsigned components;
+			glt::Vector4 value;
+		};
+
+		std::shared_ptr<glt::Shader_Program> shader;
+		/// <summary>
+		/// Sorted by name, so the order they're set in doesn't change the key.
+		/// </summary>
+		std::vector<Parameter> parameters;
+
+		void Set(const std::string& name, unsigned components, const glt::Vector4& value);
+		std::string GetKey() const;
+
+	public:
+		MaterialDescription(std::shared_ptr<glt::Shader_Program> shader) : shader(shader) {}
+
+		MaterialDescription& Set(const std::string& name, float value) { Set(name, 1, glt::Vector4(value, 0, 0, 0)); return *this; }
+		MaterialDescription& Set(const std::string& name, const glt::Vector3& value) { Set(name, 3, glt::Vector4(value, 0)); return *this; }
+		MaterialDescription& Set(const std::string& name, const glt::Vector4& value) { Set(name, 4, value); return *this; }
+	};
+
+	/// <summary>
+	/// Live GPU resources handed out by the registry.
+	/// </summary>
+	struct RenderResourceStats
+	{
+		size_t meshes = 0;
+		/// <summary>
+		/// Every toolkit mesh owns one vertex array.
+		/// </summary>
+		size_t vertexArrays = 0;
+		/// <summary>
+		/// Buffers of the generated meshes. The toolkit doesn't expose the buffers of loaded models,
+		/// so those count their vertex arrays only.
+		/// </summary>
+		size_t vertexBuffers = 0;
+		size_t materials = 0;
+		/// <summary>
+		/// Requests served with a resource that already existed.
+		/// </summary>
+		size_t reused = 0;
+	};
+
+	/// <summary>
+	/// Hands out shared meshes and materials instead of creating new GPU resources for every model.
+	/// Meshes are keyed by source file or generator parameters, materials by shader and uniform values.
+	///
+	/// The registry only keeps weak references: resources live as long as a model uses them, and asking
+	/// again after that creates them again.
+	/// </summary>
+	class RenderResourceRegistry
+	{
+	private:
+		struct MeshEntry
+		{
+			std::weak_ptr<glt::Drawable> drawable;
+			size_t vertexArrays;
+			size_t vertexBuffers;
+		};
+
+		struct BoundsEntry
+		{
+			/// <summary>
+			/// Tells a live mesh from a new one that got the address of a dead one.
+			/// </summary>
+			std::weak_ptr<glt::Drawable> drawable;
+			Aabb bounds;
+		};
+
+		std::map<std::string, MeshEntry> meshes;
+		std::map<std::string, std::weak_ptr<glt::Material>> materials;
+		/// <summary>
+		/// Loaded .obj files. Models created from them hold the template alive.
+		/// </summary>
+		std::map<std::string, std::weak_ptr<glt::Model>> modelTemplates;
+		std::unordered_map<const glt::Drawable*, BoundsEntry> meshBounds;
+		size_t reused = 0;
+
+		/// <summary>
+		/// Box around the vertices of an .obj file, read from its "v" lines.
+		/// </summary>
+		static Aabb ReadObjBounds(const std::string& objFilePath);
+
+	public:
+		/// <summary>
+		/// Mesh with the given key, built by create the first time.
+		/// </summary>
+		/// <param name="vertexBuffers">Buffers create allocates, for the stats</param>
+		/// <param name="bounds">Box around the mesh in its own space, infinite if unknown</param>
+		std::shared_ptr<glt::Drawable> GetMesh(const std::string& key, const std::function<std::shared_ptr<glt::Drawable>()>& create,
+			size_t vertexBuffers = 0, const Aabb& bounds = Aabb::Infinite());
+
+		/// <summary>
+		/// Local bounds of a mesh handed out by the registry. Infinite for anything else, so it's never culled.
+		/// </summary>
+		Aabb GetBounds(const glt::Drawable* drawable) const;
+
+		/// <summary>
+		/// Union of the bounds of the model's pieces, in model space.
+		/// </summary>
+		Aabb GetBounds(const glt::Model& model) const;
+
+		/// <summary>
+		/// The toolkit's unit cube.
+		/// </summary>
+		std::shared_ptr<glt::Drawable> GetCube();
+
+		std::shared_ptr<glt::Material> GetMaterial(const std::string& name, const MaterialDescription& description);
+
+		/// <summary>
+		/// New model node (own transform) made of the shared cube and the default material.
+		/// </summary>
+		std::shared_ptr<glt::Model> CreateCubeModel();
+
+		/// <summary>
+		/// New model node whose pieces are shared with every other model of the same .obj file.
+		/// </summary>
+		/// <returns>nullptr if the file can't be loaded</returns>
+		std::shared_ptr<glt::Model> CreateModel(const std::string& objFilePath);
+
+		/// <summary>
+		/// Drops the entries of resources nobody uses anymore and counts the live ones.
+		/// </summary>
+		RenderResourceStats GetStats();
+
+		void LogStats();
+	};
+}
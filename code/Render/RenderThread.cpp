@@ -0,0 +1,175 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/RenderThread.h>
+#include <spdlog/spdlog.h>
+
+namespace engine
+{
+	namespace
+	{
+		double SecondsSince(Uint64 start, Uint64 end)
+		{
+			return double(end - start) / SDL_GetPerformanceFrequency();
+		}
+	}
+
+	bool RenderThread::Start(RenderFunction render)
+	{
+		if (IsRunning())
+		{
+			return true;
+		}
+		//A context can't be current on two threads.
+		if (!window->SetContextCurrent(false))
+		{
+			return false;
+		}
+
+		this->render = render;
+		writing = 0;
+		published = -1;
+		rendering = -1;
+		stopping = false;
+		contextReported = false;
+		contextTaken = false;
+		lastPublishTime = SDL_GetPerformanceCounter();
+		thread = std::thread(&RenderThread::Loop, this);
+
+		bool taken;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			contextReady.wait(lock, [this]() { return contextReported; });
+			taken = contextTaken;
+		}
+		if (!taken)
+		{
+			thread.join();
+			window->SetContextCurrent(true);
+			spdlog::error("The render thread couldn't take the GL context");
+			return false;
+		}
+		spdlog::info("Render thread started");
+		return true;
+	}
+
+	void RenderThread::Stop()
+	{
+		if (!IsRunning())
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		snapshotPublished.notify_one();
+		thread.join();
+
+		window->SetContextCurrent(true);
+		//Posted after the last frame, still owed.
+		for (auto& work : posted)
+		{
+			work();
+		}
+		posted.clear();
+		spdlog::info("Render thread stopped");
+	}
+
+	FrameSnapshot& RenderThread::AcquireSnapshot()
+	{
+		const Uint64 waitStart = SDL_GetPerformanceCounter();
+		std::unique_lock<std::mutex> lock(mutex);
+		snapshotReleased.wait(lock, [this]() { return stopping || (published < 0 && rendering != writing); });
+		acquireWaitTime = SecondsSince(waitStart, SDL_GetPerformanceCounter());
+		return snapshots[writing];
+	}
+
+	void RenderThread::Publish()
+	{
+		const Uint64 now = SDL_GetPerformanceCounter();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			snapshots[writing].publishTime = now;
+			published = writing;
+			writing ^= 1;
+
+			stats.publishedFrames++;
+			stats.simulation.Add(SecondsSince(lastPublishTime, now), acquireWaitTime);
+			lastPublishTime = now;
+		}
+		snapshotPublished.notify_one();
+	}
+
+	void RenderThread::Post(std::function<void()> work)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		posted.push_back(std::move(work));
+	}
+
+	RenderThreadStats RenderThread::GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+
+	void RenderThread::Loop()
+	{
+		const bool taken = window->SetContextCurrent(true);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			contextReported = true;
+			contextTaken = taken;
+		}
+		contextReady.notify_one();
+		if (!taken)
+		{
+			return;
+		}
+
+		std::vector<std::function<void()>> work;
+		Uint64 lastFrameEnd = SDL_GetPerformanceCounter();
+		while (true)
+		{
+			const Uint64 waitStart = SDL_GetPerformanceCounter();
+			int snapshot;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				snapshotPublished.wait(lock, [this]() { return stopping || published >= 0; });
+				if (published < 0)
+				{
+					break;
+				}
+				snapshot = published;
+				rendering = published;
+				published = -1;
+				work.swap(posted);
+			}
+			//The simulation may start filling the other snapshot.
+			snapshotReleased.notify_one();
+			const Uint64 renderStart = SDL_GetPerformanceCounter();
+
+			for (auto& job : work)
+			{
+				job();
+			}
+			work.clear();
+			render(snapshots[snapshot]);
+
+			const Uint64 frameEnd = SDL_GetPerformanceCounter();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				rendering = -1;
+				stats.renderedFrames++;
+				stats.render.Add(SecondsSince(lastFrameEnd, frameEnd), SecondsSince(waitStart, renderStart));
+				stats.latency = SecondsSince(snapshots[snapshot].publishTime, frameEnd);
+				stats.averageLatency = stats.averageLatency == 0 ? stats.latency : stats.averageLatency * 0.95 + stats.latency * 0.05;
+			}
+			snapshotReleased.notify_one();
+			lastFrameEnd = frameEnd;
+		}
+
+		window->SetContextCurrent(false);
+	}
+}
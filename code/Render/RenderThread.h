@@ -0,0 +1,156 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sdl2/SDL.h>
+#include <Window/Window.h>
+#include <Render/FrameSnapshot.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Frame and wait times of one of the two threads, in seconds.
+	/// </summary>
+	struct ThreadTimings
+	{
+		/// <summary>
+		/// From the previous frame of the thread to this one: one over its throughput.
+		/// </summary>
+		double frameTime = 0;
+		/// <summary>
+		/// Part of frameTime spent waiting for the other thread.
+		/// </summary>
+		double waitTime = 0;
+		/// <summary>
+		/// Exponential moving averages, steadier to display or log.
+		/// </summary>
+		double averageFrameTime = 0;
+		double averageWaitTime = 0;
+
+		void Add(double frame, double wait)
+		{
+			frameTime = frame;
+			waitTime = wait;
+			averageFrameTime = averageFrameTime == 0 ? frame : averageFrameTime * 0.95 + frame * 0.05;
+			averageWaitTime = averageWaitTime == 0 ? wait : averageWaitTime * 0.95 + wait * 0.05;
+		}
+	};
+
+	struct RenderThreadStats
+	{
+		unsigned long long publishedFrames = 0;
+		unsigned long long renderedFrames = 0;
+		/// <summary>
+		/// Simulation frames are timed from one Publish() to the next, the wait is the one in AcquireSnapshot().
+		/// </summary>
+		ThreadTimings simulation;
+		/// <summary>
+		/// Render frames include the buffer swap, the wait is for the next snapshot.
+		/// </summary>
+		ThreadTimings render;
+		/// <summary>
+		/// From Publish() to the end of the frame drawn from that snapshot.
+		/// </summary>
+		double latency = 0;
+		double averageLatency = 0;
+	};
+
+	/// <summary>
+	/// Thread that owns the GL context and draws frames from snapshots of the scene, while the calling
+	/// (simulation) thread computes the next one.
+	///
+	/// There are two snapshots: the simulation fills one while the other is drawn. AcquireSnapshot() waits
+	/// until the render thread has taken the last snapshot published and is done with the one to fill,
+	/// so the simulation runs at most one frame ahead, and every frame is drawn.
+	///
+	/// Anything else needing the context once the thread is running (uploads, deletions) must be posted
+	/// to it with Post().
+	/// </summary>
+	class RenderThread
+	{
+	public:
+		/// <summary>
+		/// Draws a frame, swap included. Called on the render thread.
+		/// </summary>
+		typedef std::function<void(const FrameSnapshot&)> RenderFunction;
+
+	private:
+		Window* window;
+		RenderFunction render;
+		std::thread thread;
+
+		FrameSnapshot snapshots[2];
+		/// <summary>
+		/// Snapshot the simulation fills, the one published and not taken yet, the one being drawn.
+		/// -1 when there is none.
+		/// </summary>
+		int writing = 0;
+		int published = -1;
+		int rendering = -1;
+		bool stopping = false;
+		/// <summary>
+		/// Set by the thread once it tried to take the GL context, and whether it did.
+		/// </summary>
+		bool contextReported = false;
+		bool contextTaken = false;
+		std::vector<std::function<void()>> posted;
+
+		mutable std::mutex mutex;
+		std::condition_variable snapshotPublished;
+		std::condition_variable snapshotReleased;
+		std::condition_variable contextReady;
+
+		RenderThreadStats stats;
+		Uint64 lastPublishTime = 0;
+		double acquireWaitTime = 0;
+
+		void Loop();
+
+	public:
+		RenderThread(Window& window) { this->window = &window; }
+		~RenderThread() { Stop(); }
+
+		RenderThread(const RenderThread&) = delete;
+		RenderThread& operator = (const RenderThread&) = delete;
+
+		/// <summary>
+		/// Releases the GL context from the calling thread and starts drawing on a new thread, which
+		/// takes it. Waits for the thread to have the context.
+		/// </summary>
+		/// <returns>false if the thread couldn't take it: it's current on the calling thread again</returns>
+		bool Start(RenderFunction render);
+
+		/// <summary>
+		/// Draws the snapshot already published, stops the thread and makes the GL context current on
+		/// the calling thread again.
+		/// </summary>
+		void Stop();
+
+		bool IsRunning() const { return thread.joinable(); }
+
+		/// <summary>
+		/// Snapshot to fill for the next frame, waiting for the render thread to be done with it.
+		/// Simulation thread only, followed by Publish().
+		/// </summary>
+		FrameSnapshot& AcquireSnapshot();
+
+		/// <summary>
+		/// Hands the acquired snapshot over to the render thread.
+		/// </summary>
+		void Publish();
+
+		/// <summary>
+		/// Runs work on the render thread, with the GL context, before drawing the next frame.
+		/// </summary>
+		void Post(std::function<void()> work);
+
+		RenderThreadStats GetStats() const;
+	};
+}
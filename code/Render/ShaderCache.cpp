@@ -0,0 +1,323 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/ShaderCache.h>
+#include <Core/Hash.h>
+#include <spdlog/spdlog.h>
+#include <sdl2/SDL.h>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+
+namespace engine
+{
+	namespace
+	{
+		/// <summary>
+		/// GL 4.1 enums, missing from the 3.3 headers.
+		/// </summary>
+		const GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+		const GLenum PROGRAM_BINARY_LENGTH = 0x8741;
+		const GLenum NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
+
+		const char BINARY_MAGIC[4] = { 'G', 'E', 'S', 'B' };
+		const uint32_t BINARY_VERSION = 1;
+
+		template <typename T>
+		void Write(std::ofstream& stream, const T& value)
+		{
+			stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		template <typename T>
+		bool Read(std::ifstream& stream, T& value)
+		{
+			return bool(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+		}
+
+		std::string GetGlString(GLenum name)
+		{
+			const GLubyte* string = glGetString(name);
+			return string ? reinterpret_cast<const char*>(string) : "";
+		}
+
+		/// <summary>
+		/// Compile log of a shader, empty if it compiled.
+		/// </summary>
+		std::string GetCompileLog(GLuint shader)
+		{
+			GLint compiled = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+			if (compiled == GL_TRUE)
+			{
+				return "";
+			}
+			GLint length = 0;
+			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+			std::string log(size_t(length > 0 ? length : 1), '\0');
+			glGetShaderInfoLog(shader, length, nullptr, &log[0]);
+			log.resize(log.find('\0'));
+			return log;
+		}
+	}
+
+	bool ShaderCache::Initialize(const std::string& cacheDirectory)
+	{
+		driver = GetGlString(GL_VENDOR) + "|" + GetGlString(GL_RENDERER) + "|" + GetGlString(GL_VERSION);
+
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major > 4 || (major == 4 && minor >= 1) || SDL_GL_ExtensionSupported("GL_ARB_get_program_binary"))
+		{
+			getProgramBinary = (GetProgramBinaryProc)SDL_GL_GetProcAddress("glGetProgramBinary");
+			programBinary = (ProgramBinaryProc)SDL_GL_GetProcAddress("glProgramBinary");
+			programParameteri = (ProgramParameteriProc)SDL_GL_GetProcAddress("glProgramParameteri");
+		}
+		//Some drivers have no binary format at all.
+		GLint formats = 0;
+		if (HasProgramBinaries())
+		{
+			glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &formats);
+		}
+		if (formats <= 0)
+		{
+			getProgramBinary = nullptr;
+			programBinary = nullptr;
+		}
+
+		//Both extensions only add the thread count call and the non-blocking status query; issuing the
+		//compiles before checking them is what lets the driver overlap them.
+		MaxShaderCompilerThreadsProc maxShaderCompilerThreads = nullptr;
+		if (SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile"))
+		{
+			maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR");
+		}
+		else if (SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile"))
+		{
+			maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB");
+		}
+		parallelCompile = maxShaderCompilerThreads != nullptr;
+		if (parallelCompile)
+		{
+			//All the threads the driver wants.
+			maxShaderCompilerThreads(0xFFFFFFFF);
+		}
+
+		if (HasProgramBinaries())
+		{
+			std::error_code error;
+			std::filesystem::create_directories(cacheDirectory, error);
+			if (error)
+			{
+				spdlog::warn("Couldn't create the shader cache " + cacheDirectory + ": " + error.message());
+			}
+			else
+			{
+				directory = cacheDirectory;
+			}
+		}
+
+		spdlog::info(std::string("Shader cache ") + (!directory.empty() ? "in " + directory : "unavailable, shaders are compiled every time")
+			+ (parallelCompile ? ", parallel shader compile" : ""));
+		return !directory.empty();
+	}
+
+	std::string ShaderCache::GetBinaryPath(uint64_t key) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return directory + name;
+	}
+
+	bool ShaderCache::Load(uint64_t key, glt::Shader_Program& program)
+	{
+		if (directory.empty())
+		{
+			return false;
+		}
+		const std::string path = GetBinaryPath(key);
+		std::ifstream stream(path, std::ios::binary);
+		if (!stream)
+		{
+			return false;
+		}
+
+		char magic[4];
+		uint32_t version = 0, driverLength = 0, format = 0, length = 0;
+		uint64_t fileKey = 0;
+		bool valid = Read(stream, magic) && Read(stream, version) && Read(stream, fileKey) && Read(stream, driverLength)
+			&& std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0 && version == BINARY_VERSION && fileKey == key
+			&& driverLength == driver.size();
+		std::string fileDriver(driverLength, '\0');
+		std::vector<char> binary;
+		if (valid)
+		{
+			valid = stream.read(&fileDriver[0], std::streamsize(driverLength)) && fileDriver == driver
+				&& Read(stream, format) && Read(stream, length) && length > 0;
+		}
+		if (valid)
+		{
+			binary.resize(length);
+			valid = bool(stream.read(binary.data(), std::streamsize(length)));
+		}
+		if (!valid)
+		{
+			spdlog::warn("Ignoring shader binary " + path + ", written by another driver or damaged");
+			stats.rejected++;
+			return false;
+		}
+
+		programBinary(program, GLenum(format), binary.data(), GLsizei(length));
+		if (!program.finish_link())
+		{
+			spdlog::warn("GL refused shader binary " + path + ", compiling it again");
+			stats.rejected++;
+			return false;
+		}
+		return true;
+	}
+
+	void ShaderCache::Save(uint64_t key, const glt::Shader_Program& program)
+	{
+		if (directory.empty())
+		{
+			return;
+		}
+		GLint length = 0;
+		glGetProgramiv(program, PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+		{
+			return;
+		}
+		std::vector<char> binary(static_cast<size_t>(length));
+		GLsizei written = 0;
+		GLenum format = 0;
+		getProgramBinary(program, length, &written, &format, binary.data());
+		if (written <= 0)
+		{
+			return;
+		}
+
+		//Written aside and renamed, so a crash halfway never leaves a damaged binary under the real name.
+		const std::string path = GetBinaryPath(key);
+		{
+			std::ofstream stream(path + ".tmp", std::ios::binary | std::ios::trunc);
+			if (!stream)
+			{
+				spdlog::warn("Couldn't write shader binary " + path);
+				return;
+			}
+			stream.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+			Write(stream, BINARY_VERSION);
+			Write(stream, key);
+			Write(stream, uint32_t(driver.size()));
+			stream.write(driver.data(), std::streamsize(driver.size()));
+			Write(stream, uint32_t(format));
+			Write(stream, uint32_t(written));
+			stream.write(binary.data(), std::streamsize(written));
+			if (!stream)
+			{
+				spdlog::warn("Couldn't write shader binary " + path);
+				return;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(path + ".tmp", path, error);
+		if (!error)
+		{
+			stats.saved++;
+		}
+	}
+
+	std::vector<std::unique_ptr<glt::Shader_Program>> ShaderCache::Build(const std::vector<ProgramSource>& sources)
+	{
+		const Uint64 start = SDL_GetPerformanceCounter();
+
+		struct Pending
+		{
+			size_t index;
+			uint64_t key;
+			GLuint vertexShader;
+			GLuint fragmentShader;
+		};
+
+		std::vector<std::unique_ptr<glt::Shader_Program>> programs(sources.size());
+		std::vector<Pending> pending;
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			Fnv1aHash key;
+			const std::string* parts[] = { &driver, &sources[i].vertex, &sources[i].fragment };
+			for (const std::string* part : parts)
+			{
+				key.Add(part->data(), part->size());
+				key.Add(uint8_t(0));
+			}
+
+			programs[i].reset(new glt::Shader_Program);
+			if (Load(key.Get(), *programs[i]))
+			{
+				stats.loaded++;
+				continue;
+			}
+			pending.push_back({ i, key.Get(), 0, 0 });
+		}
+
+		//Every compile, then every link, then every check: nothing waits on the driver until the end.
+		for (Pending& program : pending)
+		{
+			const char* vertexSource = sources[program.index].vertex.c_str();
+			const char* fragmentSource = sources[program.index].fragment.c_str();
+			program.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+			program.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+			glShaderSource(program.vertexShader, 1, &vertexSource, nullptr);
+			glShaderSource(program.fragmentShader, 1, &fragmentSource, nullptr);
+			glCompileShader(program.vertexShader);
+			glCompileShader(program.fragmentShader);
+		}
+		for (const Pending& program : pending)
+		{
+			glt::Shader_Program& shaderProgram = *programs[program.index];
+			glAttachShader(shaderProgram, program.vertexShader);
+			glAttachShader(shaderProgram, program.fragmentShader);
+			if (!directory.empty() && programParameteri)
+			{
+				programParameteri(shaderProgram, PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			}
+			shaderProgram.start_link();
+		}
+		for (const Pending& program : pending)
+		{
+			std::unique_ptr<glt::Shader_Program>& shaderProgram = programs[program.index];
+			if (shaderProgram->finish_link())
+			{
+				stats.compiled++;
+				Save(program.key, *shaderProgram);
+			}
+			else
+			{
+				spdlog::error("Shader \"" + sources[program.index].name + "\" failed to build: " + GetCompileLog(program.vertexShader)
+					+ GetCompileLog(program.fragmentShader) + shaderProgram->log());
+			}
+
+			glDetachShader(*shaderProgram, program.vertexShader);
+			glDetachShader(*shaderProgram, program.fragmentShader);
+			glDeleteShader(program.vertexShader);
+			glDeleteShader(program.fragmentShader);
+			if (!shaderProgram->is_usable())
+			{
+				shaderProgram.reset();
+			}
+		}
+
+		stats.milliseconds += (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+		return programs;
+	}
+
+	std::unique_ptr<glt::Shader_Program> ShaderCache::Build(const ProgramSource& source)
+	{
+		return std::move(Build(std::vector<ProgramSource>{ source }).front());
+	}
+}
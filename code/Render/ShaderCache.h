@@ -0,0 +1,107 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <gltk/OpenGL.hpp>
+#include <gltk/Shader_Program.hpp>
+
+namespace engine
+{
+	/// <summary>
+	/// Complete sources of a program, #version line included.
+	/// </summary>
+	struct ProgramSource
+	{
+		/// <summary>
+		/// Only for the log.
+		/// </summary>
+		std::string name;
+		std::string vertex;
+		std::string fragment;
+	};
+
+	struct ShaderCacheStats
+	{
+		/// <summary>
+		/// Programs loaded from their binary, compiled from source and linked, and binaries written.
+		/// </summary>
+		unsigned loaded = 0;
+		unsigned compiled = 0;
+		unsigned saved = 0;
+		/// <summary>
+		/// Binaries found but not taken: written by another driver or version, damaged, or refused by GL.
+		/// Their programs were compiled instead.
+		/// </summary>
+		unsigned rejected = 0;
+		double milliseconds = 0;
+	};
+
+	/// <summary>
+	/// Builds programs from source, keeping their linked binaries (glGetProgramBinary) on disk so later
+	/// launches load them instead of compiling.
+	///
+	/// A binary is found by a hash of the sources and the driver (vendor, renderer and version strings),
+	/// which its file also keeps in full: after a driver update the old binaries are simply not found, and
+	/// whatever GL refuses anyway is compiled from source and written again.
+	///
+	/// Build() issues every compile and link of the batch before checking any of them, so drivers with
+	/// KHR_parallel_shader_compile (or the ARB one) work on them all at once.
+	///
+	/// Program binaries are GL 4.1 (or ARB_get_program_binary) and are loaded like the other entry points
+	/// beyond the engine's 3.3 loader; without them it only compiles.
+	/// </summary>
+	class ShaderCache
+	{
+	private:
+		typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufferSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+		typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+		typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum name, GLint value);
+		typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+		GetProgramBinaryProc getProgramBinary = nullptr;
+		ProgramBinaryProc programBinary = nullptr;
+		ProgramParameteriProc programParameteri = nullptr;
+		bool parallelCompile = false;
+
+		/// <summary>
+		/// Empty until Initialize(): nothing is read or written.
+		/// </summary>
+		std::string directory;
+		std::string driver;
+
+		ShaderCacheStats stats;
+
+		std::string GetBinaryPath(uint64_t key) const;
+
+		/// <summary>
+		/// Loads the binary into the program, if there's one for the key and GL takes it.
+		/// </summary>
+		bool Load(uint64_t key, glt::Shader_Program& program);
+		void Save(uint64_t key, const glt::Shader_Program& program);
+
+	public:
+		/// <summary>
+		/// Looks up the driver and its extensions, and creates the directory. Needs a current GL context.
+		/// </summary>
+		/// <returns>false if binaries can't be kept, Build() compiles everything then</returns>
+		bool Initialize(const std::string& cacheDirectory = "cache/shaders/");
+
+		/// <summary>
+		/// Builds every program of the batch, from its binary or from source.
+		/// </summary>
+		/// <returns>The programs, in the order of the sources, nullptr for those that failed (logged)</returns>
+		std::vector<std::unique_ptr<glt::Shader_Program>> Build(const std::vector<ProgramSource>& sources);
+		std::unique_ptr<glt::Shader_Program> Build(const ProgramSource& source);
+
+		bool HasProgramBinaries() const { return getProgramBinary != nullptr && programBinary != nullptr; }
+		bool HasParallelCompile() const { return parallelCompile; }
+
+		const ShaderCacheStats& GetStats() const { return stats; }
+	};
+}
@@ -0,0 +1,159 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/SpatialGrid.h>
+#include <algorithm>
+#include <cmath>
+
+namespace engine
+{
+	SpatialGrid::CellRange SpatialGrid::GetCellRange(const SDL_FRect& bounds) const
+	{
+		return {
+			int(std::floor(bounds.x / cellSize)),
+			int(std::floor(bounds.y / cellSize)),
+			int(std::floor((bounds.x + bounds.w) / cellSize)),
+			int(std::floor((bounds.y + bounds.h) / cellSize))
+		};
+	}
+
+	void SpatialGrid::AddToCells(int id, const CellRange& range)
+	{
+		for (int y = range.minY; y <= range.maxY; y++)
+		{
+			for (int x = range.minX; x <= range.maxX; x++)
+			{
+				cells[GetCellKey(x, y)].push_back(id);
+			}
+		}
+	}
+
+	void SpatialGrid::RemoveFromCells(int id, const CellRange& range)
+	{
+		for (int y = range.minY; y <= range.maxY; y++)
+		{
+			for (int x = range.minX; x <= range.maxX; x++)
+			{
+				auto cell = cells.find(GetCellKey(x, y));
+				if (cell == cells.end())
+				{
+					continue;
+				}
+
+				//Order inside a cell doesn't matter: swap with the last one and pop.
+				std::vector<int>& ids = cell->second;
+				auto it = std::find(ids.begin(), ids.end(), id);
+				if (it != ids.end())
+				{
+					*it = ids.back();
+					ids.pop_back();
+				}
+				if (ids.empty())
+				{
+					cells.erase(cell);
+				}
+			}
+		}
+	}
+
+	void SpatialGrid::Update(int id, const SDL_FRect& bounds)
+	{
+		if (id < 0)
+		{
+			return;
+		}
+		if (size_t(id) >= items.size())
+		{
+			items.resize(id + 1);
+		}
+
+		Item& item = items[id];
+		const CellRange range = GetCellRange(bounds);
+		if (item.inGrid)
+		{
+			if (item.cells == range)
+			{
+				return;
+			}
+			RemoveFromCells(id, item.cells);
+		}
+		else
+		{
+			item.inGrid = true;
+			itemCount++;
+		}
+
+		item.cells = range;
+		AddToCells(id, range);
+	}
+
+	void SpatialGrid::Remove(int id)
+	{
+		if (id < 0 || size_t(id) >= items.size() || !items[id].inGrid)
+		{
+			return;
+		}
+
+		RemoveFromCells(id, items[id].cells);
+		items[id].inGrid = false;
+		itemCount--;
+	}
+
+	void SpatialGrid::Clear()
+	{
+		cells.clear();
+		items.clear();
+		itemCount = 0;
+	}
+
+	void SpatialGrid::Query(const SDL_FRect& area, std::vector<int>& result)
+	{
+		queryStamp++;
+		const CellRange range = GetCellRange(area);
+
+		//Huge areas over a sparse world: walking the occupied cells is cheaper than walking the range.
+		const int64_t rangeCells = int64_t(range.maxX - range.minX + 1) * (range.maxY - range.minY + 1);
+		if (rangeCells > int64_t(cells.size()))
+		{
+			for (const auto& cell : cells)
+			{
+				const int x = int(uint32_t(cell.first >> 32));
+				const int y = int(uint32_t(cell.first));
+				if (x < range.minX || x > range.maxX || y < range.minY || y > range.maxY)
+				{
+					continue;
+				}
+				for (int id : cell.second)
+				{
+					if (items[id].queryStamp != queryStamp)
+					{
+						items[id].queryStamp = queryStamp;
+						result.push_back(id);
+					}
+				}
+			}
+			return;
+		}
+
+		for (int y = range.minY; y <= range.maxY; y++)
+		{
+			for (int x = range.minX; x <= range.maxX; x++)
+			{
+				auto cell = cells.find(GetCellKey(x, y));
+				if (cell == cells.end())
+				{
+					continue;
+				}
+				for (int id : cell->second)
+				{
+					if (items[id].queryStamp != queryStamp)
+					{
+						items[id].queryStamp = queryStamp;
+						result.push_back(id);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <sdl2/SDL.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Uniform grid over the world, stored as a hash of the occupied cells so the world can be any size.
+	/// Items are identified by a small non-negative id (entity ids) and kept in every cell their bounds touch.
+	///
+	/// Update() only touches the cells when an item moves to a different range of cells, so items that
+	/// move a little every frame cost a comparison.
+	/// </summary>
+	class SpatialGrid
+	{
+	private:
+		struct CellRange
+		{
+			int minX, minY, maxX, maxY;
+			bool operator == (const CellRange& other) const
+			{
+				return minX == other.minX && minY == other.minY && maxX == other.maxX && maxY == other.maxY;
+			}
+		};
+
+		struct Item
+		{
+			CellRange cells;
+			bool inGrid = false;
+			/// <summary>
+			/// Last query that returned it, so items over several cells are only returned once.
+			/// </summary>
+			unsigned queryStamp = 0;
+		};
+
+		float cellSize;
+		std::unordered_map<uint64_t, std::vector<int>> cells;
+		std::vector<Item> items;
+		unsigned queryStamp = 0;
+		size_t itemCount = 0;
+
+		static uint64_t GetCellKey(int x, int y) { return uint64_t(uint32_t(x)) << 32 | uint32_t(y); }
+		CellRange GetCellRange(const SDL_FRect& bounds) const;
+		void AddToCells(int id, const CellRange& range);
+		void RemoveFromCells(int id, const CellRange& range);
+
+	public:
+		/// <param name="cellSize">In world units. Around a few times the usual item size works best.</param>
+		explicit SpatialGrid(float cellSize = 256.f) : cellSize(cellSize) {}
+
+		/// <summary>
+		/// Adds the item, or moves it if it's already in the grid.
+		/// </summary>
+		void Update(int id, const SDL_FRect& bounds);
+		void Remove(int id);
+		void Clear();
+
+		/// <summary>
+		/// Appends to result the id of every item whose cells overlap area. Items are only appended once,
+		/// but they may not actually overlap area: callers get a conservative set.
+		/// </summary>
+		void Query(const SDL_FRect& area, std::vector<int>& result);
+
+		size_t GetItemCount() const { return itemCount; }
+		size_t GetCellCount() const { return cells.size(); }
+	};
+}
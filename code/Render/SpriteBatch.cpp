@@ -0,0 +1,136 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/SpriteBatch.h>
+#include <algorithm>
+#include <cmath>
+
+namespace engine
+{
+	namespace
+	{
+		const double DEGREES_TO_RADIANS = 3.14159265358979323846 / 180.0;
+	}
+
+	void SpriteBatch::Begin()
+	{
+		sprites.clear();
+		sortKeys.clear();
+		textures.clear();
+		lastTextureIndex = 0;
+	}
+
+	void SpriteBatch::Draw(SDL_Texture* texture, const SDL_Rect& srcRect, const SDL_FRect& dstRect, float angle, int layer, SDL_Color color)
+	{
+		if (!texture)
+		{
+			return;
+		}
+
+		//Layers are biased so negative ones sort before positive ones.
+		const uint64_t layerKey = uint64_t(std::clamp(layer, -32768, 32767) + 32768);
+		sortKeys.push_back(layerKey << 48 | uint64_t(GetTextureIndex(texture)) << 32 | uint64_t(sprites.size()));
+
+		sprites.push_back({ texture, srcRect, dstRect, angle, color });
+	}
+
+	void SpriteBatch::End(SDL_Renderer* renderer)
+	{
+		drawCalls = 0;
+		if (sprites.empty())
+		{
+			return;
+		}
+
+		//The sprite index in the low bits keeps the sort stable.
+		std::sort(sortKeys.begin(), sortKeys.end());
+
+		vertices.resize(sprites.size() * 4);
+		size_t runStart = 0;
+		SDL_Texture* runTexture = nullptr;
+		uint64_t runKey = 0;
+		float inverseWidth = 0, inverseHeight = 0;
+
+		for (size_t i = 0; i < sortKeys.size(); i++)
+		{
+			const Sprite& sprite = sprites[uint32_t(sortKeys[i])];
+			const uint64_t key = sortKeys[i] >> 32;
+			if (i == 0 || key != runKey)
+			{
+				if (i > 0)
+				{
+					Flush(renderer, runTexture, runStart, i - runStart);
+				}
+				runStart = i;
+				runKey = key;
+				runTexture = sprite.texture;
+
+				int width, height;
+				SDL_QueryTexture(runTexture, nullptr, nullptr, &width, &height);
+				inverseWidth = 1.f / width;
+				inverseHeight = 1.f / height;
+			}
+
+			const float u0 = sprite.srcRect.x * inverseWidth;
+			const float v0 = sprite.srcRect.y * inverseHeight;
+			const float u1 = (sprite.srcRect.x + sprite.srcRect.w) * inverseWidth;
+			const float v1 = (sprite.srcRect.y + sprite.srcRect.h) * inverseHeight;
+
+			//Corners relative to the center: top left, top right, bottom right, bottom left.
+			const float halfWidth = sprite.dstRect.w * 0.5f;
+			const float halfHeight = sprite.dstRect.h * 0.5f;
+			SDL_FPoint corners[4] = { { -halfWidth, -halfHeight }, { halfWidth, -halfHeight }, { halfWidth, halfHeight }, { -halfWidth, halfHeight } };
+			if (sprite.angle != 0.f)
+			{
+				const float sine = float(std::sin(sprite.angle * DEGREES_TO_RADIANS));
+				const float cosine = float(std::cos(sprite.angle * DEGREES_TO_RADIANS));
+				for (SDL_FPoint& corner : corners)
+				{
+					corner = { corner.x * cosine - corner.y * sine, corner.x * sine + corner.y * cosine };
+				}
+			}
+
+			const float centerX = sprite.dstRect.x + halfWidth;
+			const float centerY = sprite.dstRect.y + halfHeight;
+			SDL_Vertex* quad = &vertices[i * 4];
+			quad[0] = { { centerX + corners[0].x, centerY + corners[0].y }, sprite.color, { u0, v0 } };
+			quad[1] = { { centerX + corners[1].x, centerY + corners[1].y }, sprite.color, { u1, v0 } };
+			quad[2] = { { centerX + corners[2].x, centerY + corners[2].y }, sprite.color, { u1, v1 } };
+			quad[3] = { { centerX + corners[3].x, centerY + corners[3].y }, sprite.color, { u0, v1 } };
+		}
+		Flush(renderer, runTexture, runStart, sortKeys.size() - runStart);
+	}
+
+	uint32_t SpriteBatch::GetTextureIndex(SDL_Texture* texture)
+	{
+		//Sprites usually come in long runs of the same texture (or atlas).
+		if (lastTextureIndex < textures.size() && textures[lastTextureIndex] == texture)
+		{
+			return uint32_t(lastTextureIndex);
+		}
+
+		auto it = std::find(textures.begin(), textures.end(), texture);
+		lastTextureIndex = size_t(it - textures.begin());
+		if (it == textures.end())
+		{
+			textures.push_back(texture);
+		}
+		return uint32_t(lastTextureIndex);
+	}
+
+	void SpriteBatch::Flush(SDL_Renderer* renderer, SDL_Texture* texture, size_t firstSprite, size_t spriteCount)
+	{
+		for (size_t quad = indices.size() / 6; quad < spriteCount; quad++)
+		{
+			const int first = int(quad * 4);
+			indices.insert(indices.end(), { first, first + 1, first + 2, first + 2, first + 3, first });
+		}
+
+		if (renderer)
+		{
+			SDL_RenderGeometry(renderer, texture, &vertices[firstSprite * 4], int(spriteCount * 4), indices.data(), int(spriteCount * 6));
+		}
+		drawCalls++;
+	}
+}
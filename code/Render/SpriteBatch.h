@@ -0,0 +1,78 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <cstdint>
+#include <sdl2/SDL.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Collects the sprites of a frame and draws them with a few SDL_RenderGeometry calls, one per run of
+	/// sprites sharing layer and texture, instead of one SDL_RenderCopyEx per sprite.
+	///
+	/// Sprites are drawn by layer (lowest first), then grouped by texture. Inside the same layer and
+	/// texture they keep the order they were added in.
+	/// </summary>
+	class SpriteBatch
+	{
+	private:
+		struct Sprite
+		{
+			SDL_Texture* texture;
+			SDL_Rect srcRect;
+			SDL_FRect dstRect;
+			float angle;
+			SDL_Color color;
+		};
+
+		std::vector<Sprite> sprites;
+		/// <summary>
+		/// layer | texture index | sprite index, sorted to get the drawing order.
+		/// </summary>
+		std::vector<uint64_t> sortKeys;
+		/// <summary>
+		/// Textures seen this frame. The index in here goes in the sort key, as a pointer doesn't fit.
+		/// </summary>
+		std::vector<SDL_Texture*> textures;
+		size_t lastTextureIndex = 0;
+
+		std::vector<SDL_Vertex> vertices;
+		/// <summary>
+		/// 0 1 2 2 3 0 for every quad, shared by all the runs.
+		/// </summary>
+		std::vector<int> indices;
+
+		unsigned drawCalls = 0;
+
+		uint32_t GetTextureIndex(SDL_Texture* texture);
+		void Flush(SDL_Renderer* renderer, SDL_Texture* texture, size_t firstSprite, size_t spriteCount);
+
+	public:
+		/// <summary>
+		/// Forgets the sprites of the previous frame.
+		/// </summary>
+		void Begin();
+
+		/// <param name="srcRect">Region of the texture, in pixels</param>
+		/// <param name="dstRect">Where it goes on screen, in pixels</param>
+		/// <param name="angle">Clockwise rotation around the center of dstRect, in degrees (as SDL_RenderCopyEx)</param>
+		void Draw(SDL_Texture* texture, const SDL_Rect& srcRect, const SDL_FRect& dstRect, float angle = 0.f,
+			int layer = 0, SDL_Color color = { 255, 255, 255, 255 });
+
+		/// <summary>
+		/// Sorts the sprites, builds their vertices and submits them.
+		/// With a null renderer everything but the submission is done (benchmarks).
+		/// </summary>
+		void End(SDL_Renderer* renderer);
+
+		size_t GetSpriteCount() const { return sprites.size(); }
+		/// <summary>
+		/// SDL_RenderGeometry calls issued by the last End().
+		/// </summary>
+		unsigned GetDrawCallCount() const { return drawCalls; }
+	};
+}
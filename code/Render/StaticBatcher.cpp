@@ -0,0 +1,334 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/StaticBatcher.h>
+#include <Render/MeshAccess.h>
+#include <Render/InstancedRenderer.h>
+#include <Render/GlState.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <string>
+
+namespace engine
+{
+	namespace
+	{
+		/// <summary>
+		/// Copies the first floats of every vertex of an attribute out of its buffer. The vertex array
+		/// owning it must be bound.
+		/// </summary>
+		template <typename TValue>
+		bool ReadAttribute(GLuint location, std::vector<TValue>& values)
+		{
+			GLint enabled = 0, buffer = 0, size = 0, type = 0, stride = 0;
+			void* pointer = nullptr;
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &stride);
+			glGetVertexAttribPointerv(location, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+			if (!enabled || !buffer || type != GL_FLOAT || size_t(size) * sizeof(float) < sizeof(TValue))
+			{
+				return false;
+			}
+			const size_t vertexStride = stride ? size_t(stride) : size * sizeof(float);
+			const size_t offset = size_t(pointer);
+
+			GlState::Instance().BindBuffer(GL_COPY_READ_BUFFER, GLuint(buffer));
+			GLint bytes = 0;
+			glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &bytes);
+			if (size_t(bytes) < offset + sizeof(TValue))
+			{
+				return false;
+			}
+
+			std::vector<uint8_t> data(size_t(bytes) - offset);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, GLintptr(offset), GLsizeiptr(data.size()), data.data());
+			values.resize((data.size() - sizeof(TValue)) / vertexStride + 1);
+			for (size_t i = 0; i < values.size(); i++)
+			{
+				std::memcpy(&values[i], data.data() + i * vertexStride, sizeof(TValue));
+			}
+			return true;
+		}
+
+		uint8_t ToByte(float channel)
+		{
+			return uint8_t(std::clamp(channel, 0.f, 1.f) * 255.f + 0.5f);
+		}
+	}
+
+	StaticBatcher::~StaticBatcher()
+	{
+		ReleaseBuffers();
+	}
+
+	bool StaticBatcher::ReadGeometry(const glt::Mesh& mesh, MeshGeometry& geometry)
+	{
+		const glt::Vertex_Array_Object* vao = MeshAccess::GetVao(mesh);
+		const GLsizei count = MeshAccess::GetVerticesCount(mesh);
+		if (!vao || MeshAccess::GetPrimitiveType(mesh) != GL_TRIANGLES || count <= 0)
+		{
+			return false;
+		}
+
+		vao->bind();
+		bool read = ReadAttribute(glt::Mesh::COORDINATES, geometry.positions) && ReadAttribute(glt::Mesh::NORMALS, geometry.normals)
+			&& geometry.positions.size() == geometry.normals.size();
+		//Texture coordinates are optional, and dropped if they don't match the other attributes.
+		if (read && (!ReadAttribute(TEXTURE_COORDINATES, geometry.textureCoordinates) || geometry.textureCoordinates.size() != geometry.positions.size()))
+		{
+			geometry.textureCoordinates.clear();
+		}
+
+		const GLenum indicesType = MeshAccess::GetIndicesType(mesh);
+		if (read && indicesType == GL_NONE)
+		{
+			geometry.indices.resize(size_t(count));
+			for (GLsizei i = 0; i < count; i++)
+			{
+				geometry.indices[i] = uint32_t(i);
+			}
+		}
+		else if (read)
+		{
+			GLint buffer = 0;
+			glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &buffer);
+			const size_t indexSize = indicesType == GL_UNSIGNED_BYTE ? 1 : indicesType == GL_UNSIGNED_SHORT ? 2 : 4;
+			std::vector<uint8_t> data(size_t(count) * indexSize);
+			read = buffer != 0;
+			if (read)
+			{
+				GlState::Instance().BindBuffer(GL_COPY_READ_BUFFER, GLuint(buffer));
+				glGetBufferSubData(GL_COPY_READ_BUFFER, 0, GLsizeiptr(data.size()), data.data());
+				geometry.indices.resize(size_t(count));
+				for (size_t i = 0; i < geometry.indices.size(); i++)
+				{
+					const uint8_t* index = data.data() + i * indexSize;
+					geometry.indices[i] = indexSize == 1 ? *index : indexSize == 2 ? *reinterpret_cast<const uint16_t*>(index)
+						: *reinterpret_cast<const uint32_t*>(index);
+				}
+			}
+		}
+		vao->unbind();
+		//Bound and unbound by the toolkit, the tracker can't tell.
+		GlState::Instance().Invalidate();
+
+		if (read)
+		{
+			for (uint32_t index : geometry.indices)
+			{
+				read = read && index < geometry.positions.size();
+			}
+		}
+		return read;
+	}
+
+	const MeshGeometry* StaticBatcher::GetGeometry(const glt::Drawable* drawable)
+	{
+		auto it = geometries.find(drawable);
+		if (it == geometries.end())
+		{
+			const glt::Mesh* mesh = dynamic_cast<const glt::Mesh*>(drawable);
+			MeshGeometry geometry;
+			if (!mesh || !ReadGeometry(*mesh, geometry))
+			{
+				//Remembered as empty, it won't be read again.
+				geometry = MeshGeometry();
+			}
+			it = geometries.emplace(drawable, std::move(geometry)).first;
+		}
+		return it->second.indices.empty() ? nullptr : &it->second;
+	}
+
+	void StaticBatcher::Clear()
+	{
+		geometries.clear();
+		pieces.clear();
+		cells.clear();
+		vertexCount = 0;
+		modelCount = 0;
+		ReleaseBuffers();
+	}
+
+	bool StaticBatcher::Add(const glt::Model& model, const glm::vec4& color)
+	{
+		return Add(model, model.get_total_transformation(), color);
+	}
+
+	bool StaticBatcher::Add(const glt::Model& model, const glm::mat4& transform, const glm::vec4& color)
+	{
+		const size_t firstPiece = pieces.size();
+		for (const auto& piece : model.get_pieces())
+		{
+			const MeshGeometry* geometry = GetGeometry(piece.drawable.get());
+			if (!geometry)
+			{
+				pieces.resize(firstPiece);
+				return false;
+			}
+			pieces.push_back({ geometry, piece.material.get(), transform, color });
+		}
+		modelCount++;
+		return true;
+	}
+
+	void StaticBatcher::Build()
+	{
+		ReleaseBuffers();
+		cells.clear();
+		vertexCount = 0;
+
+		//Pieces are grouped by material and by the cell their center falls in. A piece is never split,
+		//so the cells' bounds may overlap a little.
+		struct CellKey
+		{
+			const glt::Material* material;
+			glm::ivec3 cell;
+			uint32_t piece;
+		};
+		std::vector<CellKey> keys;
+		keys.reserve(pieces.size());
+		for (size_t i = 0; i < pieces.size(); i++)
+		{
+			const Piece& piece = pieces[i];
+			Aabb bounds;
+			for (const glm::vec3& position : piece.geometry->positions)
+			{
+				bounds.Add(glm::vec3(piece.transform * glm::vec4(position, 1.f)));
+			}
+			keys.push_back({ piece.material, glm::ivec3(glm::floor(bounds.GetCenter() / cellSize)), uint32_t(i) });
+		}
+		std::sort(keys.begin(), keys.end(), [](const CellKey& a, const CellKey& b)
+			{
+				if (a.material != b.material) return a.material < b.material;
+				if (a.cell.x != b.cell.x) return a.cell.x < b.cell.x;
+				if (a.cell.y != b.cell.y) return a.cell.y < b.cell.y;
+				if (a.cell.z != b.cell.z) return a.cell.z < b.cell.z;
+				return a.piece < b.piece;
+			});
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			if (i == 0 || keys[i].material != keys[i - 1].material || keys[i].cell != keys[i - 1].cell)
+			{
+				cells.push_back({ keys[i].material, Aabb(), uint32_t(indices.size()), 0 });
+			}
+			StaticBatchCell& cell = cells.back();
+
+			const Piece& piece = pieces[keys[i].piece];
+			const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(piece.transform)));
+			const uint8_t color[4] = { ToByte(piece.color.r), ToByte(piece.color.g), ToByte(piece.color.b), ToByte(piece.color.a) };
+
+			const uint32_t firstVertex = uint32_t(vertices.size());
+			for (size_t v = 0; v < piece.geometry->positions.size(); v++)
+			{
+				Vertex vertex;
+				vertex.position = glm::vec3(piece.transform * glm::vec4(piece.geometry->positions[v], 1.f));
+				vertex.normal = glm::normalize(normalMatrix * piece.geometry->normals[v]);
+				std::memcpy(vertex.color, color, sizeof(color));
+				cell.bounds.Add(vertex.position);
+				vertices.push_back(vertex);
+			}
+			for (uint32_t index : piece.geometry->indices)
+			{
+				indices.push_back(firstVertex + index);
+			}
+			cell.indexCount += uint32_t(piece.geometry->indices.size());
+		}
+		vertexCount = vertices.size();
+
+		//The merged copy is all that's needed from now on.
+		pieces.clear();
+		geometries.clear();
+		if (cells.empty())
+		{
+			return;
+		}
+
+		GlState& state = GlState::Instance();
+		glGenVertexArrays(1, &vertexArray);
+		glGenBuffers(1, &vertexBuffer);
+		glGenBuffers(1, &indexBuffer);
+		glGenBuffers(1, &transformBuffer);
+		state.BindVertexArray(vertexArray);
+
+		const GLsizei stride = GLsizei(sizeof(Vertex));
+		state.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertices.size() * sizeof(Vertex)), vertices.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(glt::Mesh::COORDINATES);
+		glVertexAttribPointer(glt::Mesh::COORDINATES, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, position));
+		glEnableVertexAttribArray(glt::Mesh::NORMALS);
+		glVertexAttribPointer(glt::Mesh::NORMALS, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, normal));
+		const GLuint colorLocation = InstancedRenderer::INSTANCE_ATTRIBUTE + 4;
+		glEnableVertexAttribArray(colorLocation);
+		glVertexAttribPointer(colorLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const void*)offsetof(Vertex, color));
+
+		//A non instanced draw reads instance 0 of the divided attributes.
+		const glm::mat4 identity(1.f);
+		state.BindBuffer(GL_ARRAY_BUFFER, transformBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(identity), &identity, GL_STATIC_DRAW);
+		for (GLuint column = 0; column < 4; column++)
+		{
+			const GLuint location = InstancedRenderer::INSTANCE_ATTRIBUTE + column;
+			glEnableVertexAttribArray(location);
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, GLsizei(sizeof(identity)), (const void*)(column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(location, 1);
+		}
+
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indices.size() * sizeof(uint32_t)), indices.data(), GL_STATIC_DRAW);
+		state.BindVertexArray(0);
+
+		spdlog::info("Static batches: " + std::to_string(modelCount) + " models merged into " + std::to_string(cells.size())
+			+ " draws, " + std::to_string(vertexCount) + " vertices");
+	}
+
+	void StaticBatcher::ReleaseBuffers()
+	{
+		if (vertexArray)
+		{
+			GlState::Instance().ForgetVertexArray(vertexArray);
+			glDeleteVertexArrays(1, &vertexArray);
+			vertexArray = 0;
+		}
+		for (GLuint* buffer : { &vertexBuffer, &indexBuffer, &transformBuffer })
+		{
+			if (*buffer)
+			{
+				GlState::Instance().ForgetBuffer(*buffer);
+				glDeleteBuffers(1, buffer);
+				*buffer = 0;
+			}
+		}
+	}
+
+	void StaticBatcher::Cull(const Frustum& frustum, std::vector<unsigned>& visible) const
+	{
+		for (size_t i = 0; i < cells.size(); i++)
+		{
+			if (frustum.Classify(cells[i].bounds) != Frustum::OUTSIDE)
+			{
+				visible.push_back(unsigned(i));
+			}
+		}
+	}
+
+	void StaticBatcher::Bind() const
+	{
+		GlState::Instance().BindVertexArray(vertexArray);
+	}
+
+	void StaticBatcher::DrawCell(unsigned cell) const
+	{
+		glDrawElements(GL_TRIANGLES, GLsizei(cells[cell].indexCount), GL_UNSIGNED_INT,
+			(const void*)(size_t(cells[cell].firstIndex) * sizeof(uint32_t)));
+	}
+}
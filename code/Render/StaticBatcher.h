@@ -0,0 +1,162 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include <gltk/OpenGL.hpp>
+#include <gltk/Drawable.hpp>
+#include <gltk/Material.hpp>
+#include <gltk/Mesh.hpp>
+#include <gltk/Model.hpp>
+#include <Render/Bounds.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Triangles of a mesh, in its own space. Texture coordinates may be empty.
+	/// </summary>
+	struct MeshGeometry
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> textureCoordinates;
+		std::vector<uint32_t> indices;
+	};
+
+	/// <summary>
+	/// One draw of the static geometry: the triangles of a material inside a cell.
+	/// </summary>
+	struct StaticBatchCell
+	{
+		const glt::Material* material;
+		/// <summary>
+		/// World space box around the cell's triangles.
+		/// </summary>
+		Aabb bounds;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	/// <summary>
+	/// Merges the meshes of models that never move into shared vertex and index buffers, transformed to
+	/// world space once. The world is split into cubic cells and every (material, cell) pair becomes one
+	/// draw with its own bounds, so culling still works per cell instead of per model.
+	///
+	/// The merged vertices hold the model color, and attribute locations match InstancedRenderer's shader
+	/// with an identity instance transform: cells are drawn with the instanced program (see
+	/// RenderQueue::AddStaticCells()).
+	/// </summary>
+	class StaticBatcher
+	{
+	private:
+		/// <summary>
+		/// Layout of the merged vertex buffer.
+		/// </summary>
+		struct Vertex
+		{
+			glm::vec3 position;
+			glm::vec3 normal;
+			/// <summary>
+			/// Model color, 8 bits per channel.
+			/// </summary>
+			uint8_t color[4];
+		};
+
+		struct Piece
+		{
+			const MeshGeometry* geometry;
+			const glt::Material* material;
+			glm::mat4 transform;
+			glm::vec4 color;
+		};
+
+		float cellSize;
+
+		/// <summary>
+		/// Read back once per mesh, freed by Build().
+		/// </summary>
+		std::unordered_map<const glt::Drawable*, MeshGeometry> geometries;
+		std::vector<Piece> pieces;
+
+		std::vector<StaticBatchCell> cells;
+		size_t vertexCount = 0;
+		size_t modelCount = 0;
+
+		GLuint vertexArray = 0;
+		GLuint vertexBuffer = 0;
+		GLuint indexBuffer = 0;
+		/// <summary>
+		/// A single identity matrix, read as the instance transform of every vertex.
+		/// </summary>
+		GLuint transformBuffer = 0;
+
+		const MeshGeometry* GetGeometry(const glt::Drawable* drawable);
+		void ReleaseBuffers();
+
+	public:
+		StaticBatcher(float cellSize = 32.f) : cellSize(cellSize) {}
+		~StaticBatcher();
+
+		StaticBatcher(const StaticBatcher&) = delete;
+		StaticBatcher& operator = (const StaticBatcher&) = delete;
+
+		/// <summary>
+		/// Attribute location of the toolkit meshes' texture coordinates, after glt::Mesh's own.
+		/// </summary>
+		static const GLuint TEXTURE_COORDINATES = 2;
+
+		/// <summary>
+		/// Reads a mesh's triangles back from its buffers. Only float positions and normals drawn as
+		/// GL_TRIANGLES are supported.
+		/// </summary>
+		static bool ReadGeometry(const glt::Mesh& mesh, MeshGeometry& geometry);
+
+		/// <summary>
+		/// Forgets the models added and the batches built.
+		/// </summary>
+		void Clear();
+
+		/// <summary>
+		/// Queues the model for the next Build(), with its current transformation. Nothing is added if a
+		/// piece can't be read.
+		/// </summary>
+		/// <returns>Whether the model will be batched</returns>
+		bool Add(const glt::Model& model, const glm::vec4& color);
+		/// <summary>
+		/// Same, with the given model to world transform instead of the model's own.
+		/// </summary>
+		bool Add(const glt::Model& model, const glm::mat4& transform, const glm::vec4& color);
+
+		/// <summary>
+		/// Merges the models added since the last Clear() and uploads them. Needs the GL context.
+		/// </summary>
+		void Build();
+
+		/// <summary>
+		/// Appends the cells that may be seen by the frustum to visible.
+		/// </summary>
+		void Cull(const Frustum& frustum, std::vector<unsigned>& visible) const;
+
+		/// <summary>
+		/// Binds the merged vertex array. It's left bound, the render queue unbinds it at the end of the frame.
+		/// </summary>
+		void Bind() const;
+
+		/// <summary>
+		/// Draws the cell, Bind() must have been called.
+		/// </summary>
+		void DrawCell(unsigned cell) const;
+
+		/// <summary>
+		/// Sorted by material.
+		/// </summary>
+		const std::vector<StaticBatchCell>& GetCells() const { return cells; }
+		size_t GetVertexCount() const { return vertexCount; }
+		size_t GetModelCount() const { return modelCount; }
+	};
+}
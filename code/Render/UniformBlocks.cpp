@@ -0,0 +1,165 @@
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <Render/UniformBlocks.h>
+#include <Render/GlState.h>
+#include <gltk/Light.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace engine
+{
+	const char* UniformBlocks::FRAME_BLOCK_SOURCE =
+		"struct Frame_Light\n"
+		"{\n"
+		"    vec4 position;\n"
+		"    vec4 color;\n"
+		"};\n"
+		"layout (std140) uniform Frame_Block\n"
+		"{\n"
+		"    mat4  view_matrix;\n"
+		"    mat4  projection_matrix;\n"
+		"    vec4  ambient_color;\n"
+		"    ivec4 light_count;\n"
+		"    vec4  cluster_grid;\n"
+		"    vec4  cluster_depth;\n"
+		//Size must be MAX_FRAME_LIGHTS.
+		"    Frame_Light lights[64];\n"
+		"};\n";
+
+	const char* UniformBlocks::MATERIAL_BLOCK_SOURCE =
+		"layout (std140) uniform Material_Block\n"
+		"{\n"
+		"    vec4 material_color;\n"
+		"    vec4 material_specular;\n"
+		"};\n";
+
+	UniformBlocks::~UniformBlocks()
+	{
+		for (GLuint buffer : { frameBuffer, materialBuffer })
+		{
+			if (buffer)
+			{
+				GlState::Instance().ForgetBuffer(buffer);
+				glDeleteBuffers(1, &buffer);
+			}
+		}
+	}
+
+	bool UniformBlocks::Initialize(size_t initialMaterials)
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		alignment = std::max(alignment, 1);
+		materialStride = (sizeof(MaterialBlock) + alignment - 1) / alignment * alignment;
+
+		glGenBuffers(1, &frameBuffer);
+		glGenBuffers(1, &materialBuffer);
+		GlState::Instance().BindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), nullptr, GL_DYNAMIC_DRAW);
+
+		std::memset(&frame, 0, sizeof(frame));
+		ReserveMaterials(std::max<size_t>(initialMaterials, 1));
+
+		if (glGetError() != GL_NO_ERROR)
+		{
+			spdlog::error("Couldn't create the uniform buffers");
+			return false;
+		}
+		return true;
+	}
+
+	void UniformBlocks::BindProgram(GLuint program)
+	{
+		const GLuint frameIndex = glGetUniformBlockIndex(program, "Frame_Block");
+		if (frameIndex != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(program, frameIndex, FRAME_BLOCK_BINDING);
+		}
+		const GLuint materialIndex = glGetUniformBlockIndex(program, "Material_Block");
+		if (materialIndex != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(program, materialIndex, MATERIAL_BLOCK_BINDING);
+		}
+	}
+
+	void UniformBlocks::ReserveMaterials(size_t count)
+	{
+		if (count <= materialCapacity)
+		{
+			return;
+		}
+		materialCapacity = std::max(count, materialCapacity * 2);
+		materialData.resize(materialCapacity * materialStride);
+
+		//A new store: whatever range was bound points into the old one.
+		GlState::Instance().BindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, GLsizeiptr(materialData.size()), materialData.data(), GL_DYNAMIC_DRAW);
+		GlState::Instance().ForgetBuffer(materialBuffer);
+	}
+
+	void UniformBlocks::CollectLights(const glt::Matrix44& view, const std::vector<glt::Node*>& nodes, std::vector<FrameLight>& lights)
+	{
+		lights.clear();
+		for (glt::Node* node : nodes)
+		{
+			if (const glt::Light* light = dynamic_cast<const glt::Light*>(node))
+			{
+				lights.push_back({ view * light->get_total_transformation()[3], glm::vec4(light->get_color() * light->get_intensity(), 1.f) });
+			}
+		}
+	}
+
+	void UniformBlocks::UpdateFrame(const glt::Matrix44& view, const glt::Matrix44& projection, const std::vector<FrameLight>& lights,
+		const glm::vec4& ambient)
+	{
+		frame.view = view;
+		frame.projection = projection;
+		frame.ambient = ambient;
+
+		const int count = int(std::min<size_t>(lights.size(), MAX_FRAME_LIGHTS));
+		std::copy(lights.begin(), lights.begin() + count, frame.lights);
+		frame.lightCount = glm::ivec4(count, 0, 0, 0);
+
+		//Only the lights in use are uploaded.
+		GlState::Instance().BindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, GLsizeiptr(offsetof(FrameBlock, lights) + count * sizeof(FrameLight)), &frame);
+		GlState::Instance().BindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, frameBuffer);
+	}
+
+	void UniformBlocks::SetClusters(const LightClusters* clusters, float viewportWidth, float viewportHeight)
+	{
+		if (!clusters)
+		{
+			frame.clusterGrid = glm::vec4(0, 0, 0, 0);
+			frame.clusterDepth = glm::vec4(0, 0, 0, 0);
+			return;
+		}
+		frame.clusterGrid = glm::vec4(float(clusters->GetTilesX()), float(clusters->GetTilesY()), float(clusters->GetSlices()), 0.f);
+		frame.clusterDepth = glm::vec4(clusters->GetSliceScale(), clusters->GetSliceBias(), viewportWidth, viewportHeight);
+	}
+
+	unsigned UniformBlocks::AddMaterial(const MaterialBlock& material)
+	{
+		ReserveMaterials(materialCount + 1);
+		const unsigned slot = materialCount++;
+		SetMaterial(slot, material);
+		return slot;
+	}
+
+	void UniformBlocks::SetMaterial(unsigned slot, const MaterialBlock& material)
+	{
+		std::memcpy(materialData.data() + slot * materialStride, &material, sizeof(material));
+		GlState::Instance().BindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, GLintptr(slot * materialStride), sizeof(material), &material);
+	}
+
+	void UniformBlocks::BindMaterial(unsigned slot)
+	{
+		GlState::Instance().BindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, materialBuffer,
+			GLintptr(slot * materialStride), GLsizeiptr(sizeof(MaterialBlock)));
+	}
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <gltk/OpenGL.hpp>
+#include <gltk/Math.hpp>
+#include <gltk/Node.hpp>
+#include <Render/LightClusters.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Lights a shader using the frame block can see at once.
+	/// </summary>
+	const unsigned MAX_FRAME_LIGHTS = 64;
+
+	/// <summary>
+	/// Binding points of the blocks. Shaders get them from UniformBlocks::BindProgram().
+	/// </summary>
+	enum UniformBlockBinding : GLuint
+	{
+		FRAME_BLOCK_BINDING = 0,
+		MATERIAL_BLOCK_BINDING = 1
+	};
+
+	/// <summary>
+	/// std140 layout of FRAME_BLOCK_SOURCE: every member is a multiple of 16 bytes, so the C++ struct
+	/// matches without padding.
+	/// </summary>
+	struct FrameLight
+	{
+		/// <summary>
+		/// View space, w unused.
+		/// </summary>
+		glm::vec4 position;
+		/// <summary>
+		/// Color times intensity, w unused.
+		/// </summary>
+		glm::vec4 color;
+	};
+
+	struct FrameBlock
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 ambient;
+		/// <summary>
+		/// x: lights in use.
+		/// </summary>
+		glm::ivec4 lightCount;
+		/// <summary>
+		/// Clustered point lights (see ClusteredLighting). Grid: tiles x, tiles y, slices (0 without
+		/// clusters). Depth: slice scale and bias, viewport width and height.
+		/// </summary>
+		glm::vec4 clusterGrid;
+		glm::vec4 clusterDepth;
+		FrameLight lights[MAX_FRAME_LIGHTS];
+	};
+
+	/// <summary>
+	/// std140 layout of MATERIAL_BLOCK_SOURCE.
+	/// </summary>
+	struct MaterialBlock
+	{
+		glm::vec4 color = glm::vec4(1, 1, 1, 1);
+		/// <summary>
+		/// rgb: specular color, w: shininess.
+		/// </summary>
+		glm::vec4 specular = glm::vec4(0.3f, 0.3f, 0.3f, 32.f);
+	};
+
+	static_assert(sizeof(FrameBlock) == 192 + 32 * MAX_FRAME_LIGHTS, "FrameBlock must match the std140 layout");
+	static_assert(sizeof(MaterialBlock) == 32, "MaterialBlock must match the std140 layout");
+
+	/// <summary>
+	/// Per-frame and per-material uniform buffers shared by every program that declares the blocks.
+	///
+	/// The frame block (camera and lights) is uploaded and bound once per frame. Material blocks are
+	/// packed into a single buffer, each at its own aligned offset, and a material is selected by binding
+	/// its range: switching materials costs a glBindBufferRange instead of a glUniform* per value.
+	///
+	/// Only engine shaders can use them: the toolkit's own programs still get loose uniforms.
+	/// </summary>
+	class UniformBlocks
+	{
+	private:
+		GLuint frameBuffer = 0;
+		GLuint materialBuffer = 0;
+
+		/// <summary>
+		/// Bytes between two material blocks, GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT rounded up.
+		/// </summary>
+		size_t materialStride = 0;
+		size_t materialCapacity = 0;
+		/// <summary>
+		/// CPU copy of the material buffer, reuploaded when it grows.
+		/// </summary>
+		std::vector<uint8_t> materialData;
+		unsigned materialCount = 0;
+
+		FrameBlock frame;
+
+		void ReserveMaterials(size_t count);
+
+	public:
+		/// <summary>
+		/// Declaration of the frame block, to paste into shader code after the #version line.
+		/// </summary>
+		static const char* FRAME_BLOCK_SOURCE;
+		static const char* MATERIAL_BLOCK_SOURCE;
+
+		UniformBlocks() = default;
+		~UniformBlocks();
+
+		UniformBlocks(const UniformBlocks&) = delete;
+		UniformBlocks& operator = (const UniformBlocks&) = delete;
+
+		/// <summary>
+		/// Creates the buffers. Needs the GL context.
+		/// </summary>
+		bool Initialize(size_t initialMaterials = 64);
+
+		/// <summary>
+		/// Points the program's blocks (those it declares) at the shared binding points. Once per program.
+		/// </summary>
+		static void BindProgram(GLuint program);
+
+		/// <summary>
+		/// Replaces lights with the glt::Lights among the nodes, as the frame block takes them. Reads the
+		/// nodes: on the thread that changes them.
+		/// </summary>
+		static void CollectLights(const glt::Matrix44& view, const std::vector<glt::Node*>& nodes, std::vector<FrameLight>& lights);
+
+		/// <summary>
+		/// Uploads the camera and the lights, and binds the frame block. Lights past MAX_FRAME_LIGHTS are ignored.
+		/// </summary>
+		void UpdateFrame(const glt::Matrix44& view, const glt::Matrix44& projection, const std::vector<FrameLight>& lights,
+			const glm::vec4& ambient = glm::vec4(0.2f, 0.2f, 0.2f, 1.f));
+
+		/// <summary>
+		/// Grid the clustered lights were binned with, uploaded with the next UpdateFrame().
+		/// nullptr turns the clustered lights off.
+		/// </summary>
+		void SetClusters(const LightClusters* clusters, float viewportWidth, float viewportHeight);
+
+		/// <returns>Slot of the new material block</returns>
+		unsigned AddMaterial(const MaterialBlock& material);
+		void SetMaterial(unsigned slot, const MaterialBlock& material);
+
+		/// <summary>
+		/// Binds the material's range of the shared buffer. Does nothing if it's already bound.
+		/// </summary>
+		void BindMaterial(unsigned slot);
+
+		unsigned GetMaterialCount() const { return materialCount; }
+		unsigned GetLightCount() const { return unsigned(frame.lightCount.x); }
+	};
+}
@@ -36,6 +36,11 @@ namespace engine
 			spdlog::info("Starting up entities' transforms...");
 			for (auto& entity : GetSystemEntities())
 			{
+				//Entities without a node (ex: point lights) keep their transform as is.
+				if (!entity.HasComponent<Node3DComponent>())
+				{
+					continue;
+				}
 				std::shared_ptr<glt::Node> node = entity.GetComponent<Node3DComponent>().node;
 				auto& transform = entity.GetComponent<TransformComponent>();
 
@@ -6,7 +6,22 @@
 #include <ECS/ECS.h>
 #include <Components/TransformComponent.h>
 #include <Components/Node3DComponent.h>
+#include <Components/RigidbodyComponent.h>
 #include <Window/Window.h>
+#include <Input/InputState.h>
+#include <Input/LateLatch.h>
+#include <Kernel/FrameStats.h>
+#include <Render/RenderQueue.h>
+#include <Render/InstancedRenderer.h>
+#include <Render/RenderResourceRegistry.h>
+#include <Render/AabbTree.h>
+#include <Render/OcclusionCuller.h>
+#include <Render/ClusteredLighting.h>
+#include <Render/StaticBatcher.h>
+#include <Render/RenderThread.h>
+#include <gltk/Light.hpp>
+#include <Jobs/JobSystem.h>
+#include <Systems/PointLight3DSystem.h>
 #include <spdlog/spdlog.h>
 
 namespace engine
@@ -15,6 +30,355 @@ namespace engine
 	{
 		std::unique_ptr<glt::Render_Node> glRenderer;
 		Window* window;
+
+		/// <summary>
+		/// The Render_Node still owns the camera and numbers the lights, but the draws go through the queue.
+		/// </summary>
+		RenderQueue renderQueue;
+		InstancedRenderer instancedRenderer;
+		UniformBlocks uniformBlocks;
+		/// <summary>
+		/// Shared buffers of every mesh drawn, so switching meshes doesn't switch vertex arrays.
+		/// </summary>
+		MeshPool meshPool;
+		/// <summary>
+		/// Binaries of the engine's shaders, kept between launches.
+		/// </summary>
+		ShaderCache shaderCache;
+
+		/// <summary>
+		/// Point lights of the scene, binned per cluster every frame for the instanced shader.
+		/// </summary>
+		ClusteredLighting clusteredLighting;
+		PointLight3DSystem* pointLights = nullptr;
+
+		struct RenderedModel
+		{
+			glt::Model* model;
+			Entity entity;
+			/// <summary>
+			/// In model space. Infinite when the meshes have no known bounds: the model is never culled.
+			/// </summary>
+			Aabb localBounds;
+			/// <summary>
+			/// In the culling tree, -1 if it's never culled.
+			/// </summary>
+			int proxy;
+			/// <summary>
+			/// Its bounds are updated every frame: it has a rigidbody or a parent.
+			/// </summary>
+			bool dynamic;
+			/// <summary>
+			/// Hides what's behind it, see Node3DComponent::occluder.
+			/// </summary>
+			bool occluder;
+			/// <summary>
+			/// Flagged static (Node3DComponent::isStatic), and merged into the static batches if batched.
+			/// Batched models stay in the culling tree as occluders, but aren't queued.
+			/// </summary>
+			bool isStatic;
+			bool batched;
+			/// <summary>
+			/// Color it was batched with. Batched models are always visible ones.
+			/// </summary>
+			glm::vec4 batchedColor;
+		};
+
+		std::vector<RenderedModel> models;
+
+		/// <summary>
+		/// Set by MarkMoved() and MarkStatic() on the simulation side, one per model. They reach the
+		/// models with the next snapshot.
+		/// </summary>
+		struct ModelChanges
+		{
+			bool isStatic;
+			bool dynamic;
+			bool moved;
+		};
+		std::vector<ModelChanges> modelChanges;
+
+		/// <summary>
+		/// Frames are always drawn from a snapshot. Without the render thread it's this one, taken right
+		/// before drawing.
+		/// </summary>
+		FrameSnapshot snapshot;
+		unsigned long long capturedFrames = 0;
+		bool renderThreadEnabled = false;
+
+		/// <summary>
+		/// The scene's lights, read by Capture() only.
+		/// </summary>
+		std::vector<glt::Node*> sceneLights;
+		/// <summary>
+		/// Stand-ins for the scene's lights on the drawing side, placed from the snapshot every frame: the
+		/// toolkit's shaders get their light uniforms from them (glt::Light::shader_changed()). They sit in
+		/// view space, under a camera at the origin.
+		/// </summary>
+		std::unique_ptr<glt::Render_Node> lightStage;
+		std::vector<std::shared_ptr<glt::Light>> stageLights;
+		std::vector<glt::Node*> shaderListeners;
+
+		RenderResourceRegistry* renderResources = nullptr;
+		AabbTree cullingTree;
+		bool cullingTreeBuilt = false;
+		std::vector<int> visibleModels;
+		CullingStats cullingStats;
+
+		bool occlusionCulling = false;
+		OcclusionCuller occlusionCuller;
+
+		StaticBatcher staticBatcher;
+		bool staticBatchesBuilt = false;
+		std::vector<unsigned> visibleCells;
+
+		/// <summary>
+		/// One per recording batch, at most one per thread of the JobSystem. Their arrays are kept
+		/// between frames.
+		/// </summary>
+		std::vector<RenderCommandBuffer> commandBuffers;
+
+		/// <summary>
+		/// Records the visible models on the JobSystem workers, a buffer per batch, and merges the
+		/// buffers into the queue in order. The GL thread only sorts and submits afterwards.
+		/// </summary>
+		void RecordVisibleModels(const FrameSnapshot& frame)
+		{
+			if (commandBuffers.empty())
+			{
+				commandBuffers.resize(JobSystem::Instance().GetWorkerCount() + 1);
+			}
+			//Small batches cost more to schedule than to record.
+			const size_t batchSize = std::max<size_t>(64, (visibleModels.size() + commandBuffers.size() - 1) / commandBuffers.size());
+			for (RenderCommandBuffer& buffer : commandBuffers)
+			{
+				buffer.Begin(frame.view, frame.farPlane);
+			}
+
+			JobSystem::Instance().ParallelFor(visibleModels.size(), batchSize, [this, &frame, batchSize](size_t begin, size_t end)
+				{
+					RenderCommandBuffer& buffer = commandBuffers[begin / batchSize];
+					for (size_t i = begin; i < end; i++)
+					{
+						const RenderedModel& model = models[visibleModels[i]];
+						const ModelSnapshot& state = frame.models[visibleModels[i]];
+						if (!model.batched && state.visible)
+						{
+							buffer.Add(*model.model, state.transform, RenderPass::OPAQUE_PASS, state.color);
+						}
+					}
+				});
+
+			for (const RenderCommandBuffer& buffer : commandBuffers)
+			{
+				renderQueue.Merge(buffer);
+			}
+		}
+
+		/// <summary>
+		/// Merges the static models whose materials the instanced shader can stand in for. Done on the
+		/// first frame like the culling tree, and again after a static model is moved.
+		/// </summary>
+		void BuildStaticBatches(const FrameSnapshot& frame)
+		{
+			staticBatcher.Clear();
+			for (size_t i = 0; i < models.size(); i++)
+			{
+				RenderedModel& model = models[i];
+				const ModelSnapshot& state = frame.models[i];
+				model.batched = false;
+				if (!model.isStatic || !state.visible)
+				{
+					continue;
+				}
+				bool instanced = !model.model->get_pieces().empty();
+				for (const auto& piece : model.model->get_pieces())
+				{
+					instanced = instanced && renderQueue.IsInstanced(piece.material.get());
+				}
+				model.batched = instanced && staticBatcher.Add(*model.model, state.transform, state.color);
+				model.batchedColor = state.color;
+			}
+			staticBatcher.Build();
+			staticBatchesBuilt = true;
+		}
+
+		/// <summary>
+		/// Removes from visibleModels the models hidden behind the visible occluders.
+		/// </summary>
+		void CullOccluded(const glt::Matrix44& viewProjection, const FrameSnapshot& frame)
+		{
+			occlusionCuller.Begin(viewProjection);
+			for (int index : visibleModels)
+			{
+				const RenderedModel& model = models[index];
+				//A hidden wall hides nothing.
+				if (model.occluder && frame.models[index].visible)
+				{
+					occlusionCuller.AddOccluder(model.localBounds, frame.models[index].transform);
+				}
+			}
+			if (occlusionCuller.GetOccluderTriangleCount() == 0)
+			{
+				return;
+			}
+			occlusionCuller.Rasterize();
+
+			size_t kept = 0;
+			for (int index : visibleModels)
+			{
+				const RenderedModel& model = models[index];
+				//Occluders are kept: their own box is never behind itself, and testing them costs as much.
+				if (model.occluder || model.proxy < 0
+					|| occlusionCuller.IsVisible(model.localBounds.Transform(frame.models[index].transform)))
+				{
+					visibleModels[kept++] = index;
+				}
+			}
+			cullingStats.occluded = unsigned(visibleModels.size() - kept);
+			cullingStats.drawn -= std::min(cullingStats.drawn, cullingStats.occluded);
+			visibleModels.resize(kept);
+		}
+
+		/// <summary>
+		/// Puts every bounded model in the culling tree, and its meshes in the pool. Done on the first
+		/// frame, once every system has placed its nodes.
+		/// </summary>
+		void BuildCullingTree(const FrameSnapshot& frame)
+		{
+			cullingTree.Clear();
+			meshPool.Collect();
+			for (size_t i = 0; i < models.size(); i++)
+			{
+				RenderedModel& model = models[i];
+				if (meshPool.IsReady())
+				{
+					for (const auto& piece : model.model->get_pieces())
+					{
+						meshPool.Add(piece.drawable);
+					}
+				}
+				model.localBounds = renderResources ? renderResources->GetBounds(*model.model) : Aabb::Infinite();
+				model.proxy = model.localBounds.IsInfinite() || model.localBounds.IsEmpty() ? -1
+					: cullingTree.CreateProxy(model.localBounds.Transform(frame.models[i].transform), int(i));
+			}
+			cullingTreeBuilt = true;
+		}
+
+		LateLatch* lateLatch = nullptr;
+		FrameStats* frameStats = nullptr;
+		std::shared_ptr<InputState> inputState;
+
+		/// <summary>
+		/// Declared last: it's stopped, and the GL context back on this thread, before the GL resources
+		/// above are released.
+		/// </summary>
+		std::unique_ptr<RenderThread> renderThread;
+
+		/// <summary>
+		/// Copies what the frame needs of the scene. Simulation thread.
+		/// </summary>
+		void Capture(FrameSnapshot& frame)
+		{
+			frame.frame = capturedFrames++;
+			glt::Camera* camera = glRenderer->get_active_camera();
+			frame.hasCamera = camera != nullptr;
+			if (camera)
+			{
+				frame.view = camera->get_inverse_total_transformation();
+				frame.projection = camera->get_projection_matrix();
+				frame.farPlane = camera->get_far();
+			}
+
+			frame.models.resize(models.size());
+			for (size_t i = 0; i < models.size(); i++)
+			{
+				const RenderedModel& model = models[i];
+				ModelSnapshot& state = frame.models[i];
+				state.transform = model.model->get_total_transformation();
+				state.color = model.entity.GetComponent<Node3DComponent>().color;
+				state.visible = !model.model->is_not_visible();
+				state.isStatic = modelChanges[i].isStatic;
+				state.dynamic = modelChanges[i].dynamic;
+				state.moved = modelChanges[i].moved;
+				modelChanges[i].moved = false;
+			}
+
+			UniformBlocks::CollectLights(frame.view, sceneLights, frame.lights);
+
+			frame.hasPointLights = pointLights != nullptr;
+			if (pointLights)
+			{
+				pointLights->Collect(frame.pointLights);
+			}
+			frame.inputSampleTime = inputState ? inputState->GetLastSampleTime() : 0;
+		}
+
+		/// <summary>
+		/// Takes in the changes to the models made since the previous snapshot.
+		/// </summary>
+		void ApplyChanges(const FrameSnapshot& frame)
+		{
+			for (size_t i = 0; i < models.size(); i++)
+			{
+				RenderedModel& model = models[i];
+				const ModelSnapshot& state = frame.models[i];
+				if (state.isStatic != model.isStatic)
+				{
+					model.isStatic = state.isStatic;
+					staticBatchesBuilt = false;
+				}
+				model.dynamic = state.dynamic;
+				if (state.moved && model.proxy >= 0)
+				{
+					cullingTree.MoveProxy(model.proxy, model.localBounds.Transform(state.transform));
+				}
+				//The batches keep their own copy of the transform and color.
+				if (model.batched && (state.moved || !state.visible || state.color != model.batchedColor))
+				{
+					staticBatchesBuilt = false;
+				}
+			}
+		}
+
+		/// <summary>
+		/// Clears, draws the snapshot and swaps. On the render thread if there is one.
+		/// </summary>
+		void DrawFrame(const FrameSnapshot& frame)
+		{
+			glClearColor(0.2, 0.2f, 0.2f, 1);
+			window->Clear();
+			Render(frame);
+			window->SwapBuffers();
+
+			//Input replays never sample the live input, there is nothing to measure then.
+			if (frameStats && frame.inputSampleTime != 0)
+			{
+				frameStats->AddInputToPresent(double(SDL_GetPerformanceCounter() - frame.inputSampleTime) / SDL_GetPerformanceFrequency());
+			}
+		}
+
+		void StartRenderThread()
+		{
+			renderThread.reset(new RenderThread(*window));
+			if (!renderThread->Start([this](const FrameSnapshot& frame) { DrawFrame(frame); }))
+			{
+				spdlog::error("Couldn't start the render thread, rendering on the main thread");
+				renderThread.reset();
+				renderThreadEnabled = false;
+			}
+		}
+
+		void StopRenderThread()
+		{
+			renderThread->Stop();
+			const RenderThreadStats stats = renderThread->GetStats();
+			spdlog::info("Render thread: {} frames, simulation {:.2f} ms/frame ({:.2f} waiting), render {:.2f} ms/frame ({:.2f} waiting), "
+				"snapshot to present {:.2f} ms", stats.renderedFrames, stats.simulation.averageFrameTime * 1000.0,
+				stats.simulation.averageWaitTime * 1000.0, stats.render.averageFrameTime * 1000.0, stats.render.averageWaitTime * 1000.0,
+				stats.averageLatency * 1000.0);
+			renderThread.reset();
+		}
 	public:
 		ModelRender3DSystem(Window& window)
 		{
@@ -25,6 +389,10 @@ namespace engine
 			this->glRenderer.reset(new glt::Render_Node);
 			//glRenderer = new glt::Render_Node;
 			this->window = &window;
+
+			lightStage.reset(new glt::Render_Node);
+			lightStage->add("camera", std::shared_ptr<glt::Camera>(new glt::Camera(20.f, 1.f, 500.f, 1.f)));
+			lightStage->set_active_camera("camera");
 		}
 
 		//static std::shared_ptr< System > CreateInstance(glt::Render_Node& glRenderer, Window& window)
@@ -32,6 +400,132 @@ namespace engine
 		//	return std::make_shared<ModelRender3DSystem>(glRenderer, window);
 		//}
 
+		/// <summary>
+		/// Called around every render submission to correct the scene with the freshest input.
+		/// nullptr disables it.
+		/// </summary>
+		void SetLateLatch(LateLatch* latch)
+		{
+			lateLatch = latch;
+		}
+
+		/// <summary>
+		/// Latency from the latest input sample to the buffer swap will be measured into stats.
+		/// </summary>
+		void SetFrameStats(FrameStats& stats, std::shared_ptr<InputState> inputState)
+		{
+			this->frameStats = &stats;
+			this->inputState = inputState;
+		}
+
+		/// <summary>
+		/// Where the mesh bounds come from. Without it nothing is culled.
+		/// </summary>
+		void SetRenderResources(RenderResourceRegistry* resources)
+		{
+			renderResources = resources;
+			cullingTreeBuilt = false;
+		}
+
+		/// <summary>
+		/// Models without rigidbody or parent are considered static. Call this after moving one.
+		/// </summary>
+		void MarkMoved(Entity entity)
+		{
+			for (size_t i = 0; i < models.size(); i++)
+			{
+				if (models[i].entity == entity)
+				{
+					modelChanges[i].moved = true;
+				}
+			}
+		}
+
+		/// <summary>
+		/// Static models are merged into shared buffers, drawn per cell instead of per model. Static
+		/// models that are moved anyway need MarkMoved().
+		/// </summary>
+		void MarkStatic(Entity entity, bool isStatic = true)
+		{
+			for (size_t i = 0; i < models.size(); i++)
+			{
+				if (models[i].entity == entity && entity.GetComponent<TransformComponent>().parent == NULL)
+				{
+					modelChanges[i].isStatic = isStatic;
+					modelChanges[i].dynamic = !isStatic && entity.HasComponent<RigidbodyComponent>();
+				}
+			}
+		}
+
+		const StaticBatcher& GetStaticBatcher() const { return staticBatcher; }
+		MeshPoolStats GetMeshPoolStats() const { return meshPool.GetStats(); }
+		const ShaderCacheStats& GetShaderCacheStats() const { return shaderCache.GetStats(); }
+
+		/// <summary>
+		/// Models flagged as occluders hide the models behind them from then on. Off by default: it only
+		/// pays off in scenes with big occluders in front of many models.
+		/// </summary>
+		void EnableOcclusionCulling(bool enable)
+		{
+			occlusionCulling = enable;
+		}
+
+		/// <summary>
+		/// Where the point lights come from. nullptr turns them off.
+		/// </summary>
+		void SetPointLights(PointLight3DSystem* lights)
+		{
+			pointLights = lights;
+		}
+
+		/// <summary>
+		/// Draws on a thread of its own, which takes the GL context, from snapshots of the scene: frame N
+		/// is drawn while the simulation computes frame N + 1. It starts with the next Run(), after
+		/// Initialize(). The late latch is ignored meanwhile, the snapshot is taken too early for it.
+		/// Disable it before SDL shuts down; its stats are logged then.
+		/// </summary>
+		void EnableRenderThread(bool enable)
+		{
+			renderThreadEnabled = enable;
+			if (!enable && renderThread)
+			{
+				StopRenderThread();
+			}
+		}
+
+		/// <summary>
+		/// Runs work that needs the GL context: posted to the render thread if there's one, right away otherwise.
+		/// </summary>
+		void RunOnRenderThread(std::function<void()> work)
+		{
+			if (renderThread)
+			{
+				renderThread->Post(std::move(work));
+			}
+			else
+			{
+				work();
+			}
+		}
+
+		/// <summary>
+		/// Frame times, waits and latency of both threads. All zero without the render thread.
+		/// </summary>
+		RenderThreadStats GetRenderThreadStats() const
+		{
+			return renderThread ? renderThread->GetStats() : RenderThreadStats();
+		}
+
+		/// <summary>
+		/// Frustum and occlusion culling counters of the last frame.
+		/// </summary>
+		const CullingStats& GetCullingStats() const { return cullingStats; }
+
+		/// <summary>
+		/// GL calls issued and skipped as redundant during the last complete frame.
+		/// </summary>
+		const GlState::Counters& GetGlStateCounters() const { return GlState::Instance().GetLastFrameCounters(); }
+
 		bool Initialize()
 		{
 			spdlog::info("Adding entities to OpenGL renderer...");
@@ -39,6 +533,23 @@ namespace engine
 			{
 				Node3DComponent openGlComp = entity.GetComponent<Node3DComponent>();
 				glRenderer->add(openGlComp.modelId, openGlComp.node);
+				if (glt::Model* model = dynamic_cast<glt::Model*>(openGlComp.node.get()))
+				{
+					const TransformComponent& transform = entity.GetComponent<TransformComponent>();
+					const bool dynamic = entity.HasComponent<RigidbodyComponent>() || transform.parent != NULL;
+					const bool isStatic = openGlComp.isStatic && transform.parent == NULL;
+					models.push_back({ model, entity, Aabb::Infinite(), -1, dynamic && !isStatic, openGlComp.occluder, isStatic, false, glm::vec4(1, 1, 1, 1) });
+					modelChanges.push_back({ isStatic, dynamic && !isStatic, false });
+				}
+				if (glt::Light* light = dynamic_cast<glt::Light*>(openGlComp.node.get()))
+				{
+					//Added in the same order, the stand-ins get the same light indices.
+					std::shared_ptr<glt::Light> stageLight(new glt::Light);
+					lightStage->add(openGlComp.modelId, stageLight);
+					sceneLights.push_back(light);
+					stageLights.push_back(stageLight);
+					shaderListeners.push_back(stageLight.get());
+				}
 				spdlog::info("Added \"" + openGlComp.modelId + "\" to renderer system");
 			}
 
@@ -47,15 +558,125 @@ namespace engine
 			glRenderer->get_active_camera()->set_aspect_ratio(float(width) / height);
 			glViewport(0, 0, width, height);
 
+			if (meshPool.Initialize())
+			{
+				renderQueue.SetMeshPool(&meshPool);
+			}
+
+			//Nodes sharing a mesh with the default material are drawn instanced. Without the instanced
+			//shader everything still goes through the regular path.
+			shaderCache.Initialize();
+			if (uniformBlocks.Initialize() && instancedRenderer.Initialize(&shaderCache))
+			{
+				renderQueue.SetUniformBlocks(&uniformBlocks);
+				renderQueue.SetInstancing(&instancedRenderer);
+				renderQueue.EnableInstancing(glt::Material::default_material().get());
+				//Pooled meshes of the same material go in one multi-draw, whatever the mesh.
+				renderQueue.EnableMultiDraw(meshPool.IsReady());
+				clusteredLighting.Initialize();
+			}
+			const ShaderCacheStats& shaders = shaderCache.GetStats();
+			spdlog::info("Shaders: " + std::to_string(shaders.loaded) + " loaded from binaries, " + std::to_string(shaders.compiled)
+				+ " compiled, " + std::to_string(shaders.rejected) + " binaries rejected, " + std::to_string(shaders.milliseconds) + " ms");
+
 			return true;
 		}
 
+		/// <summary>
+		/// Queues the models the camera of the snapshot sees, sorts the queue and submits it.
+		/// </summary>
+		void Render(const FrameSnapshot& frame)
+		{
+			if (!frame.hasCamera)
+			{
+				return;
+			}
+
+			//Assets loaded since the last frame may have bound anything.
+			GlState::Instance().BeginFrame();
+
+			ApplyChanges(frame);
+			if (!cullingTreeBuilt)
+			{
+				BuildCullingTree(frame);
+			}
+			if (!staticBatchesBuilt)
+			{
+				BuildStaticBatches(frame);
+			}
+
+			visibleModels.clear();
+			for (size_t i = 0; i < models.size(); i++)
+			{
+				const RenderedModel& model = models[i];
+				if (model.proxy < 0)
+				{
+					visibleModels.push_back(int(i));
+				}
+				else if (model.dynamic)
+				{
+					cullingTree.MoveProxy(model.proxy, model.localBounds.Transform(frame.models[i].transform));
+				}
+			}
+
+			cullingStats = CullingStats();
+			const glt::Matrix44 viewProjection = frame.projection * frame.view;
+			cullingTree.Query(Frustum::FromMatrix(viewProjection), visibleModels, cullingStats);
+			if (occlusionCulling)
+			{
+				CullOccluded(viewProjection, frame);
+			}
+
+			renderQueue.Begin(frame.view, frame.projection, frame.farPlane);
+			RecordVisibleModels(frame);
+			visibleCells.clear();
+			staticBatcher.Cull(Frustum::FromMatrix(viewProjection), visibleCells);
+			renderQueue.AddStaticCells(staticBatcher, visibleCells);
+			renderQueue.Sort();
+
+			if (frame.hasPointLights && clusteredLighting.IsReady())
+			{
+				clusteredLighting.Update(frame.view, frame.projection, frame.pointLights);
+				clusteredLighting.Bind();
+				uniformBlocks.SetClusters(&clusteredLighting.GetClusters(), float(window->GetWidth()), float(window->GetHeight()));
+			}
+			else
+			{
+				uniformBlocks.SetClusters(nullptr, 0.f, 0.f);
+			}
+
+			for (size_t i = 0; i < stageLights.size() && i < frame.lights.size(); i++)
+			{
+				stageLights[i]->set_transformation(glt::translate(glt::Matrix44(1), glt::Vector3(frame.lights[i].position)));
+				stageLights[i]->set_color(glt::Vector3(frame.lights[i].color));
+			}
+			renderQueue.Submit(shaderListeners, frame.lights);
+		}
+
 		void Run(float deltaTime)
 		{
-			glClearColor(0.2, 0.2f, 0.2f, 1);
-			window->Clear();
-			glRenderer->render();
-			window->SwapBuffers();
+			if (renderThreadEnabled && !renderThread)
+			{
+				StartRenderThread();
+			}
+			if (renderThread)
+			{
+				Capture(renderThread->AcquireSnapshot());
+				renderThread->Publish();
+				return;
+			}
+
+			if (lateLatch)
+			{
+				lateLatch->Latch();
+				Capture(snapshot);
+				lateLatch->Unlatch();
+			}
+			else
+			{
+				Capture(snapshot);
+			}
+			DrawFrame(snapshot);
 		}
 	};
 }
\ No newline at end of file
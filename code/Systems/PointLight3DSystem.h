@@ -0,0 +1,59 @@
+#pragma once
+
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <ECS/ECS.h>
+#include <Components/TransformComponent.h>
+#include <Components/PointLightComponent.h>
+#include <Render/LightClusters.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Gathers the point lights of the scene for the renderer (see ModelRender3DSystem::SetPointLights()).
+	/// </summary>
+	class PointLight3DSystem : public System
+	{
+	public:
+		PointLight3DSystem()
+		{
+			// We specify the components that our system is interested in.
+			RequireComponent<TransformComponent>();
+			RequireComponent<PointLightComponent>();
+		}
+
+		static std::shared_ptr< System > CreateInstance()
+		{
+			return std::make_shared<PointLight3DSystem>();
+		}
+
+		/// <summary>
+		/// Replaces the contents of lights with the lights of every entity, in world space. The position
+		/// is the transform's own: parents are not applied.
+		/// </summary>
+		void Collect(std::vector<PointLight>& lights) const
+		{
+			lights.clear();
+			for (const auto& entity : GetSystemEntities())
+			{
+				const auto& transform = entity.GetComponent<TransformComponent>();
+				const auto& light = entity.GetComponent<PointLightComponent>();
+
+				PointLight pointLight;
+				pointLight.position = transform.position;
+				pointLight.radius = light.radius;
+				pointLight.color = light.color;
+				pointLight.intensity = light.intensity;
+				lights.push_back(pointLight);
+			}
+		}
+
+		void Run(float deltaTime)
+		{
+
+		}
+	};
+}
@@ -3,11 +3,17 @@
  *  Copyright (c) Lorenzo Herran - 2021   *
 \******************************************/
 
+#include <vector>
+#include <algorithm>
+#include <cmath>
 #include <sdl2/SDL.h>
 #include <ECS/ECS.h>
 #include <Components/TransformComponent.h>
 #include <Components/SpriteComponent.h>
 #include <AssetManager/AssetManager.h>
+#include <Render/SpriteBatch.h>
+#include <Render/Camera2D.h>
+#include <Render/SpatialGrid.h>
 
 namespace engine
 {
@@ -15,6 +21,49 @@ namespace engine
 	{
 	private:
 		SDL_Renderer* renderer;
+		SpriteBatch spriteBatch;
+
+		SpatialGrid grid;
+		/// <summary>
+		/// Entities of the system indexed by id, to go back from the grid results.
+		/// </summary>
+		std::vector<Entity> entityById;
+		std::vector<int> visibleIds;
+		/// <summary>
+		/// Sprites drawn last frame, after the exact test on the grid's candidates.
+		/// </summary>
+		size_t visibleCount = 0;
+
+		/// <summary>
+		/// Box holding the sprite whatever its rotation (the square around its diagonal when rotated).
+		/// </summary>
+		static SDL_FRect GetBounds(const SDL_FRect& rect, float angle)
+		{
+			if (angle == 0.f)
+			{
+				return rect;
+			}
+			const float diagonal = std::sqrt(rect.w * rect.w + rect.h * rect.h);
+			return {
+				rect.x + (rect.w - diagonal) * 0.5f,
+				rect.y + (rect.h - diagonal) * 0.5f,
+				diagonal,
+				diagonal
+			};
+		}
+
+		static SDL_FRect GetBounds(const Entity& entity)
+		{
+			const TransformComponent& transform = entity.GetComponent<TransformComponent>();
+			const SpriteComponent& sprite = entity.GetComponent<SpriteComponent>();
+			return GetBounds({ transform.position.x, transform.position.y, sprite.width * transform.scale.x, sprite.height * transform.scale.y },
+				transform.rotation.x);
+		}
+
+		static bool Overlaps(const SDL_FRect& a, const SDL_FRect& b)
+		{
+			return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+		}
 	public:
 		RenderSystem()
 		{
@@ -30,38 +79,112 @@ namespace engine
 		//}
 
 
-		void Render(SDL_Renderer* renderer, std::unique_ptr<AssetManager>& assetStore)
+		void OnEntityAdded(Entity entity) override
+		{
+			const size_t id = size_t(entity.GetId());
+			if (id >= entityById.size())
+			{
+				entityById.resize(id + 1);
+			}
+			entityById[id] = entity;
+			grid.Update(entity.GetId(), GetBounds(entity));
+		}
+
+		void OnEntityRemoved(Entity entity) override
+		{
+			grid.Remove(entity.GetId());
+		}
+
+		/// <summary>
+		/// Draws the sprites that the camera sees. Sprites are drawn in the same order as without culling.
+		/// </summary>
+		void Render(SDL_Renderer* renderer, std::unique_ptr<AssetManager>& assetStore, const Camera2D& camera)
 		{
 			this->renderer = renderer;
-			for (auto entity : GetSystemEntities())
+
+			//Anything may have moved or changed its sprite, rigidbody or not. Sprites staying in the same
+			//cells only cost the comparison.
+			for (const auto& entity : GetSystemEntities())
 			{
-				const TransformComponent transform = entity.GetComponent<TransformComponent>();
-				const SpriteComponent sprite = entity.GetComponent<SpriteComponent>();
+				grid.Update(entity.GetId(), GetBounds(entity));
+			}
+
+			const SDL_FRect view = camera.GetViewRect();
+			visibleIds.clear();
+			grid.Query(view, visibleIds);
+			//Same order every frame, whatever cells the sprites were found in.
+			std::sort(visibleIds.begin(), visibleIds.end());
+
+			//Consecutive sprites usually share their image, no need to look it up again.
+			const std::string* lastAssetId = nullptr;
+			SDL_Texture* lastTexture = nullptr;
+			SDL_Point atlasOffset = { 0, 0 };
+
+			visibleCount = 0;
+			spriteBatch.Begin();
+			for (int id : visibleIds)
+			{
+				const Entity& entity = entityById[id];
+				const TransformComponent& transform = entity.GetComponent<TransformComponent>();
+				const SpriteComponent& sprite = entity.GetComponent<SpriteComponent>();
 
-				//Section of our original sprite texture, useful for things such as tilemaps.
-				SDL_Rect srcRect = sprite.srcRect;
 				//Set the destination rectangle with the x,y position to be rendered.
-				SDL_Rect dstRect = {
-					static_cast<int>(transform.position.x),
-					static_cast<int>(transform.position.y),
-					static_cast<int>(sprite.width * transform.scale.x),
-					static_cast<int>(sprite.height * transform.scale.y)
+				const SDL_FRect worldRect = {
+					transform.position.x,
+					transform.position.y,
+					sprite.width * transform.scale.x,
+					sprite.height * transform.scale.y
 				};
 
-				SDL_RenderCopyEx(
-					renderer,
-					assetStore->GetTexture(sprite.assetId),
-					&srcRect,
-					&dstRect,
-					transform.rotation.x,
-					NULL,
-					SDL_FLIP_NONE);
+				//The grid is conservative, do the exact test before paying for the texture lookup.
+				if (!Overlaps(GetBounds(worldRect, transform.rotation.x), view))
+				{
+					continue;
+				}
+
+				if (!lastAssetId || *lastAssetId != sprite.assetId)
+				{
+					lastAssetId = &sprite.assetId;
+					//Images packed in an atlas are drawn from their page, whether the sprite was remapped or not.
+					const AtlasSprite packed = assetStore->GetAtlasSprite(sprite.assetId);
+					lastTexture = packed.texture.IsValid() ? packed.texture.Get() : assetStore->GetTexture(sprite.assetId);
+					atlasOffset = { packed.rect.x, packed.rect.y };
+				}
+
+				//srcRect is the section of our original sprite texture, useful for things such as tilemaps.
+				SDL_Rect srcRect = sprite.srcRect;
+				srcRect.x += atlasOffset.x;
+				srcRect.y += atlasOffset.y;
+				//SpriteBatch drops the sprites whose texture isn't loaded.
+				if (lastTexture)
+				{
+					spriteBatch.Draw(lastTexture, srcRect, camera.WorldToScreen(worldRect), transform.rotation.x, sprite.layer);
+					visibleCount++;
+				}
 			}
+
+			//Sorted by layer and then by texture: sprites drawn from an atlas go out in a handful of draws.
+			SDL_RenderSetClipRect(renderer, &camera.GetViewport());
+			spriteBatch.End(renderer);
+			SDL_RenderSetClipRect(renderer, nullptr);
 		}
 
+		/// <summary>
+		/// Draws with a camera covering the whole output, world units being pixels.
+		/// </summary>
+		void Render(SDL_Renderer* renderer, std::unique_ptr<AssetManager>& assetStore)
+		{
+			int width = 0, height = 0;
+			SDL_GetRendererOutputSize(renderer, &width, &height);
+			const Camera2D camera({ 0, 0, width, height }, glm::vec2(width * 0.5f, height * 0.5f));
+			Render(renderer, assetStore, camera);
+		}
+
+		size_t GetVisibleCount() const { return visibleCount; }
+
 		~RenderSystem()
 		{
 			SDL_DestroyRenderer(renderer);
 		}
 	};
-}
\ No newline at end of file
+}
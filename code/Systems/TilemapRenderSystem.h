@@ -0,0 +1,196 @@
+#pragma once
+/******************************************\
+ *  Copyright (c) Lorenzo Herran - 2021   *
+\******************************************/
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <sdl2/SDL.h>
+#include <ECS/ECS.h>
+#include <Components/TransformComponent.h>
+#include <Components/TilemapComponent.h>
+#include <AssetManager/AssetManager.h>
+#include <Render/Camera2D.h>
+
+namespace engine
+{
+	/// <summary>
+	/// Draws tilemaps chunk by chunk: a chunk is baked into a vertex batch the first time it's drawn and
+	/// after it changes, and then drawn with one SDL_RenderGeometry call whenever the camera sees it.
+	///
+	/// Tilemaps are submitted right away, so call it before RenderSystem::Render() for them to be behind the sprites.
+	/// </summary>
+	class TilemapRenderSystem : public System
+	{
+	private:
+		/// <summary>
+		/// 0 1 2 2 3 0 for every quad, shared by all the chunks.
+		/// </summary>
+		std::vector<int> indices;
+		/// <summary>
+		/// Chunk vertices moved to screen space, rebuilt for every draw.
+		/// </summary>
+		std::vector<SDL_Vertex> screenVertices;
+		std::vector<Entity> sortedEntities;
+
+		unsigned drawCalls = 0;
+		unsigned bakedChunks = 0;
+
+		void Bake(const TilemapComponent& tilemap, TilemapChunk& chunk, int chunkX, int chunkY, int textureWidth, int textureHeight)
+		{
+			chunk.vertices.clear();
+			chunk.dirty = false;
+
+			const int tilesetColumns = textureWidth / tilemap.tileSize;
+			if (tilesetColumns <= 0)
+			{
+				return;
+			}
+
+			const float size = float(tilemap.tileSize);
+			const float u = size / textureWidth;
+			const float v = size / textureHeight;
+			const SDL_Color white = { 255, 255, 255, 255 };
+
+			const int firstX = chunkX * tilemap.chunkSize;
+			const int firstY = chunkY * tilemap.chunkSize;
+			const int lastX = std::min(firstX + tilemap.chunkSize, tilemap.width);
+			const int lastY = std::min(firstY + tilemap.chunkSize, tilemap.height);
+			for (int y = firstY; y < lastY; y++)
+			{
+				for (int x = firstX; x < lastX; x++)
+				{
+					const uint16_t tile = tilemap.tiles[size_t(y) * tilemap.width + x];
+					if (tile == TilemapComponent::EMPTY_TILE)
+					{
+						continue;
+					}
+
+					const float left = x * size;
+					const float top = y * size;
+					const float srcU = (tile % tilesetColumns) * u;
+					const float srcV = (tile / tilesetColumns) * v;
+
+					chunk.vertices.push_back({ { left, top }, white, { srcU, srcV } });
+					chunk.vertices.push_back({ { left + size, top }, white, { srcU + u, srcV } });
+					chunk.vertices.push_back({ { left + size, top + size }, white, { srcU + u, srcV + v } });
+					chunk.vertices.push_back({ { left, top + size }, white, { srcU, srcV + v } });
+				}
+			}
+			bakedChunks++;
+		}
+
+		void Draw(SDL_Renderer* renderer, SDL_Texture* texture, const TilemapChunk& chunk, float scaleX, float scaleY, float offsetX, float offsetY)
+		{
+			const size_t quadCount = chunk.vertices.size() / 4;
+			for (size_t quad = indices.size() / 6; quad < quadCount; quad++)
+			{
+				const int first = int(quad * 4);
+				indices.insert(indices.end(), { first, first + 1, first + 2, first + 2, first + 3, first });
+			}
+
+			screenVertices.resize(chunk.vertices.size());
+			for (size_t i = 0; i < chunk.vertices.size(); i++)
+			{
+				const SDL_Vertex& vertex = chunk.vertices[i];
+				screenVertices[i] = { { vertex.position.x * scaleX + offsetX, vertex.position.y * scaleY + offsetY }, vertex.color, vertex.tex_coord };
+			}
+
+			SDL_RenderGeometry(renderer, texture, screenVertices.data(), int(screenVertices.size()), indices.data(), int(quadCount * 6));
+			drawCalls++;
+		}
+
+	public:
+		TilemapRenderSystem()
+		{
+			RequireComponent<TransformComponent>();
+			RequireComponent<TilemapComponent>();
+		}
+
+		void Render(SDL_Renderer* renderer, std::unique_ptr<AssetManager>& assetStore, const Camera2D& camera)
+		{
+			drawCalls = 0;
+			bakedChunks = 0;
+
+			sortedEntities = GetSystemEntities();
+			std::stable_sort(sortedEntities.begin(), sortedEntities.end(), [](const Entity& a, const Entity& b)
+				{
+					return a.GetComponent<TilemapComponent>().layer < b.GetComponent<TilemapComponent>().layer;
+				});
+
+			const SDL_FRect view = camera.GetViewRect();
+			const SDL_Rect& viewport = camera.GetViewport();
+			const float zoom = camera.GetZoom();
+
+			SDL_RenderSetClipRect(renderer, &viewport);
+			for (const auto& entity : sortedEntities)
+			{
+				const TransformComponent& transform = entity.GetComponent<TransformComponent>();
+				TilemapComponent& tilemap = entity.GetComponent<TilemapComponent>();
+				if (tilemap.chunks.empty() || transform.scale.x <= 0.f || transform.scale.y <= 0.f)
+				{
+					continue;
+				}
+
+				SDL_Texture* texture = assetStore->GetTexture(tilemap.assetId);
+				int textureWidth = 0, textureHeight = 0;
+				if (!texture || SDL_QueryTexture(texture, nullptr, nullptr, &textureWidth, &textureHeight) != 0)
+				{
+					continue;
+				}
+
+				//Range of chunks under the view, straight from the chunk grid: no need to test them one by one.
+				const float chunkWidth = tilemap.chunkSize * tilemap.tileSize * transform.scale.x;
+				const float chunkHeight = tilemap.chunkSize * tilemap.tileSize * transform.scale.y;
+				const int firstX = std::max(0, int(std::floor((view.x - transform.position.x) / chunkWidth)));
+				const int firstY = std::max(0, int(std::floor((view.y - transform.position.y) / chunkHeight)));
+				const int lastX = std::min(tilemap.chunkColumns - 1, int(std::floor((view.x + view.w - transform.position.x) / chunkWidth)));
+				const int lastY = std::min(tilemap.chunkRows - 1, int(std::floor((view.y + view.h - transform.position.y) / chunkHeight)));
+
+				//Map space to screen space: scale, then the camera.
+				const float scaleX = transform.scale.x * zoom;
+				const float scaleY = transform.scale.y * zoom;
+				const float offsetX = (transform.position.x - view.x) * zoom + viewport.x;
+				const float offsetY = (transform.position.y - view.y) * zoom + viewport.y;
+
+				for (int chunkY = firstY; chunkY <= lastY; chunkY++)
+				{
+					for (int chunkX = firstX; chunkX <= lastX; chunkX++)
+					{
+						TilemapChunk& chunk = tilemap.chunks[size_t(chunkY) * tilemap.chunkColumns + chunkX];
+						if (chunk.dirty)
+						{
+							Bake(tilemap, chunk, chunkX, chunkY, textureWidth, textureHeight);
+						}
+						if (!chunk.vertices.empty())
+						{
+							Draw(renderer, texture, chunk, scaleX, scaleY, offsetX, offsetY);
+						}
+					}
+				}
+			}
+			SDL_RenderSetClipRect(renderer, nullptr);
+		}
+
+		/// <summary>
+		/// Draws with a camera covering the whole output, world units being pixels.
+		/// </summary>
+		void Render(SDL_Renderer* renderer, std::unique_ptr<AssetManager>& assetStore)
+		{
+			int width = 0, height = 0;
+			SDL_GetRendererOutputSize(renderer, &width, &height);
+			const Camera2D camera({ 0, 0, width, height }, glm::vec2(width * 0.5f, height * 0.5f));
+			Render(renderer, assetStore, camera);
+		}
+
+		/// <summary>
+		/// Chunks drawn by the last Render().
+		/// </summary>
+		unsigned GetDrawCallCount() const { return drawCalls; }
+		/// <summary>
+		/// Chunks rebuilt by the last Render(), 0 on most frames.
+		/// </summary>
+		unsigned GetBakedChunkCount() const { return bakedChunks; }
+	};
+}
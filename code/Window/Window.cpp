@@ -5,6 +5,7 @@
 #include <Window/Window.h>
 #include <sdl2/SDL.h>
 #include <sdl2/SDL_mixer.h>
+#include <sdl2/SDL_ttf.h>
 #include <spdlog/spdlog.h>
 #include <gltk/OpenGL.hpp>
 
@@ -31,8 +32,15 @@ namespace engine
 			return;
 		}
 
+		if (TTF_Init() == -1)
+		{
+			spdlog::error("Error initializing SDL TTF");
+			return;
+		}
+
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+		//3.3 for instancing (see InstancedRenderer), 3.2 is still drawn without it.
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 
 		sdlWindow = SDL_CreateWindow
 		(
@@ -50,6 +58,13 @@ namespace engine
 		{
 			glContext = SDL_GL_CreateContext(sdlWindow);
 
+			if (!glContext)
+			{
+				spdlog::warn("No GL 3.3 context, trying 3.2 without instancing");
+				SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+				glContext = SDL_GL_CreateContext(sdlWindow);
+			}
+
 			if (!glContext)
 			{
 				spdlog::error("GL Context couldn't be initialized in SDL Window.");
@@ -71,6 +86,7 @@ namespace engine
 
 	Window::~Window()
 	{
+		TTF_Quit();
 		Mix_CloseAudio();
 		if (glContext) SDL_GL_DeleteContext(glContext);
 		if (sdlWindow) SDL_DestroyWindow(sdlWindow);
@@ -95,6 +111,15 @@ namespace engine
 		}
 	}
 
+	void Window::SetVisible(bool isVisible)
+	{
+		if (sdlWindow)
+		{
+			if (isVisible)	SDL_ShowWindow(sdlWindow);
+			else			SDL_HideWindow(sdlWindow);
+		}
+	}
+
 	unsigned Window::GetWidth() const
 	{
 		int width = 0, height;
@@ -122,4 +147,14 @@ namespace engine
 	{
 		if (glContext) SDL_GL_SwapWindow(sdlWindow);
 	}
+
+	bool Window::SetContextCurrent(bool isCurrent) const
+	{
+		if (!glContext || SDL_GL_MakeCurrent(sdlWindow, isCurrent ? glContext : nullptr) != 0)
+		{
+			spdlog::error(std::string("Couldn't change the current GL context: ") + SDL_GetError());
+			return false;
+		}
+		return true;
+	}
 }
\ No newline at end of file
@@ -41,6 +41,10 @@ namespace engine
 
 		void SetVsync(bool isEnabled);
 
+		/** Shows or hides the window. A hidden window keeps its GL context, which allows headless runs.
+		  */
+		void SetVisible(bool isVisible);
+
 		/** Borra el buffer de la pantalla usando OpenGL.
 		  */
 		void Clear() const;
@@ -49,5 +53,10 @@ namespace engine
 		  */
 		void SwapBuffers() const;
 
+		/** Makes the GL context current on the calling thread, or releases it from it. A context is current
+		  * on one thread at a time: the thread that has it must release it before another one takes it.
+		  */
+		bool SetContextCurrent(bool isCurrent) const;
+
 	};
 }
\ No newline at end of file
@@ -0,0 +1,393 @@
+/*
+ * GL FUNCTIONS
+ * Copyright © 2021+ Lorenzo Herran
+ *
+ * Distributed under the Boost Software License, version  1.0
+ * See documents/LICENSE.TXT or www.boost.org/LICENSE_1_0.txt
+ */
+
+#ifndef OPENGL_TOOLKIT_GL_FUNCTIONS_HEADER
+#define OPENGL_TOOLKIT_GL_FUNCTIONS_HEADER
+
+    /**
+     * Every entry point glad loads (core profile, GL 3.3), without the gl prefix. Expand it with a
+     * macro taking the name to go over all of them, as Recording_Backend does.
+     */
+
+    #define GLT_GL_FUNCTIONS(X) \
+        X(CullFace)                            \
+        X(FrontFace)                           \
+        X(Hint)                                \
+        X(LineWidth)                           \
+        X(PointSize)                           \
+        X(PolygonMode)                         \
+        X(Scissor)                             \
+        X(TexParameterf)                       \
+        X(TexParameterfv)                      \
+        X(TexParameteri)                       \
+        X(TexParameteriv)                      \
+        X(TexImage1D)                          \
+        X(TexImage2D)                          \
+        X(DrawBuffer)                          \
+        X(Clear)                               \
+        X(ClearColor)                          \
+        X(ClearStencil)                        \
+        X(ClearDepth)                          \
+        X(StencilMask)                         \
+        X(ColorMask)                           \
+        X(DepthMask)                           \
+        X(Disable)                             \
+        X(Enable)                              \
+        X(Finish)                              \
+        X(Flush)                               \
+        X(BlendFunc)                           \
+        X(LogicOp)                             \
+        X(StencilFunc)                         \
+        X(StencilOp)                           \
+        X(DepthFunc)                           \
+        X(PixelStoref)                         \
+        X(PixelStorei)                         \
+        X(ReadBuffer)                          \
+        X(ReadPixels)                          \
+        X(GetBooleanv)                         \
+        X(GetDoublev)                          \
+        X(GetError)                            \
+        X(GetFloatv)                           \
+        X(GetIntegerv)                         \
+        X(GetString)                           \
+        X(GetTexImage)                         \
+        X(GetTexParameterfv)                   \
+        X(GetTexParameteriv)                   \
+        X(GetTexLevelParameterfv)              \
+        X(GetTexLevelParameteriv)              \
+        X(IsEnabled)                           \
+        X(DepthRange)                          \
+        X(Viewport)                            \
+        X(DrawArrays)                          \
+        X(DrawElements)                        \
+        X(PolygonOffset)                       \
+        X(CopyTexImage1D)                      \
+        X(CopyTexImage2D)                      \
+        X(CopyTexSubImage1D)                   \
+        X(CopyTexSubImage2D)                   \
+        X(TexSubImage1D)                       \
+        X(TexSubImage2D)                       \
+        X(BindTexture)                         \
+        X(DeleteTextures)                      \
+        X(GenTextures)                         \
+        X(IsTexture)                           \
+        X(DrawRangeElements)                   \
+        X(TexImage3D)                          \
+        X(TexSubImage3D)                       \
+        X(CopyTexSubImage3D)                   \
+        X(ActiveTexture)                       \
+        X(SampleCoverage)                      \
+        X(CompressedTexImage3D)                \
+        X(CompressedTexImage2D)                \
+        X(CompressedTexImage1D)                \
+        X(CompressedTexSubImage3D)             \
+        X(CompressedTexSubImage2D)             \
+        X(CompressedTexSubImage1D)             \
+        X(GetCompressedTexImage)               \
+        X(BlendFuncSeparate)                   \
+        X(MultiDrawArrays)                     \
+        X(MultiDrawElements)                   \
+        X(PointParameterf)                     \
+        X(PointParameterfv)                    \
+        X(PointParameteri)                     \
+        X(PointParameteriv)                    \
+        X(BlendColor)                          \
+        X(BlendEquation)                       \
+        X(GenQueries)                          \
+        X(DeleteQueries)                       \
+        X(IsQuery)                             \
+        X(BeginQuery)                          \
+        X(EndQuery)                            \
+        X(GetQueryiv)                          \
+        X(GetQueryObjectiv)                    \
+        X(GetQueryObjectuiv)                   \
+        X(BindBuffer)                          \
+        X(DeleteBuffers)                       \
+        X(GenBuffers)                          \
+        X(IsBuffer)                            \
+        X(BufferData)                          \
+        X(BufferSubData)                       \
+        X(GetBufferSubData)                    \
+        X(MapBuffer)                           \
+        X(UnmapBuffer)                         \
+        X(GetBufferParameteriv)                \
+        X(GetBufferPointerv)                   \
+        X(BlendEquationSeparate)               \
+        X(DrawBuffers)                         \
+        X(StencilOpSeparate)                   \
+        X(StencilFuncSeparate)                 \
+        X(StencilMaskSeparate)                 \
+        X(AttachShader)                        \
+        X(BindAttribLocation)                  \
+        X(CompileShader)                       \
+        X(CreateProgram)                       \
+        X(CreateShader)                        \
+        X(DeleteProgram)                       \
+        X(DeleteShader)                        \
+        X(DetachShader)                        \
+        X(DisableVertexAttribArray)            \
+        X(EnableVertexAttribArray)             \
+        X(GetActiveAttrib)                     \
+        X(GetActiveUniform)                    \
+        X(GetAttachedShaders)                  \
+        X(GetAttribLocation)                   \
+        X(GetProgramiv)                        \
+        X(GetProgramInfoLog)                   \
+        X(GetShaderiv)                         \
+        X(GetShaderInfoLog)                    \
+        X(GetShaderSource)                     \
+        X(GetUniformLocation)                  \
+        X(GetUniformfv)                        \
+        X(GetUniformiv)                        \
+        X(GetVertexAttribdv)                   \
+        X(GetVertexAttribfv)                   \
+        X(GetVertexAttribiv)                   \
+        X(GetVertexAttribPointerv)             \
+        X(IsProgram)                           \
+        X(IsShader)                            \
+        X(LinkProgram)                         \
+        X(ShaderSource)                        \
+        X(UseProgram)                          \
+        X(Uniform1f)                           \
+        X(Uniform2f)                           \
+        X(Uniform3f)                           \
+        X(Uniform4f)                           \
+        X(Uniform1i)                           \
+        X(Uniform2i)                           \
+        X(Uniform3i)                           \
+        X(Uniform4i)                           \
+        X(Uniform1fv)                          \
+        X(Uniform2fv)                          \
+        X(Uniform3fv)                          \
+        X(Uniform4fv)                          \
+        X(Uniform1iv)                          \
+        X(Uniform2iv)                          \
+        X(Uniform3iv)                          \
+        X(Uniform4iv)                          \
+        X(UniformMatrix2fv)                    \
+        X(UniformMatrix3fv)                    \
+        X(UniformMatrix4fv)                    \
+        X(ValidateProgram)                     \
+        X(VertexAttrib1d)                      \
+        X(VertexAttrib1dv)                     \
+        X(VertexAttrib1f)                      \
+        X(VertexAttrib1fv)                     \
+        X(VertexAttrib1s)                      \
+        X(VertexAttrib1sv)                     \
+        X(VertexAttrib2d)                      \
+        X(VertexAttrib2dv)                     \
+        X(VertexAttrib2f)                      \
+        X(VertexAttrib2fv)                     \
+        X(VertexAttrib2s)                      \
+        X(VertexAttrib2sv)                     \
+        X(VertexAttrib3d)                      \
+        X(VertexAttrib3dv)                     \
+        X(VertexAttrib3f)                      \
+        X(VertexAttrib3fv)                     \
+        X(VertexAttrib3s)                      \
+        X(VertexAttrib3sv)                     \
+        X(VertexAttrib4Nbv)                    \
+        X(VertexAttrib4Niv)                    \
+        X(VertexAttrib4Nsv)                    \
+        X(VertexAttrib4Nub)                    \
+        X(VertexAttrib4Nubv)                   \
+        X(VertexAttrib4Nuiv)                   \
+        X(VertexAttrib4Nusv)                   \
+        X(VertexAttrib4bv)                     \
+        X(VertexAttrib4d)                      \
+        X(VertexAttrib4dv)                     \
+        X(VertexAttrib4f)                      \
+        X(VertexAttrib4fv)                     \
+        X(VertexAttrib4iv)                     \
+        X(VertexAttrib4s)                      \
+        X(VertexAttrib4sv)                     \
+        X(VertexAttrib4ubv)                    \
+        X(VertexAttrib4uiv)                    \
+        X(VertexAttrib4usv)                    \
+        X(VertexAttribPointer)                 \
+        X(UniformMatrix2x3fv)                  \
+        X(UniformMatrix3x2fv)                  \
+        X(UniformMatrix2x4fv)                  \
+        X(UniformMatrix4x2fv)                  \
+        X(UniformMatrix3x4fv)                  \
+        X(UniformMatrix4x3fv)                  \
+        X(ColorMaski)                          \
+        X(GetBooleani_v)                       \
+        X(GetIntegeri_v)                       \
+        X(Enablei)                             \
+        X(Disablei)                            \
+        X(IsEnabledi)                          \
+        X(BeginTransformFeedback)              \
+        X(EndTransformFeedback)                \
+        X(BindBufferRange)                     \
+        X(BindBufferBase)                      \
+        X(TransformFeedbackVaryings)           \
+        X(GetTransformFeedbackVarying)         \
+        X(ClampColor)                          \
+        X(BeginConditionalRender)              \
+        X(EndConditionalRender)                \
+        X(VertexAttribIPointer)                \
+        X(GetVertexAttribIiv)                  \
+        X(GetVertexAttribIuiv)                 \
+        X(VertexAttribI1i)                     \
+        X(VertexAttribI2i)                     \
+        X(VertexAttribI3i)                     \
+        X(VertexAttribI4i)                     \
+        X(VertexAttribI1ui)                    \
+        X(VertexAttribI2ui)                    \
+        X(VertexAttribI3ui)                    \
+        X(VertexAttribI4ui)                    \
+        X(VertexAttribI1iv)                    \
+        X(VertexAttribI2iv)                    \
+        X(VertexAttribI3iv)                    \
+        X(VertexAttribI4iv)                    \
+        X(VertexAttribI1uiv)                   \
+        X(VertexAttribI2uiv)                   \
+        X(VertexAttribI3uiv)                   \
+        X(VertexAttribI4uiv)                   \
+        X(VertexAttribI4bv)                    \
+        X(VertexAttribI4sv)                    \
+        X(VertexAttribI4ubv)                   \
+        X(VertexAttribI4usv)                   \
+        X(GetUniformuiv)                       \
+        X(BindFragDataLocation)                \
+        X(GetFragDataLocation)                 \
+        X(Uniform1ui)                          \
+        X(Uniform2ui)                          \
+        X(Uniform3ui)                          \
+        X(Uniform4ui)                          \
+        X(Uniform1uiv)                         \
+        X(Uniform2uiv)                         \
+        X(Uniform3uiv)                         \
+        X(Uniform4uiv)                         \
+        X(TexParameterIiv)                     \
+        X(TexParameterIuiv)                    \
+        X(GetTexParameterIiv)                  \
+        X(GetTexParameterIuiv)                 \
+        X(ClearBufferiv)                       \
+        X(ClearBufferuiv)                      \
+        X(ClearBufferfv)                       \
+        X(ClearBufferfi)                       \
+        X(GetStringi)                          \
+        X(IsRenderbuffer)                      \
+        X(BindRenderbuffer)                    \
+        X(DeleteRenderbuffers)                 \
+        X(GenRenderbuffers)                    \
+        X(RenderbufferStorage)                 \
+        X(GetRenderbufferParameteriv)          \
+        X(IsFramebuffer)                       \
+        X(BindFramebuffer)                     \
+        X(DeleteFramebuffers)                  \
+        X(GenFramebuffers)                     \
+        X(CheckFramebufferStatus)              \
+        X(FramebufferTexture1D)                \
+        X(FramebufferTexture2D)                \
+        X(FramebufferTexture3D)                \
+        X(FramebufferRenderbuffer)             \
+        X(GetFramebufferAttachmentParameteriv) \
+        X(GenerateMipmap)                      \
+        X(BlitFramebuffer)                     \
+        X(RenderbufferStorageMultisample)      \
+        X(FramebufferTextureLayer)             \
+        X(MapBufferRange)                      \
+        X(FlushMappedBufferRange)              \
+        X(BindVertexArray)                     \
+        X(DeleteVertexArrays)                  \
+        X(GenVertexArrays)                     \
+        X(IsVertexArray)                       \
+        X(DrawArraysInstanced)                 \
+        X(DrawElementsInstanced)               \
+        X(TexBuffer)                           \
+        X(PrimitiveRestartIndex)               \
+        X(CopyBufferSubData)                   \
+        X(GetUniformIndices)                   \
+        X(GetActiveUniformsiv)                 \
+        X(GetActiveUniformName)                \
+        X(GetUniformBlockIndex)                \
+        X(GetActiveUniformBlockiv)             \
+        X(GetActiveUniformBlockName)           \
+        X(UniformBlockBinding)                 \
+        X(DrawElementsBaseVertex)              \
+        X(DrawRangeElementsBaseVertex)         \
+        X(DrawElementsInstancedBaseVertex)     \
+        X(MultiDrawElementsBaseVertex)         \
+        X(ProvokingVertex)                     \
+        X(FenceSync)                           \
+        X(IsSync)                              \
+        X(DeleteSync)                          \
+        X(ClientWaitSync)                      \
+        X(WaitSync)                            \
+        X(GetInteger64v)                       \
+        X(GetSynciv)                           \
+        X(GetInteger64i_v)                     \
+        X(GetBufferParameteri64v)              \
+        X(FramebufferTexture)                  \
+        X(TexImage2DMultisample)               \
+        X(TexImage3DMultisample)               \
+        X(GetMultisamplefv)                    \
+        X(SampleMaski)                         \
+        X(BindFragDataLocationIndexed)         \
+        X(GetFragDataIndex)                    \
+        X(GenSamplers)                         \
+        X(DeleteSamplers)                      \
+        X(IsSampler)                           \
+        X(BindSampler)                         \
+        X(SamplerParameteri)                   \
+        X(SamplerParameteriv)                  \
+        X(SamplerParameterf)                   \
+        X(SamplerParameterfv)                  \
+        X(SamplerParameterIiv)                 \
+        X(SamplerParameterIuiv)                \
+        X(GetSamplerParameteriv)               \
+        X(GetSamplerParameterIiv)              \
+        X(GetSamplerParameterfv)               \
+        X(GetSamplerParameterIuiv)             \
+        X(QueryCounter)                        \
+        X(GetQueryObjecti64v)                  \
+        X(GetQueryObjectui64v)                 \
+        X(VertexAttribDivisor)                 \
+        X(VertexAttribP1ui)                    \
+        X(VertexAttribP1uiv)                   \
+        X(VertexAttribP2ui)                    \
+        X(VertexAttribP2uiv)                   \
+        X(VertexAttribP3ui)                    \
+        X(VertexAttribP3uiv)                   \
+        X(VertexAttribP4ui)                    \
+        X(VertexAttribP4uiv)                   \
+        X(VertexP2ui)                          \
+        X(VertexP2uiv)                         \
+        X(VertexP3ui)                          \
+        X(VertexP3uiv)                         \
+        X(VertexP4ui)                          \
+        X(VertexP4uiv)                         \
+        X(TexCoordP1ui)                        \
+        X(TexCoordP1uiv)                       \
+        X(TexCoordP2ui)                        \
+        X(TexCoordP2uiv)                       \
+        X(TexCoordP3ui)                        \
+        X(TexCoordP3uiv)                       \
+        X(TexCoordP4ui)                        \
+        X(TexCoordP4uiv)                       \
+        X(MultiTexCoordP1ui)                   \
+        X(MultiTexCoordP1uiv)                  \
+        X(MultiTexCoordP2ui)                   \
+        X(MultiTexCoordP2uiv)                  \
+        X(MultiTexCoordP3ui)                   \
+        X(MultiTexCoordP3uiv)                  \
+        X(MultiTexCoordP4ui)                   \
+        X(MultiTexCoordP4uiv)                  \
+        X(NormalP3ui)                          \
+        X(NormalP3uiv)                         \
+        X(ColorP3ui)                           \
+        X(ColorP3uiv)                          \
+        X(ColorP4ui)                           \
+        X(ColorP4uiv)                          \
+        X(SecondaryColorP3ui)                  \
+        X(SecondaryColorP3uiv)
+
+#endif
@@ -50,6 +50,16 @@
                 intensity = new_intensity;
             }
 
+            const Vector3 & get_color () const
+            {
+                return color;
+            }
+
+            float get_intensity () const
+            {
+                return intensity;
+            }
+
         public:
 
             virtual bool changes_shaders () const
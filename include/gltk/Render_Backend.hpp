@@ -0,0 +1,332 @@
+/*
+ * RENDER BACKEND
+ * Copyright © 2021+ Lorenzo Herran
+ *
+ * Distributed under the Boost Software License, version  1.0
+ * See documents/LICENSE.TXT or www.boost.org/LICENSE_1_0.txt
+ */
+
+#ifndef OPENGL_TOOLKIT_RENDER_BACKEND_HEADER
+#define OPENGL_TOOLKIT_RENDER_BACKEND_HEADER
+
+    #include <cstring>
+    #include <vector>
+    #include <OpenGL.hpp>
+    #include <Gl_Functions.hpp>
+
+    namespace glt
+    {
+
+        /**
+         * Where the GL calls of the toolkit and the engine end up. They all go through glad's function
+         * pointers, which initialize_opengl_extensions() points at the driver: a backend installs its
+         * own in their place, and puts the previous ones back when uninstalled.
+         */
+        class Render_Backend
+        {
+        public:
+
+            virtual ~Render_Backend() = default;
+
+            virtual const char * get_name () const = 0;
+
+            virtual bool install   () = 0;
+            virtual void uninstall () = 0;
+        };
+
+        /**
+         * Backend without GPU nor GL context: every call is counted in memory (and logged in order, if
+         * asked) and does nothing else. Scenes, materials and shaders can be built and drawn as usual,
+         * so the CPU side of the renderer can be measured on any machine.
+         *
+         * Calls return zero, but for what the toolkit needs to go on: names from glGen* and glCreate*,
+         * successful compilations, links and framebuffers, a GL 3.3 version and a mapping buffer.
+         * Nothing is stored: reading back buffers gives zeros.
+         *
+         * One thread at a time, like a GL context.
+         */
+        class Recording_Backend : public Render_Backend
+        {
+        public:
+
+            #define GLT_RECORDING_BACKEND_ENUM(NAME) NAME,
+
+            enum Function
+            {
+                GLT_GL_FUNCTIONS(GLT_RECORDING_BACKEND_ENUM)
+                FUNCTION_COUNT
+            };
+
+            #undef GLT_RECORDING_BACKEND_ENUM
+
+        private:
+
+            typedef void (APIENTRYP Entry_Point)();
+
+            template< typename FUNCTION, Function ID >
+            struct Recorder;
+
+            template< typename RESULT, typename ... ARGUMENTS, Function ID >
+            struct Recorder< RESULT (APIENTRYP)(ARGUMENTS ...), ID >
+            {
+                static RESULT APIENTRY call (ARGUMENTS ...)
+                {
+                    record (ID);
+                    return RESULT();
+                }
+            };
+
+        private:
+
+            Entry_Point         previous[FUNCTION_COUNT] = {};
+            unsigned            counts  [FUNCTION_COUNT] = {};
+            bool                logging = false;
+            std::vector< Function > log;
+
+            GLuint              next_name = 1;
+            std::vector< char > mapped;                                 ///< Memory handed out by glMapBufferRange.
+
+            static Recording_Backend *& active ()
+            {
+                static Recording_Backend * backend = nullptr;
+                return backend;
+            }
+
+            static void record (Function function)
+            {
+                Recording_Backend * backend = active ();
+
+                backend->counts[function]++;
+
+                if (backend->logging) backend->log.push_back (function);
+            }
+
+        private:
+
+            // Calls whose results the toolkit checks:
+
+            template< Function ID >
+            static void APIENTRY generate_names (GLsizei count, GLuint * names)
+            {
+                record (ID);
+                for (GLsizei i = 0; i < count; ++i) names[i] = active ()->next_name++;
+            }
+
+            template< Function ID >
+            static GLuint APIENTRY create_object ()
+            {
+                record (ID);
+                return active ()->next_name++;
+            }
+
+            static GLuint APIENTRY create_shader (GLenum )
+            {
+                return create_object< CreateShader > ();
+            }
+
+            template< Function ID >
+            static void APIENTRY get_object_parameter (GLuint , GLenum parameter, GLint * value)
+            {
+                record (ID);
+
+                switch (parameter)
+                {
+                    case GL_COMPILE_STATUS:
+                    case GL_LINK_STATUS:
+                    case GL_VALIDATE_STATUS:  *value = GL_TRUE; break;
+                    case GL_INFO_LOG_LENGTH:  *value = 1;       break;
+                    default:                  *value = 0;
+                }
+            }
+
+            template< Function ID >
+            static void APIENTRY get_info_log (GLuint , GLsizei size, GLsizei * length, GLchar * log)
+            {
+                record (ID);
+                if (length) *length = 0;
+                if (log && size > 0) log[0] = 0;
+            }
+
+            static void APIENTRY get_integer (GLenum parameter, GLint * value)
+            {
+                record (GetIntegerv);
+
+                switch (parameter)
+                {
+                    case GL_MAJOR_VERSION:
+                    case GL_MINOR_VERSION:                   *value = 3;   break;
+                    case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: *value = 256; break;
+                    default:                                 *value = 0;
+                }
+            }
+
+            static const GLubyte * APIENTRY get_string (GLenum )
+            {
+                record (GetString);
+                return reinterpret_cast< const GLubyte * >("3.3 Recording_Backend");
+            }
+
+            static GLenum APIENTRY check_framebuffer_status (GLenum )
+            {
+                record (CheckFramebufferStatus);
+                return GL_FRAMEBUFFER_COMPLETE;
+            }
+
+            static void * APIENTRY map_buffer_range (GLenum , GLintptr , GLsizeiptr size, GLbitfield )
+            {
+                record (MapBufferRange);
+
+                std::vector< char > & memory = active ()->mapped;
+
+                if (memory.size () < size_t(size)) memory.resize (size_t(size));
+
+                return memory.data ();
+            }
+
+            static GLboolean APIENTRY unmap_buffer (GLenum )
+            {
+                record (UnmapBuffer);
+                return GL_TRUE;
+            }
+
+            static void APIENTRY get_buffer_sub_data (GLenum , GLintptr , GLsizeiptr size, void * data)
+            {
+                record (GetBufferSubData);
+                std::memset (data, 0, size_t(size));
+            }
+
+        public:
+
+            Recording_Backend() = default;
+           ~Recording_Backend()
+            {
+                uninstall ();
+            }
+
+            Recording_Backend(const Recording_Backend & ) = delete;
+            Recording_Backend & operator = (const Recording_Backend & ) = delete;
+
+            const char * get_name () const override
+            {
+                return "recording";
+            }
+
+            /**
+             * Only one backend can be installed at a time: returns false if another one is.
+             */
+            bool install () override
+            {
+                if (active ()) return active () == this;
+
+                #define GLT_RECORDING_BACKEND_INSTALL(NAME)                                                \
+                    previous[NAME] = reinterpret_cast< Entry_Point >(glad_gl##NAME);                      \
+                    glad_gl##NAME  = &Recorder< decltype(glad_gl##NAME), NAME >::call;
+
+                GLT_GL_FUNCTIONS(GLT_RECORDING_BACKEND_INSTALL)
+
+                #undef GLT_RECORDING_BACKEND_INSTALL
+
+                glad_glGenBuffers          = &generate_names< GenBuffers          >;
+                glad_glGenTextures         = &generate_names< GenTextures         >;
+                glad_glGenVertexArrays     = &generate_names< GenVertexArrays     >;
+                glad_glGenFramebuffers     = &generate_names< GenFramebuffers     >;
+                glad_glGenRenderbuffers    = &generate_names< GenRenderbuffers    >;
+                glad_glGenQueries          = &generate_names< GenQueries          >;
+                glad_glGenSamplers         = &generate_names< GenSamplers         >;
+                glad_glCreateProgram       = &create_object < CreateProgram       >;
+                glad_glCreateShader        = &create_shader;
+                glad_glGetShaderiv         = &get_object_parameter< GetShaderiv  >;
+                glad_glGetProgramiv        = &get_object_parameter< GetProgramiv >;
+                glad_glGetShaderInfoLog    = &get_info_log< GetShaderInfoLog  >;
+                glad_glGetProgramInfoLog   = &get_info_log< GetProgramInfoLog >;
+                glad_glGetIntegerv         = &get_integer;
+                glad_glGetString           = &get_string;
+                glad_glCheckFramebufferStatus = &check_framebuffer_status;
+                glad_glMapBufferRange      = &map_buffer_range;
+                glad_glUnmapBuffer         = &unmap_buffer;
+                glad_glGetBufferSubData    = &get_buffer_sub_data;
+
+                active () = this;
+
+                return true;
+            }
+
+            void uninstall () override
+            {
+                if (active () != this) return;
+
+                #define GLT_RECORDING_BACKEND_UNINSTALL(NAME)                                              \
+                    glad_gl##NAME = reinterpret_cast< decltype(glad_gl##NAME) >(previous[NAME]);
+
+                GLT_GL_FUNCTIONS(GLT_RECORDING_BACKEND_UNINSTALL)
+
+                #undef GLT_RECORDING_BACKEND_UNINSTALL
+
+                active () = nullptr;
+            }
+
+        public:
+
+            static const char * get_function_name (Function function)
+            {
+                #define GLT_RECORDING_BACKEND_NAME(NAME) "gl" #NAME,
+
+                static const char * const names[] = { GLT_GL_FUNCTIONS(GLT_RECORDING_BACKEND_NAME) };
+
+                #undef GLT_RECORDING_BACKEND_NAME
+
+                return names[function];
+            }
+
+            /**
+             * Calls of a function since the last reset().
+             */
+            unsigned get_count (Function function) const
+            {
+                return counts[function];
+            }
+
+            unsigned get_total_count () const
+            {
+                unsigned total = 0; for (unsigned count : counts) total += count; return total;
+            }
+
+            /**
+             * Calls that draw something (glDraw* and glMultiDraw*, buffer selections left out).
+             */
+            unsigned get_draw_call_count () const
+            {
+                return counts[DrawArrays                 ] + counts[DrawElements                   ]
+                     + counts[DrawRangeElements          ] + counts[DrawArraysInstanced            ]
+                     + counts[DrawElementsInstanced      ] + counts[DrawElementsBaseVertex         ]
+                     + counts[DrawRangeElementsBaseVertex] + counts[DrawElementsInstancedBaseVertex]
+                     + counts[MultiDrawArrays            ] + counts[MultiDrawElements              ]
+                     + counts[MultiDrawElementsBaseVertex];
+            }
+
+            /**
+             * Keeps every call, in order, besides counting them. Off by default.
+             */
+            void set_logging (bool enabled)
+            {
+                logging = enabled;
+            }
+
+            const std::vector< Function > & get_log () const
+            {
+                return log;
+            }
+
+            /**
+             * Zeroes the counts and empties the log. The names handed out keep growing.
+             */
+            void reset ()
+            {
+                std::memset (counts, 0, sizeof(counts));
+                log.clear ();
+            }
+        };
+
+    }
+
+#endif
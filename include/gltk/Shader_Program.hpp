@@ -86,6 +86,11 @@
                 return (link_completed);
             }
 
+            operator GLuint () const
+            {
+                return (program_object_id);
+            }
+
         public:
 
             void attach (const Shader & shader)
@@ -102,6 +107,44 @@
 
             bool link ();
 
+            /**
+             * link() in two halves, so the links (and compiles) of several programs can be issued before
+             * waiting for any: drivers with KHR_parallel_shader_compile run them meanwhile.
+             * finish_link() also completes a glProgramBinary() load, which sets the same link status.
+             */
+            void start_link ()
+            {
+                link_completed = false;
+
+                glLinkProgram (program_object_id);
+            }
+
+            bool finish_link ()
+            {
+                GLint succeeded = GL_FALSE;
+
+                glGetProgramiv (program_object_id, GL_LINK_STATUS, &succeeded);
+
+                link_completed = succeeded == GL_TRUE;
+
+                if (!link_completed)
+                {
+                    GLint log_length = 0;
+
+                    glGetProgramiv (program_object_id, GL_INFO_LOG_LENGTH, &log_length);
+
+                    log_string.assign (size_t(log_length > 0 ? log_length : 1), '\0');
+
+                    glGetProgramInfoLog (program_object_id, log_length, nullptr, &log_string[0]);
+
+                    log_string.resize (log_string.find ('\0'));
+                }
+                else
+                    log_string.clear ();
+
+                return (link_completed);
+            }
+
             void use () const
             {
                 assert(is_usable ());